@@ -0,0 +1,104 @@
+#ifndef __FACEREC_STUB__CONTEXT_NODE_H__
+#define __FACEREC_STUB__CONTEXT_NODE_H__
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "objects.h"
+
+
+namespace facerec_stub {
+
+// json-like tree behind HContext handles
+class ContextNode
+{
+public:
+	enum Type
+	{
+		NONE,
+		OBJECT,
+		ARRAY,
+		STRING,
+		LONG,
+		DOUBLE,
+		BOOL,
+		DATA,
+		DYNAMIC_TEMPLATE_INDEX,
+		CONTEXT_TEMPLATE
+	};
+
+	ContextNode() : type(NONE), long_value(0), double_value(0), bool_value(false), data(NULL), data_size(0) {}
+
+	ContextNode(const ContextNode &other);
+
+	ContextNode& operator=(const ContextNode &other);
+
+	void clear();
+
+	// moves the content out of other, leaving it empty
+	void take(ContextNode &other);
+
+	bool equal(const ContextNode &other) const;
+
+	ContextNode* find(const std::string &key) const;
+
+	ContextNode& getOrInsert(const std::string &key);
+
+	ContextNode& at(const int64_t index) const;
+
+	size_t length() const;
+
+	Type type;
+
+	std::map<std::string, std::unique_ptr<ContextNode> > object;
+	std::vector<std::unique_ptr<ContextNode> > array;
+
+	std::string string_value;
+	int64_t long_value;
+	double double_value;
+	bool bool_value;
+
+	// data either points into owned_data or to a borrowed buffer
+	std::vector<unsigned char> owned_data;
+	unsigned char* data;
+	uint64_t data_size;
+
+	std::shared_ptr<DynamicIndexState> index;
+	TemplateDataPtr templ;
+
+	// handles returned by TDVContext_getDynamicTemplateIndex are owned by the node
+	std::unique_ptr<DynamicTemplateIndex> index_handle;
+};
+
+
+inline
+ContextNode& node(HContext* handle)
+{
+	FACEREC_STUB_ASSERT(0x1b2e6f0d, handle, "null context handle");
+
+	return *reinterpret_cast<ContextNode*>(handle);
+}
+
+inline
+HContext* handle(ContextNode* node)
+{
+	return reinterpret_cast<HContext*>(node);
+}
+
+
+std::string to_json(const ContextNode &node);
+
+void from_json(const std::string &json, ContextNode &node);
+
+
+// the template method of processing blocks and dynamic indexes
+// is the "modification" config value
+std::string config_method(const ContextNode &config);
+
+int64_t config_long(const ContextNode &config, const std::string &key, const int64_t default_value);
+
+}  // namespace facerec_stub
+
+#endif  // __FACEREC_STUB__CONTEXT_NODE_H__
@@ -0,0 +1,226 @@
+#ifndef __FACEREC_STUB__OBJECTS_H__
+#define __FACEREC_STUB__OBJECTS_H__
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "stub_api.h"
+
+
+namespace facerec_stub {
+
+// number of points returned by RawSample_getLandmarks
+const int landmarks_count = 21;
+
+// default length of a fake template, can be overridden
+// with the "stub_template_size" recognizer parameter
+const int default_template_size = 512;
+
+
+// config key = value overrides passed to the create* functions
+typedef std::map<std::string, double> Overrides;
+
+Overrides make_overrides(
+	const int32_t count,
+	char const* const* const keys,
+	double const* const values);
+
+double get_override(const Overrides &overrides, const std::string &key, const double default_value);
+
+// "/path/to/method12v30_recognizer.xml" -> "method12v30"
+std::string method_name_from_config(const std::string &ini_file);
+
+
+class Service : public ApiObject
+{
+public:
+	std::string conf_dir;
+};
+
+
+// immutable template payload, shared between
+// Template, ContextTemplate, TemplatesIndex and DynamicTemplateIndex
+struct TemplateData
+{
+	std::string method;
+	std::vector<float> values;
+};
+
+typedef std::shared_ptr<const TemplateData> TemplateDataPtr;
+
+// deterministic unit-norm template for the given seed
+TemplateDataPtr make_template(const std::string &method, const int size, const uint64_t seed);
+
+// euclidean distance between unit vectors, lies in [0, 2]
+float distance(const TemplateData &a, const TemplateData &b);
+
+struct MatchResult
+{
+	double distance;
+	double far;
+	double frr;
+	double score;
+};
+
+MatchResult match_result_by_distance(const double distance);
+
+void save_template(const TemplateData &templ, void* stream, write_func_type write_func);
+
+TemplateDataPtr load_template(void* stream, read_func_type read_func);
+
+
+class Template : public ApiObject
+{
+public:
+	Template(const TemplateDataPtr &data) : data(data) {}
+
+	const TemplateDataPtr data;
+};
+
+
+class TemplatesIndex : public ApiObject
+{
+public:
+	std::string method;
+	std::vector<TemplateDataPtr> templates;
+	int64_t capacity;
+	int32_t search_threads_count;
+};
+
+
+class Recognizer : public ApiObject
+{
+public:
+	std::string method;
+	int template_size;
+};
+
+
+struct Rect
+{
+	int32_t x;
+	int32_t y;
+	int32_t width;
+	int32_t height;
+};
+
+
+class RawSample : public ApiObject
+{
+public:
+	int32_t id;
+	int32_t frame_id;
+	Rect rect;
+	int32_t image_width;
+	int32_t image_height;
+	float yaw;
+	float pitch;
+	float roll;
+	float score;
+	std::vector<float> landmarks;  // x, y, z triples
+};
+
+// i-th of faces_count fake detections on an image of the given size
+RawSample* make_sample(
+	const int32_t image_width,
+	const int32_t image_height,
+	const int i,
+	const int faces_count,
+	const int32_t id,
+	const int32_t frame_id);
+
+
+class Capturer : public ApiObject
+{
+public:
+	int faces_count;
+};
+
+
+// flat storage read by the VideoWorker static callbacks
+// and by FacerecService::getLicenseState
+class StructStorage : public ApiObject
+{
+public:
+	struct Field
+	{
+		int64_t int64_value;
+		double double_value;
+		void* pointer_value;
+	};
+
+	std::unordered_map<int32_t, Field> fields;
+
+	Field& operator[](const int32_t field_id)
+	{
+		return fields[field_id];
+	}
+
+	const Field& at(const int32_t field_id) const;
+};
+
+
+class VideoWorker : public ApiObject
+{
+public:
+	struct Callback
+	{
+		int32_t id;
+		void* func;
+		void* userdata;
+	};
+
+	std::mutex mutex;
+
+	pbio::facerec::capi::VideoWorker_TrackingCallbackFunc tracking_callback;
+
+	std::vector<Callback> tracking_callbacks;
+	std::vector<Callback> tracking_callbacks_u;
+
+	// callbacks of the other kinds are registered and removed,
+	// but never called since the stub does not create templates
+	std::vector<Callback> other_callbacks;
+
+	int32_t next_callback_id;
+
+	void* this_vw;
+
+	std::string method;
+	int32_t streams_count;
+	int faces_count;
+	std::vector<int32_t> frame_ids;
+
+	std::string errors;
+};
+
+
+struct DynamicIndexState
+{
+	std::string method;
+	uint64_t capacity;
+	std::vector<std::pair<std::string, TemplateDataPtr> > elements;
+	std::unordered_map<std::string, size_t> positions;
+};
+
+// DynamicTemplateIndex handles are not ApiObject's,
+// they are released with DynamicTemplateIndex_destructor
+class DynamicTemplateIndex
+{
+public:
+	DynamicTemplateIndex(const std::shared_ptr<DynamicIndexState> &state) : state(state) {}
+
+	const std::shared_ptr<DynamicIndexState> state;
+};
+
+DynamicTemplateIndex& dynamic_index(const void* handle);
+
+void dynamic_index_add(DynamicIndexState &state, const TemplateDataPtr &templ, const std::string &uuid);
+
+}  // namespace facerec_stub
+
+#endif  // __FACEREC_STUB__OBJECTS_H__
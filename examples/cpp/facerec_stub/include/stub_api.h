@@ -0,0 +1,176 @@
+#ifndef __FACEREC_STUB__STUB_API_H__
+#define __FACEREC_STUB__STUB_API_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <exception>
+#include <string>
+
+#include <pbio/c_api_functions_list_macro.h>
+
+
+// every symbol that pbio::import::DllHandle resolves is declared here
+// with default visibility, so each definition in src/ is checked
+// against the exact signature from c_api_functions_list_macro.h
+
+#define FACEREC_STUB_EXPORT __attribute__((visibility("default")))
+
+#define FACEREC_STUB_583E_DECL(rtype, name, typed_args, args, return) \
+	extern "C" FACEREC_STUB_EXPORT rtype _583e_ADD_NAMESPACE(name) typed_args;
+
+#define FACEREC_STUB_TDV_DECL(rtype, name, typed_args, args, return) \
+	extern "C" FACEREC_STUB_EXPORT rtype name typed_args;
+
+__583e_FLIST(FACEREC_STUB_583E_DECL)
+__TDV_FLIST(FACEREC_STUB_TDV_DECL)
+__TDV_METASDK_FLIST(FACEREC_STUB_TDV_DECL)
+
+#define FACEREC_STUB_583E(name) _583e_ADD_NAMESPACE(name)
+
+
+namespace facerec_stub {
+
+typedef pbio::facerec::capi::binary_stream_write_func_type write_func_type;
+typedef pbio::facerec::capi::binary_stream_read_func_type read_func_type;
+
+
+// base of everything that the wrappers release with apiObject_destructor
+class ApiObject
+{
+public:
+	virtual ~ApiObject() {}
+};
+
+
+class Error : public std::exception
+{
+public:
+	Error(const uint32_t code, const std::string &what) :
+		_code(code),
+		_what(what)
+	{
+	}
+
+	virtual const char* what() const throw() override
+	{
+		return _what.c_str();
+	}
+
+	uint32_t code() const
+	{
+		return _code;
+	}
+
+private:
+	uint32_t _code;
+	std::string _what;
+};
+
+
+class ApiException : public ApiObject
+{
+public:
+	ApiException(const uint32_t code, const std::string &what) :
+		code(code),
+		what(what)
+	{
+	}
+
+	const uint32_t code;
+	const std::string what;
+};
+
+
+#define FACEREC_STUB_ASSERT(code, expr, description) \
+	do \
+	{ \
+		if(!(expr)) \
+		{ \
+			throw facerec_stub::Error( \
+				code, \
+				"Error in facerec stub: " + std::string(description) + ", error code: " #code "."); \
+		} \
+	} while(0)
+
+
+inline
+void store_exception(void** out_exception, ApiException* exception)
+{
+	*out_exception = static_cast<ApiObject*>(exception);
+}
+
+inline
+void store_exception(ContextEH** out_exception, ApiException* exception)
+{
+	*out_exception = reinterpret_cast<ContextEH*>(static_cast<ApiObject*>(exception));
+}
+
+inline
+ApiException& context_exception(ContextEH* exception)
+{
+	return *static_cast<ApiException*>(reinterpret_cast<ApiObject*>(exception));
+}
+
+
+// runs func and converts any thrown error into an exception object
+// returned through out_exception, as the real library does
+template<typename OutException, typename Func>
+auto guard(OutException* out_exception, Func func) -> decltype(func())
+{
+	try
+	{
+		return func();
+	}
+	catch(const Error &e)
+	{
+		store_exception(out_exception, new ApiException(e.code(), e.what()));
+	}
+	catch(const std::exception &e)
+	{
+		store_exception(out_exception, new ApiException(0x7e3a11c4, std::string("Error in facerec stub: ") + e.what()));
+	}
+
+	typedef decltype(func()) result_type;
+	return result_type();
+}
+
+
+template<typename T>
+T& object(const void* handle)
+{
+	FACEREC_STUB_ASSERT(0x2f1c80ab, handle, "null object handle");
+
+	return *static_cast<T*>(reinterpret_cast<ApiObject*>(const_cast<void*>(handle)));
+}
+
+template<typename Handle>
+Handle* handle(ApiObject* object)
+{
+	return reinterpret_cast<Handle*>(object);
+}
+
+
+inline
+void write_string(void* stream, write_func_type write_func, const std::string &str)
+{
+	write_func(stream, str.data(), str.size());
+}
+
+template<typename T>
+void write_value(void* stream, write_func_type write_func, const T &value)
+{
+	write_func(stream, &value, sizeof(value));
+}
+
+template<typename T>
+T read_value(void* stream, read_func_type read_func)
+{
+	T value = T();
+	read_func(stream, &value, sizeof(value));
+	return value;
+}
+
+}  // namespace facerec_stub
+
+#endif  // __FACEREC_STUB__STUB_API_H__
@@ -0,0 +1,313 @@
+#include <vector>
+
+#include "objects.h"
+
+
+using namespace facerec_stub;
+
+namespace {
+
+const int32_t encoded_image_width = 640;
+const int32_t encoded_image_height = 480;
+
+void capture(
+	const Capturer &capturer,
+	const int32_t image_width,
+	const int32_t image_height,
+	void* result_pointers_vector,
+	pbio::facerec::capi::assign_pointers_vector_func_type assign_pointers_vector_func)
+{
+	FACEREC_STUB_ASSERT(0x44c0e1d9, image_width > 0 && image_height > 0, "bad image size");
+
+	std::vector<void*> samples;
+
+	for(int i = 0; i < capturer.faces_count; ++i)
+		samples.push_back(static_cast<ApiObject*>(make_sample(image_width, image_height, i, capturer.faces_count, i, 0)));
+
+	assign_pointers_vector_func(result_pointers_vector, samples.data(), static_cast<int32_t>(samples.size()));
+}
+
+const RawSample& sample(const void* rawsample)
+{
+	return object<RawSample>(rawsample);
+}
+
+}  // namespace
+
+
+extern "C" {
+
+void FACEREC_STUB_583E(Capturer_capture_raw_image)(
+	void* capturer,
+	const void* /*image_data*/,
+	int32_t image_width,
+	int32_t image_height,
+	int32_t /*image_format*/,
+	void* result_pointers_vector,
+	pbio::facerec::capi::assign_pointers_vector_func_type assign_pointers_vector_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		capture(object<Capturer>(capturer), image_width, image_height, result_pointers_vector, assign_pointers_vector_func);
+	});
+}
+
+void FACEREC_STUB_583E(Capturer_capture_raw_image_with_crop)(
+	void* capturer,
+	const void* /*image_data*/,
+	int32_t image_width,
+	int32_t image_height,
+	int32_t /*image_format*/,
+	int32_t /*image_with_crop*/,
+	int32_t /*image_crop_info_offset_x*/,
+	int32_t /*image_crop_info_offset_y*/,
+	int32_t /*image_crop_info_data_image_width*/,
+	int32_t /*image_crop_info_data_image_height*/,
+	void* result_pointers_vector,
+	pbio::facerec::capi::assign_pointers_vector_func_type assign_pointers_vector_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		capture(object<Capturer>(capturer), image_width, image_height, result_pointers_vector, assign_pointers_vector_func);
+	});
+}
+
+void FACEREC_STUB_583E(Capturer_capture_encoded_image)(
+	void* capturer,
+	const void* /*data*/,
+	int32_t /*data_size*/,
+	void* result_pointers_vector,
+	pbio::facerec::capi::assign_pointers_vector_func_type assign_pointers_vector_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		capture(object<Capturer>(capturer), encoded_image_width, encoded_image_height, result_pointers_vector, assign_pointers_vector_func);
+	});
+}
+
+void FACEREC_STUB_583E(Capturer_resetHistory)(
+	void* /*capturer*/,
+	void** /*out_exception*/)
+{
+}
+
+int32_t FACEREC_STUB_583E(Capturer_getType)(
+	void* capturer,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		object<Capturer>(capturer);
+
+		return int32_t(0);
+	});
+}
+
+void FACEREC_STUB_583E(Capturer_setParameter)(
+	void* capturer,
+	const char* param_name,
+	double param_value,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		if(std::string(param_name) == "stub_faces_count")
+			object<Capturer>(capturer).faces_count = static_cast<int>(param_value);
+	});
+}
+
+
+void FACEREC_STUB_583E(RawSample_getRectangle)(
+	void* rawsample,
+	int32_t *x,
+	int32_t *y,
+	int32_t *width,
+	int32_t *height,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		const Rect &rect = sample(rawsample).rect;
+
+		*x = rect.x;
+		*y = rect.y;
+		*width = rect.width;
+		*height = rect.height;
+	});
+}
+
+void FACEREC_STUB_583E(RawSample_getLandmarks)(
+	void* rawsample,
+	void* landmarks_floats_vector,
+	pbio::facerec::capi::assign_floats_vector_func_type assign_floats_vector_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		const std::vector<float> &landmarks = sample(rawsample).landmarks;
+
+		assign_floats_vector_func(landmarks_floats_vector, landmarks.data(), static_cast<int32_t>(landmarks.size()));
+	});
+}
+
+void FACEREC_STUB_583E(RawSample_getIrisLandmarks)(
+	void* rawsample,
+	void* landmarks_floats_vector,
+	pbio::facerec::capi::assign_floats_vector_func_type assign_floats_vector_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		sample(rawsample);
+
+		assign_floats_vector_func(landmarks_floats_vector, NULL, 0);
+	});
+}
+
+void FACEREC_STUB_583E(RawSample_getLeftEye)(
+	void* rawsample,
+	float* point_x,
+	float* point_y,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		const Rect &rect = sample(rawsample).rect;
+
+		*point_x = rect.x + rect.width * 0.3f;
+		*point_y = rect.y + rect.height * 0.4f;
+	});
+}
+
+void FACEREC_STUB_583E(RawSample_getRightEye)(
+	void* rawsample,
+	float* point_x,
+	float* point_y,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		const Rect &rect = sample(rawsample).rect;
+
+		*point_x = rect.x + rect.width * 0.7f;
+		*point_y = rect.y + rect.height * 0.4f;
+	});
+}
+
+void FACEREC_STUB_583E(RawSample_getAngles)(
+	void* rawsample,
+	float* yaw,
+	float* pitch,
+	float* roll,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		const RawSample &s = sample(rawsample);
+
+		*yaw = s.yaw;
+		*pitch = s.pitch;
+		*roll = s.roll;
+	});
+}
+
+int32_t FACEREC_STUB_583E(RawSample_getID)(
+	void* rawsample,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return sample(rawsample).id;
+	});
+}
+
+int32_t FACEREC_STUB_583E(RawSample_getType)(
+	void* rawsample,
+	void** out_exception)
+{
+	// SAMPLE_TYPE_FRONTAL
+	return guard(out_exception, [&]
+	{
+		sample(rawsample);
+
+		return int32_t(0);
+	});
+}
+
+float FACEREC_STUB_583E(RawSample_getScore)(
+	void* rawsample,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return sample(rawsample).score;
+	});
+}
+
+float FACEREC_STUB_583E(RawSample_getFaceVisibilityScore)(
+	void* rawsample,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return sample(rawsample).score;
+	});
+}
+
+int32_t FACEREC_STUB_583E(RawSample_getFrameID)(
+	void* rawsample,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return sample(rawsample).frame_id;
+	});
+}
+
+int32_t FACEREC_STUB_583E(RawSample_hasOriginalImage)(
+	void* rawsample,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		sample(rawsample);
+
+		return int32_t(0);
+	});
+}
+
+void FACEREC_STUB_583E(RawSample_getFaceCutRectangle)(
+	void* rawsample,
+	int32_t /*cut_type*/,
+	float* corners,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		const Rect &rect = sample(rawsample).rect;
+
+		const float x[4] = {float(rect.x), float(rect.x + rect.width), float(rect.x + rect.width), float(rect.x)};
+		const float y[4] = {float(rect.y), float(rect.y), float(rect.y + rect.height), float(rect.y + rect.height)};
+
+		for(int i = 0; i < 4; ++i)
+		{
+			corners[i * 2 + 0] = x[i];
+			corners[i * 2 + 1] = y[i];
+		}
+	});
+}
+
+pbio::facerec::RawSampleImpl* FACEREC_STUB_583E(RawSample_downscaleToPreferredSize)(
+	void* rawsample,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return handle<pbio::facerec::RawSampleImpl>(new RawSample(sample(rawsample)));
+	});
+}
+
+}  // extern "C"
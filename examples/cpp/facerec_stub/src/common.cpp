@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "objects.h"
+
+
+namespace facerec_stub {
+
+namespace {
+
+const char template_magic[] = "FSTB";
+
+class Lcg
+{
+public:
+	Lcg(const uint64_t seed) : _state(seed * 6364136223846793005ULL + 1442695040888963407ULL) {}
+
+	// uniform in [-1, 1)
+	float next()
+	{
+		_state = _state * 6364136223846793005ULL + 1442695040888963407ULL;
+		return static_cast<float>((_state >> 40) & 0xffffff) / float(1 << 23) - 1.f;
+	}
+
+private:
+	uint64_t _state;
+};
+
+}  // namespace
+
+
+Overrides make_overrides(
+	const int32_t count,
+	char const* const* const keys,
+	double const* const values)
+{
+	Overrides result;
+
+	for(int32_t i = 0; i < count; ++i)
+		result[keys[i]] = values[i];
+
+	return result;
+}
+
+
+double get_override(const Overrides &overrides, const std::string &key, const double default_value)
+{
+	const Overrides::const_iterator it = overrides.find(key);
+
+	return it == overrides.end() ? default_value : it->second;
+}
+
+
+std::string method_name_from_config(const std::string &ini_file)
+{
+	std::string name = ini_file.substr(ini_file.find_last_of("/\\") + 1);
+
+	name = name.substr(0, name.find('.'));
+
+	const std::string suffix = "_recognizer";
+
+	if(name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+		name.resize(name.size() - suffix.size());
+
+	return name;
+}
+
+
+TemplateDataPtr make_template(const std::string &method, const int size, const uint64_t seed)
+{
+	TemplateData* const result = new TemplateData();
+
+	result->method = method;
+	result->values.resize(size);
+
+	Lcg lcg(seed);
+
+	double norm = 0;
+
+	for(int i = 0; i < size; ++i)
+	{
+		result->values[i] = lcg.next();
+		norm += result->values[i] * result->values[i];
+	}
+
+	const float scale = norm > 0 ? static_cast<float>(1 / std::sqrt(norm)) : 0.f;
+
+	for(int i = 0; i < size; ++i)
+		result->values[i] *= scale;
+
+	return TemplateDataPtr(result);
+}
+
+
+float distance(const TemplateData &a, const TemplateData &b)
+{
+	FACEREC_STUB_ASSERT(0x3c9d6b21, a.method == b.method, "templates were created with different methods");
+	FACEREC_STUB_ASSERT(0x3c9d6b21, a.values.size() == b.values.size(), "templates have different sizes");
+
+	float sum = 0;
+
+	for(size_t i = 0; i < a.values.size(); ++i)
+	{
+		const float d = a.values[i] - b.values[i];
+		sum += d * d;
+	}
+
+	return std::sqrt(sum);
+}
+
+
+MatchResult match_result_by_distance(const double distance)
+{
+	const double t = std::min(std::max(distance / 2, 0.), 1.);
+
+	MatchResult result;
+
+	result.distance = distance;
+	result.far = t;
+	result.frr = 1 - t;
+	result.score = 1 - t;
+
+	return result;
+}
+
+
+void save_template(const TemplateData &templ, void* stream, write_func_type write_func)
+{
+	write_func(stream, template_magic, 4);
+	write_value(stream, write_func, static_cast<uint32_t>(templ.method.size()));
+	write_string(stream, write_func, templ.method);
+	write_value(stream, write_func, static_cast<uint32_t>(templ.values.size()));
+	write_func(stream, templ.values.data(), templ.values.size() * sizeof(float));
+}
+
+
+TemplateDataPtr load_template(void* stream, read_func_type read_func)
+{
+	char magic[4] = {0};
+
+	read_func(stream, magic, 4);
+
+	FACEREC_STUB_ASSERT(0x6a0e3f52, std::memcmp(magic, template_magic, 4) == 0, "bad template data");
+
+	TemplateData* const result = new TemplateData();
+	TemplateDataPtr result_ptr(result);
+
+	const uint32_t method_size = read_value<uint32_t>(stream, read_func);
+
+	FACEREC_STUB_ASSERT(0x6a0e3f52, method_size < 1024, "bad template data");
+
+	result->method.resize(method_size);
+	read_func(stream, &result->method[0], method_size);
+
+	const uint32_t size = read_value<uint32_t>(stream, read_func);
+
+	FACEREC_STUB_ASSERT(0x6a0e3f52, size < (1 << 20), "bad template data");
+
+	result->values.resize(size);
+	read_func(stream, result->values.data(), size * sizeof(float));
+
+	return result_ptr;
+}
+
+
+RawSample* make_sample(
+	const int32_t image_width,
+	const int32_t image_height,
+	const int i,
+	const int faces_count,
+	const int32_t id,
+	const int32_t frame_id)
+{
+	RawSample* const sample = new RawSample();
+
+	const int32_t size = std::max(1, std::min(image_width / (faces_count + 1), image_height / 2));
+
+	sample->id = id;
+	sample->frame_id = frame_id;
+	sample->rect.x = (i * image_width) / std::max(1, faces_count) + size / 4;
+	sample->rect.y = image_height / 4;
+	sample->rect.width = size;
+	sample->rect.height = size;
+	sample->image_width = image_width;
+	sample->image_height = image_height;
+	sample->yaw = static_cast<float>((i * 7) % 21 - 10);
+	sample->pitch = static_cast<float>((i * 3) % 11 - 5);
+	sample->roll = 0.f;
+	sample->score = 0.99f;
+
+	sample->landmarks.resize(landmarks_count * 3);
+
+	for(int k = 0; k < landmarks_count; ++k)
+	{
+		// points on a 5 x 5 grid inside the face rectangle
+		sample->landmarks[k * 3 + 0] = sample->rect.x + sample->rect.width * ((k % 5) + 0.5f) / 5;
+		sample->landmarks[k * 3 + 1] = sample->rect.y + sample->rect.height * ((k / 5) + 0.5f) / 5;
+		sample->landmarks[k * 3 + 2] = 0.f;
+	}
+
+	return sample;
+}
+
+
+const StructStorage::Field& StructStorage::at(const int32_t field_id) const
+{
+	const std::unordered_map<int32_t, Field>::const_iterator it = fields.find(field_id);
+
+	FACEREC_STUB_ASSERT(0x0d4f9a63, it != fields.end(), "no such struct storage field");
+
+	return it->second;
+}
+
+
+DynamicTemplateIndex& dynamic_index(const void* handle)
+{
+	FACEREC_STUB_ASSERT(0x2f1c80ab, handle, "null object handle");
+
+	return *static_cast<DynamicTemplateIndex*>(const_cast<void*>(handle));
+}
+
+
+void dynamic_index_add(DynamicIndexState &state, const TemplateDataPtr &templ, const std::string &uuid)
+{
+	FACEREC_STUB_ASSERT(0x4b7e2c90, templ->method == state.method, "template method does not match the index method");
+	FACEREC_STUB_ASSERT(0x4b7e2c91, state.positions.find(uuid) == state.positions.end(), "uuid is already in the index");
+
+	state.positions[uuid] = state.elements.size();
+	state.elements.push_back(std::make_pair(uuid, templ));
+
+	state.capacity = std::max<uint64_t>(state.capacity, state.elements.size());
+}
+
+}  // namespace facerec_stub
@@ -0,0 +1,625 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "context_node.h"
+
+
+using namespace facerec_stub;
+
+namespace {
+
+const int32_t encoded_image_width = 640;
+const int32_t encoded_image_height = 480;
+
+// pbio::Context::Format
+int32_t image_channels(const int32_t format)
+{
+	switch(format)
+	{
+		case 0:  // FORMAT_BGR
+		case 1:  // FORMAT_RGB
+			return 3;
+		case 2:  // FORMAT_BGRA8888
+			return 4;
+		default:  // YUV formats are stored as a single plane of height * 3 / 2 rows
+			return 1;
+	}
+}
+
+const char* image_color_space(const int32_t format)
+{
+	switch(format)
+	{
+		case 0: return "BGR";
+		case 1: return "RGB";
+		case 2: return "BGRA";
+		case 3: return "YUV420";
+		case 4: return "NV12";
+		case 5: return "NV21";
+		default: return "BGR";
+	}
+}
+
+ContextNode* make_image(const uint8_t* data, const int32_t width, const int32_t height, const int32_t format)
+{
+	FACEREC_STUB_ASSERT(0x44c0e1d9, width > 0 && height > 0, "bad image size");
+
+	const int32_t channels = image_channels(format);
+	const int64_t rows = channels == 1 ? height * 3 / 2 : height;
+	const uint64_t size = rows * width * channels;
+
+	std::unique_ptr<ContextNode> result(new ContextNode());
+	ContextNode &image = result->getOrInsert("image");
+
+	image.getOrInsert("format").type = ContextNode::STRING;
+	image.getOrInsert("format").string_value = "NDARRAY";
+	image.getOrInsert("color_space").type = ContextNode::STRING;
+	image.getOrInsert("color_space").string_value = image_color_space(format);
+	image.getOrInsert("dtype").type = ContextNode::STRING;
+	image.getOrInsert("dtype").string_value = "uint8_t";
+
+	ContextNode &blob = image.getOrInsert("blob");
+
+	blob.type = ContextNode::DATA;
+
+	if(data)
+		blob.owned_data.assign(data, data + size);
+	else
+		blob.owned_data.assign(size, 0);
+
+	blob.data = blob.owned_data.data();
+	blob.data_size = size;
+
+	ContextNode &shape = image.getOrInsert("shape");
+
+	shape.type = ContextNode::ARRAY;
+
+	for(const int64_t dim : {rows, int64_t(width), int64_t(channels)})
+	{
+		shape.array.emplace_back(new ContextNode());
+		shape.array.back()->type = ContextNode::LONG;
+		shape.array.back()->long_value = dim;
+	}
+
+	return result.release();
+}
+
+ContextNode& checked(HContext* ctx, const ContextNode::Type type, const char* what)
+{
+	ContextNode &n = node(ctx);
+
+	FACEREC_STUB_ASSERT(0x0b83d5e5, n.type == type, std::string("context is not ") + what);
+
+	return n;
+}
+
+void put_data(ContextNode &n, const unsigned char* val, const uint64_t copy_sz)
+{
+	ContextNode data;
+
+	data.type = ContextNode::DATA;
+
+	if(copy_sz)
+	{
+		if(val)
+			data.owned_data.assign(val, val + copy_sz);
+		else
+			data.owned_data.assign(copy_sz, 0);
+
+		data.data = data.owned_data.data();
+		data.data_size = copy_sz;
+	}
+	else
+	{
+		// copy_sz == 0 stores the pointer without copying
+		data.data = const_cast<unsigned char*>(val);
+		data.data_size = 0;
+	}
+
+	n.take(data);
+}
+
+}  // namespace
+
+
+extern "C" {
+
+const char* TDVException_getMessage(ContextEH* errorHandler)
+{
+	return context_exception(errorHandler).what.c_str();
+}
+
+unsigned int TDVException_getErrorCode(ContextEH* errorHandler)
+{
+	return context_exception(errorHandler).code;
+}
+
+void TDVException_deleteException(ContextEH* errorHandler)
+{
+	delete &context_exception(errorHandler);
+}
+
+
+HContext* TDVContext_create(ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return handle(new ContextNode());
+	});
+}
+
+void TDVContext_destroy(HContext* ctx, ContextEH** errorHandler)
+{
+	guard(errorHandler, [&]
+	{
+		delete &node(ctx);
+	});
+}
+
+HContext* TDVContext_createFromEncodedImage(const uint8_t* data, uint64_t dataSize, ContextEH** errorHandler)
+{
+	// the stub does not decode images, every encoded image is a black 640x480 BGR frame
+	return guard(errorHandler, [&]
+	{
+		FACEREC_STUB_ASSERT(0x44c0e1d9, data && dataSize, "empty encoded image");
+
+		return handle(make_image(NULL, encoded_image_width, encoded_image_height, 0));
+	});
+}
+
+HContext* TDVContext_createFromFrame(uint8_t* data, int32_t width, int32_t height, int32_t format, int32_t /*baseAngle*/, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return handle(make_image(data, width, height, format));
+	});
+}
+
+HContext* TDVContext_createFromJsonFile(const char* path, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		std::ifstream file(path, std::ios_base::binary);
+
+		FACEREC_STUB_ASSERT(0x7b1d04e6, file.is_open(), std::string("can not open file '") + path + "'");
+
+		std::ostringstream json;
+		json << file.rdbuf();
+
+		std::unique_ptr<ContextNode> result(new ContextNode());
+
+		from_json(json.str(), *result);
+
+		return handle(result.release());
+	});
+}
+
+void TDVContext_saveToJsonFile(HContext* ctx, const char* path, ContextEH** errorHandler)
+{
+	guard(errorHandler, [&]
+	{
+		const std::string json = to_json(node(ctx));
+
+		std::ofstream file(path, std::ios_base::binary);
+
+		FACEREC_STUB_ASSERT(0x7b1d04e6, file.is_open(), std::string("can not open file '") + path + "'");
+
+		file << json;
+	});
+}
+
+const char* TDVContext_serializeToJson(HContext* ctx, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		const std::string json = to_json(node(ctx));
+
+		char* const result = new char[json.size() + 1];
+
+		std::memcpy(result, json.c_str(), json.size() + 1);
+
+		return static_cast<const char*>(result);
+	});
+}
+
+void TDVContext_deleteString(const char* str, ContextEH** /*errorHandler*/)
+{
+	delete[] str;
+}
+
+
+HContext* TDVContext_getByIndex(HContext* ctx, int key, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return handle(&node(ctx).at(key));
+	});
+}
+
+HContext* TDVContext_getByKey(HContext* ctx, const char* key, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		ContextNode* const child = node(ctx).find(key);
+
+		FACEREC_STUB_ASSERT(0x0b83d5e6, child, std::string("key '") + key + "' not found");
+
+		return handle(child);
+	});
+}
+
+HContext* TDVContext_getOrInsertByKey(HContext* ctx, const char* key, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return handle(&node(ctx).getOrInsert(key));
+	});
+}
+
+void TDVContext_copy(HContext* src, HContext* dst, ContextEH** errorHandler)
+{
+	guard(errorHandler, [&]
+	{
+		node(dst) = node(src);
+	});
+}
+
+HContext* TDVContext_clone(HContext* ctx, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return handle(new ContextNode(node(ctx)));
+	});
+}
+
+HContext* TDVContext_clear(HContext* ctx, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		node(ctx).clear();
+
+		return ctx;
+	});
+}
+
+void TDVContext_erase(HContext* ctx, const char* key, ContextEH** errorHandler)
+{
+	guard(errorHandler, [&]
+	{
+		ContextNode &n = node(ctx);
+
+		if(n.type == ContextNode::OBJECT)
+			n.object.erase(key);
+	});
+}
+
+void TDVContext_reserve(HContext* ctx, const uint64_t size, ContextEH** errorHandler)
+{
+	guard(errorHandler, [&]
+	{
+		ContextNode &n = node(ctx);
+
+		if(n.type == ContextNode::NONE)
+			n.type = ContextNode::ARRAY;
+
+		FACEREC_STUB_ASSERT(0x0b83d5e3, n.type == ContextNode::ARRAY, "context is not an array");
+
+		n.array.reserve(size);
+	});
+}
+
+bool TDVContext_contains(HContext* ctx, const char* key, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return node(ctx).find(key) != NULL;
+	});
+}
+
+bool TDVContext_empty(HContext* ctx, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		const ContextNode &n = node(ctx);
+
+		return n.type == ContextNode::NONE || n.length() == 0;
+	});
+}
+
+bool TDVContext_compare(HContext* ctx, HContext* ctx2, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return node(ctx).equal(node(ctx2));
+	});
+}
+
+
+void TDVContext_putStr(HContext* ctx, const char* str, ContextEH** errorHandler)
+{
+	guard(errorHandler, [&]
+	{
+		ContextNode &n = node(ctx);
+
+		n.clear();
+		n.type = ContextNode::STRING;
+		n.string_value = str;
+	});
+}
+
+void TDVContext_putLong(HContext* ctx, int64_t val, ContextEH** errorHandler)
+{
+	guard(errorHandler, [&]
+	{
+		ContextNode &n = node(ctx);
+
+		n.clear();
+		n.type = ContextNode::LONG;
+		n.long_value = val;
+	});
+}
+
+void TDVContext_putDouble(HContext* ctx, double val, ContextEH** errorHandler)
+{
+	guard(errorHandler, [&]
+	{
+		ContextNode &n = node(ctx);
+
+		n.clear();
+		n.type = ContextNode::DOUBLE;
+		n.double_value = val;
+	});
+}
+
+void TDVContext_putBool(HContext* ctx, bool val, ContextEH** errorHandler)
+{
+	guard(errorHandler, [&]
+	{
+		ContextNode &n = node(ctx);
+
+		n.clear();
+		n.type = ContextNode::BOOL;
+		n.bool_value = val;
+	});
+}
+
+unsigned char* TDVContext_allocDataPtr(HContext* ctx, uint64_t size, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		ContextNode &n = node(ctx);
+
+		put_data(n, NULL, size);
+
+		return n.data;
+	});
+}
+
+unsigned char* TDVContext_putDataPtr(HContext* ctx, unsigned char* val, uint64_t copy_sz, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		ContextNode &n = node(ctx);
+
+		put_data(n, val, copy_sz);
+
+		return n.data;
+	});
+}
+
+unsigned char* TDVContext_putConstDataPtr(HContext* ctx, const unsigned char* val, uint64_t copy_sz, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		ContextNode &n = node(ctx);
+
+		put_data(n, val, copy_sz);
+
+		return n.data;
+	});
+}
+
+void TDVContext_putDynamicTemplateIndex(HContext* context, void* value, ContextEH** errorHandler)
+{
+	guard(errorHandler, [&]
+	{
+		ContextNode &n = node(context);
+		const std::shared_ptr<DynamicIndexState> state = dynamic_index(value).state;
+
+		n.clear();
+		n.type = ContextNode::DYNAMIC_TEMPLATE_INDEX;
+		n.index = state;
+	});
+}
+
+void TDVContext_putContextTemplate(HContext* context, void* value, ContextEH** errorHandler)
+{
+	guard(errorHandler, [&]
+	{
+		ContextNode &n = node(context);
+		const TemplateDataPtr templ = object<Template>(value).data;
+
+		n.clear();
+		n.type = ContextNode::CONTEXT_TEMPLATE;
+		n.templ = templ;
+	});
+}
+
+void TDVContext_pushBack(HContext* ctx, void* data, bool copy, ContextEH** errorHandler)
+{
+	guard(errorHandler, [&]
+	{
+		ContextNode &n = node(ctx);
+		ContextNode &element = node(reinterpret_cast<HContext*>(data));
+
+		if(n.type == ContextNode::NONE)
+			n.type = ContextNode::ARRAY;
+
+		FACEREC_STUB_ASSERT(0x0b83d5e3, n.type == ContextNode::ARRAY, "context is not an array");
+
+		if(copy)
+		{
+			n.array.emplace_back(new ContextNode(element));
+		}
+		else
+		{
+			n.array.emplace_back(new ContextNode());
+			n.array.back()->take(element);
+		}
+	});
+}
+
+
+uint64_t TDVContext_getLength(HContext* ctx, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return static_cast<uint64_t>(node(ctx).length());
+	});
+}
+
+char** TDVContext_getKeys(HContext* ctx, uint64_t length, ContextEH** errorHandler)
+{
+	// released by the caller with TDVContext_freePtr, each key and then the array
+	return guard(errorHandler, [&]
+	{
+		const ContextNode &n = checked(ctx, ContextNode::OBJECT, "an object");
+
+		FACEREC_STUB_ASSERT(0x0b83d5e4, length <= n.object.size(), "length is greater than the number of keys");
+
+		char** const result = static_cast<char**>(std::malloc(sizeof(char*) * (length ? length : 1)));
+
+		uint64_t i = 0;
+
+		for(auto it = n.object.begin(); i < length; ++it, ++i)
+		{
+			result[i] = static_cast<char*>(std::malloc(it->first.size() + 1));
+			std::memcpy(result[i], it->first.c_str(), it->first.size() + 1);
+		}
+
+		return result;
+	});
+}
+
+void TDVContext_freePtr(void* ptr)
+{
+	std::free(ptr);
+}
+
+
+#define FACEREC_STUB_CONTEXT_IS(name, condition) \
+	bool name(HContext* ctx, ContextEH** errorHandler) \
+	{ \
+		return guard(errorHandler, [&] \
+		{ \
+			const ContextNode::Type type = node(ctx).type; \
+			return condition; \
+		}); \
+	}
+
+FACEREC_STUB_CONTEXT_IS(TDVContext_isNone, type == ContextNode::NONE)
+FACEREC_STUB_CONTEXT_IS(TDVContext_isArray, type == ContextNode::ARRAY)
+FACEREC_STUB_CONTEXT_IS(TDVContext_isObject, type == ContextNode::OBJECT)
+FACEREC_STUB_CONTEXT_IS(TDVContext_isBool, type == ContextNode::BOOL)
+FACEREC_STUB_CONTEXT_IS(TDVContext_isLong, type == ContextNode::LONG)
+FACEREC_STUB_CONTEXT_IS(TDVContext_isDouble, type == ContextNode::DOUBLE)
+FACEREC_STUB_CONTEXT_IS(TDVContext_isString, type == ContextNode::STRING)
+FACEREC_STUB_CONTEXT_IS(TDVContext_isDataPtr, type == ContextNode::DATA)
+FACEREC_STUB_CONTEXT_IS(TDVContext_isBlobData, type == ContextNode::DATA)
+FACEREC_STUB_CONTEXT_IS(TDVContext_isDynamicTemplateIndex, type == ContextNode::DYNAMIC_TEMPLATE_INDEX)
+FACEREC_STUB_CONTEXT_IS(TDVContext_isContextTemplate, type == ContextNode::CONTEXT_TEMPLATE)
+
+
+const char* TDVContext_getStr(HContext* ctx, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return checked(ctx, ContextNode::STRING, "a string").string_value.c_str();
+	});
+}
+
+uint64_t TDVContext_getStrSize(HContext* ctx, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return static_cast<uint64_t>(checked(ctx, ContextNode::STRING, "a string").string_value.size());
+	});
+}
+
+int64_t TDVContext_getLong(HContext* ctx, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return checked(ctx, ContextNode::LONG, "a long").long_value;
+	});
+}
+
+double TDVContext_getDouble(HContext* ctx, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		const ContextNode &n = node(ctx);
+
+		if(n.type == ContextNode::LONG)
+			return static_cast<double>(n.long_value);
+
+		return checked(ctx, ContextNode::DOUBLE, "a double").double_value;
+	});
+}
+
+bool TDVContext_getBool(HContext* ctx, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return checked(ctx, ContextNode::BOOL, "a bool").bool_value;
+	});
+}
+
+unsigned char* TDVContext_getDataPtr(HContext* ctx, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		return checked(ctx, ContextNode::DATA, "a data pointer").data;
+	});
+}
+
+uint8_t* TDVContext_getBlobData(HContext* ctx, size_t* size, ContextEH** errorHandler)
+{
+	return guard(errorHandler, [&]
+	{
+		const ContextNode &n = checked(ctx, ContextNode::DATA, "a data pointer");
+
+		*size = n.data_size;
+
+		return static_cast<uint8_t*>(n.data);
+	});
+}
+
+void* TDVContext_getDynamicTemplateIndex(HContext* ctx, ContextEH** errorHandler)
+{
+	// the handle is owned by the node, the wrapper marks it weak
+	return guard(errorHandler, [&]
+	{
+		ContextNode &n = checked(ctx, ContextNode::DYNAMIC_TEMPLATE_INDEX, "a DynamicTemplateIndex");
+
+		if(!n.index_handle)
+			n.index_handle.reset(new DynamicTemplateIndex(n.index));
+
+		return static_cast<void*>(n.index_handle.get());
+	});
+}
+
+void* TDVContext_getContextTemplate(HContext* ctx, ContextEH** errorHandler)
+{
+	// the wrapper releases the result with ContextTemplate_destructor
+	return guard(errorHandler, [&]
+	{
+		const ContextNode &n = checked(ctx, ContextNode::CONTEXT_TEMPLATE, "a ContextTemplate");
+
+		return static_cast<void*>(static_cast<ApiObject*>(new Template(n.templ)));
+	});
+}
+
+}  // extern "C"
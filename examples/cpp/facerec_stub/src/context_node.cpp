@@ -0,0 +1,623 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#include "context_node.h"
+
+
+namespace facerec_stub {
+
+ContextNode::ContextNode(const ContextNode &other) :
+	type(NONE),
+	long_value(0),
+	double_value(0),
+	bool_value(false),
+	data(NULL),
+	data_size(0)
+{
+	*this = other;
+}
+
+
+ContextNode& ContextNode::operator=(const ContextNode &other)
+{
+	if(this == &other)
+		return *this;
+
+	ContextNode copy;
+
+	copy.type = other.type;
+
+	for(const auto &child : other.object)
+		copy.object[child.first].reset(new ContextNode(*child.second));
+
+	copy.array.reserve(other.array.size());
+
+	for(const auto &element : other.array)
+		copy.array.emplace_back(new ContextNode(*element));
+
+	copy.string_value = other.string_value;
+	copy.long_value = other.long_value;
+	copy.double_value = other.double_value;
+	copy.bool_value = other.bool_value;
+
+	if(other.type == DATA)
+	{
+		if(other.owned_data.empty())
+		{
+			// borrowed buffers stay borrowed
+			copy.data = other.data;
+		}
+		else
+		{
+			copy.owned_data = other.owned_data;
+			copy.data = copy.owned_data.data();
+		}
+
+		copy.data_size = other.data_size;
+	}
+
+	copy.index = other.index;
+	copy.templ = other.templ;
+
+	take(copy);
+
+	return *this;
+}
+
+
+void ContextNode::clear()
+{
+	type = NONE;
+	object.clear();
+	array.clear();
+	string_value.clear();
+	long_value = 0;
+	double_value = 0;
+	bool_value = false;
+	owned_data.clear();
+	data = NULL;
+	data_size = 0;
+	index.reset();
+	templ.reset();
+	index_handle.reset();
+}
+
+
+void ContextNode::take(ContextNode &other)
+{
+	clear();
+
+	type = other.type;
+	object.swap(other.object);
+	array.swap(other.array);
+	string_value.swap(other.string_value);
+	long_value = other.long_value;
+	double_value = other.double_value;
+	bool_value = other.bool_value;
+
+	// moving the vector keeps its buffer, so data stays valid
+	owned_data.swap(other.owned_data);
+	data = other.data;
+	data_size = other.data_size;
+
+	index.swap(other.index);
+	templ.swap(other.templ);
+
+	other.clear();
+}
+
+
+bool ContextNode::equal(const ContextNode &other) const
+{
+	if(type != other.type)
+		return false;
+
+	switch(type)
+	{
+		case NONE:
+			return true;
+
+		case OBJECT:
+		{
+			if(object.size() != other.object.size())
+				return false;
+
+			for(const auto &child : object)
+			{
+				const ContextNode* const other_child = other.find(child.first);
+
+				if(!other_child || !child.second->equal(*other_child))
+					return false;
+			}
+
+			return true;
+		}
+
+		case ARRAY:
+		{
+			if(array.size() != other.array.size())
+				return false;
+
+			for(size_t i = 0; i < array.size(); ++i)
+				if(!array[i]->equal(*other.array[i]))
+					return false;
+
+			return true;
+		}
+
+		case STRING:
+			return string_value == other.string_value;
+
+		case LONG:
+			return long_value == other.long_value;
+
+		case DOUBLE:
+			return double_value == other.double_value;
+
+		case BOOL:
+			return bool_value == other.bool_value;
+
+		case DATA:
+			return data_size == other.data_size && std::equal(data, data + data_size, other.data);
+
+		case DYNAMIC_TEMPLATE_INDEX:
+			return index == other.index;
+
+		case CONTEXT_TEMPLATE:
+			return templ == other.templ;
+	}
+
+	return false;
+}
+
+
+ContextNode* ContextNode::find(const std::string &key) const
+{
+	if(type != OBJECT)
+		return NULL;
+
+	const auto it = object.find(key);
+
+	return it == object.end() ? NULL : it->second.get();
+}
+
+
+ContextNode& ContextNode::getOrInsert(const std::string &key)
+{
+	if(type == NONE)
+		type = OBJECT;
+
+	FACEREC_STUB_ASSERT(0x0b83d5e2, type == OBJECT, "context is not an object");
+
+	std::unique_ptr<ContextNode> &child = object[key];
+
+	if(!child)
+		child.reset(new ContextNode());
+
+	return *child;
+}
+
+
+ContextNode& ContextNode::at(const int64_t index) const
+{
+	FACEREC_STUB_ASSERT(0x0b83d5e3, type == ARRAY || type == OBJECT, "context is not an array");
+	FACEREC_STUB_ASSERT(0x0b83d5e4, index >= 0 && index < (int64_t) length(), "index out of range");
+
+	if(type == ARRAY)
+		return *array[index];
+
+	auto it = object.begin();
+	std::advance(it, index);
+
+	return *it->second;
+}
+
+
+size_t ContextNode::length() const
+{
+	if(type == OBJECT)
+		return object.size();
+
+	if(type == ARRAY)
+		return array.size();
+
+	return 0;
+}
+
+
+namespace {
+
+void write_json_string(std::ostringstream &out, const std::string &str)
+{
+	out << '"';
+
+	for(const char c : str)
+	{
+		switch(c)
+		{
+			case '"': out << "\\\""; break;
+			case '\\': out << "\\\\"; break;
+			case '\n': out << "\\n"; break;
+			case '\r': out << "\\r"; break;
+			case '\t': out << "\\t"; break;
+			default:
+				if(static_cast<unsigned char>(c) < 0x20)
+				{
+					char buffer[8];
+					std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+					out << buffer;
+				}
+				else
+				{
+					out << c;
+				}
+		}
+	}
+
+	out << '"';
+}
+
+void write_json(std::ostringstream &out, const ContextNode &node)
+{
+	switch(node.type)
+	{
+		case ContextNode::NONE:
+			out << "null";
+			break;
+
+		case ContextNode::OBJECT:
+		{
+			out << '{';
+
+			bool first = true;
+
+			for(const auto &child : node.object)
+			{
+				if(!first)
+					out << ',';
+
+				first = false;
+
+				write_json_string(out, child.first);
+				out << ':';
+				write_json(out, *child.second);
+			}
+
+			out << '}';
+			break;
+		}
+
+		case ContextNode::ARRAY:
+		{
+			out << '[';
+
+			for(size_t i = 0; i < node.array.size(); ++i)
+			{
+				if(i)
+					out << ',';
+
+				write_json(out, *node.array[i]);
+			}
+
+			out << ']';
+			break;
+		}
+
+		case ContextNode::STRING:
+			write_json_string(out, node.string_value);
+			break;
+
+		case ContextNode::LONG:
+			out << node.long_value;
+			break;
+
+		case ContextNode::DOUBLE:
+		{
+			// shortest of the round-trip representations
+			char buffer[32];
+			std::snprintf(buffer, sizeof(buffer), "%.15g", node.double_value);
+
+			if(std::strtod(buffer, NULL) != node.double_value)
+				std::snprintf(buffer, sizeof(buffer), "%.17g", node.double_value);
+
+			std::string value = buffer;
+
+			if(value.find_first_of(".eEn") == std::string::npos)
+				value += ".0";
+
+			out << value;
+			break;
+		}
+
+		case ContextNode::BOOL:
+			out << (node.bool_value ? "true" : "false");
+			break;
+
+		case ContextNode::DATA:
+			write_json_string(out, "<binary data " + std::to_string(node.data_size) + " bytes>");
+			break;
+
+		case ContextNode::DYNAMIC_TEMPLATE_INDEX:
+			write_json_string(out, "<DynamicTemplateIndex>");
+			break;
+
+		case ContextNode::CONTEXT_TEMPLATE:
+			write_json_string(out, "<ContextTemplate>");
+			break;
+	}
+}
+
+
+class JsonParser
+{
+public:
+	JsonParser(const std::string &json) : _json(json), _pos(0) {}
+
+	void parse(ContextNode &node)
+	{
+		value(node);
+		skipSpaces();
+
+		check(_pos == _json.size(), "unexpected trailing characters");
+	}
+
+private:
+	void check(const bool condition, const char* what) const
+	{
+		FACEREC_STUB_ASSERT(0x39e7c1a5, condition, std::string("bad json: ") + what + " at " + std::to_string(_pos));
+	}
+
+	void skipSpaces()
+	{
+		while(_pos < _json.size() && std::isspace(static_cast<unsigned char>(_json[_pos])))
+			++_pos;
+	}
+
+	char peek()
+	{
+		skipSpaces();
+
+		check(_pos < _json.size(), "unexpected end");
+
+		return _json[_pos];
+	}
+
+	void expect(const char c)
+	{
+		check(peek() == c, "unexpected character");
+
+		++_pos;
+	}
+
+	bool literal(const char* word)
+	{
+		const std::string w = word;
+
+		if(_json.compare(_pos, w.size(), w) != 0)
+			return false;
+
+		_pos += w.size();
+
+		return true;
+	}
+
+	std::string string()
+	{
+		expect('"');
+
+		std::string result;
+
+		while(true)
+		{
+			check(_pos < _json.size(), "unterminated string");
+
+			const char c = _json[_pos++];
+
+			if(c == '"')
+				break;
+
+			if(c != '\\')
+			{
+				result += c;
+				continue;
+			}
+
+			check(_pos < _json.size(), "unterminated string");
+
+			const char e = _json[_pos++];
+
+			switch(e)
+			{
+				case 'n': result += '\n'; break;
+				case 'r': result += '\r'; break;
+				case 't': result += '\t'; break;
+				case 'b': result += '\b'; break;
+				case 'f': result += '\f'; break;
+				case 'u':
+				{
+					check(_pos + 4 <= _json.size(), "bad escape");
+
+					const unsigned code = std::strtoul(_json.substr(_pos, 4).c_str(), NULL, 16);
+					_pos += 4;
+
+					// utf-8 encoding of the basic multilingual plane
+					if(code < 0x80)
+					{
+						result += static_cast<char>(code);
+					}
+					else if(code < 0x800)
+					{
+						result += static_cast<char>(0xc0 | (code >> 6));
+						result += static_cast<char>(0x80 | (code & 0x3f));
+					}
+					else
+					{
+						result += static_cast<char>(0xe0 | (code >> 12));
+						result += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+						result += static_cast<char>(0x80 | (code & 0x3f));
+					}
+					break;
+				}
+				default: result += e;
+			}
+		}
+
+		return result;
+	}
+
+	void value(ContextNode &node)
+	{
+		const char c = peek();
+
+		if(c == '{')
+		{
+			++_pos;
+			node.type = ContextNode::OBJECT;
+
+			if(peek() == '}')
+			{
+				++_pos;
+				return;
+			}
+
+			while(true)
+			{
+				const std::string key = string();
+
+				expect(':');
+				value(node.getOrInsert(key));
+
+				if(peek() == ',')
+				{
+					++_pos;
+					continue;
+				}
+
+				expect('}');
+				break;
+			}
+		}
+		else if(c == '[')
+		{
+			++_pos;
+			node.type = ContextNode::ARRAY;
+
+			if(peek() == ']')
+			{
+				++_pos;
+				return;
+			}
+
+			while(true)
+			{
+				node.array.emplace_back(new ContextNode());
+				value(*node.array.back());
+
+				if(peek() == ',')
+				{
+					++_pos;
+					continue;
+				}
+
+				expect(']');
+				break;
+			}
+		}
+		else if(c == '"')
+		{
+			node.type = ContextNode::STRING;
+			node.string_value = string();
+		}
+		else if(literal("true"))
+		{
+			node.type = ContextNode::BOOL;
+			node.bool_value = true;
+		}
+		else if(literal("false"))
+		{
+			node.type = ContextNode::BOOL;
+			node.bool_value = false;
+		}
+		else if(literal("null"))
+		{
+			node.type = ContextNode::NONE;
+		}
+		else
+		{
+			const size_t begin = _pos;
+
+			while(_pos < _json.size() && std::string("+-0123456789.eE").find(_json[_pos]) != std::string::npos)
+				++_pos;
+
+			check(_pos > begin, "unexpected character");
+
+			const std::string number = _json.substr(begin, _pos - begin);
+
+			if(number.find_first_of(".eE") == std::string::npos)
+			{
+				node.type = ContextNode::LONG;
+				node.long_value = std::strtoll(number.c_str(), NULL, 10);
+			}
+			else
+			{
+				node.type = ContextNode::DOUBLE;
+				node.double_value = std::strtod(number.c_str(), NULL);
+			}
+		}
+	}
+
+	const std::string &_json;
+	size_t _pos;
+};
+
+}  // namespace
+
+
+std::string to_json(const ContextNode &node)
+{
+	std::ostringstream out;
+
+	write_json(out, node);
+
+	return out.str();
+}
+
+
+void from_json(const std::string &json, ContextNode &node)
+{
+	ContextNode result;
+
+	JsonParser(json).parse(result);
+
+	node.take(result);
+}
+
+
+std::string config_method(const ContextNode &config)
+{
+	const ContextNode* const modification = config.find("modification");
+
+	if(modification && modification->type == ContextNode::STRING)
+		return modification->string_value;
+
+	return "30";
+}
+
+
+int64_t config_long(const ContextNode &config, const std::string &key, const int64_t default_value)
+{
+	const ContextNode* const value = config.find(key);
+
+	if(value && value->type == ContextNode::LONG)
+		return value->long_value;
+
+	if(value && value->type == ContextNode::DOUBLE)
+		return static_cast<int64_t>(value->double_value);
+
+	return default_value;
+}
+
+}  // namespace facerec_stub
@@ -0,0 +1,44 @@
+#include <atomic>
+#include <iostream>
+
+#include "stub_api.h"
+
+
+// weak fallback for every symbol of the C API,
+// strong definitions from the other files take precedence;
+// a fallback prints a warning once and returns a zero value
+// (the args lists of the table do not always match typed_args,
+// so the out exception argument can not be reached generically)
+
+namespace facerec_stub {
+
+void not_implemented(std::atomic<bool> &reported, const char* name)
+{
+	if(!reported.exchange(true))
+		std::cerr << "facerec stub: " << name << " is not implemented" << std::endl;
+}
+
+}  // namespace facerec_stub
+
+
+#define FACEREC_STUB_583E_DEFAULT(rtype, name, typed_args, args, return) \
+	extern "C" __attribute__((weak)) rtype _583e_ADD_NAMESPACE(name) typed_args \
+	{ \
+		static std::atomic<bool> reported(false); \
+		facerec_stub::not_implemented(reported, #name); \
+		typedef rtype RetType_##name; \
+		return RetType_##name(); \
+	}
+
+#define FACEREC_STUB_TDV_DEFAULT(rtype, name, typed_args, args, return) \
+	extern "C" __attribute__((weak)) rtype name typed_args \
+	{ \
+		static std::atomic<bool> reported(false); \
+		facerec_stub::not_implemented(reported, #name); \
+		typedef rtype RetType_##name; \
+		return RetType_##name(); \
+	}
+
+__583e_FLIST(FACEREC_STUB_583E_DEFAULT)
+__TDV_FLIST(FACEREC_STUB_TDV_DEFAULT)
+__TDV_METASDK_FLIST(FACEREC_STUB_TDV_DEFAULT)
@@ -0,0 +1,326 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "context_node.h"
+
+
+using namespace facerec_stub;
+
+namespace {
+
+const uint64_t default_capacity = 1000;
+
+const char index_magic[] = "FSDI";
+
+void ofstream_write(void* stream, const void* data, uint64_t bytes_count)
+{
+	static_cast<std::ofstream*>(stream)->write(static_cast<const char*>(data), bytes_count);
+}
+
+DynamicIndexState& state(void* templateIndex)
+{
+	return *dynamic_index(templateIndex).state;
+}
+
+std::shared_ptr<DynamicIndexState> make_state(const HContext* config)
+{
+	const ContextNode &config_node = node(const_cast<HContext*>(config));
+
+	std::shared_ptr<DynamicIndexState> result = std::make_shared<DynamicIndexState>();
+
+	result->method = config_method(config_node);
+	result->capacity = static_cast<uint64_t>(config_long(config_node, "capacity", default_capacity));
+
+	return result;
+}
+
+void remove(DynamicIndexState &s, const std::string &uuid)
+{
+	const auto it = s.positions.find(uuid);
+
+	FACEREC_STUB_ASSERT(0x4b7e2c92, it != s.positions.end(), "uuid '" + uuid + "' is not in the index");
+
+	// swap with the last element to keep removal O(1)
+	const size_t position = it->second;
+
+	s.positions.erase(it);
+
+	if(position + 1 != s.elements.size())
+	{
+		s.elements[position] = s.elements.back();
+		s.positions[s.elements[position].first] = position;
+	}
+
+	s.elements.pop_back();
+}
+
+}  // namespace
+
+
+extern "C" {
+
+void* FACEREC_STUB_583E(FacerecService_createDynamicTemplateIndex_1)(
+	void* service,
+	const void** contextTemplates,
+	const char** uuids,
+	uint64_t size,
+	const HContext* config,
+	void** outException)
+{
+	return guard(outException, [&]
+	{
+		object<Service>(service);
+
+		const std::shared_ptr<DynamicIndexState> s = make_state(config);
+
+		for(uint64_t i = 0; i < size; ++i)
+			dynamic_index_add(*s, object<Template>(contextTemplates[i]).data, uuids[i]);
+
+		return static_cast<void*>(new DynamicTemplateIndex(s));
+	});
+}
+
+void* FACEREC_STUB_583E(FacerecService_createDynamicTemplateIndex_2)(
+	void* service,
+	const HContext* config,
+	void** outException)
+{
+	return guard(outException, [&]
+	{
+		object<Service>(service);
+
+		return static_cast<void*>(new DynamicTemplateIndex(make_state(config)));
+	});
+}
+
+void FACEREC_STUB_583E(DynamicTemplateIndex_add_1)(
+	void* templateIndex,
+	const pbio::facerec::TemplateImpl* templ,
+	const char* uuid,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		dynamic_index_add(state(templateIndex), object<Template>(templ).data, uuid);
+	});
+}
+
+void FACEREC_STUB_583E(DynamicTemplateIndex_add_2)(
+	void* templateIndex,
+	pbio::facerec::TemplateImpl** templs,
+	const char** uuids,
+	uint64_t size,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		DynamicIndexState &s = state(templateIndex);
+
+		for(uint64_t i = 0; i < size; ++i)
+			dynamic_index_add(s, object<Template>(templs[i]).data, uuids[i]);
+	});
+}
+
+void FACEREC_STUB_583E(DynamicTemplateIndex_add_3)(
+	void* templateIndex,
+	const void* contextTemplate,
+	const char* uuid,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		dynamic_index_add(state(templateIndex), object<Template>(contextTemplate).data, uuid);
+	});
+}
+
+void FACEREC_STUB_583E(DynamicTemplateIndex_add_4)(
+	void* templateIndex,
+	const void** contextTemplates,
+	const char** uuids,
+	uint64_t size,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		DynamicIndexState &s = state(templateIndex);
+
+		for(uint64_t i = 0; i < size; ++i)
+			dynamic_index_add(s, object<Template>(contextTemplates[i]).data, uuids[i]);
+	});
+}
+
+void FACEREC_STUB_583E(DynamicTemplateIndex_remove_1)(
+	void* templateIndex,
+	const char* uuid,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		remove(state(templateIndex), uuid);
+	});
+}
+
+void FACEREC_STUB_583E(DynamicTemplateIndex_remove_2)(
+	void* templateIndex,
+	const char** uuids,
+	uint64_t size,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		DynamicIndexState &s = state(templateIndex);
+
+		for(uint64_t i = 0; i < size; ++i)
+			remove(s, uuids[i]);
+	});
+}
+
+uint64_t FACEREC_STUB_583E(DynamicTemplateIndex_size)(
+	void* templateIndex,
+	void** outException)
+{
+	return guard(outException, [&]
+	{
+		return static_cast<uint64_t>(state(templateIndex).elements.size());
+	});
+}
+
+uint64_t FACEREC_STUB_583E(DynamicTemplateIndex_capacity)(
+	void* templateIndex,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return state(templateIndex).capacity;
+	});
+}
+
+void FACEREC_STUB_583E(DynamicTemplateIndex_concatenate)(
+	void* templateIndex,
+	void* otherIndex,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		DynamicIndexState &s = state(templateIndex);
+		const DynamicIndexState &other = state(otherIndex);
+
+		for(const auto &element : other.elements)
+			dynamic_index_add(s, element.second, element.first);
+	});
+}
+
+void* FACEREC_STUB_583E(DynamicTemplateIndex_at_by_uuid)(
+	void* templateIndex,
+	const char* uuid,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		const DynamicIndexState &s = state(templateIndex);
+		const auto it = s.positions.find(uuid);
+
+		FACEREC_STUB_ASSERT(0x4b7e2c92, it != s.positions.end(), std::string("uuid '") + uuid + "' is not in the index");
+
+		return static_cast<void*>(static_cast<ApiObject*>(new Template(s.elements[it->second].second)));
+	});
+}
+
+void FACEREC_STUB_583E(DynamicTemplateIndex_at_by_index)(
+	void* templateIndex,
+	int64_t index,
+	void* stream,
+	write_func_type binary_stream_write_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		const DynamicIndexState &s = state(templateIndex);
+
+		FACEREC_STUB_ASSERT(0x71d3a8e4, index >= 0 && index < (int64_t) s.elements.size(), "index out of range");
+
+		write_string(stream, binary_stream_write_func, s.elements[index].first);
+	});
+}
+
+void* FACEREC_STUB_583E(DynamicTemplateIndex_get)(
+	void* templateIndex,
+	int64_t index,
+	void** outException)
+{
+	return guard(outException, [&]
+	{
+		const DynamicIndexState &s = state(templateIndex);
+
+		FACEREC_STUB_ASSERT(0x71d3a8e4, index >= 0 && index < (int64_t) s.elements.size(), "index out of range");
+
+		return static_cast<void*>(static_cast<ApiObject*>(new Template(s.elements[index].second)));
+	});
+}
+
+void FACEREC_STUB_583E(DynamicTemplateIndex_getMethodName)(
+	void* templateIndex,
+	void* name_stream,
+	write_func_type binary_stream_write_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		write_string(name_stream, binary_stream_write_func, state(templateIndex).method);
+	});
+}
+
+void FACEREC_STUB_583E(DynamicTemplateIndex_clear)(
+	void* templateIndex,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		DynamicIndexState &s = state(templateIndex);
+
+		s.elements.clear();
+		s.positions.clear();
+	});
+}
+
+void FACEREC_STUB_583E(DynamicTemplateIndex_save)(
+	void* templateIndex,
+	const char* filePath,
+	bool allowOverwrite,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		const DynamicIndexState &s = state(templateIndex);
+
+		if(!allowOverwrite)
+		{
+			FACEREC_STUB_ASSERT(0x7b1d04e7, !std::ifstream(filePath).good(), std::string("file '") + filePath + "' already exists");
+		}
+
+		std::ofstream file(filePath, std::ios_base::binary);
+
+		FACEREC_STUB_ASSERT(0x7b1d04e6, file.is_open(), std::string("can not open file '") + filePath + "'");
+
+		file.write(index_magic, 4);
+		write_value(&file, ofstream_write, static_cast<uint32_t>(s.method.size()));
+		write_string(&file, ofstream_write, s.method);
+		write_value(&file, ofstream_write, static_cast<uint64_t>(s.elements.size()));
+
+		for(const auto &element : s.elements)
+		{
+			write_value(&file, ofstream_write, static_cast<uint32_t>(element.first.size()));
+			write_string(&file, ofstream_write, element.first);
+			save_template(*element.second, &file, ofstream_write);
+		}
+	});
+}
+
+void FACEREC_STUB_583E(DynamicTemplateIndex_destructor)(
+	void* templateIndex)
+{
+	delete static_cast<DynamicTemplateIndex*>(templateIndex);
+}
+
+}  // extern "C"
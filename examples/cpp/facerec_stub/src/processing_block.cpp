@@ -0,0 +1,438 @@
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+#include "context_node.h"
+
+
+using namespace facerec_stub;
+
+namespace {
+
+const int default_objects_count = 1;
+
+const char* const pose_keypoints[] = {
+	"nose",
+	"left_eye", "right_eye",
+	"left_ear", "right_ear",
+	"left_shoulder", "right_shoulder",
+	"left_elbow", "right_elbow",
+	"left_wrist", "right_wrist",
+	"left_hip", "right_hip",
+	"left_knee", "right_knee",
+	"left_ankle", "right_ankle"};
+
+const char* const face_keypoints[] = {
+	"left_eye", "right_eye", "nose", "mouth"};
+
+
+class ProcessingBlock : public ApiObject
+{
+public:
+	std::string unit_type;
+	std::string method;
+	int objects_count;
+	std::function<void(const ProcessingBlock&, ContextNode&)> process;
+};
+
+
+ContextNode& set(ContextNode &n, const std::string &key, const ContextNode::Type type)
+{
+	ContextNode &child = n.getOrInsert(key);
+
+	child.clear();
+	child.type = type;
+
+	return child;
+}
+
+void set_string(ContextNode &n, const std::string &key, const std::string &value)
+{
+	set(n, key, ContextNode::STRING).string_value = value;
+}
+
+void set_double(ContextNode &n, const std::string &key, const double value)
+{
+	set(n, key, ContextNode::DOUBLE).double_value = value;
+}
+
+void set_long(ContextNode &n, const std::string &key, const int64_t value)
+{
+	set(n, key, ContextNode::LONG).long_value = value;
+}
+
+void set_bool(ContextNode &n, const std::string &key, const bool value)
+{
+	set(n, key, ContextNode::BOOL).bool_value = value;
+}
+
+ContextNode& push(ContextNode &array, const ContextNode::Type type)
+{
+	if(array.type == ContextNode::NONE)
+		array.type = ContextNode::ARRAY;
+
+	array.array.emplace_back(new ContextNode());
+	array.array.back()->type = type;
+
+	return *array.array.back();
+}
+
+void push_double(ContextNode &array, const double value)
+{
+	push(array, ContextNode::DOUBLE).double_value = value;
+}
+
+void set_proj(ContextNode &point, const double x, const double y)
+{
+	ContextNode &proj = set(point, "proj", ContextNode::ARRAY);
+
+	push_double(proj, x);
+	push_double(proj, y);
+}
+
+void set_value_confidence(ContextNode &obj, const std::string &key, const bool value, const double confidence)
+{
+	ContextNode &result = set(obj, key, ContextNode::OBJECT);
+
+	set_bool(result, "value", value);
+	set_double(result, "confidence", confidence);
+}
+
+const ContextNode& child(const ContextNode &n, const std::string &key)
+{
+	const ContextNode* const result = n.find(key);
+
+	FACEREC_STUB_ASSERT(0x0b83d5e6, result, "key '" + key + "' not found");
+
+	return *result;
+}
+
+// objects of the class, or all objects if class_name is empty
+void for_each_object(ContextNode &io, const std::string &class_name, const std::function<void(ContextNode&)> &func)
+{
+	ContextNode* const objects = io.find("objects");
+
+	FACEREC_STUB_ASSERT(0x0b83d5e6, objects && objects->type == ContextNode::ARRAY, "key 'objects' not found");
+
+	for(const auto &obj : objects->array)
+	{
+		const ContextNode* const cls = obj->find("class");
+
+		if(class_name.empty() || (cls && cls->type == ContextNode::STRING && cls->string_value == class_name))
+			func(*obj);
+	}
+}
+
+// normalized bbox of the object: x1, y1, x2, y2
+void get_bbox(const ContextNode &obj, double bbox[4])
+{
+	const ContextNode &b = child(obj, "bbox");
+
+	for(int i = 0; i < 4; ++i)
+		bbox[i] = b.at(i).double_value;
+}
+
+
+void detect(const ProcessingBlock &block, ContextNode &io, const std::string &class_name)
+{
+	child(io, "image");
+
+	ContextNode &objects = io.getOrInsert("objects");
+
+	if(objects.type == ContextNode::NONE)
+		objects.type = ContextNode::ARRAY;
+
+	const int64_t first_id = objects.array.size();
+	const int count = block.objects_count;
+
+	for(int i = 0; i < count; ++i)
+	{
+		ContextNode &obj = push(objects, ContextNode::OBJECT);
+
+		const double width = 1.0 / (count + 1);
+
+		set_long(obj, "id", first_id + i);
+		set_string(obj, "class", class_name);
+		set_double(obj, "confidence", 0.9);
+
+		ContextNode &bbox = set(obj, "bbox", ContextNode::ARRAY);
+
+		push_double(bbox, (i + 0.5) * width);
+		push_double(bbox, 0.25);
+		push_double(bbox, (i + 1.5) * width);
+		push_double(bbox, 0.75);
+	}
+}
+
+void fit_face(ContextNode &obj)
+{
+	double bbox[4];
+	get_bbox(obj, bbox);
+
+	const double w = bbox[2] - bbox[0];
+	const double h = bbox[3] - bbox[1];
+
+	ContextNode &keypoints = set(obj, "keypoints", ContextNode::OBJECT);
+
+	const double named[][2] = {{0.3, 0.4}, {0.7, 0.4}, {0.5, 0.6}, {0.5, 0.8}};
+
+	for(size_t k = 0; k < sizeof(face_keypoints) / sizeof(face_keypoints[0]); ++k)
+		set_proj(keypoints.getOrInsert(face_keypoints[k]), bbox[0] + w * named[k][0], bbox[1] + h * named[k][1]);
+
+	ContextNode &points = set(keypoints, "points", ContextNode::ARRAY);
+
+	for(int k = 0; k < landmarks_count; ++k)
+		set_proj(push(points, ContextNode::OBJECT), bbox[0] + w * ((k % 5) + 0.5) / 5, bbox[1] + h * ((k / 5) + 0.5) / 5);
+}
+
+void estimate_pose(ContextNode &obj)
+{
+	double bbox[4];
+	get_bbox(obj, bbox);
+
+	const size_t count = sizeof(pose_keypoints) / sizeof(pose_keypoints[0]);
+
+	ContextNode &keypoints = set(obj, "keypoints", ContextNode::OBJECT);
+
+	for(size_t k = 0; k < count; ++k)
+	{
+		ContextNode &point = keypoints.getOrInsert(pose_keypoints[k]);
+
+		set_proj(point, bbox[0] + (bbox[2] - bbox[0]) * (k % 2 ? 0.35 : 0.65), bbox[1] + (bbox[3] - bbox[1]) * (k + 1.0) / (count + 1));
+		set_double(point, "score", 0.9);
+	}
+}
+
+Template* face_template(const ContextNode &face_template_node)
+{
+	const ContextNode &templ = face_template_node.type == ContextNode::CONTEXT_TEMPLATE ?
+		face_template_node :
+		child(face_template_node, "template");
+
+	FACEREC_STUB_ASSERT(0x0b83d5e5, templ.type == ContextNode::CONTEXT_TEMPLATE, "context is not a ContextTemplate");
+
+	return new Template(templ.templ);
+}
+
+void extract_template(const ProcessingBlock &block, ContextNode &obj)
+{
+	double bbox[4];
+	get_bbox(obj, bbox);
+
+	const ContextNode* const id = obj.find("id");
+
+	// the same object id always gives the same "person"
+	const uint64_t seed = id && id->type == ContextNode::LONG ? id->long_value : static_cast<uint64_t>(bbox[0] * 1e6);
+
+	ContextNode &templ = set(set(obj, "face_template", ContextNode::OBJECT), "template", ContextNode::CONTEXT_TEMPLATE);
+
+	templ.templ = make_template(block.method, default_template_size, seed);
+}
+
+void write_match(ContextNode &result, const float d)
+{
+	const MatchResult match = match_result_by_distance(d);
+
+	set_double(result, "distance", match.distance);
+	set_double(result, "far", match.far);
+	set_double(result, "frr", match.frr);
+	set_double(result, "score", match.score);
+}
+
+void verify(ContextNode &io)
+{
+	const std::unique_ptr<Template> t1(face_template(child(io, "template1")));
+	const std::unique_ptr<Template> t2(face_template(child(io, "template2")));
+
+	write_match(set(io, "result", ContextNode::OBJECT), distance(*t1->data, *t2->data));
+}
+
+void build_index(const ProcessingBlock &block, ContextNode &io)
+{
+	const ContextNode &templates = child(io, "templates");
+
+	const std::shared_ptr<DynamicIndexState> state = std::make_shared<DynamicIndexState>();
+
+	state->method = block.method;
+	state->capacity = templates.length();
+
+	for(size_t i = 0; i < templates.length(); ++i)
+	{
+		const std::unique_ptr<Template> templ(face_template(templates.at(i)));
+
+		dynamic_index_add(*state, templ->data, std::to_string(i));
+	}
+
+	set(io, "template_index", ContextNode::DYNAMIC_TEMPLATE_INDEX).index = state;
+}
+
+void match(ContextNode &io)
+{
+	const ContextNode &index_node = child(io, "template_index");
+
+	FACEREC_STUB_ASSERT(0x0b83d5e5, index_node.type == ContextNode::DYNAMIC_TEMPLATE_INDEX, "context is not a DynamicTemplateIndex");
+
+	const DynamicIndexState &state = *index_node.index;
+
+	const int64_t knn = std::min<int64_t>(config_long(io, "knn", 1), state.elements.size());
+
+	const ContextNode &queries_node = child(io, "queries");
+
+	std::vector<const ContextNode*> queries;
+
+	if(queries_node.type == ContextNode::ARRAY)
+		for(const auto &q : queries_node.array)
+			queries.push_back(q.get());
+	else
+		queries.push_back(&queries_node);
+
+	ContextNode &results = set(io, "results", ContextNode::ARRAY);
+
+	std::vector<float> distances(state.elements.size());
+	std::vector<size_t> order(state.elements.size());
+
+	for(const ContextNode* const query_node : queries)
+	{
+		const std::unique_ptr<Template> query(face_template(*query_node));
+
+		for(size_t i = 0; i < state.elements.size(); ++i)
+			distances[i] = distance(*query->data, *state.elements[i].second);
+
+		std::iota(order.begin(), order.end(), 0);
+		std::partial_sort(order.begin(), order.begin() + knn, order.end(),
+			[&distances](const size_t a, const size_t b) { return distances[a] < distances[b]; });
+
+		// a single query gets a flat list of knn results
+		ContextNode &query_results = queries.size() == 1 ? results : push(results, ContextNode::ARRAY);
+
+		for(int64_t j = 0; j < knn; ++j)
+		{
+			ContextNode &r = push(query_results, ContextNode::OBJECT);
+
+			set_long(r, "index", order[j]);
+			set_string(r, "uuid", state.elements[order[j]].first);
+			write_match(r, distances[order[j]]);
+		}
+	}
+}
+
+
+ProcessingBlock* create_block(const ContextNode &config)
+{
+	std::unique_ptr<ProcessingBlock> block(new ProcessingBlock());
+
+	const ContextNode &unit_type = child(config, "unit_type");
+
+	FACEREC_STUB_ASSERT(0x0b83d5e5, unit_type.type == ContextNode::STRING, "unit_type is not a string");
+
+	block->unit_type = unit_type.string_value;
+	block->method = config_method(config);
+	block->objects_count = static_cast<int>(config_long(config, "stub_objects_count", default_objects_count));
+
+	const std::string &t = block->unit_type;
+
+	typedef const ProcessingBlock& B;
+	typedef ContextNode& C;
+
+	if(t == "FACE_DETECTOR")
+		block->process = [](B b, C io) { detect(b, io, "face"); };
+	else if(t == "HUMAN_BODY_DETECTOR")
+		block->process = [](B b, C io) { detect(b, io, "body"); };
+	else if(t == "OBJECT_DETECTOR")
+		block->process = [](B b, C io) { detect(b, io, "object"); };
+	else if(t == "FACE_FITTER")
+		block->process = [](B, C io) { for_each_object(io, "face", fit_face); };
+	else if(t == "HUMAN_POSE_ESTIMATOR")
+		block->process = [](B, C io) { for_each_object(io, "body", estimate_pose); };
+	else if(t == "FACE_TEMPLATE_EXTRACTOR")
+		block->process = [](B b, C io) { for_each_object(io, "face", [&b](C obj) { extract_template(b, obj); }); };
+	else if(t == "AGE_ESTIMATOR")
+		block->process = [](B, C io) { for_each_object(io, "face", [](C obj) { set_long(obj, "age", 30); }); };
+	else if(t == "GENDER_ESTIMATOR")
+		block->process = [](B, C io) { for_each_object(io, "face", [](C obj) { set_string(obj, "gender", "MALE"); }); };
+	else if(t == "EMOTION_ESTIMATOR")
+		block->process = [](B, C io)
+		{
+			for_each_object(io, "face", [](C obj)
+			{
+				ContextNode &emotions = set(obj, "emotions", ContextNode::ARRAY);
+				ContextNode &e = push(emotions, ContextNode::OBJECT);
+
+				set_string(e, "emotion", "NEUTRAL");
+				set_double(e, "confidence", 0.9);
+			});
+		};
+	else if(t == "MASK_ESTIMATOR")
+		block->process = [](B, C io) { for_each_object(io, "face", [](C obj) { set_value_confidence(obj, "has_medical_mask", false, 0.9); }); };
+	else if(t == "GLASSES_ESTIMATOR")
+		block->process = [](B, C io) { for_each_object(io, "face", [](C obj) { set_value_confidence(obj, "glasses", false, 0.9); }); };
+	else if(t == "DEEPFAKE_ESTIMATOR")
+		block->process = [](B, C io) { for_each_object(io, "face", [](C obj) { set_value_confidence(obj, "deepfake", false, 0.9); }); };
+	else if(t == "EYE_OPENNESS_ESTIMATOR")
+		block->process = [](B, C io)
+		{
+			for_each_object(io, "face", [](C obj)
+			{
+				set_value_confidence(obj, "is_left_eye_open", true, 0.9);
+				set_value_confidence(obj, "is_right_eye_open", true, 0.9);
+			});
+		};
+	else if(t == "LIVENESS_ESTIMATOR")
+		block->process = [](B, C io)
+		{
+			for_each_object(io, "face", [](C obj)
+			{
+				ContextNode &liveness = set(obj, "liveness", ContextNode::OBJECT);
+
+				set_string(liveness, "value", "REAL");
+				set_double(liveness, "confidence", 0.9);
+			});
+		};
+	else if(t == "QUALITY_ASSESSMENT_ESTIMATOR")
+		block->process = [](B, C io) { for_each_object(io, "face", [](C obj) { set_double(set(obj, "quality", ContextNode::OBJECT), "total_score", 0.9); }); };
+	else if(t == "VERIFICATION_MODULE")
+		block->process = [](B, C io) { verify(io); };
+	else if(t == "TEMPLATE_INDEX")
+		block->process = [](B b, C io) { build_index(b, io); };
+	else if(t == "MATCHER_MODULE")
+		block->process = [](B, C io) { match(io); };
+	else
+		FACEREC_STUB_ASSERT(0x5e8c0d18, false, "unit_type '" + t + "' is not supported");
+
+	return block.release();
+}
+
+}  // namespace
+
+
+extern "C" {
+
+HPBlock* FACEREC_STUB_583E(FacerecService_ProcessingBlock_createProcessingBlock)(
+	void* service,
+	const HContext* block_ptr,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		object<Service>(service);
+
+		return handle<HPBlock>(create_block(node(const_cast<HContext*>(block_ptr))));
+	});
+}
+
+void TDVProcessingBlock_processContext(HPBlock* block_ptr, HContext* ctx_ptr, ContextEH** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		const ProcessingBlock &block = object<ProcessingBlock>(block_ptr);
+
+		block.process(block, node(ctx_ptr));
+	});
+}
+
+void TDVProcessingBlock_destroyBlock(HPBlock* block_ptr, ContextEH** /*out_exception*/)
+{
+	delete reinterpret_cast<ApiObject*>(block_ptr);
+}
+
+}  // extern "C"
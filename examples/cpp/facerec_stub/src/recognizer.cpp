@@ -0,0 +1,474 @@
+#include <algorithm>
+#include <numeric>
+
+#include "objects.h"
+
+
+using namespace facerec_stub;
+
+namespace {
+
+const TemplateData& template_data(const void* templ)
+{
+	return *object<Template>(templ).data;
+}
+
+void write_match_result(
+	const MatchResult &match,
+	double* result_distance,
+	double* result_fa_r,
+	double* result_fr_r,
+	double* result_score)
+{
+	*result_distance = match.distance;
+	*result_fa_r = match.far;
+	*result_fr_r = match.frr;
+	*result_score = match.score;
+}
+
+}  // namespace
+
+
+extern "C" {
+
+void FACEREC_STUB_583E(Template_getMethodName)(
+	void* templ,
+	void* name_stream,
+	write_func_type binary_stream_write_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		write_string(name_stream, binary_stream_write_func, template_data(templ).method);
+	});
+}
+
+void FACEREC_STUB_583E(Template_save)(
+	void* templ,
+	void* binary_stream,
+	write_func_type binary_stream_write_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		save_template(template_data(templ), binary_stream, binary_stream_write_func);
+	});
+}
+
+
+void FACEREC_STUB_583E(ContextTemplate_getMethodName)(
+	void* templ,
+	void* name_stream,
+	write_func_type binary_stream_write_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		write_string(name_stream, binary_stream_write_func, template_data(templ).method);
+	});
+}
+
+void FACEREC_STUB_583E(ContextTemplate_save)(
+	void* templ,
+	void* binary_stream,
+	write_func_type binary_stream_write_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		save_template(template_data(templ), binary_stream, binary_stream_write_func);
+	});
+}
+
+void* FACEREC_STUB_583E(ContextTemplate_loadTemplate)(
+	void* binaryStream,
+	read_func_type binaryStreamReadFunction,
+	void** outException)
+{
+	return guard(outException, [&]
+	{
+		return static_cast<void*>(static_cast<ApiObject*>(new Template(load_template(binaryStream, binaryStreamReadFunction))));
+	});
+}
+
+int32_t FACEREC_STUB_583E(ContextTemplate_size)(
+	void* templ,
+	void** outException)
+{
+	return guard(outException, [&]
+	{
+		return static_cast<int32_t>(template_data(templ).values.size() * sizeof(float));
+	});
+}
+
+void* FACEREC_STUB_583E(ContextTemplate_convert)(
+	void* context,
+	void** outException)
+{
+	// Template and ContextTemplate share the representation
+	return guard(outException, [&]
+	{
+		return static_cast<void*>(static_cast<ApiObject*>(new Template(object<Template>(context).data)));
+	});
+}
+
+void FACEREC_STUB_583E(ContextTemplate_destructor)(
+	void* implementation)
+{
+	delete reinterpret_cast<ApiObject*>(implementation);
+}
+
+
+void FACEREC_STUB_583E(TemplatesIndex_getMethodName)(
+	void* templates_index,
+	void* name_stream,
+	write_func_type binary_stream_write_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		write_string(name_stream, binary_stream_write_func, object<TemplatesIndex>(templates_index).method);
+	});
+}
+
+int64_t FACEREC_STUB_583E(TemplatesIndex_size)(
+	void* templates_index,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return static_cast<int64_t>(object<TemplatesIndex>(templates_index).templates.size());
+	});
+}
+
+pbio::facerec::TemplateImpl* FACEREC_STUB_583E(TemplatesIndex_at)(
+	void* templates_index,
+	int64_t index,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		const TemplatesIndex &templates = object<TemplatesIndex>(templates_index);
+
+		FACEREC_STUB_ASSERT(0x71d3a8e4, index >= 0 && index < (int64_t) templates.templates.size(), "index out of range");
+
+		return handle<pbio::facerec::TemplateImpl>(new Template(templates.templates[index]));
+	});
+}
+
+void FACEREC_STUB_583E(TemplatesIndex_reserveSearchMemory)(
+	void* templates_index,
+	int64_t /*queries_count*/,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		object<TemplatesIndex>(templates_index);
+	});
+}
+
+
+void FACEREC_STUB_583E(Recognizer_getMethodName)(
+	void* recognizer,
+	void* name_stream,
+	write_func_type binary_stream_write_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		write_string(name_stream, binary_stream_write_func, object<Recognizer>(recognizer).method);
+	});
+}
+
+pbio::facerec::TemplateImpl* FACEREC_STUB_583E(Recognizer_processing)(
+	void* recognizer,
+	const pbio::facerec::RawSampleImpl* raw_sample,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		const Recognizer &r = object<Recognizer>(recognizer);
+
+		// the same track id always gives the same "person"
+		const RawSample &sample = object<RawSample>(raw_sample);
+
+		return handle<pbio::facerec::TemplateImpl>(
+			new Template(make_template(r.method, r.template_size, static_cast<uint64_t>(sample.id))));
+	});
+}
+
+pbio::facerec::TemplateImpl* FACEREC_STUB_583E(Recognizer_loadTemplate)(
+	void* recognizer,
+	void* binary_stream,
+	read_func_type binary_stream_read_func,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		const Recognizer &r = object<Recognizer>(recognizer);
+
+		const TemplateDataPtr data = load_template(binary_stream, binary_stream_read_func);
+
+		FACEREC_STUB_ASSERT(0x1e5f7b36, data->method == r.method, "template was created with another method");
+
+		return handle<pbio::facerec::TemplateImpl>(new Template(data));
+	});
+}
+
+void FACEREC_STUB_583E(Recognizer_verifyMatch_v2)(
+	void* recognizer,
+	const pbio::facerec::TemplateImpl* template1,
+	const pbio::facerec::TemplateImpl* template2,
+	double* result_distance,
+	double* result_fa_r,
+	double* result_fr_r,
+	double* result_score,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		object<Recognizer>(recognizer);
+
+		write_match_result(
+			match_result_by_distance(distance(template_data(template1), template_data(template2))),
+			result_distance,
+			result_fa_r,
+			result_fr_r,
+			result_score);
+	});
+}
+
+pbio::facerec::TemplatesIndexImpl* FACEREC_STUB_583E(Recognizer_createIndex)(
+	void* recognizer,
+	int64_t templates_count,
+	pbio::facerec::TemplateImpl const* const* templates,
+	int32_t search_threads_count,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		const Recognizer &r = object<Recognizer>(recognizer);
+
+		TemplatesIndex* const index = new TemplatesIndex();
+		std::unique_ptr<ApiObject> index_holder(index);
+
+		index->method = r.method;
+		index->capacity = templates_count;
+		index->search_threads_count = search_threads_count;
+		index->templates.reserve(templates_count);
+
+		for(int64_t i = 0; i < templates_count; ++i)
+		{
+			const TemplateDataPtr &data = object<Template>(templates[i]).data;
+
+			FACEREC_STUB_ASSERT(0x1e5f7b36, data->method == r.method, "template was created with another method");
+
+			index->templates.push_back(data);
+		}
+
+		return handle<pbio::facerec::TemplatesIndexImpl>(index_holder.release());
+	});
+}
+
+pbio::facerec::TemplatesIndexImpl* FACEREC_STUB_583E(Recognizer_createResizableIndex)(
+	void* recognizer,
+	int64_t templates_count,
+	int32_t search_threads_count,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		TemplatesIndex* const index = new TemplatesIndex();
+
+		index->method = object<Recognizer>(recognizer).method;
+		index->capacity = templates_count;
+		index->search_threads_count = search_threads_count;
+
+		return handle<pbio::facerec::TemplatesIndexImpl>(index);
+	});
+}
+
+void FACEREC_STUB_583E(Recognizer_search_v2)(
+	void* recognizer,
+	int32_t /*acceleration*/,
+	int32_t queries_count,
+	pbio::facerec::TemplateImpl const* const* query_templates,
+	const pbio::facerec::TemplatesIndexImpl* templates_index,
+	int64_t k,
+	int64_t* result_i_ptr,
+	float* result_distance_ptr,
+	float* result_far_ptr,
+	float* result_frr_ptr,
+	float* result_score_ptr,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		object<Recognizer>(recognizer);
+
+		const TemplatesIndex &index = object<TemplatesIndex>(templates_index);
+
+		const int64_t size = index.templates.size();
+		const int64_t found = std::min(k, size);
+
+		std::vector<float> distances(size);
+		std::vector<int64_t> order(size);
+
+		for(int32_t q = 0; q < queries_count; ++q)
+		{
+			const TemplateData &query = template_data(query_templates[q]);
+
+			for(int64_t i = 0; i < size; ++i)
+				distances[i] = distance(query, *index.templates[i]);
+
+			std::iota(order.begin(), order.end(), 0);
+
+			std::partial_sort(
+				order.begin(),
+				order.begin() + found,
+				order.end(),
+				[&distances](const int64_t a, const int64_t b)
+				{
+					return distances[a] < distances[b] || (distances[a] == distances[b] && a < b);
+				});
+
+			for(int64_t j = 0; j < k; ++j)
+			{
+				const int64_t r = q * k + j;
+
+				if(j < found)
+				{
+					const MatchResult match = match_result_by_distance(distances[order[j]]);
+
+					result_i_ptr[r] = order[j];
+					result_distance_ptr[r] = static_cast<float>(match.distance);
+					result_far_ptr[r] = static_cast<float>(match.far);
+					result_frr_ptr[r] = static_cast<float>(match.frr);
+					result_score_ptr[r] = static_cast<float>(match.score);
+				}
+				else
+				{
+					result_i_ptr[r] = -1;
+					result_distance_ptr[r] = result_far_ptr[r] = result_frr_ptr[r] = result_score_ptr[r] = 0.f;
+				}
+			}
+		}
+	});
+}
+
+void FACEREC_STUB_583E(Recognizer_getROCCurvePointByDistanceThreshold_v2)(
+	void* recognizer,
+	double distance_threshold,
+	double* result_distance,
+	double* result_fa_r,
+	double* result_fr_r,
+	double* result_score,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		object<Recognizer>(recognizer);
+
+		write_match_result(match_result_by_distance(distance_threshold), result_distance, result_fa_r, result_fr_r, result_score);
+	});
+}
+
+void FACEREC_STUB_583E(Recognizer_getROCCurvePointByFAR_v2)(
+	void* recognizer,
+	double desired_far,
+	double* result_distance,
+	double* result_fa_r,
+	double* result_fr_r,
+	double* result_score,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		object<Recognizer>(recognizer);
+
+		write_match_result(match_result_by_distance(2 * desired_far), result_distance, result_fa_r, result_fr_r, result_score);
+	});
+}
+
+void FACEREC_STUB_583E(Recognizer_getROCCurvePointByFRR_v2)(
+	void* recognizer,
+	double desired_frr,
+	double* result_distance,
+	double* result_fa_r,
+	double* result_fr_r,
+	double* result_score,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		object<Recognizer>(recognizer);
+
+		write_match_result(match_result_by_distance(2 * (1 - desired_frr)), result_distance, result_fa_r, result_fr_r, result_score);
+	});
+}
+
+void FACEREC_STUB_583E(Recognizer_getROCCurvePointByScoreThreshold)(
+	void* recognizer,
+	double score_threshold,
+	double* result_distance,
+	double* result_fa_r,
+	double* result_fr_r,
+	double* result_score,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		object<Recognizer>(recognizer);
+
+		write_match_result(match_result_by_distance(2 * (1 - score_threshold)), result_distance, result_fa_r, result_fr_r, result_score);
+	});
+}
+
+void FACEREC_STUB_583E(Recognizer_chooseRepresentativeTemplatesSet)(
+	void* recognizer,
+	pbio::facerec::TemplateImpl const* const* const templates,
+	int8_t const* const templates_inviolable_flags,
+	const int32_t templates_count,
+	int32_t* const choosen_set_indexes_out,
+	const int32_t set_size,
+	void** out_exception)
+{
+	// greedy farthest point selection seeded with the inviolable templates
+	guard(out_exception, [&]
+	{
+		object<Recognizer>(recognizer);
+
+		FACEREC_STUB_ASSERT(0x58a2c6f7, set_size <= templates_count, "set_size is greater than templates count");
+
+		std::vector<float> nearest(templates_count, 1e9f);
+		std::vector<bool> chosen(templates_count, false);
+
+		int32_t chosen_count = 0;
+
+		const auto choose = [&](const int32_t c)
+		{
+			chosen[c] = true;
+			choosen_set_indexes_out[chosen_count++] = c;
+
+			for(int32_t i = 0; i < templates_count; ++i)
+				nearest[i] = std::min(nearest[i], distance(template_data(templates[i]), template_data(templates[c])));
+		};
+
+		for(int32_t i = 0; i < templates_count && chosen_count < set_size; ++i)
+			if(templates_inviolable_flags[i])
+				choose(i);
+
+		while(chosen_count < set_size)
+		{
+			int32_t best = -1;
+
+			for(int32_t i = 0; i < templates_count; ++i)
+				if(!chosen[i] && (best < 0 || nearest[i] > nearest[best]))
+					best = i;
+
+			choose(best);
+		}
+	});
+}
+
+}  // extern "C"
@@ -0,0 +1,189 @@
+#include <facerec/libfacerec.h>
+#include <pbio/StructStorageFields.h>
+
+#include "objects.h"
+
+
+using namespace facerec_stub;
+
+namespace {
+
+Service* create_service(char const* conf_dir)
+{
+	Service* const service = new Service();
+
+	service->conf_dir = conf_dir ? conf_dir : "";
+
+	return service;
+}
+
+}  // namespace
+
+
+extern "C" {
+
+uint32_t FACEREC_STUB_583E(apiException_code)(void* exception)
+{
+	return object<ApiException>(exception).code;
+}
+
+char const* FACEREC_STUB_583E(apiException_what)(void* exception)
+{
+	return object<ApiException>(exception).what.c_str();
+}
+
+void FACEREC_STUB_583E(apiObject_destructor)(void* object)
+{
+	delete reinterpret_cast<ApiObject*>(object);
+}
+
+
+void FACEREC_STUB_583E(get_version)(
+	void* version_stream,
+	write_func_type binary_stream_write_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		write_string(version_stream, binary_stream_write_func, LIBFACEREC_VERSION);
+	});
+}
+
+
+void* FACEREC_STUB_583E(FacerecService_constructor2)(
+	char const* conf_dir,
+	char const* /*license_dir*/,
+	char const* /*dll_path*/,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return static_cast<void*>(static_cast<ApiObject*>(create_service(conf_dir)));
+	});
+}
+
+void* FACEREC_STUB_583E(FacerecService_constructor3)(
+	void* /*ae_ptr*/,
+	char const* conf_dir,
+	char const* /*license_dir*/,
+	char const* /*dll_path*/,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return static_cast<void*>(static_cast<ApiObject*>(create_service(conf_dir)));
+	});
+}
+
+void* FACEREC_STUB_583E(FacerecService_constructor4)(
+	char const* conf_dir,
+	char const* /*license_body*/,
+	char const* /*dll_path*/,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return static_cast<void*>(static_cast<ApiObject*>(create_service(conf_dir)));
+	});
+}
+
+void* FACEREC_STUB_583E(FacerecService_constructor5)(
+	void* /*ae_ptr*/,
+	char const* conf_dir,
+	char const* /*license_body*/,
+	char const* /*dll_path*/,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return static_cast<void*>(static_cast<ApiObject*>(create_service(conf_dir)));
+	});
+}
+
+void FACEREC_STUB_583E(FacerecService_toggleAlgorithmsCacheKepp)(
+	int32_t /*cache_keep_enabled*/,
+	void** /*out_exception*/)
+{
+}
+
+
+pbio::facerec::StructStorageImpl* FACEREC_STUB_583E(FacerecService_getLicenseState)(
+	void* service,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		object<Service>(service);
+
+		static char empty[] = "";
+
+		StructStorage* const result = new StructStorage();
+
+		(*result)[pbio::StructStorageFields::license_state_online_t].int64_value = 0;
+		(*result)[pbio::StructStorageFields::license_state_licenses_count_t].int64_value = 0;
+		(*result)[pbio::StructStorageFields::license_state_android_app_id_t].pointer_value = empty;
+		(*result)[pbio::StructStorageFields::license_state_android_serial_t].pointer_value = empty;
+		(*result)[pbio::StructStorageFields::license_state_ios_app_id_t].pointer_value = empty;
+		(*result)[pbio::StructStorageFields::license_state_hardware_reg_t].pointer_value = empty;
+
+		return handle<pbio::facerec::StructStorageImpl>(result);
+	});
+}
+
+void FACEREC_STUB_583E(FacerecService_forceOnlineLicenseUpdate)(
+	void* /*service*/,
+	void** /*out_exception*/)
+{
+}
+
+
+pbio::facerec::RecognizerImpl* FACEREC_STUB_583E(FacerecService_createRecognizer2)(
+	void* service,
+	const char* ini_file,
+	const int32_t overridden_count,
+	char const* const* const overridden_keys,
+	double const* const overridden_values,
+	const int32_t /*processing*/,
+	const int32_t /*matching*/,
+	const int32_t /*processing_less_memory_consumption*/,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		object<Service>(service);
+
+		const Overrides overrides = make_overrides(overridden_count, overridden_keys, overridden_values);
+
+		Recognizer* const recognizer = new Recognizer();
+
+		recognizer->method = method_name_from_config(ini_file);
+		recognizer->template_size = static_cast<int>(get_override(overrides, "stub_template_size", default_template_size));
+
+		return handle<pbio::facerec::RecognizerImpl>(recognizer);
+	});
+}
+
+
+pbio::facerec::CapturerImpl* FACEREC_STUB_583E(FacerecService_createCapturerE)(
+	void* service,
+	const char* /*ini_file*/,
+	const int32_t overridden_count,
+	char const* const* const overridden_keys,
+	double const* const overridden_values,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		object<Service>(service);
+
+		const Overrides overrides = make_overrides(overridden_count, overridden_keys, overridden_values);
+
+		Capturer* const capturer = new Capturer();
+
+		capturer->faces_count = static_cast<int>(get_override(overrides, "stub_faces_count", 1));
+
+		return handle<pbio::facerec::CapturerImpl>(capturer);
+	});
+}
+
+}  // extern "C"
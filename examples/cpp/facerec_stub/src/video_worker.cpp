@@ -0,0 +1,470 @@
+#include <algorithm>
+
+#include <pbio/StructStorageFields.h>
+
+#include "objects.h"
+
+
+using namespace facerec_stub;
+
+namespace {
+
+typedef pbio::StructStorageFields Fields;
+
+int32_t add_callback(std::vector<VideoWorker::Callback> &callbacks, VideoWorker &vw, void* func, void* userdata)
+{
+	const std::lock_guard<std::mutex> lock(vw.mutex);
+
+	VideoWorker::Callback callback;
+
+	callback.id = vw.next_callback_id++;
+	callback.func = func;
+	callback.userdata = userdata;
+
+	callbacks.push_back(callback);
+
+	return callback.id;
+}
+
+void remove_callback(VideoWorker &vw, const int32_t callback_id)
+{
+	const std::lock_guard<std::mutex> lock(vw.mutex);
+
+	const auto has_id = [callback_id](const VideoWorker::Callback &c) { return c.id == callback_id; };
+
+	for(std::vector<VideoWorker::Callback>* callbacks : {&vw.tracking_callbacks, &vw.tracking_callbacks_u, &vw.other_callbacks})
+		callbacks->erase(std::remove_if(callbacks->begin(), callbacks->end(), has_id), callbacks->end());
+}
+
+void split_callbacks(
+	const std::vector<VideoWorker::Callback> &callbacks,
+	std::vector<void*> &funcs,
+	std::vector<void*> &userdata)
+{
+	for(const VideoWorker::Callback &c : callbacks)
+	{
+		funcs.push_back(c.func);
+		userdata.push_back(c.userdata);
+	}
+}
+
+// runs the fake tracker on the frame and calls the tracking callbacks synchronously
+int32_t add_frame(VideoWorker &vw, const int32_t image_width, const int32_t image_height, const int32_t stream_id)
+{
+	FACEREC_STUB_ASSERT(0x2a9b5e1c, stream_id >= 0 && stream_id < vw.streams_count, "bad stream_id");
+	FACEREC_STUB_ASSERT(0x44c0e1d9, image_width > 0 && image_height > 0, "bad image size");
+
+	int32_t frame_id;
+	std::vector<void*> funcs, userdata, u_funcs, u_userdata;
+
+	{
+		const std::lock_guard<std::mutex> lock(vw.mutex);
+
+		frame_id = vw.frame_ids[stream_id]++;
+
+		split_callbacks(vw.tracking_callbacks, funcs, userdata);
+		split_callbacks(vw.tracking_callbacks_u, u_funcs, u_userdata);
+	}
+
+	const int count = vw.faces_count;
+
+	std::vector<void*> samples(count);
+	std::vector<int32_t> zeros(count, 0);
+	std::vector<int32_t> passed(count, 1);  // SampleCheckStatus::PASSED
+	std::vector<float> quality(count, 1.f);
+	std::vector<float> zero_floats(count, 0.f);
+
+	// samples are owned by the wrapper objects created in the callback
+	for(int i = 0; i < count; ++i)
+		samples[i] = static_cast<ApiObject*>(make_sample(image_width, image_height, i, count, i, frame_id));
+
+	StructStorage storage;
+
+	storage[Fields::video_worker_stream_id_t].int64_value = stream_id;
+	storage[Fields::video_worker_frame_id_t].int64_value = frame_id;
+	storage[Fields::video_worker_samples_count_t].int64_value = count;
+	storage[Fields::video_worker_samples_t].pointer_value = samples.data();
+	storage[Fields::video_worker_weak_samples_t].pointer_value = zeros.data();
+	storage[Fields::video_worker_samples_quality_t].pointer_value = quality.data();
+	storage[Fields::video_worker_good_light_and_blur_samples_t].pointer_value = passed.data();
+	storage[Fields::video_worker_good_angles_samples_t].pointer_value = passed.data();
+	storage[Fields::video_worker_good_face_size_samples_t].pointer_value = passed.data();
+	storage[Fields::video_worker_detector_confirmed_samples_t].pointer_value = passed.data();
+	storage[Fields::video_worker_depth_liveness_confirmed_samples_t].pointer_value = zeros.data();
+	storage[Fields::video_worker_ir_liveness_confirmed_samples_t].pointer_value = zeros.data();
+	storage[Fields::video_worker_samples_track_age_gender_set_t].pointer_value = zeros.data();
+	storage[Fields::video_worker_samples_track_gender_t].pointer_value = zeros.data();
+	storage[Fields::video_worker_samples_track_age_t].pointer_value = zeros.data();
+	storage[Fields::video_worker_samples_track_age_years_t].pointer_value = zero_floats.data();
+	storage[Fields::video_worker_samples_track_emotions_set_t].pointer_value = zeros.data();
+	storage[Fields::video_worker_samples_track_emotions_count_t].pointer_value = zeros.data();
+	storage[Fields::video_worker_samples_track_emotions_confidence_t].pointer_value = zero_floats.data();
+	storage[Fields::video_worker_samples_track_emotions_emotion_t].pointer_value = zeros.data();
+	storage[Fields::video_worker_active_liveness_type_samples_t].pointer_value = zeros.data();
+	storage[Fields::video_worker_active_liveness_confirmed_samples_t].pointer_value = zeros.data();
+	storage[Fields::video_worker_active_liveness_score_samples_t].pointer_value = zero_floats.data();
+
+	vw.tracking_callback(
+		&vw.errors,
+		vw.this_vw,
+		static_cast<ApiObject*>(&storage),
+		static_cast<int32_t>(funcs.size()),
+		funcs.data(),
+		userdata.data(),
+		static_cast<int32_t>(u_funcs.size()),
+		u_funcs.data(),
+		u_userdata.data());
+
+	return frame_id;
+}
+
+}  // namespace
+
+
+extern "C" {
+
+pbio::facerec::VideoWorkerImpl* FACEREC_STUB_583E(FacerecService_createVideoWorker_sti_age_gender_emotions)(
+	void* service,
+	const pbio::facerec::capi::VideoWorker_TrackingCallbackFunc trackingCallback,
+	const pbio::facerec::capi::VideoWorker_TemplateCreatedCallbackFunc /*templateCreatedCallback*/,
+	const pbio::facerec::capi::VideoWorker_MatchFoundCallbackFunc /*matchFoundCallback*/,
+	const pbio::facerec::capi::VideoWorker_TrackingLostCallbackFunc /*trackingLostCallback*/,
+	const pbio::facerec::capi::VideoWorker_StiPersonOutdatedCallbackFunc /*stiPersonOutdatedCallback*/,
+	const char* /*video_worker_ini_file*/,
+	const int32_t vw_overridden_count,
+	char const* const* const vw_overridden_keys,
+	double const* const vw_overridden_values,
+	const char* recognizer_ini_file,
+	const int32_t /*rec_overridden_count*/,
+	char const* const* const /*rec_overridden_keys*/,
+	double const* const /*rec_overridden_values*/,
+	const int32_t streams_count,
+	const int32_t /*processing_threads_count*/,
+	const int32_t /*matching_threads_count*/,
+	const uint32_t /*short_time_identification_enabled*/,
+	const float /*short_time_identification_distance_threshold*/,
+	const float /*short_time_identification_outdate_time_seconds*/,
+	const int32_t /*age_gender_threads_count*/,
+	const int32_t /*emotions_threads_count*/,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		object<Service>(service);
+
+		FACEREC_STUB_ASSERT(0x2a9b5e1c, streams_count > 0, "bad streams_count");
+
+		const Overrides overrides = make_overrides(vw_overridden_count, vw_overridden_keys, vw_overridden_values);
+
+		VideoWorker* const vw = new VideoWorker();
+
+		vw->tracking_callback = trackingCallback;
+		vw->next_callback_id = 1;
+		vw->this_vw = NULL;
+		vw->method = recognizer_ini_file ? method_name_from_config(recognizer_ini_file) : "";
+		vw->streams_count = streams_count;
+		vw->faces_count = static_cast<int>(get_override(overrides, "stub_faces_count", 1));
+		vw->frame_ids.assign(streams_count, 0);
+
+		return handle<pbio::facerec::VideoWorkerImpl>(vw);
+	});
+}
+
+
+void FACEREC_STUB_583E(VideoWorker_setThisVW)(
+	void* video_worker,
+	void* this_vw,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		object<VideoWorker>(video_worker).this_vw = this_vw;
+	});
+}
+
+void FACEREC_STUB_583E(VideoWorker_errStreamWriteFunc)(
+	void* err_stream,
+	const void* data,
+	uint64_t bytes_count)
+{
+	static_cast<std::string*>(err_stream)->append(static_cast<const char*>(data), bytes_count);
+}
+
+void FACEREC_STUB_583E(VideoWorker_checkExceptions)(
+	void* video_worker,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		VideoWorker &vw = object<VideoWorker>(video_worker);
+
+		std::string errors;
+
+		{
+			const std::lock_guard<std::mutex> lock(vw.mutex);
+			errors.swap(vw.errors);
+		}
+
+		FACEREC_STUB_ASSERT(0x6ce24ef9, errors.empty(), errors);
+	});
+}
+
+void FACEREC_STUB_583E(VideoWorker_getMethodName)(
+	void* video_worker,
+	void* name_stream,
+	write_func_type binary_stream_write_func,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		write_string(name_stream, binary_stream_write_func, object<VideoWorker>(video_worker).method);
+	});
+}
+
+int32_t FACEREC_STUB_583E(VideoWorker_getStreamsCount)(
+	void* video_worker,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return object<VideoWorker>(video_worker).streams_count;
+	});
+}
+
+int32_t FACEREC_STUB_583E(VideoWorker_getTrackingConveyorSize)(
+	void* video_worker,
+	int32_t /*stream_id*/,
+	void** out_exception)
+{
+	// frames are processed synchronously, so the conveyor is always empty
+	return guard(out_exception, [&]
+	{
+		object<VideoWorker>(video_worker);
+
+		return int32_t(0);
+	});
+}
+
+int32_t FACEREC_STUB_583E(VideoWorker_addVideoFrame)(
+	void* video_worker,
+	const void* /*image_data*/,
+	int32_t image_width,
+	int32_t image_height,
+	int32_t /*image_format*/,
+	int32_t stream_id,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return add_frame(object<VideoWorker>(video_worker), image_width, image_height, stream_id);
+	});
+}
+
+int32_t FACEREC_STUB_583E(VideoWorker_addVideoFrameWithTimestamp)(
+	void* video_worker,
+	const void* /*image_data*/,
+	int32_t image_width,
+	int32_t image_height,
+	int32_t /*image_format*/,
+	int32_t stream_id,
+	const uint64_t /*timestamp_microsec*/,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return add_frame(object<VideoWorker>(video_worker), image_width, image_height, stream_id);
+	});
+}
+
+int32_t FACEREC_STUB_583E(VideoWorker_addVideoFrameWithTimestamp_with_crop)(
+	void* video_worker,
+	const void* /*image_data*/,
+	int32_t image_width,
+	int32_t image_height,
+	int32_t /*image_format*/,
+	int32_t /*image_with_crop*/,
+	int32_t /*image_crop_info_offset_x*/,
+	int32_t /*image_crop_info_offset_y*/,
+	int32_t /*image_crop_info_data_image_width*/,
+	int32_t /*image_crop_info_data_image_height*/,
+	int32_t stream_id,
+	const uint64_t /*timestamp_microsec*/,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return add_frame(object<VideoWorker>(video_worker), image_width, image_height, stream_id);
+	});
+}
+
+void FACEREC_STUB_583E(VideoWorker_resetTrackerOnStream)(
+	void* video_worker,
+	int32_t stream_id,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		VideoWorker &vw = object<VideoWorker>(video_worker);
+
+		FACEREC_STUB_ASSERT(0x2a9b5e1c, stream_id >= 0 && stream_id < vw.streams_count, "bad stream_id");
+	});
+}
+
+int32_t FACEREC_STUB_583E(VideoWorker_resetStream)(
+	void* video_worker,
+	int32_t stream_id,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		VideoWorker &vw = object<VideoWorker>(video_worker);
+
+		FACEREC_STUB_ASSERT(0x2a9b5e1c, stream_id >= 0 && stream_id < vw.streams_count, "bad stream_id");
+
+		const std::lock_guard<std::mutex> lock(vw.mutex);
+
+		return vw.frame_ids[stream_id];
+	});
+}
+
+int32_t FACEREC_STUB_583E(VideoWorker_addTrackingCallback)(
+	void* video_worker,
+	void* callback,
+	void* userdata,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		VideoWorker &vw = object<VideoWorker>(video_worker);
+
+		return add_callback(vw.tracking_callbacks, vw, callback, userdata);
+	});
+}
+
+int32_t FACEREC_STUB_583E(VideoWorker_addTrackingCallbackU)(
+	void* video_worker,
+	void* callback,
+	void* userdata,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		VideoWorker &vw = object<VideoWorker>(video_worker);
+
+		return add_callback(vw.tracking_callbacks_u, vw, callback, userdata);
+	});
+}
+
+#define FACEREC_STUB_OTHER_CALLBACK(name) \
+	int32_t FACEREC_STUB_583E(name)( \
+		void* video_worker, \
+		void* const callback, \
+		void* const userdata, \
+		void** out_exception) \
+	{ \
+		return guard(out_exception, [&] \
+		{ \
+			VideoWorker &vw = object<VideoWorker>(video_worker); \
+			return add_callback(vw.other_callbacks, vw, callback, userdata); \
+		}); \
+	}
+
+FACEREC_STUB_OTHER_CALLBACK(VideoWorker_addTemplateCreatedCallback)
+FACEREC_STUB_OTHER_CALLBACK(VideoWorker_addTemplateCreatedCallbackU)
+FACEREC_STUB_OTHER_CALLBACK(VideoWorker_addMatchFoundCallback)
+FACEREC_STUB_OTHER_CALLBACK(VideoWorker_addMatchFoundCallbackExt)
+FACEREC_STUB_OTHER_CALLBACK(VideoWorker_addMatchFoundCallbackU)
+FACEREC_STUB_OTHER_CALLBACK(VideoWorker_addTrackingLostCallback)
+FACEREC_STUB_OTHER_CALLBACK(VideoWorker_addTrackingLostCallbackU)
+FACEREC_STUB_OTHER_CALLBACK(VideoWorker_addStiPersonOutdatedCallbackU)
+
+#define FACEREC_STUB_REMOVE_CALLBACK(name) \
+	void FACEREC_STUB_583E(name)( \
+		void* video_worker, \
+		int32_t callback_id, \
+		void** out_exception) \
+	{ \
+		guard(out_exception, [&] \
+		{ \
+			remove_callback(object<VideoWorker>(video_worker), callback_id); \
+		}); \
+	}
+
+FACEREC_STUB_REMOVE_CALLBACK(VideoWorker_removeTrackingCallback)
+FACEREC_STUB_REMOVE_CALLBACK(VideoWorker_removeTemplateCreatedCallback)
+FACEREC_STUB_REMOVE_CALLBACK(VideoWorker_removeMatchFoundCallback)
+FACEREC_STUB_REMOVE_CALLBACK(VideoWorker_removeTrackingLostCallback)
+FACEREC_STUB_REMOVE_CALLBACK(VideoWorker_removeStiPersonOutdatedCallback)
+
+void FACEREC_STUB_583E(VideoWorker_toggleSomething)(
+	void* /*video_worker*/,
+	int32_t /*stream_id*/,
+	int32_t /*something*/,
+	void** /*out_exception*/)
+{
+}
+
+void FACEREC_STUB_583E(VideoWorker_setDatabase)(
+	void* video_worker,
+	int32_t /*acceleration*/,
+	int32_t /*elements_count*/,
+	uint64_t const* /*elements_ids*/,
+	uint64_t const* /*persons_ids*/,
+	pbio::facerec::TemplateImpl const* const* /*elements_templates*/,
+	float const* /*elements_thresholds*/,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		object<VideoWorker>(video_worker);
+	});
+}
+
+void FACEREC_STUB_583E(VideoWorker_setParameter)(
+	void* video_worker,
+	const char* param_name,
+	double param_value,
+	void** out_exception)
+{
+	guard(out_exception, [&]
+	{
+		if(std::string(param_name) == "stub_faces_count")
+			object<VideoWorker>(video_worker).faces_count = static_cast<int>(param_value);
+	});
+}
+
+
+int64_t FACEREC_STUB_583E(StructStorage_get_int64)(
+	const void* struct_storage,
+	int32_t field_id,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return object<StructStorage>(struct_storage).at(field_id).int64_value;
+	});
+}
+
+double FACEREC_STUB_583E(StructStorage_get_double)(
+	const void* struct_storage,
+	int32_t field_id,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return object<StructStorage>(struct_storage).at(field_id).double_value;
+	});
+}
+
+void* FACEREC_STUB_583E(StructStorage_get_pointer)(
+	const void* struct_storage,
+	int32_t field_id,
+	void** out_exception)
+{
+	return guard(out_exception, [&]
+	{
+		return object<StructStorage>(struct_storage).at(field_id).pointer_value;
+	});
+}
+
+}  // extern "C"
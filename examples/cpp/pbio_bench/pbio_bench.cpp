@@ -0,0 +1,1274 @@
+/**
+ \file pbio_bench.cpp
+ \brief Microbenchmarks of the pbio C++ wrapper hot paths, run against the stand-in libfacerec.so.
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <facerec/import.h>
+#include <facerec/libfacerec.h>
+#include <pbio/ClusteredTemplatesIndex.h>
+#include <pbio/PackedGallery.h>
+#include <pbio/SearchBatcher.h>
+#include <pbio/UpdatableTemplatesIndex.h>
+
+
+// every allocation of the process (wrapper and library) is counted,
+// the library part is constant between runs, so regressions of the headers stay visible.
+// All forms of the global operators are replaced and use malloc/free; they are not inlined,
+// otherwise gcc matches the inlined free against operator new (-Wmismatched-new-delete)
+#if defined(__GNUC__)
+#define PBIO_BENCH_NOINLINE __attribute__((noinline))
+#else
+#define PBIO_BENCH_NOINLINE
+#endif
+
+static std::atomic<uint64_t> allocations_count(0);
+
+static void* counted_malloc(std::size_t size) noexcept
+{
+	allocations_count.fetch_add(1, std::memory_order_relaxed);
+
+	return std::malloc(size ? size : 1);
+}
+
+PBIO_BENCH_NOINLINE void* operator new(std::size_t size)
+{
+	if(void* const ptr = counted_malloc(size))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+PBIO_BENCH_NOINLINE void* operator new[](std::size_t size)
+{
+	if(void* const ptr = counted_malloc(size))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+PBIO_BENCH_NOINLINE void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return counted_malloc(size);
+}
+
+PBIO_BENCH_NOINLINE void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return counted_malloc(size);
+}
+
+PBIO_BENCH_NOINLINE void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+PBIO_BENCH_NOINLINE void operator delete[](void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+PBIO_BENCH_NOINLINE void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+PBIO_BENCH_NOINLINE void operator delete[](void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+PBIO_BENCH_NOINLINE void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+
+PBIO_BENCH_NOINLINE void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+
+#ifdef __cpp_aligned_new
+
+static void* counted_aligned_alloc(std::size_t size, std::align_val_t alignment) noexcept
+{
+	const std::size_t align = static_cast<std::size_t>(alignment);
+
+	allocations_count.fetch_add(1, std::memory_order_relaxed);
+
+	// aligned_alloc requires the size to be a multiple of the alignment
+	return std::aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align);
+}
+
+PBIO_BENCH_NOINLINE void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	if(void* const ptr = counted_aligned_alloc(size, alignment))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+PBIO_BENCH_NOINLINE void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	if(void* const ptr = counted_aligned_alloc(size, alignment))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+PBIO_BENCH_NOINLINE void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return counted_aligned_alloc(size, alignment);
+}
+
+PBIO_BENCH_NOINLINE void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return counted_aligned_alloc(size, alignment);
+}
+
+PBIO_BENCH_NOINLINE void operator delete(void* ptr, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+PBIO_BENCH_NOINLINE void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+PBIO_BENCH_NOINLINE void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+PBIO_BENCH_NOINLINE void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+	std::free(ptr);
+}
+
+PBIO_BENCH_NOINLINE void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+
+PBIO_BENCH_NOINLINE void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+	std::free(ptr);
+}
+
+#endif  // __cpp_aligned_new
+
+
+namespace {
+
+// sets the allocs/op counter of the benchmark on destruction
+class AllocationsCounter
+{
+public:
+	AllocationsCounter(benchmark::State &state) :
+		_state(state),
+		_start(allocations_count.load(std::memory_order_relaxed))
+	{
+	}
+
+	~AllocationsCounter()
+	{
+		_state.counters["allocs/op"] = benchmark::Counter(
+			static_cast<double>(allocations_count.load(std::memory_order_relaxed) - _start),
+			benchmark::Counter::kAvgIterations);
+	}
+
+private:
+	benchmark::State &_state;
+	const uint64_t _start;
+};
+
+
+std::string dll_path = PBIO_BENCH_DEFAULT_DLL_PATH;
+
+const int image_width = 640;
+const int image_height = 480;
+
+const std::string recognizer_config = "method12v30_recognizer.xml";
+
+
+const pbio::FacerecService::Ptr& service()
+{
+	static const pbio::FacerecService::Ptr result = pbio::FacerecService::createService(dll_path, "../conf/facerec/");
+
+	return result;
+}
+
+const pbio::Recognizer::Ptr& recognizer()
+{
+	static const pbio::Recognizer::Ptr result = service()->createRecognizer(recognizer_config, true, true);
+
+	return result;
+}
+
+const pbio::RawImage& image()
+{
+	static std::vector<unsigned char> data(image_width * image_height * 3);
+	static const pbio::RawImage result(image_width, image_height, pbio::IRawImage::FORMAT_BGR, data.data());
+
+	return result;
+}
+
+std::vector<pbio::RawSample::Ptr> capture(const int faces_count)
+{
+	pbio::FacerecService::Config config("common_capturer4_fda.xml");
+	config.overrideParameter("stub_faces_count", faces_count);
+
+	return service()->createCapturer(config)->capture(image());
+}
+
+std::vector<pbio::Template::Ptr> make_templates(const int count)
+{
+	std::vector<pbio::Template::Ptr> result;
+
+	for(const pbio::RawSample::Ptr &sample : capture(count))
+		result.push_back(recognizer()->processing(*sample));
+
+	return result;
+}
+
+// {"objects": [{"id": i, "class": "face", "confidence": 0.9, "bbox": [4 doubles]}, ...]}
+pbio::Context make_objects_context(const int objects_count)
+{
+	pbio::Context result = service()->createContext();
+
+	for(int i = 0; i < objects_count; ++i)
+	{
+		pbio::Context object = service()->createContext();
+
+		object["id"] = static_cast<long>(i);
+		object["class"] = std::string("face");
+		object["confidence"] = 0.9;
+
+		for(int j = 0; j < 4; ++j)
+			object["bbox"].push_back(0.25 * j);
+
+		result["objects"].push_back(object);
+	}
+
+	return result;
+}
+
+
+void BM_CreateService(benchmark::State &state)
+{
+	// keeps the library loaded, so only the symbol binding and the service construction are measured
+	service();
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		const pbio::FacerecService::Ptr result = pbio::FacerecService::createService(dll_path, "../conf/facerec/");
+
+		benchmark::DoNotOptimize(result.get());
+	}
+}
+BENCHMARK(BM_CreateService);
+
+
+void BM_ContextOperatorBracket(benchmark::State &state)
+{
+	const int objects_count = static_cast<int>(state.range(0));
+	const pbio::Context context = make_objects_context(objects_count);
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		double sum = 0;
+
+		for(int i = 0; i < objects_count; ++i)
+			sum += context["objects"][i]["confidence"].getDouble() + context["objects"][i]["bbox"][2].getDouble();
+
+		benchmark::DoNotOptimize(sum);
+	}
+
+	state.SetItemsProcessed(state.iterations() * objects_count);
+}
+BENCHMARK(BM_ContextOperatorBracket)->Arg(1)->Arg(16);
+
+
+void BM_ContextAt(benchmark::State &state)
+{
+	const int objects_count = static_cast<int>(state.range(0));
+	const pbio::Context context = make_objects_context(objects_count);
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		double sum = 0;
+
+		for(int i = 0; i < objects_count; ++i)
+			sum += context.at("objects").at(i).at("confidence").getDouble() + context.at("objects").at(i).at("bbox").at(2).getDouble();
+
+		benchmark::DoNotOptimize(sum);
+	}
+
+	state.SetItemsProcessed(state.iterations() * objects_count);
+}
+BENCHMARK(BM_ContextAt)->Arg(1)->Arg(16);
+
+
+// the same reads with paths compiled once
+void BM_ContextPathGet(benchmark::State &state)
+{
+	const int objects_count = static_cast<int>(state.range(0));
+	const pbio::Context context = make_objects_context(objects_count);
+
+	std::vector<pbio::Context::Path> confidences;
+	std::vector<pbio::Context::Path> bboxes;
+
+	for(int i = 0; i < objects_count; ++i)
+	{
+		confidences.push_back("objects/" + std::to_string(i) + "/confidence");
+		bboxes.push_back("objects/" + std::to_string(i) + "/bbox/2");
+	}
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		double sum = 0;
+
+		for(int i = 0; i < objects_count; ++i)
+			sum += context.get<double>(confidences[i]) + context.get<double>(bboxes[i]);
+
+		benchmark::DoNotOptimize(sum);
+	}
+
+	state.SetItemsProcessed(state.iterations() * objects_count);
+}
+BENCHMARK(BM_ContextPathGet)->Arg(1)->Arg(16);
+
+
+// full-width crop of a 4K BGR frame put into a Context: putImage (row copy) against BorrowedImage
+void BM_ContextPutImageCrop(benchmark::State &state)
+{
+	std::vector<unsigned char> frame(3840 * 2160 * 3);
+	const pbio::RawImage image(3840, 2160, pbio::IRawImage::FORMAT_BGR, frame.data());
+	const pbio::RawImage crop = image.crop(pbio::Rectangle(0, 540, 3840, 1080));
+
+	pbio::Context context = service()->createContext();
+
+	for(auto _ : state)
+	{
+		if(state.range(0) == 0)
+		{
+			pbio::context_utils::putImage(context, crop);
+		}
+		else
+		{
+			pbio::context_utils::BorrowedImage borrowed(context, crop);
+
+			benchmark::DoNotOptimize(borrowed.borrowed());
+		}
+	}
+
+	state.SetBytesProcessed(state.iterations() * crop.width * crop.height * 3);
+}
+BENCHMARK(BM_ContextPutImageCrop)->Arg(0)->Arg(1);
+
+
+// 4K NV12 decoder output with padded strides: repacked by the caller for createContextFromFrame against BorrowedImage planes
+void BM_ContextPutImageNV12(benchmark::State &state)
+{
+	const size_t width = 3840, height = 2160, stride = 4096;
+	std::vector<unsigned char> luma(stride * height), chroma(stride * height / 2);
+	std::vector<unsigned char> frame(width * height * 3 / 2);
+
+	const unsigned char* planes[] = {luma.data(), chroma.data()};
+	const size_t strides[] = {stride, stride};
+
+	for(auto _ : state)
+	{
+		if(state.range(0) == 0)
+		{
+			for(size_t row = 0; row < height; ++row)
+				std::memcpy(frame.data() + row * width, luma.data() + row * stride, width);
+			for(size_t row = 0; row < height / 2; ++row)
+				std::memcpy(frame.data() + (height + row) * width, chroma.data() + row * stride, width);
+
+			pbio::Context context = service()->createContextFromFrame(
+				frame.data(), static_cast<int32_t>(width), static_cast<int32_t>(height), pbio::Context::FORMAT_YUV_NV12);
+
+			benchmark::DoNotOptimize(context.size());
+		}
+		else
+		{
+			pbio::Context context = service()->createContext();
+			pbio::context_utils::BorrowedImage borrowed(context, pbio::Context::FORMAT_YUV_NV12, height, width, planes, strides);
+
+			benchmark::DoNotOptimize(borrowed.image().size());
+		}
+	}
+
+	state.SetBytesProcessed(state.iterations() * width * height * 3 / 2);
+}
+BENCHMARK(BM_ContextPutImageNV12)->Arg(0)->Arg(1);
+
+
+// all fields of range(0) objects: per-field iteration over "objects" against one extractObjects call
+void BM_ContextObjectsIterate(benchmark::State &state)
+{
+	const int objects_count = static_cast<int>(state.range(0));
+	const pbio::Context context = make_objects_context(objects_count);
+
+	std::vector<double> bboxes;
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		bboxes.clear();
+
+		for(const auto &object : context.at("objects"))
+		{
+			const pbio::Context::Ref bbox = object.at("bbox");
+
+			bboxes.push_back(object.at("id").getLong());
+			bboxes.push_back(object.at("confidence").getDouble());
+
+			for(int j = 0; j < 4; ++j)
+				bboxes.push_back(bbox[j].getDouble());
+
+			benchmark::DoNotOptimize(object.at("class").getString());
+		}
+
+		benchmark::DoNotOptimize(bboxes.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * objects_count);
+}
+BENCHMARK(BM_ContextObjectsIterate)->Arg(1)->Arg(64);
+
+
+void BM_ContextExtractObjects(benchmark::State &state)
+{
+	const int objects_count = static_cast<int>(state.range(0));
+	const pbio::Context context = make_objects_context(objects_count);
+
+	pbio::ObjectsView view;
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		context.extractObjects(view);
+
+		benchmark::DoNotOptimize(view.bboxes.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * objects_count);
+}
+BENCHMARK(BM_ContextExtractObjects)->Arg(1)->Arg(64);
+
+
+// probing of an optional key: the throwing and the noexcept API
+void BM_ContextMissingKeyCatch(benchmark::State &state)
+{
+	const pbio::Context context = make_objects_context(1);
+	const pbio::Context object = context["objects"][0];
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		double value = 0;
+
+		try
+		{
+			value = object.at("age").getDouble();
+		}
+		catch(const pbio::Error &)
+		{
+			value = -1;
+		}
+
+		benchmark::DoNotOptimize(value);
+	}
+}
+BENCHMARK(BM_ContextMissingKeyCatch);
+
+
+void BM_ContextMissingKeyTryAt(benchmark::State &state)
+{
+	const pbio::Context context = make_objects_context(1);
+	const pbio::Context object = context["objects"][0];
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		const pbio::Expected<pbio::Context::Ref> age = object.tryAt("age");
+		const double value = age ? age->tryGetDouble().valueOr(-1) : -1;
+
+		benchmark::DoNotOptimize(value);
+	}
+}
+BENCHMARK(BM_ContextMissingKeyTryAt);
+
+
+void BM_ContextArrayIterator(benchmark::State &state)
+{
+	const int objects_count = static_cast<int>(state.range(0));
+	const pbio::Context context = make_objects_context(objects_count);
+	const pbio::Context objects = context["objects"];
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		long sum = 0;
+
+		for(const pbio::Context &object : objects)
+			sum += object["id"].getLong();
+
+		benchmark::DoNotOptimize(sum);
+	}
+
+	state.SetItemsProcessed(state.iterations() * objects_count);
+}
+BENCHMARK(BM_ContextArrayIterator)->Arg(1)->Arg(16);
+
+
+void BM_RecognizerSearch(benchmark::State &state)
+{
+	const size_t k = static_cast<size_t>(state.range(0));
+	const std::vector<pbio::Template::Ptr> templates = make_templates(128);
+	const pbio::TemplatesIndex::Ptr index = recognizer()->createIndex(templates, 1);
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		const std::vector<pbio::Recognizer::SearchResult> result = recognizer()->search(*templates[0], *index, k);
+
+		benchmark::DoNotOptimize(result.data());
+	}
+}
+BENCHMARK(BM_RecognizerSearch)->Arg(1)->Arg(100);
+
+
+// batch 1:N search, results unpacked into vectors of vectors or written into a reused buffer
+void BM_RecognizerSearchBatch(benchmark::State &state)
+{
+	const std::vector<pbio::Template::Ptr> templates = make_templates(128);
+	const pbio::TemplatesIndex::Ptr index = recognizer()->createIndex(templates, 1);
+	const std::vector<pbio::Template::Ptr> queries(templates.begin(), templates.begin() + 16);
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		const std::vector<std::vector<pbio::Recognizer::SearchResult> > result = recognizer()->search(queries, *index, 10);
+
+		benchmark::DoNotOptimize(result.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_RecognizerSearchBatch);
+
+
+void BM_RecognizerSearchBatchBuffer(benchmark::State &state)
+{
+	const std::vector<pbio::Template::Ptr> templates = make_templates(128);
+	const pbio::TemplatesIndex::Ptr index = recognizer()->createIndex(templates, 1);
+	const std::vector<pbio::Template::Ptr> queries(templates.begin(), templates.begin() + 16);
+
+	pbio::SearchResultBuffer result(queries.size(), 10);
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		recognizer()->search(queries, *index, 10, result);
+
+		benchmark::DoNotOptimize(result.indexes(0));
+	}
+
+	state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_RecognizerSearchBatchBuffer);
+
+
+// 16 single-template queries in flight at once, coalesced by SearchBatcher into one search call
+void BM_SearchBatcher(benchmark::State &state)
+{
+	const std::vector<pbio::Template::Ptr> templates = make_templates(128);
+	const pbio::TemplatesIndex::Ptr index = recognizer()->createIndex(templates, 1);
+	const std::vector<pbio::Template::Ptr> queries(templates.begin(), templates.begin() + 16);
+
+	pbio::SearchBatcher batcher(recognizer(), index, queries.size());
+
+	std::vector<std::future<std::vector<pbio::Recognizer::SearchResult> > > results(queries.size());
+
+	for(auto _ : state)
+	{
+		for(size_t i = 0; i < queries.size(); ++i)
+			results[i] = batcher.search(queries[i], 10);
+
+		for(size_t i = 0; i < queries.size(); ++i)
+			benchmark::DoNotOptimize(results[i].get().data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_SearchBatcher)->UseRealTime();
+
+
+// search restricted to every range(0)-th template of the index
+void BM_RecognizerSearchFiltered(benchmark::State &state)
+{
+	const size_t step = static_cast<size_t>(state.range(0));
+	const std::vector<pbio::Template::Ptr> templates = make_templates(1024);
+	const pbio::TemplatesIndex::Ptr index = recognizer()->createIndex(templates, 1);
+	const std::vector<pbio::Template::Ptr> queries(templates.begin(), templates.begin() + 16);
+
+	std::vector<uint64_t> allowed_bitmap((templates.size() + 63) / 64, 0);
+
+	for(size_t i = 0; i < templates.size(); i += step)
+		allowed_bitmap[i / 64] |= uint64_t(1) << (i % 64);
+
+	pbio::SearchResultBuffer result;
+
+	for(auto _ : state)
+	{
+		recognizer()->searchFiltered(queries, *index, 10, allowed_bitmap, result);
+
+		benchmark::DoNotOptimize(result.indexes(0));
+	}
+
+	state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_RecognizerSearchFiltered)->Arg(2)->Arg(64);
+
+
+// the same filter reused: the index of the allowed templates is created once
+void BM_RecognizerSearchFilteredIndex(benchmark::State &state)
+{
+	const size_t step = static_cast<size_t>(state.range(0));
+	const std::vector<pbio::Template::Ptr> templates = make_templates(1024);
+	const pbio::TemplatesIndex::Ptr index = recognizer()->createIndex(templates, 1);
+	const std::vector<pbio::Template::Ptr> queries(templates.begin(), templates.begin() + 16);
+
+	std::vector<uint64_t> allowed_bitmap((templates.size() + 63) / 64, 0);
+
+	for(size_t i = 0; i < templates.size(); i += step)
+		allowed_bitmap[i / 64] |= uint64_t(1) << (i % 64);
+
+	const pbio::FilteredTemplatesIndex::Ptr filtered_index = recognizer()->createFilteredIndex(*index, allowed_bitmap);
+
+	pbio::SearchResultBuffer result;
+
+	for(auto _ : state)
+	{
+		recognizer()->searchFiltered(queries, *filtered_index, 10, result);
+
+		benchmark::DoNotOptimize(result.indexes(0));
+	}
+
+	state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_RecognizerSearchFilteredIndex)->Arg(2)->Arg(64);
+
+
+// all matches under the FAR threshold, the matches count is reported as a counter
+void BM_RecognizerSearchRange(benchmark::State &state)
+{
+	const std::vector<pbio::Template::Ptr> templates = make_templates(1024);
+	const pbio::TemplatesIndex::Ptr index = recognizer()->createIndex(templates, 1);
+	const std::vector<pbio::Template::Ptr> queries(templates.begin(), templates.begin() + 16);
+
+	pbio::SearchResultBuffer result;
+
+	for(auto _ : state)
+	{
+		recognizer()->searchRange(queries, *index, 0.05, result);
+
+		benchmark::DoNotOptimize(result.indexes(0));
+	}
+
+	state.counters["matches"] = result.size(0);
+	state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_RecognizerSearchRange);
+
+
+// representative set of 16 templates out of 2048: one library call against chunks of range(0)
+void BM_ChooseRepresentativeSet(benchmark::State &state)
+{
+	const size_t chunk_size = static_cast<size_t>(state.range(0));
+	const std::vector<pbio::Template::Ptr> templates = make_templates(2048);
+
+	std::vector<size_t> result;
+
+	for(auto _ : state)
+	{
+		if(chunk_size == 0)
+			result = recognizer()->chooseRepresentativeTemplatesSet(16, templates);
+		else
+			result = recognizer()->chooseRepresentativeTemplatesSet(16, templates, std::vector<size_t>(), chunk_size, pbio::ThreadPool::Ptr());
+
+		benchmark::DoNotOptimize(result.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * templates.size());
+}
+BENCHMARK(BM_ChooseRepresentativeSet)->Arg(0)->Arg(256);
+
+
+// approximate search in range(0) of 64 clusters of a 4096 templates gallery,
+// recall against the exact search is reported as a counter
+void BM_ClusteredIndexSearch(benchmark::State &state)
+{
+	const size_t probes_count = static_cast<size_t>(state.range(0));
+	const std::vector<pbio::Template::Ptr> templates = make_templates(4096);
+	const std::vector<pbio::Template::Ptr> queries(templates.begin(), templates.begin() + 16);
+
+	const pbio::ClusteredTemplatesIndex index(recognizer(), templates, 64);
+
+	pbio::SearchResultBuffer result;
+
+	for(auto _ : state)
+	{
+		index.search(queries, 10, probes_count, result);
+
+		benchmark::DoNotOptimize(result.indexes(0));
+	}
+
+	state.counters["recall"] = index.measureRecall(queries, 10, probes_count).recall;
+	state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_ClusteredIndexSearch)->Arg(1)->Arg(8)->Arg(64);
+
+
+// 16 x 1024 distances: verifyMatch in nested loops against one verifyMatchMatrix call
+void BM_VerifyMatchLoop(benchmark::State &state)
+{
+	const std::vector<pbio::Template::Ptr> gallery = make_templates(1024);
+	const std::vector<pbio::Template::Ptr> queries(gallery.begin(), gallery.begin() + 16);
+
+	std::vector<float> distances(queries.size() * gallery.size());
+
+	for(auto _ : state)
+	{
+		for(size_t i = 0; i < queries.size(); ++i)
+			for(size_t j = 0; j < gallery.size(); ++j)
+				distances[i * gallery.size() + j] = recognizer()->verifyMatch(*queries[i], *gallery[j]).distance;
+
+		benchmark::DoNotOptimize(distances.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * distances.size());
+}
+BENCHMARK(BM_VerifyMatchLoop);
+
+
+// range(0) - threads count, each additional thread gets its own recognizer
+void BM_VerifyMatchMatrix(benchmark::State &state)
+{
+	const std::vector<pbio::Template::Ptr> gallery = make_templates(1024);
+	const std::vector<pbio::Template::Ptr> queries(gallery.begin(), gallery.begin() + 16);
+
+	const pbio::ThreadPool::Ptr thread_pool = pbio::ThreadPool::Ptr::make(static_cast<size_t>(state.range(0)));
+
+	std::vector<pbio::Recognizer::Ptr> thread_recognizers;
+
+	for(int i = 1; i < state.range(0); ++i)
+		thread_recognizers.push_back(service()->createRecognizer(recognizer_config, false, true));
+
+	std::vector<float> distances(queries.size() * gallery.size());
+
+	for(auto _ : state)
+	{
+		recognizer()->verifyMatchMatrix(queries, gallery, distances.data(), NULL, thread_pool, thread_recognizers);
+
+		benchmark::DoNotOptimize(distances.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * distances.size());
+}
+BENCHMARK(BM_VerifyMatchMatrix)->Arg(1)->Arg(4)->UseRealTime();
+
+
+// 4 shards of 128 templates, range(0) - threads count of the pool (1 - no worker threads),
+// each additional thread gets its own recognizer
+void BM_ShardedIndexSearch(benchmark::State &state)
+{
+	const std::vector<pbio::Template::Ptr> templates = make_templates(512);
+	const std::vector<pbio::Template::Ptr> queries(templates.begin(), templates.begin() + 16);
+
+	std::vector<pbio::TemplatesIndex::Ptr> shards;
+
+	for(size_t i = 0; i < templates.size(); i += 128)
+	{
+		shards.push_back(recognizer()->createIndex(
+			std::vector<pbio::Template::Ptr>(templates.begin() + i, templates.begin() + i + 128), 1));
+	}
+
+	const pbio::ShardedTemplatesIndex sharded_index(
+		shards,
+		pbio::ThreadPool::Ptr::make(static_cast<size_t>(state.range(0))));
+
+	std::vector<pbio::Recognizer::Ptr> thread_recognizers;
+
+	for(int i = 1; i < state.range(0); ++i)
+		thread_recognizers.push_back(service()->createRecognizer(recognizer_config, false, true));
+
+	pbio::SearchResultBuffer result(queries.size(), 10, shards.size());
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		recognizer()->search(queries, sharded_index, 10, result, pbio::Recognizer::SEARCH_ACCELERATION_1, thread_recognizers);
+
+		benchmark::DoNotOptimize(result.indexes(0));
+	}
+
+	state.SetItemsProcessed(state.iterations() * queries.size());
+}
+BENCHMARK(BM_ShardedIndexSearch)->Arg(1)->Arg(4)->UseRealTime();
+
+
+void tracking_callback(const pbio::VideoWorker::TrackingCallbackData &data, void* const userdata)
+{
+	*static_cast<size_t*>(userdata) += data.samples.size();
+}
+
+// the stand-in library calls the tracking callback synchronously from addVideoFrame,
+// so this measures the marshalling of VideoWorker::STrackingCallback
+void BM_VideoWorkerTrackingCallback(benchmark::State &state)
+{
+	pbio::FacerecService::Config config("video_worker_fdatracker.xml");
+	config.overrideParameter("stub_faces_count", static_cast<double>(state.range(0)));
+
+	const pbio::VideoWorker::Ptr video_worker = service()->createVideoWorker(
+		pbio::VideoWorker::Params()
+			.video_worker_config(config)
+			.recognizer_ini_file(recognizer_config)
+			.streams_count(1)
+			.processing_threads_count(1)
+			.matching_threads_count(1));
+
+	size_t samples_count = 0;
+
+	video_worker->addTrackingCallbackU(tracking_callback, &samples_count);
+
+	{
+		AllocationsCounter counter(state);
+
+		for(auto _ : state)
+			video_worker->addVideoFrame(image(), 0);
+	}
+
+	video_worker->checkExceptions();
+
+	state.SetItemsProcessed(samples_count);
+}
+BENCHMARK(BM_VideoWorkerTrackingCallback)->Arg(1)->Arg(8);
+
+
+void BM_RawSampleGetLandmarks(benchmark::State &state)
+{
+	const pbio::RawSample::Ptr sample = capture(1)[0];
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		const std::vector<pbio::RawSample::Point> landmarks = sample->getLandmarks();
+
+		benchmark::DoNotOptimize(landmarks.data());
+	}
+}
+BENCHMARK(BM_RawSampleGetLandmarks);
+
+
+void BM_TemplateSave(benchmark::State &state)
+{
+	const pbio::Template::Ptr templ = make_templates(1)[0];
+
+	std::ostringstream stream;
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		stream.seekp(0);
+		templ->save(stream);
+	}
+}
+BENCHMARK(BM_TemplateSave);
+
+
+void BM_RecognizerLoadTemplate(benchmark::State &state)
+{
+	std::ostringstream saved;
+	make_templates(1)[0]->save(saved);
+
+	std::istringstream stream(saved.str());
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		stream.clear();
+		stream.seekg(0);
+
+		const pbio::Template::Ptr templ = recognizer()->loadTemplate(stream);
+
+		benchmark::DoNotOptimize(templ.get());
+	}
+}
+BENCHMARK(BM_RecognizerLoadTemplate);
+
+
+// gallery of range(0) templates: one loadTemplate per saved template in a stream
+// against one loadTemplates / createIndex call on the packed gallery in memory
+void BM_GalleryLoadStream(benchmark::State &state)
+{
+	std::ostringstream saved;
+
+	const std::vector<pbio::Template::Ptr> templates = make_templates(static_cast<int>(state.range(0)));
+
+	for(size_t i = 0; i < templates.size(); ++i)
+		templates[i]->save(saved);
+
+	std::istringstream stream(saved.str());
+
+	for(auto _ : state)
+	{
+		stream.clear();
+		stream.seekg(0);
+
+		std::vector<pbio::Template::Ptr> loaded;
+
+		for(size_t i = 0; i < templates.size(); ++i)
+			loaded.push_back(recognizer()->loadTemplate(stream));
+
+		benchmark::DoNotOptimize(loaded.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * templates.size());
+}
+BENCHMARK(BM_GalleryLoadStream)->Arg(1024);
+
+
+void BM_GalleryLoadPacked(benchmark::State &state)
+{
+	std::ostringstream saved;
+
+	pbio::PackedGallery::write(saved, make_templates(static_cast<int>(state.range(0))));
+
+	const std::string data = saved.str();
+	const pbio::PackedGallery gallery(data.data(), data.size());
+
+	for(auto _ : state)
+	{
+		const std::vector<pbio::Template::Ptr> loaded = recognizer()->loadTemplates(gallery);
+
+		benchmark::DoNotOptimize(loaded.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * gallery.size());
+}
+BENCHMARK(BM_GalleryLoadPacked)->Arg(1024);
+
+
+void BM_GalleryCreateIndexPacked(benchmark::State &state)
+{
+	std::ostringstream saved;
+
+	pbio::PackedGallery::write(saved, make_templates(static_cast<int>(state.range(0))));
+
+	const std::string data = saved.str();
+	const pbio::PackedGallery gallery(data.data(), data.size());
+
+	for(auto _ : state)
+	{
+		const pbio::TemplatesIndex::Ptr index = recognizer()->createIndex(gallery);
+
+		benchmark::DoNotOptimize(index.get());
+	}
+
+	state.SetItemsProcessed(state.iterations() * gallery.size());
+}
+BENCHMARK(BM_GalleryCreateIndexPacked)->Arg(1024);
+
+
+// enrollment of one template into a gallery of range(0) templates:
+// full rebuild with createIndex against UpdatableTemplatesIndex::add (delta chunks and background compaction)
+void BM_EnrollRebuildIndex(benchmark::State &state)
+{
+	std::vector<pbio::Template::Ptr> templates = make_templates(static_cast<int>(state.range(0)));
+
+	for(auto _ : state)
+	{
+		templates.push_back(templates[templates.size() % 64]);
+
+		const pbio::TemplatesIndex::Ptr index = recognizer()->createIndex(templates);
+
+		benchmark::DoNotOptimize(index.get());
+	}
+}
+BENCHMARK(BM_EnrollRebuildIndex)->Arg(4096);
+
+
+void BM_EnrollUpdatableIndex(benchmark::State &state)
+{
+	const std::vector<pbio::Template::Ptr> templates = make_templates(static_cast<int>(state.range(0)));
+
+	pbio::UpdatableTemplatesIndex index(
+		recognizer(),
+		templates,
+		1,
+		0.1,
+		service()->createRecognizer(recognizer_config, false, true));
+
+	const std::vector<pbio::Template::Ptr> added(1, templates[0]);
+
+	for(auto _ : state)
+		benchmark::DoNotOptimize(index.add(added).data());
+
+	index.checkExceptions();
+}
+BENCHMARK(BM_EnrollUpdatableIndex)->Arg(4096);
+
+
+// bulk construction of a DynamicTemplateIndex of 4096 templates:
+// add with std::string uuids (range(0) == 0) against add with packed uuids in chunks of 512 (1)
+void BM_DynamicIndexBulkAdd(benchmark::State &state)
+{
+	const std::vector<pbio::Template::Ptr> templates = make_templates(4096);
+
+	std::vector<pbio::ContextTemplate::Ptr> context_templates;
+	std::vector<std::string> uuids;
+	std::string uuids_buffer;
+	std::vector<uint64_t> uuids_offsets;
+
+	for(size_t i = 0; i < templates.size(); ++i)
+	{
+		std::stringstream stream;
+		templates[i]->save(stream);
+		context_templates.push_back(service()->loadContextTemplate(stream));
+
+		uuids.push_back(std::to_string(i));
+		uuids_offsets.push_back(uuids_buffer.size());
+		uuids_buffer.append(uuids.back().c_str(), uuids.back().size() + 1);
+	}
+
+	pbio::Context config = service()->createContext();
+	config["modification"] = recognizer()->getMethodName();
+
+	for(auto _ : state)
+	{
+		const pbio::DynamicTemplateIndex::Ptr index = service()->createDynamicTemplateIndex(config);
+
+		if(state.range(0) == 0)
+			index->add(context_templates, uuids);
+		else
+			index->add(context_templates, uuids_buffer.data(), uuids_offsets, 512);
+
+		benchmark::DoNotOptimize(index.get());
+	}
+
+	state.SetItemsProcessed(state.iterations() * templates.size());
+}
+BENCHMARK(BM_DynamicIndexBulkAdd)->Arg(0)->Arg(1);
+
+
+// restart of a 4096 templates DynamicTemplateIndex: templates loaded one by one from streams and added (range(0) == 0)
+// against loadDynamicTemplateIndex of a packed file read at once (1) or memory-mapped (2)
+void BM_DynamicIndexLoad(benchmark::State &state)
+{
+	const std::vector<pbio::Template::Ptr> templates = make_templates(4096);
+	const std::string file_path = "pbio_bench_dynamic_index.pdti";
+
+	std::vector<std::string> blobs;
+	std::vector<std::string> uuids;
+
+	for(size_t i = 0; i < templates.size(); ++i)
+	{
+		std::ostringstream stream;
+		templates[i]->save(stream);
+		blobs.push_back(stream.str());
+		uuids.push_back(std::to_string(i));
+	}
+
+	pbio::Context config = service()->createContext();
+	config["modification"] = recognizer()->getMethodName();
+
+	{
+		const pbio::DynamicTemplateIndex::Ptr index = service()->createDynamicTemplateIndex(config);
+
+		for(size_t i = 0; i < blobs.size(); ++i)
+		{
+			std::istringstream stream(blobs[i]);
+			index->add(service()->loadContextTemplate(stream), uuids[i]);
+		}
+
+		index->savePacked(file_path, true);
+	}
+
+	for(auto _ : state)
+	{
+		pbio::DynamicTemplateIndex::Ptr index;
+
+		if(state.range(0) == 0)
+		{
+			index = service()->createDynamicTemplateIndex(config);
+
+			for(size_t i = 0; i < blobs.size(); ++i)
+			{
+				std::istringstream stream(blobs[i]);
+				index->add(service()->loadContextTemplate(stream), uuids[i]);
+			}
+		}
+		else
+		{
+			index = service()->loadDynamicTemplateIndex(file_path, config, state.range(0) == 2);
+		}
+
+		benchmark::DoNotOptimize(index.get());
+	}
+
+	std::remove(file_path.c_str());
+
+	state.SetItemsProcessed(state.iterations() * templates.size());
+}
+BENCHMARK(BM_DynamicIndexLoad)->Arg(0)->Arg(1)->Arg(2);
+
+
+struct RefCounted
+{
+	int32_t refcounter4light_shared_ptr;
+	int value;
+};
+
+void BM_LightSharedPtrCopy(benchmark::State &state)
+{
+	const pbio::light_shared_ptr<RefCounted> ptr = pbio::light_shared_ptr<RefCounted>::make();
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		pbio::light_shared_ptr<RefCounted> copy(ptr);
+
+		benchmark::DoNotOptimize(copy.get());
+	}
+}
+BENCHMARK(BM_LightSharedPtrCopy);
+
+
+void BM_LightSharedPtrCopySingleThread(benchmark::State &state)
+{
+	const pbio::light_shared_ptr<RefCounted, pbio::single_thread_refcounter> ptr =
+		pbio::light_shared_ptr<RefCounted, pbio::single_thread_refcounter>::make();
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		pbio::light_shared_ptr<RefCounted, pbio::single_thread_refcounter> copy(ptr);
+
+		benchmark::DoNotOptimize(copy.get());
+	}
+}
+BENCHMARK(BM_LightSharedPtrCopySingleThread);
+
+
+// rebuild of an in-memory gallery: copy of a vector of template pointers
+template<typename RefCounter>
+void BM_GalleryCopy(benchmark::State &state)
+{
+	typedef pbio::light_shared_ptr<pbio::Template, RefCounter> TemplatePtr;
+
+	const std::vector<pbio::Template::Ptr> templates = make_templates(static_cast<int>(state.range(0)));
+	const std::vector<TemplatePtr> gallery(templates.begin(), templates.end());
+
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		const std::vector<TemplatePtr> copy(gallery);
+
+		benchmark::DoNotOptimize(copy.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_GalleryCopy, pbio::atomic_refcounter)->Arg(1024);
+BENCHMARK_TEMPLATE(BM_GalleryCopy, pbio::single_thread_refcounter)->Arg(1024);
+
+
+void BM_LightSharedPtrMakeDestroy(benchmark::State &state)
+{
+	AllocationsCounter counter(state);
+
+	for(auto _ : state)
+	{
+		pbio::light_shared_ptr<RefCounted> ptr = pbio::light_shared_ptr<RefCounted>::make();
+
+		benchmark::DoNotOptimize(ptr.get());
+	}
+}
+BENCHMARK(BM_LightSharedPtrMakeDestroy)->Threads(1)->Threads(4);
+
+}  // namespace
+
+
+int main(int argc, char** argv)
+{
+	benchmark::Initialize(&argc, argv);
+
+	// the only non-benchmark argument is the optional path to libfacerec.so
+	if(argc > 2 || (argc == 2 && std::string(argv[1]).compare(0, 2, "--") == 0))
+	{
+		std::cerr << "Usage: " << argv[0] << " [<dll_path>] [--benchmark_...]" << std::endl;
+		return 1;
+	}
+
+	if(argc == 2)
+		dll_path = argv[1];
+
+	try
+	{
+		std::cerr << "libfacerec version: " << service()->getVersion() << std::endl;
+
+		benchmark::RunSpecifiedBenchmarks();
+		benchmark::Shutdown();
+	}
+	catch(const pbio::Error &e)
+	{
+		std::cerr << "facerec exception catched: '" << e.what() << "' code: " << std::hex << e.code() << std::endl;
+		return 1;
+	}
+	catch(const std::exception &e)
+	{
+		std::cerr << "exception catched: '" << e.what() << "'" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
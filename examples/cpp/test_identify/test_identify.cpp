@@ -378,13 +378,20 @@ void identifying_mode(const pbio::Capturer::Ptr capturer, const pbio::Recognizer
 	// vector<pair<distance, name>>
 	std::vector<std::pair<double, std::string> > matches;
 
+	// one row of distances: the_template with every template, in one call
+	std::vector<float> distances( templates.size() );
+
+	const time_point time_m = get_time_point();
+	recognizer->verifyMatchMatrix(
+		std::vector<pbio::Template::Ptr>( 1, the_template ),
+		templates,
+		distances.data(),
+		NULL );
+	std::cout << "templates matching time: " << milliseconds_from( time_m ) << " ms for " << count << " templates" << std::endl;
+
 	for( int i = 0; i < count; ++i )
 	{
-		const time_point time_c = get_time_point();
-		const pbio::Recognizer::MatchResult match = recognizer->verifyMatch( *the_template, *templates[i] );
-		std::cout << "templates matching time: " << milliseconds_from( time_c ) << " ms" << std::endl;
-
-		matches.push_back( std::make_pair( match.distance, names[i] ) );
+		matches.push_back( std::make_pair( (double) distances[i], names[i] ) );
 	}
 
 	std::cout << "Attention! The matching time measured very roughly and limited by timer precision,"
@@ -0,0 +1,24 @@
+#ifndef __TEST_SDK__DEDUP_H__
+#define __TEST_SDK__DEDUP_H__
+
+#include "common.h"
+
+namespace dedup {
+
+
+void dedup(
+	const std::string dll_path,
+	const std::string sdk_config_dir,
+	const std::string recognizer_config,
+	const std::vector<std::string> processing_result_files,
+	const std::string result_duplicates_file,
+	const int query_k_nearest,
+	const double far_threshold,
+	const int use_cpu_cores_count,
+	const int acceleration);
+
+
+}  // namespace dedup
+
+
+#endif  // __TEST_SDK__DEDUP_H__
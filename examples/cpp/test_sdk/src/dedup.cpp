@@ -0,0 +1,142 @@
+#include <fstream>
+
+#include "dedup.h"
+
+namespace dedup {
+
+
+// union-find root with path halving
+size_t find_root(std::vector<size_t> &parent, size_t i)
+{
+	while(parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+
+	return i;
+}
+
+
+void dedup(
+	const std::string dll_path,
+	const std::string sdk_config_dir,
+	const std::string recognizer_config,
+	const std::vector<std::string> processing_result_files,
+	const std::string result_duplicates_file,
+	const int query_k_nearest,
+	const double far_threshold,
+	const int use_cpu_cores_count,
+	const int acceleration)
+{
+	std::ofstream result_file(result_duplicates_file.c_str());
+	TMASSERT(result_file.is_open(), "Can't open output file '" + result_duplicates_file + "'");
+
+	// create service and recognizer
+	// (selfJoin searches in the threads of the index)
+	const pbio::FacerecService::Ptr service = pbio::FacerecService::createService(
+		dll_path,
+		sdk_config_dir);
+	std::cout << "Library version: " << service->getVersion() << std::endl << std::endl;
+
+	const pbio::Recognizer::Ptr recognizer = service->createRecognizer(recognizer_config, false, true);
+
+	// read templates
+	std::cout << "reading templates" << std::endl;
+
+	std::vector<pbio::Template::Ptr> templates;
+	std::vector<uint64_t> templates_image_id;
+
+	for(size_t i = 0; i < processing_result_files.size(); i++)
+	{
+		std::ifstream ifs_templates(processing_result_files[i].c_str(), std::ios_base::binary);
+		TMASSERT(ifs_templates.is_open(), "Can't open input file '" + processing_result_files[i] + "'");
+
+		uint64_t image_id;
+		while(ifs_templates.read((char*) &image_id, sizeof(image_id)))
+		{
+			templates.push_back(recognizer->loadTemplate(ifs_templates));
+			templates_image_id.push_back(image_id);
+		}
+	}
+
+	TMASSERT(templates.size() > 1, "Can't load templates");
+
+	std::cout << "templates count: " << templates.size() << std::endl;
+
+	// index self-join
+	const time_point tick1 = get_time_point();
+
+	const pbio::TemplatesIndex::Ptr index = recognizer->createIndex(templates, use_cpu_cores_count);
+
+	const time_point tick2 = get_time_point();
+
+	const std::vector<pbio::Recognizer::DuplicatePair> pairs = recognizer->selfJoin(
+		*index,
+		query_k_nearest,
+		far_threshold,
+		acceleration ?
+			pbio::Recognizer::SEARCH_ACCELERATION_1 :
+			pbio::Recognizer::NO_SEARCH_ACCELERATION);
+
+	const time_point tick3 = get_time_point();
+
+	std::cout << " index created in " << chrono::duration<double>(tick2 - tick1).count() << "s" << std::endl;
+	std::cout << " self-join done in " << chrono::duration<double>(tick3 - tick2).count() << "s" << std::endl;
+
+	// clusters are the connected components of the duplicates graph
+	std::vector<size_t> parent(templates.size());
+	for(size_t i = 0; i < parent.size(); ++i)
+		parent[i] = i;
+
+	for(size_t p = 0; p < pairs.size(); ++p)
+	{
+		const size_t a = find_root(parent, pairs[p].i);
+		const size_t b = find_root(parent, pairs[p].j);
+
+		parent[(std::max)(a, b)] = (std::min)(a, b);
+	}
+
+	// cluster id is the number of the cluster in the order of its first template
+	std::vector<size_t> root2cluster_id(templates.size(), (size_t) -1);
+	size_t clusters_count = 0;
+
+	for(size_t p = 0; p < pairs.size(); ++p)
+	{
+		const size_t root = find_root(parent, pairs[p].i);
+
+		if(root2cluster_id[root] == (size_t) -1)
+			root2cluster_id[root] = clusters_count++;
+	}
+
+	// one line per pair: cluster_id image_id1 image_id2 distance far score
+	std::vector<std::vector<size_t> > clusters_pairs(clusters_count);
+
+	for(size_t p = 0; p < pairs.size(); ++p)
+		clusters_pairs[root2cluster_id[find_root(parent, pairs[p].i)]].push_back(p);
+
+	for(size_t c = 0; c < clusters_count; ++c)
+	{
+		for(size_t n = 0; n < clusters_pairs[c].size(); ++n)
+		{
+			const pbio::Recognizer::DuplicatePair &pair = pairs[clusters_pairs[c][n]];
+
+			result_file <<
+				c << " " <<
+				templates_image_id[pair.i] << " " <<
+				templates_image_id[pair.j] << " " <<
+				pair.match_result.distance << " " <<
+				pair.match_result.fa_r << " " <<
+				pair.match_result.score << "\n";
+		}
+	}
+
+	result_file.flush();
+	TASSERT(result_file.is_open() && result_file.good());
+
+	std::cout << "duplicate pairs: " << pairs.size() << std::endl;
+	std::cout << "clusters of duplicates: " << clusters_count << std::endl;
+}
+
+
+}  // namespace dedup
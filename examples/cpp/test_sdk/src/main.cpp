@@ -6,6 +6,7 @@
 
 #include "common.h"
 #include "convert_config_format.h"
+#include "dedup.h"
 #include "detection.h"
 #include "processing.h"
 #include "recognition_test11.h"
@@ -27,6 +28,7 @@ int main(int argc, char* argv[]) try
 			"\trecognition_test_11\n" +
 			"\trecognition_test_1N\n" +
 			"\tsearch_speed_test\n" +
+			"\tdedup\n" +
 			"\tconvert_config_format\n" +
 			"\n" +
 			"detection:\n" +
@@ -92,6 +94,17 @@ int main(int argc, char* argv[]) try
 			"\t[--runtime_log_file]\n" +
 			"\tTEMPLATES_FILES (processing result or result of utils/template_generator)\n" +
 			"\n" +
+			"dedup:\n" +
+			"\t--dll_path\n" +
+			"\t--sdk_config_dir\n" +
+			"\t--recognizer_config\n" +
+			"\t--result_duplicates_file\n" +
+			"\t[--query_k_nearest]\n" +
+			"\t[--far_threshold]\n" +
+			"\t[--use_cpu_cores_count]\n" +
+			"\t[--acceleration]\n" +
+			"\tFILES (processing result)\n" +
+			"\n" +
 			"convert_config_format:\n" +
 			"\t--result_dataset_config\n" +
 			"\tFILE\n"
@@ -311,6 +324,43 @@ int main(int argc, char* argv[]) try
 		return 0;
 	}
 
+	if( mode == "dedup" )
+	{
+		std::cout << "\n";
+		std::cout << "==========" << "\n";
+		std::cout << "DEDUP MODE" << "\n";
+		std::cout << "==========" << "\n" << std::endl;
+
+		const std::string dll_path               = parser.get<std::string>("--dll_path              ", default_dll_path);
+		const std::string sdk_config_dir         = parser.get<std::string>("--sdk_config_dir        ", "../conf/facerec");
+		const std::string recognizer_config      = parser.get<std::string>("--recognizer_config     ");
+		const std::string result_duplicates_file = parser.get<std::string>("--result_duplicates_file");
+		const int         query_k_nearest        = parser.get<int        >("--query_k_nearest       ", 10);
+		const double      far_threshold          = parser.get<double     >("--far_threshold         ", 1e-6);
+		const int         use_cpu_cores_count    = parser.get<int        >("--use_cpu_cores_count   ", 1);
+		const int         acceleration           = parser.get<int        >("--acceleration          ", 0);
+
+		TASSERT(query_k_nearest > 0);
+		TASSERT(use_cpu_cores_count > 0);
+
+		// get source config files
+		std::vector<std::string> processing_result_files = parser.get();
+		TMASSERT(!processing_result_files.empty(), "Not found source templates files.");
+
+		dedup::dedup(
+			dll_path,
+			sdk_config_dir,
+			recognizer_config,
+			processing_result_files,
+			result_duplicates_file,
+			query_k_nearest,
+			far_threshold,
+			use_cpu_cores_count,
+			acceleration);
+
+		return 0;
+	}
+
 	if( mode == "convert_config_format" )
 	{
 		std::cout << "\n";
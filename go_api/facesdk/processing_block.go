@@ -5,10 +5,24 @@ package facesdk
 
 void TDVProcessingBlock_processContext(void* handle_, void* config, void** eh);
 void TDVProcessingBlock_destroyBlock(void* handle_, void** eh);
+
+static int processBatch(void* handle_, void** contexts, int count, void** eh)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		TDVProcessingBlock_processContext(handle_, contexts[i], eh);
+
+		if (*eh)
+			return i;
+	}
+
+	return -1;
+}
 */
 import "C"
 import (
 	"errors"
+	"fmt"
 	"unsafe"
 )
 
@@ -25,6 +39,35 @@ func (block *ProcessingBlock) Process(context Context) error {
 	return checkProcessingBlockException(exception)
 }
 
+// Infer each context of a batch in order with a single cgo call,
+// on an error the preceding contexts stay processed
+func (block *ProcessingBlock) ProcessBatch(contexts []Context) error {
+	if len(contexts) == 0 {
+		return nil
+	}
+
+	handles := (*[1 << 28]unsafe.Pointer)(C.malloc(C.size_t(len(contexts)) * C.size_t(unsafe.Sizeof(unsafe.Pointer(nil)))))[:len(contexts):len(contexts)]
+	defer C.free(unsafe.Pointer(&handles[0]))
+
+	for i, context := range contexts {
+		if context.implementation == nil {
+			return fmt.Errorf("ProcessBatch: context %d is not created", i)
+		}
+
+		handles[i] = context.implementation
+	}
+
+	exception := createException()
+
+	index := C.processBatch(block.implementation, &handles[0], C.int(len(contexts)), &exception)
+
+	if err := checkProcessingBlockException(exception); err != nil {
+		return fmt.Errorf("ProcessBatch: context %d: %w", int(index), err)
+	}
+
+	return nil
+}
+
 // Destroy ProcessingBlock
 func (block *ProcessingBlock) Close() error {
 	if block.implementation == nil {
@@ -15,6 +15,7 @@
 
 #include "ComplexObject.h"
 #include "Error.h"
+#include "Expected.h"
 #include "RawImage.h"
 #include "RawSample.h"
 #include "SmartPtr.h"
@@ -140,6 +141,31 @@ public:
 	*/
 	std::vector<RawSample::Ptr> capture(const unsigned char *data, int data_size);
 
+	/**
+		\~English
+		\brief
+			Same as capture(const RawImage), but an error of the library is returned
+			as a failed status instead of throwing pbio::Error.
+
+		\param[in]  image
+			Image or videoframe.
+
+		\return
+			Vector of captured face samples or failed status.
+
+		\~Russian
+		\brief
+			То же, что capture(const RawImage), но ошибка библиотеки возвращается
+			в виде статуса ошибки вместо выбрасывания pbio::Error.
+
+		\param[in]  image
+			Изображение или кадр видео.
+
+		\return
+			Вектор найденных лиц или статус ошибки.
+	*/
+	Expected<std::vector<RawSample::Ptr> > tryCapture(const RawImage image);
+
 	/**
 		\~English
 		\brief
@@ -524,6 +550,43 @@ std::vector<RawSample::Ptr> Capturer::capture(const unsigned char *data, int dat
 	return result;
 }
 
+inline
+Expected<std::vector<RawSample::Ptr> > Capturer::tryCapture(const RawImage image)
+{
+	std::vector<void*> void_result;
+
+	void* exception = NULL;
+
+	const RawImage::CapiData cdata = image.makeCapiData();
+
+	_dll_handle->Capturer_capture_raw_image_with_crop(
+		_impl,
+		cdata.data,
+		cdata.width,
+		cdata.height,
+		cdata.format,
+		cdata.with_crop,
+		cdata.crop_info_offset_x,
+		cdata.crop_info_offset_y,
+		cdata.crop_info_data_image_width,
+		cdata.crop_info_data_image_height,
+		&void_result,
+		pbio::stl_wraps::assign_pointers_vector_func,
+		&exception);
+
+	const Status status = exceptionStatus(exception, *_dll_handle);
+
+	if(!status.ok())
+		return status;
+
+	std::vector<RawSample::Ptr> result(void_result.size());
+
+	for(size_t i = 0; i < void_result.size(); ++i)
+		result[i] = RawSample::Ptr::make(_dll_handle, void_result[i]);
+
+	return result;
+}
+
 inline
 RawSample::Ptr Capturer::manualCapture(
 	const RawImage image,
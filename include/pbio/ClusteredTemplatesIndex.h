@@ -0,0 +1,618 @@
+/**
+	\file ClusteredTemplatesIndex.h
+	\~English
+	\brief ClusteredTemplatesIndex - templates index with the approximate search in the nearest clusters (IVF).
+	\~Russian
+	\brief ClusteredTemplatesIndex - индекс шаблонов с приближенным поиском в ближайших кластерах (IVF).
+*/
+
+#ifndef __PBIO_API__PBIO__CLUSTERED_TEMPLATES_INDEX_H_
+#define __PBIO_API__PBIO__CLUSTERED_TEMPLATES_INDEX_H_
+
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+#include "Error.h"
+#include "Recognizer.h"
+#include "SearchResultBuffer.h"
+#include "SmartPtr.h"
+#include "Template.h"
+#include "TemplatesIndex.h"
+#include "ThreadPool.h"
+
+
+namespace pbio
+{
+
+/** \~English
+	\brief
+		Templates index with the approximate search (inverted file, IVF).
+		The templates are split into clusters: clusters_count templates sampled uniformly
+		from the gallery are the cluster centers, every template belongs to the cluster
+		of the nearest center, every cluster has its own TemplatesIndex.
+		A query is compared with all centers and searched only in the probes_count clusters
+		with the nearest centers, so the search cost is about
+		clusters_count + probes_count * size() / clusters_count comparisons instead of size().
+		probes_count trades recall for speed, probes_count == clustersCount() with
+		NO_SEARCH_ACCELERATION gives the exact search. Use measureRecall to choose
+		probes_count on a validation set.
+		Indexes in the search results are the indexes of the templates in the vector
+		passed to the constructor.
+	\~Russian
+	\brief
+		Индекс шаблонов с приближенным поиском (инвертированный файл, IVF).
+		Шаблоны разбиваются на кластеры: clusters_count шаблонов, равномерно выбранных
+		из базы, являются центрами кластеров, каждый шаблон относится к кластеру
+		ближайшего центра, у каждого кластера свой TemplatesIndex.
+		Запрос сравнивается со всеми центрами, и поиск выполняется только в probes_count кластерах
+		с ближайшими центрами, поэтому стоимость поиска - около
+		clusters_count + probes_count * size() / clusters_count сравнений вместо size().
+		probes_count задает соотношение полноты и скорости, probes_count == clustersCount() с
+		NO_SEARCH_ACCELERATION дает точный поиск. Для выбора probes_count на валидационном наборе
+		используйте measureRecall.
+		Индексы в результатах поиска - индексы шаблонов в векторе,
+		переданном в конструктор.
+*/
+class ClusteredTemplatesIndex
+{
+public:
+
+	/** \~English
+		\brief Alias for the type of a smart pointer to ClusteredTemplatesIndex.
+		\~Russian
+		\brief Псевдоним для типа умного указателя на ClusteredTemplatesIndex.
+	*/
+	typedef LightSmartPtr<ClusteredTemplatesIndex>::tPtr Ptr;
+
+	/** \~English
+		\brief Recall of the approximate search measured by measureRecall.
+		\~Russian
+		\brief Полнота приближенного поиска, измеренная с помощью measureRecall.
+	*/
+	struct RecallReport
+	{
+		/** \~English
+			\brief Fraction of the exact k nearest templates found by the approximate search.
+			\~Russian
+			\brief Доля точных k ближайших шаблонов, найденных приближенным поиском.
+		*/
+		double recall;
+
+		/** \~English
+			\brief Time of the approximate search of all validation queries in seconds.
+			\~Russian
+			\brief Время приближенного поиска всех валидационных запросов в секундах.
+		*/
+		double approximate_time;
+
+		/** \~English
+			\brief Time of the exact search of all validation queries in seconds.
+			\~Russian
+			\brief Время точного поиска всех валидационных запросов в секундах.
+		*/
+		double exact_time;
+	};
+
+	/**
+		\~English
+		\brief
+			Create an index.
+
+		\param[in]  recognizer
+			Recognizer that created the templates, used to build and search the clusters.
+
+		\param[in]  templates
+			Templates of the gallery.
+
+		\param[in]  clusters_count
+			Count of clusters, sqrt(templates.size()) is a reasonable start.
+			Must be positive, is reduced to templates.size() if it is larger.
+
+		\param[in]  search_threads_count
+			Count of threads that will be used while searching in a cluster.
+
+		\param[in]  thread_pool
+			Pool for the parallel comparison with the cluster centers
+			(see Recognizer::verifyMatchMatrix), if NULL, it is done in the calling thread.
+
+		\param[in]  thread_recognizers
+			Recognizers for the additional threads of the pool.
+
+		\~Russian
+		\brief
+			Создать индекс.
+
+		\param[in]  recognizer
+			Распознаватель, создавший шаблоны, используется для построения кластеров и поиска в них.
+
+		\param[in]  templates
+			Шаблоны базы.
+
+		\param[in]  clusters_count
+			Количество кластеров, sqrt(templates.size()) - разумное начальное значение.
+			Должно быть положительным, уменьшается до templates.size(), если больше.
+
+		\param[in]  search_threads_count
+			Количество потоков для использования во время поиска в кластере.
+
+		\param[in]  thread_pool
+			Пул для параллельного сравнения с центрами кластеров
+			(см. Recognizer::verifyMatchMatrix), если NULL, оно выполняется в вызывающем потоке.
+
+		\param[in]  thread_recognizers
+			Распознаватели для дополнительных потоков пула.
+	*/
+	ClusteredTemplatesIndex(
+		const pbio::Recognizer::Ptr &recognizer,
+		const std::vector<pbio::Template::Ptr> &templates,
+		const size_t clusters_count,
+		const int search_threads_count = 1,
+		const pbio::ThreadPool::Ptr &thread_pool = pbio::ThreadPool::Ptr(),
+		const std::vector<pbio::Recognizer::Ptr> &thread_recognizers = std::vector<pbio::Recognizer::Ptr>());
+
+	/**
+		\~English
+		\brief Get a number of templates.
+		\~Russian
+		\brief Получить количество шаблонов.
+	*/
+	size_t size() const
+	{
+		return _locations.size();
+	}
+
+	/**
+		\~English
+		\brief Get a number of clusters.
+		\~Russian
+		\brief Получить количество кластеров.
+	*/
+	size_t clustersCount() const
+	{
+		return _centers.size();
+	}
+
+	/**
+		\~English
+		\brief Get a number of templates in the cluster.
+		\~Russian
+		\brief Получить количество шаблонов в кластере.
+	*/
+	size_t clusterSize(const size_t cluster) const;
+
+	/**
+		\~English
+		\brief Get the i-th template.
+		\~Russian
+		\brief Получить i-й шаблон.
+	*/
+	pbio::Template::Ptr at(const size_t i) const;
+
+	/**
+		\~English
+		\brief
+			Approximate search for the k nearest templates in the probes_count nearest clusters.
+			Results are the same as of Recognizer::search in the index of all templates
+			if the k nearest templates are in the probed clusters.
+
+		\param[in]  queries_templates
+			Vector of queries.
+
+		\param[in]  k
+			Count of the nearest templates for search.
+
+		\param[in]  probes_count
+			Count of the searched clusters, is reduced to clustersCount() if it is larger.
+
+		\param[out]  result
+			Buffer for the results, its previous content is overwritten.
+
+		\param[in]  acceleration
+			Acceleration type of the search in a cluster.
+
+		\~Russian
+		\brief
+			Приближенный поиск k ближайших шаблонов в probes_count ближайших кластерах.
+			Результаты совпадают с результатами Recognizer::search в индексе всех шаблонов,
+			если k ближайших шаблонов находятся в просмотренных кластерах.
+
+		\param[in]  queries_templates
+			Вектор запросных шаблонов.
+
+		\param[in]  k
+			Количество ближайших шаблонов для поиска.
+
+		\param[in]  probes_count
+			Количество кластеров для поиска, уменьшается до clustersCount(), если больше.
+
+		\param[out]  result
+			Буфер для результатов, его предыдущее содержимое перезаписывается.
+
+		\param[in]  acceleration
+			Тип ускорения поиска в кластере.
+	*/
+	void search(
+		const std::vector<pbio::Template::Ptr> &queries_templates,
+		const size_t k,
+		const size_t probes_count,
+		SearchResultBuffer &result,
+		const Recognizer::SearchAccelerationType acceleration = Recognizer::SEARCH_ACCELERATION_1) const;
+
+	/**
+		\~English
+		\brief
+			Approximate search for the k nearest templates in the probes_count nearest clusters.
+
+		\~Russian
+		\brief
+			Приближенный поиск k ближайших шаблонов в probes_count ближайших кластерах.
+	*/
+	std::vector<std::vector<Recognizer::SearchResult> > search(
+		const std::vector<pbio::Template::Ptr> &queries_templates,
+		const size_t k,
+		const size_t probes_count,
+		const Recognizer::SearchAccelerationType acceleration = Recognizer::SEARCH_ACCELERATION_1) const;
+
+	/**
+		\~English
+		\brief
+			Measure the recall of the approximate search with probes_count and acceleration
+			against the exact search (all clusters, NO_SEARCH_ACCELERATION)
+			on the validation queries.
+
+		\~Russian
+		\brief
+			Измерить полноту приближенного поиска с probes_count и acceleration
+			относительно точного поиска (все кластеры, NO_SEARCH_ACCELERATION)
+			на валидационных запросах.
+	*/
+	RecallReport measureRecall(
+		const std::vector<pbio::Template::Ptr> &validation_queries,
+		const size_t k,
+		const size_t probes_count,
+		const Recognizer::SearchAccelerationType acceleration = Recognizer::SEARCH_ACCELERATION_1) const;
+
+private:
+
+	ClusteredTemplatesIndex(const ClusteredTemplatesIndex&);
+	ClusteredTemplatesIndex& operator=(const ClusteredTemplatesIndex&);
+
+	struct Cluster
+	{
+		pbio::TemplatesIndex::Ptr index;
+
+		// indexes of the templates of the cluster in the gallery
+		std::vector<int64_t> ids;
+	};
+
+	// the distances to the centers are computed for blocks of templates (or queries)
+	// of about block_distances_count / clustersCount() rows, so only one block is kept in memory
+	static const size_t block_distances_count = 1 << 16;
+	static const size_t min_block_rows_count = 16;
+
+	size_t blockRowsCount() const;
+
+	// distances of templates[begin, end) to the centers, rows of clustersCount() elements
+	void centersDistances(
+		const std::vector<pbio::Template::Ptr> &templates,
+		const size_t begin,
+		const size_t end,
+		std::vector<pbio::Template::Ptr> &block,
+		std::vector<float> &distances) const;
+
+	const pbio::Recognizer::Ptr _recognizer;
+	const pbio::ThreadPool::Ptr _thread_pool;
+	const std::vector<pbio::Recognizer::Ptr> _thread_recognizers;
+
+	std::vector<pbio::Template::Ptr> _centers;
+	std::vector<Cluster> _clusters;
+
+	// (cluster, index in the cluster) of every template
+	std::vector<std::pair<uint32_t, uint32_t> > _locations;
+
+	int32_t refcounter4light_shared_ptr;
+
+	friend class object_with_ref_counter<ClusteredTemplatesIndex>;
+};
+
+}  // pbio namespace
+
+
+
+////////////////////////
+/////IMPLEMENTATION/////
+////////////////////////
+
+namespace pbio
+{
+
+inline
+ClusteredTemplatesIndex::ClusteredTemplatesIndex(
+	const pbio::Recognizer::Ptr &recognizer,
+	const std::vector<pbio::Template::Ptr> &templates,
+	const size_t clusters_count,
+	const int search_threads_count,
+	const pbio::ThreadPool::Ptr &thread_pool,
+	const std::vector<pbio::Recognizer::Ptr> &thread_recognizers) :
+_recognizer(recognizer),
+_thread_pool(thread_pool),
+_thread_recognizers(thread_recognizers)
+{
+	if(clusters_count == 0)
+	{
+		throw pbio::Error(0x3a8d51f6, "Error in pbio::ClusteredTemplatesIndex: clusters_count must be positive, error code: 0x3a8d51f6.");
+	}
+
+	const size_t centers_count = (std::min)(clusters_count, templates.size());
+
+	for(size_t c = 0; c < centers_count; ++c)
+		_centers.push_back(templates[c * templates.size() / centers_count]);
+
+	std::vector<std::vector<pbio::Template::Ptr> > clusters_templates(centers_count);
+
+	_clusters.resize(centers_count);
+	_locations.resize(templates.size());
+
+	// only the nearest center of every template is kept
+	const size_t block_rows_count = blockRowsCount();
+
+	std::vector<pbio::Template::Ptr> block;
+	std::vector<float> distances;
+
+	for(size_t begin = 0; begin < templates.size(); begin += block_rows_count)
+	{
+		const size_t end = (std::min)(templates.size(), begin + block_rows_count);
+
+		centersDistances(templates, begin, end, block, distances);
+
+		for(size_t i = begin; i < end; ++i)
+		{
+			const float* const row = distances.data() + (i - begin) * centers_count;
+
+			const size_t c = std::min_element(row, row + centers_count) - row;
+
+			_locations[i] = std::make_pair((uint32_t) c, (uint32_t) _clusters[c].ids.size());
+
+			_clusters[c].ids.push_back(i);
+			clusters_templates[c].push_back(templates[i]);
+		}
+	}
+
+	// a cluster can be empty if its center is a duplicate of another center
+	for(size_t c = 0; c < centers_count; ++c)
+	{
+		if(!clusters_templates[c].empty())
+			_clusters[c].index = _recognizer->createIndex(clusters_templates[c], search_threads_count);
+	}
+}
+
+
+inline
+size_t ClusteredTemplatesIndex::blockRowsCount() const
+{
+	if(_centers.empty())
+		return min_block_rows_count;
+
+	const size_t rows_count = block_distances_count / _centers.size();
+
+	return rows_count < min_block_rows_count ? min_block_rows_count : rows_count;
+}
+
+
+inline
+void ClusteredTemplatesIndex::centersDistances(
+	const std::vector<pbio::Template::Ptr> &templates,
+	const size_t begin,
+	const size_t end,
+	std::vector<pbio::Template::Ptr> &block,
+	std::vector<float> &distances) const
+{
+	block.assign(templates.begin() + begin, templates.begin() + end);
+	distances.resize(block.size() * _centers.size());
+
+	_recognizer->verifyMatchMatrix(block, _centers, distances.data(), NULL, _thread_pool, _thread_recognizers);
+}
+
+
+inline
+size_t ClusteredTemplatesIndex::clusterSize(const size_t cluster) const
+{
+	if(cluster >= _clusters.size())
+	{
+		throw pbio::Error(0x62c0e8b5, "Error in pbio::ClusteredTemplatesIndex::clusterSize: cluster index out of range, error code: 0x62c0e8b5.");
+	}
+
+	return _clusters[cluster].ids.size();
+}
+
+
+inline
+pbio::Template::Ptr ClusteredTemplatesIndex::at(const size_t i) const
+{
+	if(i >= _locations.size())
+	{
+		throw pbio::Error(0x1d95a47c, "Error in pbio::ClusteredTemplatesIndex::at: index out of range, error code: 0x1d95a47c.");
+	}
+
+	return _clusters[_locations[i].first].index->at(_locations[i].second);
+}
+
+
+inline
+void ClusteredTemplatesIndex::search(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const size_t k,
+	const size_t probes_count,
+	SearchResultBuffer &result,
+	const Recognizer::SearchAccelerationType acceleration) const
+{
+	const size_t queries_count = queries_templates.size();
+	const size_t clusters_count = _clusters.size();
+	const size_t probes = (std::min)(probes_count, clusters_count);
+
+	result.resize(queries_count, k);
+
+	if(queries_count == 0 || k == 0 || probes == 0)
+	{
+		for(size_t i = 0; i < queries_count * k; ++i)
+			result._columns.indexes[i] = -1;
+
+		result.countValid();
+		return;
+	}
+
+	// the p-th probe of every query is written to the p-th shard of the buffer,
+	// indexes in the shard columns are the gallery indexes
+	result.resizeShards(probes, k);
+
+	std::fill(result._shard_columns.indexes.begin(), result._shard_columns.indexes.end(), -1);
+
+	// queries of every cluster and the probe number of the cluster in these queries
+	std::vector<std::vector<std::pair<size_t, size_t> > > cluster_queries(clusters_count);
+	std::vector<std::pair<float, size_t> > nearest(clusters_count);
+
+	const size_t block_rows_count = blockRowsCount();
+
+	std::vector<pbio::Template::Ptr> group;
+	std::vector<float> distances;
+
+	for(size_t begin = 0; begin < queries_count; begin += block_rows_count)
+	{
+		const size_t end = (std::min)(queries_count, begin + block_rows_count);
+
+		centersDistances(queries_templates, begin, end, group, distances);
+
+		for(size_t q = begin; q < end; ++q)
+		{
+			for(size_t c = 0; c < clusters_count; ++c)
+				nearest[c] = std::make_pair(distances[(q - begin) * clusters_count + c], c);
+
+			std::partial_sort(nearest.begin(), nearest.begin() + probes, nearest.end());
+
+			for(size_t p = 0; p < probes; ++p)
+				cluster_queries[nearest[p].second].push_back(std::make_pair(q, p));
+		}
+	}
+
+	for(size_t c = 0; c < clusters_count; ++c)
+	{
+		if(cluster_queries[c].empty() || !_clusters[c].index)
+			continue;
+
+		const Cluster &cluster = _clusters[c];
+		const size_t cluster_k = (std::min)(k, cluster.ids.size());
+
+		group.clear();
+
+		for(size_t i = 0; i < cluster_queries[c].size(); ++i)
+			group.push_back(queries_templates[cluster_queries[c][i].first]);
+
+		_recognizer->search(group, *cluster.index, cluster_k, result, acceleration);
+
+		for(size_t i = 0; i < group.size(); ++i)
+		{
+			const size_t q = cluster_queries[c][i].first;
+			const size_t p = cluster_queries[c][i].second;
+
+			const size_t src = i * cluster_k;
+			const size_t dst = (p * queries_count + q) * k;
+
+			for(size_t j = 0; j < cluster_k; ++j)
+			{
+				const int64_t local = result._columns.indexes[src + j];
+
+				result._shard_columns.indexes[dst + j] = local < 0 ? -1 : cluster.ids[local];
+				result._shard_columns.distances[dst + j] = result._columns.distances[src + j];
+				result._shard_columns.fars[dst + j] = result._columns.fars[src + j];
+				result._shard_columns.frrs[dst + j] = result._columns.frrs[src + j];
+				result._shard_columns.scores[dst + j] = result._columns.scores[src + j];
+			}
+		}
+	}
+
+	result.resize(queries_count, k);
+	result.mergeShards();
+}
+
+
+inline
+std::vector<std::vector<Recognizer::SearchResult> > ClusteredTemplatesIndex::search(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const size_t k,
+	const size_t probes_count,
+	const Recognizer::SearchAccelerationType acceleration) const
+{
+	SearchResultBuffer buffer;
+
+	search(queries_templates, k, probes_count, buffer, acceleration);
+
+	std::vector<std::vector<Recognizer::SearchResult> > result(queries_templates.size());
+
+	for(size_t i = 0; i < result.size(); ++i)
+	{
+		result[i].resize(buffer.size(i));
+
+		for(size_t j = 0; j < result[i].size(); ++j)
+		{
+			result[i][j].i = buffer.indexes(i)[j];
+			result[i][j].match_result.distance = buffer.distances(i)[j];
+			result[i][j].match_result.fa_r = buffer.fars(i)[j];
+			result[i][j].match_result.fr_r = buffer.frrs(i)[j];
+			result[i][j].match_result.score = buffer.scores(i)[j];
+		}
+	}
+
+	return result;
+}
+
+
+inline
+ClusteredTemplatesIndex::RecallReport ClusteredTemplatesIndex::measureRecall(
+	const std::vector<pbio::Template::Ptr> &validation_queries,
+	const size_t k,
+	const size_t probes_count,
+	const Recognizer::SearchAccelerationType acceleration) const
+{
+	SearchResultBuffer approximate;
+	SearchResultBuffer exact;
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	search(validation_queries, k, probes_count, approximate, acceleration);
+
+	const std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+
+	search(validation_queries, k, _clusters.size(), exact, Recognizer::NO_SEARCH_ACCELERATION);
+
+	const std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+
+	size_t found = 0;
+	size_t total = 0;
+
+	for(size_t q = 0; q < validation_queries.size(); ++q)
+	{
+		const int64_t* const approximate_begin = approximate.indexes(q);
+		const int64_t* const approximate_end = approximate_begin + approximate.size(q);
+
+		for(size_t i = 0; i < exact.size(q); ++i)
+			found += std::find(approximate_begin, approximate_end, exact.indexes(q)[i]) != approximate_end;
+
+		total += exact.size(q);
+	}
+
+	RecallReport report;
+	report.recall = total == 0 ? 1. : double(found) / total;
+	report.approximate_time = std::chrono::duration<double>(middle - start).count();
+	report.exact_time = std::chrono::duration<double>(finish - middle).count();
+
+	return report;
+}
+
+}  // pbio namespace
+
+#endif  // __PBIO_API__PBIO__CLUSTERED_TEMPLATES_INDEX_H_
@@ -11,13 +11,17 @@
 
 #ifndef WITHOUT_PROCESSING_BLOCK
 
+#include <cstring>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <pbio/DllHandle.h>
+#include <pbio/Expected.h>
 #include <pbio/RawImage.h>
 #include <pbio/DynamicTemplateIndex.h>
 
@@ -36,8 +40,110 @@ inline void tdvCheckException(const DHPtr& dll_handle, ContextEH*& out_exception
 	}
 }
 
+inline Status tdvExceptionStatus(const DHPtr& dll_handle, ContextEH*& out_exception) noexcept {
+	if(out_exception)
+	{
+		const Status status(dll_handle->TDVException_getErrorCode(out_exception));
+		dll_handle->TDVException_deleteException(out_exception);
+		out_exception = nullptr;
+		return status;
+	}
+	return Status();
+}
+
 class ContextRef;
 
+namespace context_utils {
+class BorrowedImage;
+}
+
+
+/**
+	\~English
+	\brief
+		Flat arrays of the "objects" of a Processing Block output, filled by Context::extractObjects.
+		Values of the i-th object are at index i (bboxes at 4 * i),
+		keypoints of the i-th object are keypoints_offsets[i] .. keypoints_offsets[i + 1] - 1 (x at 2 * k, y at 2 * k + 1).
+		The view is intended to be reused between frames: arrays keep their capacity,
+		names are added to class_names and keypoints_names (and to their indexes) once and their ids stay the same.
+	\~Russian
+	\brief
+		Плоские массивы "objects" выхода Processing Block, заполняемые Context::extractObjects.
+		Значения i-го объекта находятся по индексу i (bboxes по 4 * i),
+		ключевые точки i-го объекта - keypoints_offsets[i] .. keypoints_offsets[i + 1] - 1 (x по 2 * k, y по 2 * k + 1).
+		Представление предназначено для повторного использования между кадрами: массивы сохраняют выделенную память,
+		имена добавляются в class_names и keypoints_names (и в их индексы) один раз, и их идентификаторы не меняются.
+*/
+struct ObjectsView
+{
+	//! \~English "id" of the objects, -1 if absent. \~Russian "id" объектов, -1 при отсутствии.
+	std::vector<int64_t> ids;
+
+	//! \~English Index of "class" of the objects in class_names, -1 if absent. \~Russian Индекс "class" объектов в class_names, -1 при отсутствии.
+	std::vector<int32_t> class_ids;
+
+	//! \~English "confidence" of the objects, NaN if absent. \~Russian "confidence" объектов, NaN при отсутствии.
+	std::vector<double> confidences;
+
+	//! \~English "bbox" of the objects: x1, y1, x2, y2, NaN if absent. \~Russian "bbox" объектов: x1, y1, x2, y2, NaN при отсутствии.
+	std::vector<double> bboxes;
+
+	//! \~English Begin of the keypoints of the objects, size() + 1 elements. \~Russian Начало ключевых точек объектов, size() + 1 элементов.
+	std::vector<size_t> keypoints_offsets;
+
+	/** \~English
+		\brief
+			"proj" of the keypoints: x, y. Named keypoints ("keypoints"/"nose"/"proj")
+			and elements of arrays ("keypoints"/"points"/i/"proj") are taken in the order of the keys.
+		\~Russian
+		\brief
+			"proj" ключевых точек: x, y. Именованные точки ("keypoints"/"nose"/"proj")
+			и элементы массивов ("keypoints"/"points"/i/"proj") берутся в порядке ключей.
+	*/
+	std::vector<double> keypoints;
+
+	//! \~English Index of the key of the keypoints in keypoints_names. \~Russian Индекс ключа ключевых точек в keypoints_names.
+	std::vector<int32_t> keypoints_names_ids;
+
+	//! \~English Class names. \~Russian Имена классов.
+	std::vector<std::string> class_names;
+
+	//! \~English Keypoints keys. \~Russian Ключи ключевых точек.
+	std::vector<std::string> keypoints_names;
+
+	//! \~English Index of a class name in class_names. \~Russian Индекс имени класса в class_names.
+	std::unordered_map<std::string, int32_t> class_names_index;
+
+	//! \~English Index of a keypoints key in keypoints_names. \~Russian Индекс ключа ключевых точек в keypoints_names.
+	std::unordered_map<std::string, int32_t> keypoints_names_index;
+
+	/** \~English
+		\brief Get a number of objects.
+		\~Russian
+		\brief Получить количество объектов.
+	*/
+	size_t size() const
+	{
+		return ids.size();
+	}
+
+	/** \~English
+		\brief Remove the objects, keeping the memory and the names.
+		\~Russian
+		\brief Удалить объекты, сохранив память и имена.
+	*/
+	void clear()
+	{
+		ids.clear();
+		class_ids.clear();
+		confidences.clear();
+		bboxes.clear();
+		keypoints_offsets.assign(1, 0);
+		keypoints.clear();
+		keypoints_names_ids.clear();
+	}
+};
+
 
 /**
 	\~English
@@ -50,6 +156,12 @@ class Context
 
 	friend class FacerecService;
 	friend class RawSample;
+	friend class context_utils::BorrowedImage;
+
+public:
+	class Path;
+
+private:
 
 	template<bool isConst=false>
 	class ContextArrayIterator
@@ -135,6 +247,38 @@ public:
 		FORMAT_NV21 = 5,
 	};
 
+protected:
+
+	// handle of the value at the path, NULL on failure (eh_ is not set if the library returned NULL without an error)
+	HContext* resolve(const Path& path) const noexcept {
+		HContext* handle = handle_;
+		for(size_t i = 0; i < path.segments_.size() && handle && !eh_; ++i) {
+			const Path::Segment& segment = path.segments_[i];
+			handle = segment.index < 0 ?
+				dll_handle->TDVContext_getByKey(handle, segment.key.c_str(), &eh_) :
+				dll_handle->TDVContext_getByIndex(handle, segment.index, &eh_);
+		}
+		return handle;
+	}
+
+	void readValue(HContext* handle, double& value) const noexcept {
+		value = dll_handle->TDVContext_getDouble(handle, &eh_);
+	}
+
+	void readValue(HContext* handle, long& value) const noexcept {
+		value = dll_handle->TDVContext_getLong(handle, &eh_);
+	}
+
+	void readValue(HContext* handle, bool& value) const noexcept {
+		value = dll_handle->TDVContext_getBool(handle, &eh_);
+	}
+
+	void readValue(HContext* handle, std::string& value) const {
+		const char* str = dll_handle->TDVContext_getStr(handle, &eh_);
+		if(!eh_)
+			value = str;
+	}
+
 protected:
 
 	Context(const DHPtr& dll_handle) : dll_handle(dll_handle), weak_(false), eh_(nullptr) {
@@ -357,6 +501,114 @@ public:
 	const Ref at(const std::string& key) const;
 	const Ref at(const int index) const;
 
+	/**
+		\~English
+			\brief noexcept version of at(), a missing key or index is returned as a failed status.
+			\param[in] key
+		\~Russian
+			\brief noexcept версия at(), отсутствующий ключ или индекс возвращается как статус ошибки.
+			\param[in] key
+	*/
+	Expected<Ref> tryAt(const char* key) const noexcept;
+	Expected<Ref> tryAt(const std::string& key) const noexcept;
+	Expected<Ref> tryAt(const int index) const noexcept;
+
+	/**
+		\~English
+			\brief
+				Fill the view with the "objects" array of this context (the output of detectors,
+				fitters and estimators): "id", "class", "confidence", "bbox" and "keypoints", all of them are optional.
+				The tree is walked with raw handles, without Context objects and iterators.
+				If there is no "objects" key, the view is empty.
+			\param[out] view - reused view
+		\~Russian
+			\brief
+				Заполнить представление массивом "objects" этого контекста (выход детекторов,
+				фиттеров и оценщиков): "id", "class", "confidence", "bbox" и "keypoints", все они необязательны.
+				Обход дерева выполняется по сырым дескрипторам, без объектов Context и итераторов.
+				Если ключа "objects" нет, представление пустое.
+			\param[out] view - переиспользуемое представление
+	*/
+	void extractObjects(ObjectsView& view) const;
+
+	/**
+		\~English
+		\brief
+			Path to a value in the context tree, parsed once and used for repeated reads with get and tryGet.
+			Segments are separated by '/', segments of less than 10 digits are array indexes, other segments are keys:
+			"keypoints/left_knee/proj/0". A segment starting with '\\' is always a key without this first '\\',
+			so "ids/\\0" is the key "0" of "ids" and "\\\\a" is the key "\\a". Keys with '/' can't be addressed.
+			The empty path is the context itself.
+			The library API takes keys as strings, so every read still makes one lookup per segment,
+			but without building strings and Context objects.
+		\~Russian
+		\brief
+			Путь к значению в дереве контекста, разбираемый один раз и используемый для повторного чтения с помощью get и tryGet.
+			Сегменты разделяются '/', сегменты менее чем из 10 цифр - индексы массивов, остальные сегменты - ключи:
+			"keypoints/left_knee/proj/0". Сегмент, начинающийся с '\\', всегда является ключом без этого первого '\\',
+			поэтому "ids/\\0" - ключ "0" в "ids", а "\\\\a" - ключ "\\a". Ключи с '/' не адресуются.
+			Пустой путь - сам контекст.
+			API библиотеки принимает ключи строками, поэтому каждое чтение по-прежнему выполняет один поиск на сегмент,
+			но без построения строк и объектов Context.
+	*/
+	class Path
+	{
+	public:
+		Path(const char* path);
+
+		Path(const std::string& path);
+
+		//! \~English Get the source string. \~Russian Получить исходную строку.
+		const std::string& str() const {
+			return path_;
+		}
+
+		//! \~English Get a number of segments. \~Russian Получить количество сегментов.
+		size_t size() const {
+			return segments_.size();
+		}
+
+	private:
+		struct Segment
+		{
+			std::string key;
+			int index;   // -1 for keys
+		};
+
+		std::string path_;
+		std::vector<Segment> segments_;
+
+		friend class Context;
+	};
+
+	/**
+		\~English
+			\brief
+				Read the value at the path.
+				T is one of double, long, bool and std::string, the same as getDouble, getLong, getBool and getString.
+			\param[in] path - compiled path
+			\return value
+		\~Russian
+			\brief
+				Прочитать значение по пути.
+				T - один из double, long, bool и std::string, так же как getDouble, getLong, getBool и getString.
+			\param[in] path - скомпилированный путь
+			\return значение
+	*/
+	template<typename T>
+	T get(const Path& path) const;
+
+	/**
+		\~English
+			\brief Version of get that returns a failed status instead of throwing pbio::Error.
+			\param[in] path - compiled path
+		\~Russian
+			\brief Версия get, возвращающая статус ошибки вместо выбрасывания pbio::Error.
+			\param[in] path - скомпилированный путь
+	*/
+	template<typename T>
+	Expected<T> tryGet(const Path& path) const;
+
 	/**
 		\~English
 			\brief checks the existence of an element by a specific key
@@ -537,6 +789,41 @@ public:
 		return pbio::ContextTemplate::Ptr::make(dll_handle, templ);
 	}
 
+	/**
+		\~English
+			\brief noexcept versions of the getters, a value of another type is returned as a failed status.
+			\return value or failed status
+		\~Russian
+			\brief noexcept версии геттеров, значение другого типа возвращается как статус ошибки.
+			\return значение или статус ошибки
+	*/
+	Expected<double> tryGetDouble() const noexcept {
+		const double ret = dll_handle->TDVContext_getDouble(handle_, &eh_);
+		const Status status = tdvExceptionStatus(dll_handle, eh_);
+		return status.ok() ? Expected<double>(ret) : Expected<double>(status);
+	}
+
+	Expected<long> tryGetLong() const noexcept {
+		const long ret = dll_handle->TDVContext_getLong(handle_, &eh_);
+		const Status status = tdvExceptionStatus(dll_handle, eh_);
+		return status.ok() ? Expected<long>(ret) : Expected<long>(status);
+	}
+
+	Expected<bool> tryGetBool() const noexcept {
+		const bool ret = dll_handle->TDVContext_getBool(handle_, &eh_);
+		const Status status = tdvExceptionStatus(dll_handle, eh_);
+		return status.ok() ? Expected<bool>(ret) : Expected<bool>(status);
+	}
+
+	// not noexcept: only std::bad_alloc of the result string can be thrown
+	Expected<std::string> tryGetString() const {
+		const char* ret = dll_handle->TDVContext_getStr(handle_, &eh_);
+		const Status status = tdvExceptionStatus(dll_handle, eh_);
+		if(!status.ok())
+			return status;
+		return Expected<std::string>(ExpectedInPlace(), ret);
+	}
+
 	/**
 		\~English
 			\brief adds a value of type string to the container
@@ -639,6 +926,40 @@ public:
 		tdvCheckException(dll_handle, eh_);
 	}
 
+	/**
+		\~English
+			\brief noexcept versions of the setters.
+			\param[in] val - value
+			\return status
+		\~Russian
+			\brief noexcept версии сеттеров.
+			\param[in] val - значение
+			\return статус
+	*/
+	Status trySetString(const char* str) noexcept {
+		dll_handle->TDVContext_putStr(handle_, str, &eh_);
+		return tdvExceptionStatus(dll_handle, eh_);
+	}
+
+	Status trySetString(const std::string& str) noexcept {
+		return trySetString(str.c_str());
+	}
+
+	Status trySetLong(long val) noexcept {
+		dll_handle->TDVContext_putLong(handle_, val, &eh_);
+		return tdvExceptionStatus(dll_handle, eh_);
+	}
+
+	Status trySetDouble(double val) noexcept {
+		dll_handle->TDVContext_putDouble(handle_, val, &eh_);
+		return tdvExceptionStatus(dll_handle, eh_);
+	}
+
+	Status trySetBool(bool val) noexcept {
+		dll_handle->TDVContext_putBool(handle_, val, &eh_);
+		return tdvExceptionStatus(dll_handle, eh_);
+	}
+
 	/**
 		\~English
 			\brief checks if there are no elements in the container
@@ -1065,6 +1386,234 @@ inline const Context::Ref Context::at(const int index) const {
 	return Ref(dll_handle, handle);
 }
 
+inline Expected<Context::Ref> Context::tryAt(const char* key) const noexcept {
+	HContext* handle = dll_handle->TDVContext_getByKey(handle_, key, &eh_);
+	const Status status = tdvExceptionStatus(dll_handle, eh_);
+	if(!status.ok())
+		return status;
+	return Expected<Ref>(ExpectedInPlace(), dll_handle, handle);
+}
+
+inline Expected<Context::Ref> Context::tryAt(const std::string& key) const noexcept {
+	return tryAt(key.c_str());
+}
+
+inline Expected<Context::Ref> Context::tryAt(const int index) const noexcept {
+	HContext* handle = dll_handle->TDVContext_getByIndex(handle_, index, &eh_);
+	const Status status = tdvExceptionStatus(dll_handle, eh_);
+	if(!status.ok())
+		return status;
+	return Expected<Ref>(ExpectedInPlace(), dll_handle, handle);
+}
+
+inline void Context::extractObjects(ObjectsView& view) const {
+	view.clear();
+
+	if(!dll_handle->TDVContext_contains(handle_, "objects", &eh_)) {
+		tdvCheckException(dll_handle, eh_);
+		return;
+	}
+
+	const auto child = [this](HContext* parent, const char* key) {
+		HContext* result = dll_handle->TDVContext_getByKey(parent, key, &eh_);
+		tdvCheckException(dll_handle, eh_);
+		return result;
+	};
+
+	const auto element = [this](HContext* parent, const size_t index) {
+		HContext* result = dll_handle->TDVContext_getByIndex(parent, static_cast<int>(index), &eh_);
+		tdvCheckException(dll_handle, eh_);
+		return result;
+	};
+
+	// numbers can be stored as long or double
+	const auto getDouble = [this](HContext* ctx) {
+		const bool is_long = dll_handle->TDVContext_isLong(ctx, &eh_);
+		tdvCheckException(dll_handle, eh_);
+		const double result = is_long ?
+			static_cast<double>(dll_handle->TDVContext_getLong(ctx, &eh_)) :
+			dll_handle->TDVContext_getDouble(ctx, &eh_);
+		tdvCheckException(dll_handle, eh_);
+		return result;
+	};
+
+	const auto contains = [this](HContext* ctx, const char* key) {
+		const bool result = dll_handle->TDVContext_contains(ctx, key, &eh_);
+		tdvCheckException(dll_handle, eh_);
+		return result;
+	};
+
+	// the key buffer keeps its capacity between the names
+	std::string name_key;
+
+	const auto nameId = [&name_key](std::vector<std::string>& names, std::unordered_map<std::string, int32_t>& index, const char* name) {
+		name_key.assign(name);
+		const std::unordered_map<std::string, int32_t>::const_iterator it = index.find(name_key);
+		if(it != index.end())
+			return it->second;
+		const int32_t result = static_cast<int32_t>(names.size());
+		names.push_back(name_key);
+		index.emplace(name_key, result);
+		return result;
+	};
+
+	const auto pushProj = [&](HContext* point, const int32_t name_id) {
+		HContext* proj = child(point, "proj");
+		view.keypoints.push_back(getDouble(element(proj, 0)));
+		view.keypoints.push_back(getDouble(element(proj, 1)));
+		view.keypoints_names_ids.push_back(name_id);
+	};
+
+	HContext* objects = child(handle_, "objects");
+
+	const size_t count = dll_handle->TDVContext_getLength(objects, &eh_);
+	tdvCheckException(dll_handle, eh_);
+
+	view.ids.reserve(count);
+	view.class_ids.reserve(count);
+	view.confidences.reserve(count);
+	view.bboxes.reserve(4 * count);
+	view.keypoints_offsets.reserve(count + 1);
+
+	// the arrays of a partially filled view would not match each other
+	try {
+		for(size_t i = 0; i < count; ++i) {
+			HContext* obj = element(objects, i);
+
+			if(contains(obj, "id")) {
+				view.ids.push_back(dll_handle->TDVContext_getLong(child(obj, "id"), &eh_));
+				tdvCheckException(dll_handle, eh_);
+			}
+			else
+				view.ids.push_back(-1);
+
+			if(contains(obj, "class")) {
+				const char* class_name = dll_handle->TDVContext_getStr(child(obj, "class"), &eh_);
+				tdvCheckException(dll_handle, eh_);
+				view.class_ids.push_back(nameId(view.class_names, view.class_names_index, class_name));
+			}
+			else
+				view.class_ids.push_back(-1);
+
+			view.confidences.push_back(contains(obj, "confidence") ?
+				getDouble(child(obj, "confidence")) : std::numeric_limits<double>::quiet_NaN());
+
+			if(contains(obj, "bbox")) {
+				HContext* bbox = child(obj, "bbox");
+				for(int j = 0; j < 4; ++j)
+					view.bboxes.push_back(getDouble(element(bbox, j)));
+			}
+			else
+				view.bboxes.insert(view.bboxes.end(), 4, std::numeric_limits<double>::quiet_NaN());
+
+			if(contains(obj, "keypoints")) {
+				HContext* keypoints = child(obj, "keypoints");
+
+				const size_t keys_count = dll_handle->TDVContext_getLength(keypoints, &eh_);
+				tdvCheckException(dll_handle, eh_);
+
+				char** keys = dll_handle->TDVContext_getKeys(keypoints, keys_count, &eh_);
+				tdvCheckException(dll_handle, eh_);
+
+				try {
+					for(size_t k = 0; k < keys_count; ++k) {
+						HContext* value = child(keypoints, keys[k]);
+						const int32_t name_id = nameId(view.keypoints_names, view.keypoints_names_index, keys[k]);
+
+						const bool is_array = dll_handle->TDVContext_isArray(value, &eh_);
+						tdvCheckException(dll_handle, eh_);
+
+						if(!is_array) {
+							pushProj(value, name_id);
+							continue;
+						}
+
+						const size_t points_count = dll_handle->TDVContext_getLength(value, &eh_);
+						tdvCheckException(dll_handle, eh_);
+
+						for(size_t p = 0; p < points_count; ++p)
+							pushProj(element(value, p), name_id);
+					}
+				}
+				catch(...) {
+					for(size_t k = 0; k < keys_count; ++k)
+						dll_handle->TDVContext_freePtr(keys[k]);
+					dll_handle->TDVContext_freePtr(keys);
+					throw;
+				}
+
+				for(size_t k = 0; k < keys_count; ++k)
+					dll_handle->TDVContext_freePtr(keys[k]);
+				dll_handle->TDVContext_freePtr(keys);
+			}
+
+			view.keypoints_offsets.push_back(view.keypoints.size() / 2);
+		}
+	}
+	catch(...) {
+		view.clear();
+		throw;
+	}
+}
+
+inline Context::Path::Path(const char* path) : Path(std::string(path ? path : "")) {}
+
+inline Context::Path::Path(const std::string& path) : path_(path) {
+	size_t begin = 0;
+	while(begin < path_.size()) {
+		size_t end = path_.find('/', begin);
+		if(end == std::string::npos)
+			end = path_.size();
+
+		if(end == begin)
+			throw pbio::Error(0x6f2e18a4, "Error in pbio::Context::Path: empty segment in '" + path_ + "', error code: 0x6f2e18a4.");
+
+		Segment segment;
+		segment.key = path_.substr(begin, end - begin);
+		segment.index = -1;
+
+		// escaped key
+		if(segment.key[0] == '\\')
+			segment.key.erase(0, 1);
+		else if(segment.key.size() < 10 && segment.key.find_first_not_of("0123456789") == std::string::npos)
+			segment.index = std::stoi(segment.key);
+
+		segments_.push_back(segment);
+
+		begin = end + 1;
+	}
+
+	if(!path_.empty() && path_.back() == '/')
+		throw pbio::Error(0x15c8e3b9, "Error in pbio::Context::Path: empty segment in '" + path_ + "', error code: 0x15c8e3b9.");
+}
+
+template<typename T>
+T Context::get(const Path& path) const {
+	T value = T();
+	HContext* handle = resolve(path);
+	if(!eh_ && !handle)
+		throw pbio::Error(0x2d47b6e3, "Error in pbio::Context::get: no value at path '" + path.str() + "', error code: 0x2d47b6e3.");
+	if(!eh_)
+		readValue(handle, value);
+	tdvCheckException(dll_handle, eh_);
+	return value;
+}
+
+template<typename T>
+Expected<T> Context::tryGet(const Path& path) const {
+	T value = T();
+	HContext* handle = resolve(path);
+	// the same code as the error of get
+	if(!eh_ && !handle)
+		return Status(0x2d47b6e3);
+	if(!eh_)
+		readValue(handle, value);
+	const Status status = tdvExceptionStatus(dll_handle, eh_);
+	if(!status.ok())
+		return status;
+	return Expected<T>(std::move(value));
+}
+
 
 namespace context_utils {
 
@@ -1111,6 +1660,337 @@ inline void putImage(Context& ctx, unsigned char* data, size_t height, size_t wi
 	ctx["shape"].push_back(static_cast<int64_t>(channels));
 }
 
+/**
+	\~English
+	\brief
+		Image put into a Context as NDARRAY with the "blob" borrowed from the caller memory when possible.
+		NDARRAY has no row stride, so only contiguous rows are borrowed without copying (full-width crops,
+		cv::Mat and decoder planes without padding); padded rows are copied once into a buffer owned
+		by this object without colour conversion. borrowed() tells which case it is.
+		BGRA8888 and planar YUV frames (NV12, NV21, YUV420) have no NDARRAY color space, so the frame
+		(packed only if its planes are not contiguous) is passed to the library as in FacerecService::createContextFromFrame,
+		which copies it: the frame is never borrowed, the context stays empty, and the converted image
+		is kept by this object and used through image(). Padded frames are packed into a buffer of the thread,
+		reused by the next frames and kept until the thread exits.
+		The release callback is called once the caller memory is no longer referenced:
+		at construction if the rows were packed or the frame was passed to the library, otherwise in release() or in the destructor,
+		which also removes the "blob" from the context. Must be destroyed before the context.
+	\~Russian
+	\brief
+		Изображение, помещенное в Context как NDARRAY с "blob", по возможности заимствованным из памяти вызывающего.
+		У NDARRAY нет шага строк, поэтому без копирования заимствуются только непрерывные строки (обрезка на всю ширину,
+		cv::Mat и плоскости декодера без выравнивания); строки с выравниванием один раз копируются в буфер,
+		принадлежащий этому объекту, без преобразования цвета. borrowed() показывает, какой это случай.
+		У кадров BGRA8888 и планарных YUV (NV12, NV21, YUV420) нет цветового пространства NDARRAY, поэтому кадр
+		(упакованный, только если его плоскости не непрерывны) передается библиотеке, как в FacerecService::createContextFromFrame,
+		которая его копирует: кадр никогда не заимствуется, контекст остается пустым, а преобразованное изображение
+		хранится в этом объекте и используется через image(). Кадры с выравниванием упаковываются в буфер потока,
+		который используется следующими кадрами и хранится до завершения потока.
+		Функция release вызывается, когда память вызывающего больше не используется:
+		при создании, если строки были упакованы или кадр был передан библиотеке, иначе в release() или в деструкторе,
+		который также удаляет "blob" из контекста. Должен быть уничтожен раньше контекста.
+*/
+class BorrowedImage {
+public:
+	typedef std::function<void()> ReleaseCallback;
+
+	/**
+		\~English
+			\param[in] ctx - image context, cleared
+			\param[in] data - first pixel
+			\param[in] height, width - size in pixels
+			\param[in] stride - bytes between the rows, 0 for width * channels
+			\param[in] format - FORMAT_GRAY, FORMAT_BGR, FORMAT_RGB, FORMAT_YUV_NV21 or FORMAT_YUV_NV12 (with the chroma plane after height rows of stride)
+			\param[in] release - called when data is no longer used, can be empty
+		\~Russian
+			\param[in] ctx - контекст изображения, очищается
+			\param[in] data - первый пиксель
+			\param[in] height, width - размер в пикселях
+			\param[in] stride - байт между строками, 0 для width * channels
+			\param[in] format - FORMAT_GRAY, FORMAT_BGR, FORMAT_RGB, FORMAT_YUV_NV21 или FORMAT_YUV_NV12 (с плоскостью цветности после height строк шага stride)
+			\param[in] release - вызывается, когда data больше не используется, может быть пустой
+	*/
+	BorrowedImage(
+		Context& ctx,
+		const unsigned char* data,
+		size_t height,
+		size_t width,
+		size_t stride,
+		pbio::IRawImage::Format format,
+		const ReleaseCallback& release = ReleaseCallback()) :
+		ctx_(ctx), release_(release), borrowed_(false), released_(false) {
+		initRaw(data, height, width, stride, format);
+	}
+
+	/**
+		\~English
+			\brief Borrow a RawImage, a crop (with_crop) is borrowed with the stride of the source image.
+		\~Russian
+			\brief Заимствовать RawImage, обрезанное изображение (with_crop) заимствуется с шагом исходного изображения.
+	*/
+	BorrowedImage(Context& ctx, const RawImage& raw_image, const ReleaseCallback& release = ReleaseCallback()) :
+		ctx_(ctx), release_(release), borrowed_(false), released_(false) {
+		const size_t channels = (raw_image.format == IRawImage::FORMAT_BGR || raw_image.format == IRawImage::FORMAT_RGB) ? 3 : 1;
+		if(raw_image.with_crop && (raw_image.format == IRawImage::FORMAT_YUV_NV21 || raw_image.format == IRawImage::FORMAT_YUV_NV12))
+			throw pbio::Error(0x3c5a91ea, "Error in pbio::context_utils::BorrowedImage: crop of a YUV RawImage is not supported, use the planes constructor, error code: 0x3c5a91ea.");
+		if(raw_image.with_crop)
+			initRaw(
+				raw_image.data + (static_cast<size_t>(raw_image.crop_info_offset_y) * raw_image.crop_info_data_image_width + raw_image.crop_info_offset_x) * channels,
+				raw_image.height,
+				raw_image.width,
+				static_cast<size_t>(raw_image.crop_info_data_image_width) * channels,
+				raw_image.format);
+		else
+			initRaw(raw_image.data, raw_image.height, raw_image.width, 0, raw_image.format);
+	}
+
+	/**
+		\~English
+			\brief Borrow a frame given by planes, for example a decoder output with padded strides.
+			\param[in] ctx - image context, cleared
+			\param[in] format - image format
+			\param[in] height, width - size in pixels, even for YUV formats
+			\param[in] planes - 1 plane for BGR, RGB and BGRA8888, 2 (Y, interleaved chroma) for NV12 and NV21, 3 (Y, U, V) for YUV420
+			\param[in] strides - bytes between the rows of the planes, 0 for the row size
+			\param[in] release - called when the planes are no longer used, can be empty
+		\~Russian
+			\brief Заимствовать кадр, заданный плоскостями, например выход декодера с выровненными шагами.
+			\param[in] ctx - контекст изображения, очищается
+			\param[in] format - формат изображения
+			\param[in] height, width - размер в пикселях, четные для форматов YUV
+			\param[in] planes - 1 плоскость для BGR, RGB и BGRA8888, 2 (Y, чередующаяся цветность) для NV12 и NV21, 3 (Y, U, V) для YUV420
+			\param[in] strides - байт между строками плоскостей, 0 для размера строки
+			\param[in] release - вызывается, когда плоскости больше не используются, может быть пустой
+	*/
+	BorrowedImage(
+		Context& ctx,
+		Context::Format format,
+		size_t height,
+		size_t width,
+		const unsigned char* const planes[],
+		const size_t strides[],
+		const ReleaseCallback& release = ReleaseCallback()) :
+		ctx_(ctx), release_(release), borrowed_(false), released_(false) {
+		initFrame(format, height, width, planes, strides);
+	}
+
+	~BorrowedImage() {
+		try {
+			release();
+		}
+		catch(...) {
+		}
+	}
+
+	/**
+		\~English
+			\brief Remove the "blob" from the context and call the release callback, if not done before.
+		\~Russian
+			\brief Удалить "blob" из контекста и вызвать функцию release, если это не сделано ранее.
+	*/
+	void release() {
+		if(released_)
+			return;
+		released_ = true;
+		if(!borrowed_)
+			return;
+		ctx_.erase("blob");
+		if(release_)
+			release_();
+	}
+
+	/**
+		\~English
+			\brief Image context: the context given to the constructor, or the image converted by the library for BGRA8888 and YUV frames.
+		\~Russian
+			\brief Контекст изображения: контекст, переданный в конструктор, или изображение, преобразованное библиотекой для кадров BGRA8888 и YUV.
+	*/
+	Context& image() {
+		return frame_image_ ? *frame_image_ : ctx_;
+	}
+
+	/**
+		\~English
+			\brief Check that the caller memory is used without copying.
+		\~Russian
+			\brief Проверить, что память вызывающего используется без копирования.
+	*/
+	bool borrowed() const {
+		return borrowed_;
+	}
+
+private:
+	BorrowedImage(const BorrowedImage&);
+	BorrowedImage& operator=(const BorrowedImage&);
+
+	struct Plane {
+		const unsigned char* data;
+		size_t row_size;
+		size_t rows;
+		size_t stride;
+	};
+
+	void initRaw(const unsigned char* data, size_t height, size_t width, size_t stride, pbio::IRawImage::Format format) {
+		const Context::Format formats[] = {
+			Context::FORMAT_BGR, Context::FORMAT_RGB, Context::FORMAT_BGR, Context::FORMAT_NV21, Context::FORMAT_YUV_NV12};
+
+		if(format == IRawImage::FORMAT_GRAY) {
+			const Plane plane = {data, width, height, stride};
+			init("GRAY", &plane, 1, height, width, 1);
+			return;
+		}
+
+		if(format < IRawImage::FORMAT_GRAY || format > IRawImage::FORMAT_YUV_NV12)
+			throw pbio::Error(0x3c5a91e7, "Error in pbio::context_utils::BorrowedImage: unsupported image format, error code: 0x3c5a91e7.");
+
+		const bool yuv = format == IRawImage::FORMAT_YUV_NV21 || format == IRawImage::FORMAT_YUV_NV12;
+		const size_t row_size = yuv ? width : width * 3;
+
+		if(!stride)
+			stride = row_size;
+
+		// the chroma plane of a RawImage follows the luma plane
+		const unsigned char* const planes[] = {data, data + height * stride};
+		const size_t strides[] = {stride, stride};
+
+		initFrame(formats[format], height, width, planes, strides);
+	}
+
+	void initFrame(Context::Format format, size_t height, size_t width, const unsigned char* const planes[], const size_t strides[]) {
+		Plane result[3];
+		size_t planes_count = 1;
+
+		switch(format) {
+			case Context::FORMAT_BGR:
+			case Context::FORMAT_RGB:
+			case Context::FORMAT_BGRA8888: {
+				const size_t channels = format == Context::FORMAT_BGRA8888 ? 4 : 3;
+				const Plane plane = {planes[0], width * channels, height, strides[0]};
+				result[0] = plane;
+				if(format == Context::FORMAT_BGRA8888)
+					initFromFrame(format, result, 1, height, width);
+				else
+					init(format == Context::FORMAT_BGR ? "BGR" : "RGB", result, 1, height, width, channels);
+				return;
+			}
+			case Context::FORMAT_YUV_NV12:
+			case Context::FORMAT_NV21:
+			case Context::FORMAT_YUV420:
+				break;
+			default:
+				throw pbio::Error(0x5e02c7d4, "Error in pbio::context_utils::BorrowedImage: unsupported image format, error code: 0x5e02c7d4.");
+		}
+
+		if(height % 2 || width % 2)
+			throw pbio::Error(0x3c5a91e9, "Error in pbio::context_utils::BorrowedImage: YUV image size must be even, error code: 0x3c5a91e9.");
+
+		const Plane luma = {planes[0], width, height, strides[0]};
+		result[0] = luma;
+
+		if(format == Context::FORMAT_YUV420) {
+			const Plane u = {planes[1], width / 2, height / 2, strides[1]};
+			const Plane v = {planes[2], width / 2, height / 2, strides[2]};
+			result[1] = u;
+			result[2] = v;
+			planes_count = 3;
+		}
+		else {
+			const Plane chroma = {planes[1], width, height / 2, strides[1]};
+			result[1] = chroma;
+			planes_count = 2;
+		}
+
+		initFromFrame(format, result, planes_count, height, width);
+	}
+
+	// the formats without an NDARRAY color space are converted by the library, as in FacerecService::createContextFromFrame,
+	// which copies the frame, so the caller memory is not referenced after the construction
+	void initFromFrame(Context::Format format, const Plane* planes, size_t planes_count, size_t height, size_t width) {
+		// the packed frame is read only by createFromFrame, so its buffer is reused by the next frames of the thread
+		static thread_local std::vector<unsigned char> frame_buffer;
+
+		const unsigned char* data = contiguous(planes, planes_count) ? planes[0].data : pack(planes, planes_count, frame_buffer);
+
+		ctx_.clear();
+
+		// the image is used in place, a copy of the "image" node would be one more copy of the frame
+		frame_.reset(new Context(ctx_.dll_handle, const_cast<uint8_t*>(data), static_cast<int32_t>(width), static_cast<int32_t>(height), format, 0));
+		frame_image_.reset((*frame_)["image"].getContextPtr());
+
+		if(release_)
+			release_();
+	}
+
+	void init(const char* color_space, const Plane* planes, size_t planes_count, size_t rows, size_t width, size_t channels) {
+		const unsigned char* data = gather(planes, planes_count);
+
+		ctx_.clear();
+		ctx_["format"] = "NDARRAY";
+		ctx_["color_space"] = color_space;
+		ctx_["blob"].setDataPtr(static_cast<const void*>(data), 0);
+		ctx_["dtype"] = "uint8_t";
+		ctx_["shape"].push_back(static_cast<int64_t>(rows));
+		ctx_["shape"].push_back(static_cast<int64_t>(width));
+		ctx_["shape"].push_back(static_cast<int64_t>(channels));
+
+		// the caller memory is not referenced after packing
+		if(!borrowed_ && release_)
+			release_();
+	}
+
+	// the planes are borrowed if they make one contiguous buffer, otherwise they are packed
+	const unsigned char* gather(const Plane* planes, size_t planes_count) {
+		borrowed_ = contiguous(planes, planes_count);
+
+		return borrowed_ ? planes[0].data : pack(planes, planes_count, packed_);
+	}
+
+	// checks the planes, true if they make one contiguous buffer
+	static bool contiguous(const Plane* planes, size_t planes_count) {
+		size_t size = 0;
+		bool result = true;
+
+		for(size_t i = 0; i < planes_count; ++i) {
+			const Plane& plane = planes[i];
+			const size_t stride = plane.stride ? plane.stride : plane.row_size;
+
+			if(!plane.data || stride < plane.row_size)
+				throw pbio::Error(0x3c5a91e8, "Error in pbio::context_utils::BorrowedImage: plane is NULL or stride is less than the row size, error code: 0x3c5a91e8.");
+
+			if((stride != plane.row_size && plane.rows > 1) || (i && plane.data != planes[0].data + size))
+				result = false;
+
+			size += plane.rows * plane.row_size;
+		}
+
+		return result;
+	}
+
+	static const unsigned char* pack(const Plane* planes, size_t planes_count, std::vector<unsigned char>& buffer) {
+		size_t size = 0;
+		for(size_t i = 0; i < planes_count; ++i)
+			size += planes[i].rows * planes[i].row_size;
+
+		buffer.resize(size);
+		unsigned char* ptr = buffer.data();
+		for(size_t i = 0; i < planes_count; ++i) {
+			const size_t stride = planes[i].stride ? planes[i].stride : planes[i].row_size;
+			for(size_t row = 0; row < planes[i].rows; ++row, ptr += planes[i].row_size)
+				std::memcpy(ptr, planes[i].data + row * stride, planes[i].row_size);
+		}
+
+		return buffer.data();
+	}
+
+	Context& ctx_;
+	std::unique_ptr<Context> frame_;
+	std::unique_ptr<Context> frame_image_;
+	std::vector<unsigned char> packed_;
+	ReleaseCallback release_;
+	bool borrowed_;
+	bool released_;
+};
+
 }
 }
 
@@ -22,6 +22,26 @@
 #endif
 
 
+// Symbol binding of the shared library build.
+// By default every function is resolved by createService and a missing one is an error.
+// PBIO_LAZY_DLL_HANDLE resolves each function on its first call instead,
+// except the functions of the noexcept try* methods, which are always resolved by createService.
+// A PBIO_DLL_HANDLE_PROFILE_* macro resolves only the functions of one API subset
+// by createService and the rest on the first call.
+#if defined(PBIO_DLL_HANDLE_PROFILE_PROCESSING_BLOCK) + defined(PBIO_DLL_HANDLE_PROFILE_RECOGNIZER) + \
+	defined(PBIO_DLL_HANDLE_PROFILE_VIDEO_WORKER) > 1
+	#error "only one of PBIO_DLL_HANDLE_PROFILE_* can be defined"
+#endif
+
+#if defined(PBIO_LAZY_DLL_HANDLE) || defined(PBIO_DLL_HANDLE_PROFILE_PROCESSING_BLOCK) || \
+	defined(PBIO_DLL_HANDLE_PROFILE_RECOGNIZER) || defined(PBIO_DLL_HANDLE_PROFILE_VIDEO_WORKER)
+	#ifndef __STATIC_LIBFACEREC_BUILD__
+		#define __PBIO_DLL_HANDLE_LAZY_BINDING__
+		#include <atomic>
+	#endif
+#endif
+
+
 
 #ifdef __STATIC_LIBFACEREC_BUILD__
 ///////
@@ -45,6 +65,89 @@
 namespace pbio {
 namespace import {
 
+#ifdef __PBIO_DLL_HANDLE_LAZY_BINDING__
+
+inline
+constexpr
+bool startsWith(char const* const name, char const* const prefix)
+{
+	return !*prefix || (*name == *prefix && startsWith(name + 1, prefix + 1));
+}
+
+inline
+constexpr
+bool equals(char const* const name, char const* const other)
+{
+	return *name == *other && (!*name || equals(name + 1, other + 1));
+}
+
+// functions called by the noexcept try* methods (Context::tryAt, tryGet*, trySet*, tryGet<T>,
+// Capturer::tryCapture, Recognizer::tryVerifyMatch) and by their error statuses:
+// a missing symbol must fail createService, it can't be thrown from a noexcept call
+inline
+constexpr
+bool usedByNoexceptCalls(char const* const name)
+{
+	return
+		equals(name, "TDVContext_getByKey") ||
+		equals(name, "TDVContext_getByIndex") ||
+		equals(name, "TDVContext_getDouble") ||
+		equals(name, "TDVContext_getLong") ||
+		equals(name, "TDVContext_getBool") ||
+		equals(name, "TDVContext_getStr") ||
+		equals(name, "TDVContext_putStr") ||
+		equals(name, "TDVContext_putLong") ||
+		equals(name, "TDVContext_putDouble") ||
+		equals(name, "TDVContext_putBool") ||
+		equals(name, "TDVException_getErrorCode") ||
+		equals(name, "TDVException_deleteException") ||
+		equals(name, "Capturer_capture_raw_image_with_crop") ||
+		equals(name, "Recognizer_verifyMatch_v2") ||
+		equals(name, "apiException_code") ||
+		equals(name, "apiObject_destructor");
+}
+
+// the functions of the selected profile are resolved by the DllHandle constructor,
+// evaluated at compile time, so the profile check costs nothing at startup
+inline
+constexpr
+bool bindAtStartup(char const* const name)
+{
+	return
+		usedByNoexceptCalls(name) ||
+	#if defined(PBIO_DLL_HANDLE_PROFILE_PROCESSING_BLOCK) || \
+		defined(PBIO_DLL_HANDLE_PROFILE_RECOGNIZER) || \
+		defined(PBIO_DLL_HANDLE_PROFILE_VIDEO_WORKER)
+		// FacerecService::createService and the exceptions of all calls
+		startsWith(name, "FacerecService_constructor") ||
+		startsWith(name, "apiException_") ||
+		startsWith(name, "apiObject_destructor") ||
+	#endif
+	#if defined(PBIO_DLL_HANDLE_PROFILE_PROCESSING_BLOCK)
+		startsWith(name, "FacerecService_ProcessingBlock_") ||
+		startsWith(name, "FacerecService_createDynamicTemplateIndex") ||
+		startsWith(name, "DynamicTemplateIndex_") ||
+		startsWith(name, "ContextTemplate_") ||
+		startsWith(name, "TDV") ||
+		startsWith(name, "tdv") ||
+	#elif defined(PBIO_DLL_HANDLE_PROFILE_RECOGNIZER)
+		startsWith(name, "FacerecService_createRecognizer") ||
+		startsWith(name, "Recognizer_") ||
+		startsWith(name, "Template_") ||
+		startsWith(name, "TemplatesIndex_") ||
+		startsWith(name, "RawSample_") ||
+	#elif defined(PBIO_DLL_HANDLE_PROFILE_VIDEO_WORKER)
+		startsWith(name, "FacerecService_createVideoWorker") ||
+		startsWith(name, "VideoWorker_") ||
+		startsWith(name, "StructStorage_") ||
+		startsWith(name, "RawSample_") ||
+		startsWith(name, "Template_") ||
+	#endif
+		false;
+}
+
+#endif
+
 class DllHandle
 {
 
@@ -84,12 +187,24 @@ public:
 
 public:
 
+#ifdef __PBIO_DLL_HANDLE_LAZY_BINDING__
+
+	#define __583e_SHARED_F_INIT(rtype, name, typed_args, args, return) \
+		, name( *this, _583e_STR_ADD_NAMESPACE(name), BindAtStartup<bindAtStartup( _583e_STRINGISE2(name) )>::value )
+
+	#define __TDV_SHARED_F_INIT(rtype, name, typed_args, args, return) \
+		, name( *this, _583e_STRINGISE2(name), BindAtStartup<bindAtStartup( _583e_STRINGISE2(name) )>::value )
+
+#else
+
 	#define __583e_SHARED_F_INIT(rtype, name, typed_args, args, return) \
 		, name( (FuncType_##name) getSymbol( _583e_STR_ADD_NAMESPACE(name) ) )
 
 	#define __TDV_SHARED_F_INIT(rtype, name, typed_args, args, return) \
 		, name( (FuncType_##name) getSymbol( _583e_STRINGISE2(name) ) )
 
+#endif
+
 	DllHandle(const char* const dll_path) :
 		_dll_path(dll_path),
 #ifdef _WIN32
@@ -183,13 +298,18 @@ private:
 		return result;
 	}
 
-	void* getSymbol(char const* const name) const
+	void* findSymbol(char const* const name) const
 	{
 		#ifdef _WIN32
-			void* const result = reinterpret_cast<void*>( GetProcAddress(_dll, name) );
+			return reinterpret_cast<void*>( GetProcAddress(_dll, name) );
 		#else
-			void* const result = dlsym(_dll, name);
+			return dlsym(_dll, name);
 		#endif
+	}
+
+	void* getSymbol(char const* const name) const
+	{
+		void* const result = findSymbol(name);
 
 		if(!result)
 		{
@@ -208,6 +328,68 @@ private:
 
 	HINSTANCE const _dll;
 
+#ifdef __PBIO_DLL_HANDLE_LAZY_BINDING__
+
+	template<bool value_>
+	struct BindAtStartup
+	{
+		static const bool value = value_;
+	};
+
+	// callable in place of the function pointer,
+	// resolves the symbol on the first call if it was not bound by the constructor
+	template<typename FuncType>
+	class LazyFunc;
+
+	template<typename RType, typename... Args>
+	class LazyFunc<RType (*)(Args...)>
+	{
+	public:
+
+		typedef RType (*FuncType)(Args...);
+
+		LazyFunc(const DllHandle &dll_handle, char const* const name, const bool bind_now) :
+		_dll_handle(dll_handle),
+		_name(name),
+		_func(bind_now ? (FuncType) dll_handle.getSymbol(name) : NULL)
+		{
+		}
+
+		RType operator()(Args... args) const
+		{
+			return get()(args...);
+		}
+
+		FuncType get() const
+		{
+			FuncType func = _func.load(std::memory_order_acquire);
+
+			if(!func)
+			{
+				func = (FuncType) _dll_handle.findSymbol(_name);
+
+				if(!func)
+				{
+					throw pbio::Error(0x2a0e7b95, "Error in pbio::import::DllHandle"
+						" can't find symbol '" + std::string(_name) + "' in dll '" + _dll_handle._dll_path + "'"
+						" on the first call, error code: 0x2a0e7b95");
+				}
+
+				_func.store(func, std::memory_order_release);
+			}
+
+			return func;
+		}
+
+	private:
+
+		const DllHandle &_dll_handle;
+		char const* const _name;
+		mutable std::atomic<FuncType> _func;
+	};
+
+#endif
+
 // without __STATIC_LIBFACEREC_BUILD__
 ///////
 #endif
@@ -215,6 +397,18 @@ private:
 
 public:
 
+#ifdef __PBIO_DLL_HANDLE_LAZY_BINDING__
+
+	#define __583e_F_FIELD_DECL(rtype, name, typed_args, args, return) \
+		typedef rtype (*FuncType_##name) typed_args; \
+		const LazyFunc<FuncType_##name> name;
+
+	#define __TDV_F_FIELD_DECL(rtype, name, typed_args, args, return) \
+		typedef rtype (*FuncType_##name) typed_args; \
+		const LazyFunc<FuncType_##name> name;
+
+#else
+
 	#define __583e_F_FIELD_DECL(rtype, name, typed_args, args, return) \
 		typedef rtype (*FuncType_##name) typed_args; \
 		const FuncType_##name name;
@@ -223,6 +417,8 @@ public:
 		typedef rtype (*FuncType_##name) typed_args; \
 		const FuncType_##name name;
 
+#endif
+
 	__583e_FLIST(__583e_F_FIELD_DECL)
 	__TDV_FLIST(__TDV_F_FIELD_DECL)
 	__TDV_METASDK_FLIST(__583e_F_FIELD_DECL)
@@ -9,6 +9,16 @@
 #ifndef __PBIO_API__PBIO__RESIZABLE_TEMPLATE_INDEX_H_
 #define __PBIO_API__PBIO__RESIZABLE_TEMPLATE_INDEX_H_
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
 #include "ComplexObject.h"
 #include "Error.h"
 #include "SmartPtr.h"
@@ -34,6 +44,13 @@ namespace pbio
         typedef LightSmartPtr<DynamicTemplateIndex>::tPtr Ptr;
         typedef LightSmartPtr<import::DllHandle>::tPtr DHPtr;
 
+        /** \~English
+            \brief Callback of the bulk insertion, called with the count of inserted templates and the total count.
+            \~Russian
+            \brief Функция обратного вызова массовой вставки, вызывается с количеством вставленных шаблонов и общим количеством.
+        */
+        typedef std::function<void(size_t added_count, size_t total_count)> ProgressCallback;
+
     public:
         /**
             \~English
@@ -93,6 +110,56 @@ namespace pbio
 
         void add(const std::vector<pbio::ContextTemplate::Ptr>& templates, const std::vector<std::string>& uuids);
 
+        /**
+            \~English
+            \brief
+                Bulk insertion with uuids packed in one buffer.
+                Templates are inserted by chunks of chunk_size, progress is called after every chunk.
+                Only chunk_size uuid pointers are kept at a time, no std::string per uuid is created.
+
+            \param[in]  templates
+                Templates to insert.
+
+            \param[in]  uuids_buffer
+                Null-terminated uuids, one after another.
+
+            \param[in]  uuids_offsets
+                Offset of the uuid of the i-th template in uuids_buffer, the size must be equal to templates.size().
+
+            \param[in]  chunk_size
+                Count of templates inserted by one library call, must be positive.
+
+            \param[in]  progress
+                Progress callback, can be empty.
+
+            \~Russian
+            \brief
+                Массовая вставка с uuid, упакованными в один буфер.
+                Шаблоны вставляются частями по chunk_size, progress вызывается после каждой части.
+                Одновременно хранится только chunk_size указателей на uuid, std::string для uuid не создаются.
+
+            \param[in]  templates
+                Шаблоны для вставки.
+
+            \param[in]  uuids_buffer
+                Завершающиеся нулём uuid, один за другим.
+
+            \param[in]  uuids_offsets
+                Смещение uuid i-го шаблона в uuids_buffer, размер должен быть равен templates.size().
+
+            \param[in]  chunk_size
+                Количество шаблонов, вставляемых одним вызовом библиотеки, должно быть положительным.
+
+            \param[in]  progress
+                Функция обратного вызова для прогресса, может быть пустой.
+        */
+        void add(
+            const std::vector<pbio::ContextTemplate::Ptr>& templates,
+            const char* uuids_buffer,
+            const std::vector<uint64_t>& uuids_offsets,
+            const size_t chunk_size = 65536,
+            const ProgressCallback& progress = ProgressCallback());
+
         void remove(const std::string& uuid);
 
         void remove(const std::vector<std::string>& uuids);
@@ -103,6 +170,63 @@ namespace pbio
 
         void save(const std::string& filePath, bool allowOverwrite) const;
 
+        /**
+            \~English
+            \brief
+                Save the index to a packed file that can be loaded with
+                FacerecService::loadDynamicTemplateIndex without a stream per template.
+                Unlike save, the file is written by the API, not by the library:
+
+                <pre>
+                offset 0:              char[8] magic "PBIODTI1"
+                offset 8:              uint32 version, uint32 method name size
+                offset 16:             uint64 templates count, uint64 templates offset
+                offset 32:             uint64 uuids offset, uint64 file size
+                offset 48:             uint64 reserved[2]
+                offset 64:             method name
+                templates offset:      templates count + 1 uint64 offsets of the templates saved with
+                                       ContextTemplate::save (relative to the end of the table), then the templates
+                uuids offset:          templates count uint64 offsets of the uuids
+                                       (relative to the end of the table), then null-terminated uuids
+                </pre>
+
+                The sections are 8-byte aligned, numbers are in the byte order of the machine that wrote the file.
+
+            \param[in]  filePath
+                Path to the file.
+
+            \param[in]  allowOverwrite
+                Overwrite the existing file.
+
+            \~Russian
+            \brief
+                Сохранить индекс в упакованный файл, который можно загрузить с помощью
+                FacerecService::loadDynamicTemplateIndex без потока на каждый шаблон.
+                В отличие от save, файл записывается API, а не библиотекой:
+
+                <pre>
+                смещение 0:            char[8] сигнатура "PBIODTI1"
+                смещение 8:            uint32 версия, uint32 размер имени метода
+                смещение 16:           uint64 количество шаблонов, uint64 смещение шаблонов
+                смещение 32:           uint64 смещение uuid, uint64 размер файла
+                смещение 48:           uint64 зарезервировано[2]
+                смещение 64:           имя метода
+                смещение шаблонов:     количество шаблонов + 1 uint64 смещений шаблонов, сохраненных с помощью
+                                       ContextTemplate::save (относительно конца таблицы), затем шаблоны
+                смещение uuid:         количество шаблонов uint64 смещений uuid
+                                       (относительно конца таблицы), затем завершающиеся нулём uuid
+                </pre>
+
+                Разделы выровнены на 8 байт, числа в порядке байт машины, записавшей файл.
+
+            \param[in]  filePath
+                Путь к файлу.
+
+            \param[in]  allowOverwrite
+                Перезаписать существующий файл.
+        */
+        void savePacked(const std::string& filePath, bool allowOverwrite) const;
+
         /**
             \~English
             \brief
@@ -127,6 +251,28 @@ namespace pbio
     private:
         DynamicTemplateIndex(const DHPtr& dll_handle, void* impl, bool weak = false);
 
+        struct PackedHeader
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t method_name_size;
+            uint64_t templates_count;
+            uint64_t templates_offset;
+            uint64_t uuids_offset;
+            uint64_t file_size;
+            uint64_t reserved[2];
+        };
+
+        static const uint32_t packed_version = 1;
+
+        static const char* packedMagic()
+        {
+            return "PBIODTI1";
+        }
+
+        // checks the header and the bounds of the sections of a packed file
+        static PackedHeader readPackedHeader(const char* data, size_t size);
+
     private:
         const DHPtr _dll_handle;
         void* const _impl;
@@ -135,6 +281,7 @@ namespace pbio
 
         friend class object_with_ref_counter<DynamicTemplateIndex>;
         friend class Context;
+        friend class FacerecService;
     };
 }
 
@@ -305,6 +452,55 @@ namespace pbio
         checkException(exception, *_dll_handle);
     }
 
+    inline void DynamicTemplateIndex::add(
+        const std::vector<pbio::ContextTemplate::Ptr>& templates,
+        const char* uuids_buffer,
+        const std::vector<uint64_t>& uuids_offsets,
+        const size_t chunk_size,
+        const ProgressCallback& progress)
+    {
+        if (uuids_offsets.size() != templates.size())
+        {
+            throw pbio::Error(0x4b7e21d3, "Error in pbio::DynamicTemplateIndex::add: uuids count does not match templates count, error code: 0x4b7e21d3.");
+        }
+
+        if (chunk_size == 0)
+        {
+            throw pbio::Error(0x1f93c6a5, "Error in pbio::DynamicTemplateIndex::add: chunk_size must be positive, error code: 0x1f93c6a5.");
+        }
+
+        std::vector<const void*> tempTemplates;
+        std::vector<const char*> tempUuids;
+
+        tempTemplates.reserve((std::min)(chunk_size, templates.size()));
+        tempUuids.reserve((std::min)(chunk_size, templates.size()));
+
+        for (size_t begin = 0; begin < templates.size(); begin += chunk_size)
+        {
+            const size_t end = (std::min)(begin + chunk_size, templates.size());
+
+            tempTemplates.clear();
+            tempUuids.clear();
+
+            for (size_t i = begin; i < end; ++i)
+            {
+                tempTemplates.push_back(templates[i]->_impl);
+                tempUuids.push_back(uuids_buffer + uuids_offsets[i]);
+            }
+
+            void* exception = nullptr;
+
+            _dll_handle->DynamicTemplateIndex_add_4(_impl, tempTemplates.data(), tempUuids.data(), tempTemplates.size(), &exception);
+
+            checkException(exception, *_dll_handle);
+
+            if (progress)
+            {
+                progress(end, templates.size());
+            }
+        }
+    }
+
     inline void DynamicTemplateIndex::remove(const std::string& uuid)
     {
         void* exception = nullptr;
@@ -355,6 +551,123 @@ namespace pbio
         checkException(exception, *_dll_handle);
     }
 
+    inline void DynamicTemplateIndex::savePacked(const std::string& filePath, bool allowOverwrite) const
+    {
+        if (!allowOverwrite && std::ifstream(filePath.c_str()).good())
+        {
+            throw pbio::Error(0x2b84f6e1, "Error in pbio::DynamicTemplateIndex::savePacked: file '" + filePath + "' already exists, error code: 0x2b84f6e1.");
+        }
+
+        const std::string methodName = getMethodName();
+        const size_t count = size();
+
+        const auto align = [](const uint64_t value) { return (value + 7) / 8 * 8; };
+
+        std::ofstream file(filePath.c_str(), std::ios_base::binary);
+
+        if (!file.is_open())
+        {
+            throw pbio::Error(0x61c3a09d, "Error in pbio::DynamicTemplateIndex::savePacked: can't open file '" + filePath + "', error code: 0x61c3a09d.");
+        }
+
+        // templates and uuids are written to the file one by one, the header and the offset tables
+        // are written as placeholders and rewritten at the end, when the offsets are known
+        PackedHeader header;
+        std::memset(&header, 0, sizeof(PackedHeader));
+        std::memcpy(header.magic, packedMagic(), sizeof(header.magic));
+        header.version = packed_version;
+        header.method_name_size = methodName.size();
+        header.templates_count = count;
+        header.templates_offset = align(sizeof(PackedHeader) + methodName.size());
+
+        const char zeros[8] = {0};
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(PackedHeader));
+        file.write(methodName.data(), methodName.size());
+        file.write(zeros, header.templates_offset - sizeof(PackedHeader) - methodName.size());
+
+        std::vector<uint64_t> templatesOffsets(count + 1, 0);
+        const uint64_t templatesDataOffset = header.templates_offset + templatesOffsets.size() * sizeof(uint64_t);
+
+        file.write(reinterpret_cast<const char*>(templatesOffsets.data()), templatesOffsets.size() * sizeof(uint64_t));
+
+        for (size_t i = 0; i < count && file; ++i)
+        {
+            get(i)->save(file);
+
+            templatesOffsets[i + 1] = static_cast<uint64_t>(file.tellp()) - templatesDataOffset;
+        }
+
+        header.uuids_offset = align(templatesDataOffset + templatesOffsets[count]);
+
+        file.write(zeros, header.uuids_offset - templatesDataOffset - templatesOffsets[count]);
+
+        std::vector<uint64_t> uuidsOffsets(count, 0);
+        uint64_t uuidsDataSize = 0;
+
+        file.write(reinterpret_cast<const char*>(uuidsOffsets.data()), uuidsOffsets.size() * sizeof(uint64_t));
+
+        for (size_t i = 0; i < count && file; ++i)
+        {
+            const std::string uuid = getUUID(i);
+
+            uuidsOffsets[i] = uuidsDataSize;
+            file.write(uuid.c_str(), uuid.size() + 1);
+            uuidsDataSize += uuid.size() + 1;
+        }
+
+        header.file_size = header.uuids_offset + uuidsOffsets.size() * sizeof(uint64_t) + uuidsDataSize;
+
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(PackedHeader));
+
+        file.seekp(header.templates_offset);
+        file.write(reinterpret_cast<const char*>(templatesOffsets.data()), templatesOffsets.size() * sizeof(uint64_t));
+
+        file.seekp(header.uuids_offset);
+        file.write(reinterpret_cast<const char*>(uuidsOffsets.data()), uuidsOffsets.size() * sizeof(uint64_t));
+
+        file.flush();
+
+        if (!file)
+        {
+            throw pbio::Error(0x4e57d2b4, "Error in pbio::DynamicTemplateIndex::savePacked: file write failed, error code: 0x4e57d2b4.");
+        }
+    }
+
+    inline DynamicTemplateIndex::PackedHeader DynamicTemplateIndex::readPackedHeader(const char* data, size_t size)
+    {
+        PackedHeader header;
+
+        if (!data || size < sizeof(PackedHeader))
+        {
+            throw pbio::Error(0x78a1c53f, "Error in pbio::DynamicTemplateIndex: data is too small for the header, error code: 0x78a1c53f.");
+        }
+
+        // the header is copied, so the data does not have to be aligned
+        std::memcpy(&header, data, sizeof(PackedHeader));
+
+        if (std::memcmp(header.magic, packedMagic(), sizeof(header.magic)) != 0 || header.version != packed_version)
+        {
+            throw pbio::Error(0x19d6e7a2, "Error in pbio::DynamicTemplateIndex: not a packed index or unsupported version, error code: 0x19d6e7a2.");
+        }
+
+        const uint64_t maxCount = size / sizeof(uint64_t);
+
+        if (header.file_size > size ||
+            sizeof(PackedHeader) + header.method_name_size > header.templates_offset ||
+            header.templates_count >= maxCount ||
+            header.templates_offset > header.uuids_offset ||
+            (header.templates_count + 1) * sizeof(uint64_t) > header.uuids_offset - header.templates_offset ||
+            header.uuids_offset > header.file_size ||
+            header.templates_count * sizeof(uint64_t) > header.file_size - header.uuids_offset)
+        {
+            throw pbio::Error(0x53b0f48c, "Error in pbio::DynamicTemplateIndex: broken or truncated packed index, error code: 0x53b0f48c.");
+        }
+
+        return header;
+    }
+
     inline DynamicTemplateIndex::~DynamicTemplateIndex()
     {
         if (_impl && !weak)
@@ -7,6 +7,7 @@
 
 #include "Error.h"
 #include "DllHandle.h"
+#include "Expected.h"
 
 namespace pbio
 {
@@ -53,6 +54,21 @@ void checkException(
 	}
 }
 
+// noexcept counterpart of checkException for the try* methods:
+// takes only the error code, so no string is built for the error description
+inline
+Status exceptionStatus(
+	void* exception,
+	const pbio::import::DllHandle &dll_handle) noexcept
+{
+	const ExceptionDestroyer ex_de(exception, dll_handle);
+
+	if(exception)
+		return Status(dll_handle.apiException_code(exception));
+
+	return Status();
+}
+
 }  // pbio namespace
 
 //! @endcond
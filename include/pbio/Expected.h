@@ -0,0 +1,323 @@
+/**
+	\file Expected.h
+	\~English
+	\brief Status and Expected - results of the noexcept API methods (try*), returned instead of throwing pbio::Error.
+	\~Russian
+	\brief Status и Expected - результаты noexcept методов API (try*), возвращаемые вместо выбрасывания pbio::Error.
+*/
+
+#ifndef __PBIO_API__PBIO__EXPECTED_H_
+#define __PBIO_API__PBIO__EXPECTED_H_
+
+#include <new>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include <stdint.h>
+
+#include "Error.h"
+
+
+namespace pbio
+{
+
+/** \~English
+	\brief
+		Result of a noexcept API method without a value.
+		Keeps only the error code, the error description is not copied,
+		so a failed call does not allocate memory on the wrapper side.
+	\~Russian
+	\brief
+		Результат noexcept метода API без значения.
+		Хранит только код ошибки, описание ошибки не копируется,
+		поэтому неудачный вызов не выделяет память на стороне обертки.
+*/
+class Status
+{
+public:
+
+	/** \~English
+		\brief Successful status.
+		\~Russian
+		\brief Успешный статус.
+	*/
+	Status() noexcept :
+	_failed(false),
+	_code(0)
+	{
+	}
+
+	/** \~English
+		\brief Failed status with the error code.
+		\~Russian
+		\brief Статус ошибки с кодом ошибки.
+	*/
+	explicit
+	Status(const uint32_t code) noexcept :
+	_failed(true),
+	_code(code)
+	{
+	}
+
+	/** \~English
+		\brief Check that the call succeeded.
+		\~Russian
+		\brief Проверить, что вызов завершился успешно.
+	*/
+	bool ok() const noexcept
+	{
+		return !_failed;
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return ok();
+	}
+
+	/** \~English
+		\brief
+			Get the error code, the same as pbio::Error::code of the exception
+			thrown by the throwing version of the method. 0 if the call succeeded.
+		\~Russian
+		\brief
+			Получить код ошибки, тот же, что pbio::Error::code исключения,
+			выбрасываемого версией метода с исключениями. 0, если вызов завершился успешно.
+	*/
+	uint32_t code() const noexcept
+	{
+		return _code;
+	}
+
+	/** \~English
+		\brief Throw pbio::Error with the error code if the call failed.
+		\~Russian
+		\brief Выбросить pbio::Error с кодом ошибки, если вызов завершился с ошибкой.
+	*/
+	void check() const
+	{
+		if(!_failed)
+			return;
+
+		std::ostringstream what;
+		what << "Error: the noexcept API call failed (use the throwing version of the method "
+			"to get the error description), error code: 0x" << std::hex << _code << ".";
+
+		throw pbio::Error(_code, what.str());
+	}
+
+private:
+
+	bool _failed;
+	uint32_t _code;
+};
+
+
+//! @cond IGNORED
+
+// tag of the Expected constructor that builds the value in place
+struct ExpectedInPlace {};
+
+//! @endcond
+
+
+/** \~English
+	\brief
+		Result of a noexcept API method - either a value or a failed Status.
+	\~Russian
+	\brief
+		Результат noexcept метода API - либо значение, либо Status ошибки.
+*/
+template<typename T>
+class Expected
+{
+public:
+
+	typedef T value_type;
+
+	//! @cond IGNORED
+
+	template<typename... Args>
+	explicit
+	Expected(ExpectedInPlace, Args&&... args) :
+	_status()
+	{
+		new(&_value) T(std::forward<Args>(args)...);
+	}
+
+	//! @endcond
+
+	Expected(const T &value) :
+	_status()
+	{
+		new(&_value) T(value);
+	}
+
+	Expected(T &&value) :
+	_status()
+	{
+		new(&_value) T(std::move(value));
+	}
+
+	Expected(const Status status) noexcept :
+	_status(status)
+	{
+	}
+
+	Expected(const Expected &other) :
+	_status(other._status)
+	{
+		if(_status.ok())
+			new(&_value) T(other._value);
+	}
+
+	Expected(Expected &&other) :
+	_status(other._status)
+	{
+		if(_status.ok())
+			new(&_value) T(std::move(other._value));
+	}
+
+	Expected& operator=(const Expected &other)
+	{
+		if(this != &other)
+		{
+			reset();
+
+			if(other._status.ok())
+				new(&_value) T(other._value);
+
+			_status = other._status;
+		}
+
+		return *this;
+	}
+
+	Expected& operator=(Expected &&other)
+	{
+		if(this != &other)
+		{
+			reset();
+
+			if(other._status.ok())
+				new(&_value) T(std::move(other._value));
+
+			_status = other._status;
+		}
+
+		return *this;
+	}
+
+	~Expected()
+	{
+		reset();
+	}
+
+	/** \~English
+		\brief Check that the call succeeded and the value is set.
+		\~Russian
+		\brief Проверить, что вызов завершился успешно и значение установлено.
+	*/
+	bool ok() const noexcept
+	{
+		return _status.ok();
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return ok();
+	}
+
+	/** \~English
+		\brief Get the status of the call.
+		\~Russian
+		\brief Получить статус вызова.
+	*/
+	const Status& status() const noexcept
+	{
+		return _status;
+	}
+
+	/** \~English
+		\brief Get the error code (0 if the call succeeded).
+		\~Russian
+		\brief Получить код ошибки (0, если вызов завершился успешно).
+	*/
+	uint32_t code() const noexcept
+	{
+		return _status.code();
+	}
+
+	/** \~English
+		\brief Get the value, throws pbio::Error if the call failed.
+		\~Russian
+		\brief Получить значение, выбрасывает pbio::Error, если вызов завершился с ошибкой.
+	*/
+	T& value()
+	{
+		_status.check();
+		return _value;
+	}
+
+	const T& value() const
+	{
+		_status.check();
+		return _value;
+	}
+
+	/** \~English
+		\brief Get the value or default_value if the call failed.
+		\~Russian
+		\brief Получить значение или default_value, если вызов завершился с ошибкой.
+	*/
+	T valueOr(T default_value) const
+	{
+		return _status.ok() ? _value : default_value;
+	}
+
+	/** \~English
+		\brief Access the value without a check, the call must be successful.
+		\~Russian
+		\brief Доступ к значению без проверки, вызов должен быть успешным.
+	*/
+	T& operator * () noexcept
+	{
+		return _value;
+	}
+
+	const T& operator * () const noexcept
+	{
+		return _value;
+	}
+
+	T* operator -> () noexcept
+	{
+		return &_value;
+	}
+
+	const T* operator -> () const noexcept
+	{
+		return &_value;
+	}
+
+private:
+
+	void reset()
+	{
+		if(_status.ok())
+			_value.~T();
+
+		_status = Status(0);
+	}
+
+	Status _status;
+
+	union
+	{
+		T _value;
+	};
+};
+
+}  // pbio namespace
+
+#endif  // __PBIO_API__PBIO__EXPECTED_H_
@@ -10,8 +10,10 @@
 #define __PBIO_API__PBIO__FACEREC_SERVICE_H_
 
 
+#include <algorithm>
 #include <istream>
 #include <stdexcept>
+#include <string>
 #include <utility>
 #include <vector>
 #include <facerec/libfacerec.h>
@@ -20,6 +22,7 @@
 #include <jni.h>
 #endif
 
+#include "stl_wraps_impls/WrapIStreamBufferImpl.h"
 #include "stl_wraps_impls/WrapIStreamImpl.h"
 #include "stl_wraps_impls/WrapOStreamImpl.h"
 
@@ -486,6 +489,72 @@ public:
 
 	DynamicTemplateIndex::Ptr createDynamicTemplateIndex(const Context& config) const;
 
+	/**
+		\~English
+		\brief
+			Load an index saved with DynamicTemplateIndex::savePacked.
+			The file is memory-mapped (or read at once if mmap is false),
+			the method of config is checked against the method in the file header before loading the templates,
+			templates are loaded from the file data in the threads of thread_pool
+			and inserted by DynamicTemplateIndex::add in chunks of chunk_size, then the file is released:
+			later add and remove change only the loaded index, not the file.
+			Thread-safe. Defined in PackedGallery.h.
+
+		\param[in]  filePath
+			Path to the file.
+
+		\param[in]  config
+			Index config, the same as for createDynamicTemplateIndex(config),
+			must create an index of the method of the saved one.
+
+		\param[in]  mmap
+			Map the file into memory instead of reading it.
+
+		\param[in]  thread_pool
+			Pool for loading the templates, can be NULL.
+
+		\param[in]  chunk_size
+			Count of templates in one chunk, must be positive.
+
+		\return
+			Loaded index.
+
+		\~Russian
+		\brief
+			Загрузить индекс, сохраненный с помощью DynamicTemplateIndex::savePacked.
+			Файл отображается в память (или читается целиком, если mmap равен false),
+			метод config сверяется с методом в заголовке файла до загрузки шаблонов,
+			шаблоны загружаются из данных файла в потоках thread_pool
+			и вставляются с помощью DynamicTemplateIndex::add частями по chunk_size, затем файл освобождается:
+			последующие add и remove изменяют только загруженный индекс, но не файл.
+			Потокобезопасный. Определен в PackedGallery.h.
+
+		\param[in]  filePath
+			Путь к файлу.
+
+		\param[in]  config
+			Конфигурация индекса, такая же, как для createDynamicTemplateIndex(config),
+			должна создавать индекс метода сохраненного индекса.
+
+		\param[in]  mmap
+			Отобразить файл в память вместо чтения.
+
+		\param[in]  thread_pool
+			Пул для загрузки шаблонов, может быть NULL.
+
+		\param[in]  chunk_size
+			Количество шаблонов в одной части, должно быть положительным.
+
+		\return
+			Загруженный индекс.
+	*/
+	DynamicTemplateIndex::Ptr loadDynamicTemplateIndex(
+		const std::string& filePath,
+		const Context& config,
+		const bool mmap = true,
+		const pbio::ThreadPool::Ptr& thread_pool = pbio::ThreadPool::Ptr(),
+		const size_t chunk_size = 65536) const;
+
 	ContextTemplate::Ptr loadContextTemplate(std::istream& stream) const;
 
 	ContextTemplate::Ptr loadContextTemplate(pbio::stl_wraps::WrapIStream &stream) const;
@@ -0,0 +1,142 @@
+/**
+	\file FilteredTemplatesIndex.h
+	\~English
+	\brief FilteredTemplatesIndex - TemplatesIndex of the templates allowed by a filter, for the repeated filtered search.
+	\~Russian
+	\brief FilteredTemplatesIndex - индекс TemplatesIndex шаблонов, разрешенных фильтром, для повторного поиска с фильтром.
+*/
+
+#ifndef __PBIO_API__PBIO__FILTERED_TEMPLATES_INDEX_H_
+#define __PBIO_API__PBIO__FILTERED_TEMPLATES_INDEX_H_
+
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "Error.h"
+#include "SmartPtr.h"
+#include "TemplatesIndex.h"
+
+
+namespace pbio
+{
+
+/** \~English
+	\brief
+		Index of the templates of a TemplatesIndex allowed by a filter,
+		created with Recognizer::createFilteredIndex and searched with Recognizer::searchFiltered.
+		Indexes in the search results are the indexes of the templates in the full index.
+	\~Russian
+	\brief
+		Индекс шаблонов индекса TemplatesIndex, разрешенных фильтром,
+		создается с помощью Recognizer::createFilteredIndex, поиск выполняется с помощью Recognizer::searchFiltered.
+		Индексы в результатах поиска - индексы шаблонов в полном индексе.
+*/
+class FilteredTemplatesIndex
+{
+public:
+
+	/** \~English
+		\brief Alias for the type of a smart pointer to FilteredTemplatesIndex.
+		\~Russian
+		\brief Псевдоним для типа умного указателя на FilteredTemplatesIndex.
+	*/
+	typedef LightSmartPtr<FilteredTemplatesIndex>::tPtr Ptr;
+
+	/**
+		\~English
+		\brief
+			Create a filtered index.
+
+		\param[in]  index
+			Index of the allowed templates, can be NULL if no template is allowed.
+
+		\param[in]  ids
+			Indexes of the templates of index in the full index.
+
+		\~Russian
+		\brief
+			Создать индекс с фильтром.
+
+		\param[in]  index
+			Индекс разрешенных шаблонов, может быть NULL, если ни один шаблон не разрешен.
+
+		\param[in]  ids
+			Индексы шаблонов index в полном индексе.
+	*/
+	FilteredTemplatesIndex(
+		const pbio::TemplatesIndex::Ptr &index,
+		const std::vector<int64_t> &ids);
+
+	/**
+		\~English
+		\brief Get a number of the allowed templates.
+		\~Russian
+		\brief Получить количество разрешенных шаблонов.
+	*/
+	size_t size() const
+	{
+		return _ids.size();
+	}
+
+	/**
+		\~English
+		\brief Get the index of the allowed templates (NULL if no template is allowed).
+		\~Russian
+		\brief Получить индекс разрешенных шаблонов (NULL, если ни один шаблон не разрешен).
+	*/
+	const pbio::TemplatesIndex::Ptr& index() const
+	{
+		return _index;
+	}
+
+	/**
+		\~English
+		\brief Get the indexes of the allowed templates in the full index.
+		\~Russian
+		\brief Получить индексы разрешенных шаблонов в полном индексе.
+	*/
+	const std::vector<int64_t>& ids() const
+	{
+		return _ids;
+	}
+
+private:
+
+	pbio::TemplatesIndex::Ptr _index;
+
+	std::vector<int64_t> _ids;
+
+	int32_t refcounter4light_shared_ptr;
+
+	friend class object_with_ref_counter<FilteredTemplatesIndex>;
+};
+
+}  // pbio namespace
+
+
+
+////////////////////////
+/////IMPLEMENTATION/////
+////////////////////////
+
+namespace pbio
+{
+
+inline
+FilteredTemplatesIndex::FilteredTemplatesIndex(
+	const pbio::TemplatesIndex::Ptr &index,
+	const std::vector<int64_t> &ids) :
+_index(index),
+_ids(ids)
+{
+	if(!_ids.empty() && (!_index || _index->size() != _ids.size()))
+	{
+		throw pbio::Error(0x3e91d5a8, "Error in pbio::FilteredTemplatesIndex: ids don't match the index, error code: 0x3e91d5a8.");
+	}
+}
+
+}  // pbio namespace
+
+#endif  // __PBIO_API__PBIO__FILTERED_TEMPLATES_INDEX_H_
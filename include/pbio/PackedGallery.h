@@ -0,0 +1,775 @@
+/**
+	\file PackedGallery.h
+	\~English
+	\brief PackedGallery - memory-mappable container of saved templates with fixed stride and an id table.
+	\~Russian
+	\brief PackedGallery - отображаемый в память контейнер сохраненных шаблонов с фиксированным шагом и таблицей идентификаторов.
+*/
+
+#ifndef __PBIO_API__PBIO__PACKED_GALLERY_H_
+#define __PBIO_API__PBIO__PACKED_GALLERY_H_
+
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#include "Error.h"
+#include "FacerecService.h"
+#include "Recognizer.h"
+#include "SmartPtr.h"
+#include "Template.h"
+
+
+namespace pbio
+{
+
+/** \~English
+	\brief
+		Read-only view of a packed gallery - a file (or a memory buffer) that contains
+		a header, the method name, templates saved with Template::save
+		in slots of a fixed stride and a table of 64-bit ids.
+		The gallery can be opened with memory mapping (PackedGallery::open)
+		and loaded with one Recognizer::loadTemplates call, Recognizer::createIndex
+		creates an index from it. These Recognizer methods and FacerecService::loadDynamicTemplateIndex
+		are defined in this header, so the other headers do not pull the memory mapping headers.
+
+		Layout (all numbers in the byte order of the machine that wrote the file):
+		<pre>
+		offset 0:              char[8] magic "PBIOGAL1"
+		offset 8:              uint32 version, uint32 method name size
+		offset 16:             uint64 templates count, uint64 template stride
+		offset 32:             uint64 templates offset, uint64 ids offset
+		offset 48:             uint64 file size, uint64 reserved
+		offset 64:             method name
+		templates offset:      templates count slots of template stride bytes
+		                       (the offset and the stride are multiples of 64, so every slot is 64-byte aligned)
+		ids offset:            templates count int64 ids (8-byte aligned)
+		</pre>
+	\~Russian
+	\brief
+		Представление упакованной галереи только для чтения - файла (или буфера в памяти),
+		содержащего заголовок, имя метода, шаблоны, сохраненные с помощью Template::save,
+		в ячейках фиксированного размера и таблицу 64-битных идентификаторов.
+		Галерея может быть открыта с отображением в память (PackedGallery::open)
+		и загружена одним вызовом Recognizer::loadTemplates, Recognizer::createIndex
+		создает индекс из нее. Эти методы Recognizer и FacerecService::loadDynamicTemplateIndex
+		определены в этом заголовке, поэтому остальные заголовки не подключают заголовки отображения в память.
+
+		Структура (все числа в порядке байт машины, записавшей файл):
+		<pre>
+		смещение 0:            char[8] сигнатура "PBIOGAL1"
+		смещение 8:            uint32 версия, uint32 размер имени метода
+		смещение 16:           uint64 количество шаблонов, uint64 размер ячейки шаблона
+		смещение 32:           uint64 смещение шаблонов, uint64 смещение идентификаторов
+		смещение 48:           uint64 размер файла, uint64 зарезервировано
+		смещение 64:           имя метода
+		смещение шаблонов:     ячейки шаблонов размером template stride байт
+		                       (смещение и размер кратны 64, поэтому каждая ячейка выровнена на 64 байта)
+		смещение ид.:          int64 идентификаторы (выравнивание 8 байт)
+		</pre>
+*/
+class PackedGallery
+{
+public:
+
+	/** \~English
+		\brief Alias for the type of a smart pointer to PackedGallery.
+		\~Russian
+		\brief Псевдоним для типа умного указателя на PackedGallery.
+	*/
+	typedef LightSmartPtr<PackedGallery>::tPtr Ptr;
+
+	/**
+		\~English
+		\brief
+			Write the templates to the packed gallery format.
+			Templates are saved twice: the first pass finds the slot size, the second writes the slots,
+			so only one template is held in memory.
+
+		\param[out]  binary_stream
+			Output stream, must be opened with the std::ios_base::binary flag.
+
+		\param[in]  templates
+			Templates created by the same method, must not be empty.
+
+		\param[in]  ids
+			Ids of the templates, if empty, the i-th template gets id i.
+
+		\~Russian
+		\brief
+			Записать шаблоны в формате упакованной галереи.
+			Шаблоны сохраняются дважды: первый проход определяет размер ячейки, второй записывает ячейки,
+			поэтому в памяти находится только один шаблон.
+
+		\param[out]  binary_stream
+			Выходной поток, необходимо открывать с флагом std::ios_base::binary.
+
+		\param[in]  templates
+			Шаблоны, созданные одним методом, не должны быть пустыми.
+
+		\param[in]  ids
+			Идентификаторы шаблонов, если пустые, i-й шаблон получает идентификатор i.
+	*/
+	static void write(
+		std::ostream &binary_stream,
+		const std::vector<pbio::Template::Ptr> &templates,
+		const std::vector<int64_t> &ids = std::vector<int64_t>());
+
+	/**
+		\~English
+		\brief
+			Write the templates to the packed gallery file.
+
+		\~Russian
+		\brief
+			Записать шаблоны в файл упакованной галереи.
+	*/
+	static void write(
+		const std::string &file_path,
+		const std::vector<pbio::Template::Ptr> &templates,
+		const std::vector<int64_t> &ids = std::vector<int64_t>());
+
+	/**
+		\~English
+		\brief
+			Open the packed gallery file with memory mapping,
+			the file is unmapped when the last pointer is destroyed.
+
+		\~Russian
+		\brief
+			Открыть файл упакованной галереи с отображением в память,
+			отображение снимается при уничтожении последнего указателя.
+	*/
+	static Ptr open(const std::string &file_path);
+
+	/**
+		\~English
+		\brief
+			Create a view of the packed gallery in the caller memory (not copied),
+			the memory must be valid while the view is used.
+
+		\~Russian
+		\brief
+			Создать представление упакованной галереи в памяти вызывающего (не копируется),
+			память должна быть действительна, пока используется представление.
+	*/
+	PackedGallery(const void* const data, const size_t size);
+
+	~PackedGallery();
+
+	/**
+		\~English
+		\brief Get the name of the method that created the templates.
+		\~Russian
+		\brief Получить имя метода, создавшего шаблоны.
+	*/
+	std::string getMethodName() const
+	{
+		return std::string(_data + sizeof(Header), _header.method_name_size);
+	}
+
+	/**
+		\~English
+		\brief Get a number of templates.
+		\~Russian
+		\brief Получить количество шаблонов.
+	*/
+	size_t size() const
+	{
+		return _header.templates_count;
+	}
+
+	/**
+		\~English
+		\brief Get the size of the slot of one template in bytes.
+		\~Russian
+		\brief Получить размер ячейки одного шаблона в байтах.
+	*/
+	size_t templateStride() const
+	{
+		return _header.template_stride;
+	}
+
+	/**
+		\~English
+		\brief Get the slots of all templates (size() * templateStride() bytes).
+		\~Russian
+		\brief Получить ячейки всех шаблонов (size() * templateStride() байт).
+	*/
+	const void* templatesData() const
+	{
+		return _data + _header.templates_offset;
+	}
+
+	/**
+		\~English
+		\brief Get the ids of all templates (size() elements).
+		\~Russian
+		\brief Получить идентификаторы всех шаблонов (size() элементов).
+	*/
+	const int64_t* ids() const
+	{
+		return reinterpret_cast<const int64_t*>(_data + _header.ids_offset);
+	}
+
+	/**
+		\~English
+		\brief Get the id of the i-th template.
+		\~Russian
+		\brief Получить идентификатор i-го шаблона.
+	*/
+	int64_t id(const size_t i) const;
+
+private:
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t method_name_size;
+		uint64_t templates_count;
+		uint64_t template_stride;
+		uint64_t templates_offset;
+		uint64_t ids_offset;
+		uint64_t file_size;
+		uint64_t reserved;
+	};
+
+	static const uint32_t current_version = 1;
+
+	static const char* magic()
+	{
+		return "PBIOGAL1";
+	}
+
+	static uint64_t align(const uint64_t value, const uint64_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	PackedGallery(const PackedGallery&);
+	PackedGallery& operator=(const PackedGallery&);
+
+	// counts the bytes of a saved template and forwards them to the stream, if any
+	class CountingOStream : public pbio::stl_wraps::WrapOStream
+	{
+	public:
+
+		explicit CountingOStream(std::ostream* const stream) :
+		_stream(stream),
+		_size(0)
+		{
+		}
+
+		virtual void write(const char* buf, uint64_t size)
+		{
+			if(_stream)
+				_stream->write(buf, size);
+
+			_size += size;
+		}
+
+		uint64_t size() const
+		{
+			return _size;
+		}
+
+	private:
+
+		std::ostream* const _stream;
+		uint64_t _size;
+	};
+
+	// checks the header and the bounds of the sections
+	void init(const void* const data, const size_t size);
+
+	// read-only mapping of the whole file, NULL on failure
+	static void* mapFile(const std::string &file_path, size_t &size);
+
+	static void unmapFile(void* const mapping, const size_t size);
+
+	const char* _data;
+	Header _header;
+
+	// mapped view, unmapped in the destructor
+	void* _mapping;
+	size_t _mapping_size;
+
+	int32_t refcounter4light_shared_ptr;
+
+	friend class object_with_ref_counter<PackedGallery>;
+	friend class FacerecService;
+};
+
+}  // pbio namespace
+
+
+
+////////////////////////
+/////IMPLEMENTATION/////
+////////////////////////
+
+namespace pbio
+{
+
+inline
+PackedGallery::PackedGallery(const void* const data, const size_t size) :
+_mapping(NULL),
+_mapping_size(0)
+{
+	init(data, size);
+}
+
+
+inline
+PackedGallery::~PackedGallery()
+{
+	if(_mapping)
+		unmapFile(_mapping, _mapping_size);
+}
+
+
+inline
+void PackedGallery::init(const void* const data, const size_t size)
+{
+	_data = static_cast<const char*>(data);
+
+	if(!_data || size < sizeof(Header))
+	{
+		throw pbio::Error(0x4b9e1d07, "Error in pbio::PackedGallery: data is too small for the header, error code: 0x4b9e1d07.");
+	}
+
+	// the header is copied, so the data does not have to be aligned
+	std::memcpy(&_header, _data, sizeof(Header));
+
+	if(std::memcmp(_header.magic, magic(), sizeof(_header.magic)) != 0 || _header.version != current_version)
+	{
+		throw pbio::Error(0x2fd6a358, "Error in pbio::PackedGallery: not a packed gallery or unsupported version, error code: 0x2fd6a358.");
+	}
+
+	const uint64_t templates_size = _header.templates_count * _header.template_stride;
+
+	if(_header.file_size > size ||
+		sizeof(Header) + _header.method_name_size > _header.templates_offset ||
+		_header.templates_offset > _header.file_size ||
+		(_header.templates_count != 0 && _header.template_stride == 0) ||
+		(_header.templates_count != 0 && _header.templates_count > (_header.file_size - _header.templates_offset) / _header.template_stride) ||
+		_header.templates_offset + templates_size > _header.ids_offset ||
+		_header.ids_offset > _header.file_size ||
+		_header.templates_count > (_header.file_size - _header.ids_offset) / sizeof(int64_t) ||
+		_header.ids_offset % sizeof(int64_t) != 0)
+	{
+		throw pbio::Error(0x6c02f9b4, "Error in pbio::PackedGallery: broken or truncated packed gallery, error code: 0x6c02f9b4.");
+	}
+}
+
+
+inline
+int64_t PackedGallery::id(const size_t i) const
+{
+	if(i >= _header.templates_count)
+	{
+		throw pbio::Error(0x39a7c6e1, "Error in pbio::PackedGallery::id: index out of range, error code: 0x39a7c6e1.");
+	}
+
+	int64_t result;
+
+	std::memcpy(&result, _data + _header.ids_offset + i * sizeof(int64_t), sizeof(int64_t));
+
+	return result;
+}
+
+
+inline
+void PackedGallery::write(
+	std::ostream &binary_stream,
+	const std::vector<pbio::Template::Ptr> &templates,
+	const std::vector<int64_t> &ids)
+{
+	if(templates.empty())
+	{
+		throw pbio::Error(0x5e80b2fa, "Error in pbio::PackedGallery::write: no templates, error code: 0x5e80b2fa.");
+	}
+
+	if(!ids.empty() && ids.size() != templates.size())
+	{
+		throw pbio::Error(0x0d4f7e93, "Error in pbio::PackedGallery::write: ids count differs from templates count, error code: 0x0d4f7e93.");
+	}
+
+	const std::string method_name = templates[0]->getMethodName();
+
+	uint64_t template_stride = 0;
+
+	// the first pass only measures the saved templates
+	for(size_t i = 0; i < templates.size(); ++i)
+	{
+		if(templates[i]->getMethodName() != method_name)
+		{
+			throw pbio::Error(0x71c3a0d5, "Error in pbio::PackedGallery::write: templates were created by different methods, error code: 0x71c3a0d5.");
+		}
+
+		CountingOStream counter(NULL);
+		templates[i]->save(counter);
+
+		if(counter.size() > template_stride)
+			template_stride = counter.size();
+	}
+
+	template_stride = align(template_stride, 64);
+
+	Header header;
+	std::memset(&header, 0, sizeof(Header));
+	std::memcpy(header.magic, magic(), sizeof(header.magic));
+	header.version = current_version;
+	header.method_name_size = method_name.size();
+	header.templates_count = templates.size();
+	header.template_stride = template_stride;
+	header.templates_offset = align(sizeof(Header) + method_name.size(), 64);
+	header.ids_offset = align(header.templates_offset + templates.size() * template_stride, 8);
+	header.file_size = header.ids_offset + templates.size() * sizeof(int64_t);
+
+	const std::vector<char> zeros(template_stride + 64, 0);
+
+	binary_stream.write((const char*) &header, sizeof(Header));
+	binary_stream.write(method_name.data(), method_name.size());
+	binary_stream.write(zeros.data(), header.templates_offset - sizeof(Header) - method_name.size());
+
+	// the second pass saves the templates directly to the stream
+	for(size_t i = 0; i < templates.size(); ++i)
+	{
+		CountingOStream slot(&binary_stream);
+		templates[i]->save(slot);
+
+		if(slot.size() > template_stride)
+		{
+			throw pbio::Error(0x27f8c16d, "Error in pbio::PackedGallery::write: template size changed between passes, error code: 0x27f8c16d.");
+		}
+
+		binary_stream.write(zeros.data(), template_stride - slot.size());
+	}
+
+	binary_stream.write(zeros.data(), header.ids_offset - header.templates_offset - templates.size() * template_stride);
+
+	for(size_t i = 0; i < templates.size(); ++i)
+	{
+		const int64_t id = ids.empty() ? int64_t(i) : ids[i];
+		binary_stream.write((const char*) &id, sizeof(int64_t));
+	}
+
+	if(!binary_stream)
+	{
+		throw pbio::Error(0x18b5e4c2, "Error in pbio::PackedGallery::write: stream write failed, error code: 0x18b5e4c2.");
+	}
+}
+
+
+inline
+void PackedGallery::write(
+	const std::string &file_path,
+	const std::vector<pbio::Template::Ptr> &templates,
+	const std::vector<int64_t> &ids)
+{
+	std::ofstream file(file_path.c_str(), std::ios_base::binary);
+
+	if(!file.is_open())
+	{
+		throw pbio::Error(0x6a91d3f8, "Error in pbio::PackedGallery::write: can't open file '" + file_path + "', error code: 0x6a91d3f8.");
+	}
+
+	write(file, templates, ids);
+}
+
+
+inline
+void* PackedGallery::mapFile(const std::string &file_path, size_t &size)
+{
+	void* mapping = NULL;
+	size = 0;
+
+#ifdef _WIN32
+	const HANDLE file = CreateFileA(
+		file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if(file != INVALID_HANDLE_VALUE)
+	{
+		LARGE_INTEGER file_size;
+
+		if(GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+		{
+			size = (size_t) file_size.QuadPart;
+
+			const HANDLE file_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+			if(file_mapping)
+			{
+				mapping = MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+
+				// the view keeps the mapping alive
+				CloseHandle(file_mapping);
+			}
+		}
+
+		CloseHandle(file);
+	}
+#else
+	const int file = ::open(file_path.c_str(), O_RDONLY);
+
+	if(file >= 0)
+	{
+		struct stat file_stat;
+
+		if(fstat(file, &file_stat) == 0 && file_stat.st_size > 0)
+		{
+			size = (size_t) file_stat.st_size;
+
+			mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, file, 0);
+
+			if(mapping == MAP_FAILED)
+				mapping = NULL;
+		}
+
+		// the mapping keeps the file alive
+		::close(file);
+	}
+#endif
+
+	return mapping;
+}
+
+
+inline
+void PackedGallery::unmapFile(void* const mapping, const size_t size)
+{
+#ifdef _WIN32
+	(void) size;
+	UnmapViewOfFile(mapping);
+#else
+	munmap(mapping, size);
+#endif
+}
+
+
+inline
+PackedGallery::Ptr PackedGallery::open(const std::string &file_path)
+{
+	size_t size = 0;
+	void* const mapping = mapFile(file_path, size);
+
+	if(!mapping)
+	{
+		throw pbio::Error(0x3e47b0c9, "Error in pbio::PackedGallery::open: can't map file '" + file_path + "', error code: 0x3e47b0c9.");
+	}
+
+	Ptr result;
+
+	try
+	{
+		result = Ptr::make(mapping, size);
+	}
+	catch(...)
+	{
+		unmapFile(mapping, size);
+		throw;
+	}
+
+	result->_mapping = mapping;
+	result->_mapping_size = size;
+
+	return result;
+}
+
+
+inline
+void Recognizer::checkGalleryMethod(const pbio::PackedGallery &gallery) const
+{
+	if(gallery.getMethodName() != getMethodName())
+	{
+		throw pbio::Error(0x0f6b2dc3, "Error: the packed gallery was created with another method, error code: 0x0f6b2dc3.");
+	}
+}
+
+
+inline
+std::vector<Template::Ptr> Recognizer::loadTemplates(const pbio::PackedGallery &gallery) const
+{
+	checkGalleryMethod(gallery);
+
+	return loadTemplates(gallery.templatesData(), gallery.templateStride(), gallery.size());
+}
+
+
+inline
+TemplatesIndex::Ptr Recognizer::createIndex(
+	const pbio::PackedGallery &gallery,
+	const int search_threads_count,
+	const int reserve_queries_count) const
+{
+	std::vector<pbio::Template::Ptr> templates = loadTemplates(gallery);
+
+	const TemplatesIndex::Ptr result = createIndex(templates, search_threads_count, reserve_queries_count);
+
+	// the library does not promise that the index can outlive
+	// the templates it was created from, so the index keeps them
+	result->_loaded_templates.swap(templates);
+
+	return result;
+}
+
+
+#ifndef WITHOUT_PROCESSING_BLOCK
+inline DynamicTemplateIndex::Ptr FacerecService::loadDynamicTemplateIndex(
+	const std::string& filePath,
+	const Context& config,
+	const bool mmap,
+	const pbio::ThreadPool::Ptr& thread_pool,
+	const size_t chunk_size) const
+{
+	if(chunk_size == 0)
+	{
+		throw pbio::Error(0x72e4a0c9, "Error in pbio::FacerecService::loadDynamicTemplateIndex: chunk_size must be positive, error code: 0x72e4a0c9.");
+	}
+
+	// the mapping or the read file, released on return
+	struct FileData
+	{
+		void* mapping;
+		size_t size;
+		std::vector<char> buffer;
+
+		FileData() : mapping(NULL), size(0) {}
+
+		~FileData()
+		{
+			if(mapping)
+				PackedGallery::unmapFile(mapping, size);
+		}
+	} file_data;
+
+	if(mmap)
+	{
+		file_data.mapping = PackedGallery::mapFile(filePath, file_data.size);
+	}
+	else
+	{
+		std::ifstream file(filePath.c_str(), std::ios_base::binary);
+
+		if(file.is_open() && file.seekg(0, std::ios_base::end))
+		{
+			file_data.buffer.resize(static_cast<size_t>(file.tellg()));
+
+			if(file.seekg(0, std::ios_base::beg) && file.read(file_data.buffer.data(), file_data.buffer.size()))
+				file_data.size = file_data.buffer.size();
+		}
+	}
+
+	const char* const data = file_data.mapping ? static_cast<const char*>(file_data.mapping) : file_data.buffer.data();
+
+	if(!data || file_data.size == 0)
+	{
+		throw pbio::Error(0x6c2e91d7, "Error in pbio::FacerecService::loadDynamicTemplateIndex: can't read file '" + filePath + "', error code: 0x6c2e91d7.");
+	}
+
+	const DynamicTemplateIndex::PackedHeader header = DynamicTemplateIndex::readPackedHeader(data, file_data.size);
+
+	const size_t count = header.templates_count;
+
+	const uint64_t templates_data_offset = header.templates_offset + (count + 1) * sizeof(uint64_t);
+	const uint64_t uuids_data_offset = header.uuids_offset + count * sizeof(uint64_t);
+	const uint64_t uuids_data_size = header.file_size - uuids_data_offset;
+
+	std::vector<uint64_t> templates_offsets(count + 1);
+	std::vector<uint64_t> uuids_offsets(count);
+
+	std::memcpy(templates_offsets.data(), data + header.templates_offset, templates_offsets.size() * sizeof(uint64_t));
+
+	if(count != 0)
+		std::memcpy(uuids_offsets.data(), data + header.uuids_offset, uuids_offsets.size() * sizeof(uint64_t));
+
+	bool broken = templates_offsets[0] != 0 ||
+		templates_offsets[count] > header.uuids_offset - templates_data_offset ||
+		(count != 0 && (uuids_data_size == 0 || data[header.file_size - 1] != '\0'));
+
+	for(size_t i = 0; i < count && !broken; ++i)
+		broken = templates_offsets[i] > templates_offsets[i + 1] || uuids_offsets[i] >= uuids_data_size;
+
+	if(broken)
+	{
+		throw pbio::Error(0x27f5a3e0, "Error in pbio::FacerecService::loadDynamicTemplateIndex: broken or truncated packed index, error code: 0x27f5a3e0.");
+	}
+
+	// the empty index is created first to check the method before loading the templates
+	Context result_config(config);
+
+	if(!result_config.contains("capacity") || result_config["capacity"].getLong() < static_cast<long>(count))
+		result_config["capacity"].setLong(static_cast<long>(count));
+
+	const DynamicTemplateIndex::Ptr result = createDynamicTemplateIndex(result_config);
+
+	if(result->getMethodName() != std::string(data + sizeof(DynamicTemplateIndex::PackedHeader), header.method_name_size))
+	{
+		throw pbio::Error(0x3a9d06cb, "Error in pbio::FacerecService::loadDynamicTemplateIndex: config method differs from the method of the saved index, error code: 0x3a9d06cb.");
+	}
+
+	std::vector<pbio::ContextTemplate::Ptr> templates(count);
+
+	const size_t chunks_count = (count + chunk_size - 1) / chunk_size;
+
+	std::atomic<size_t> next_chunk(0);
+	std::atomic<bool> failed(false);
+
+	const auto worker = [&](const size_t)
+	{
+		try
+		{
+			for(size_t chunk = next_chunk++; chunk < chunks_count && !failed; chunk = next_chunk++)
+			{
+				const size_t end = (std::min)((chunk + 1) * chunk_size, count);
+
+				for(size_t i = chunk * chunk_size; i < end; ++i)
+				{
+					pbio::stl_wraps::WrapIStreamBufferImpl stream(
+						data + templates_data_offset + templates_offsets[i],
+						static_cast<int>(templates_offsets[i + 1] - templates_offsets[i]));
+
+					templates[i] = loadContextTemplate(stream);
+				}
+			}
+		}
+		catch(...)
+		{
+			failed = true;
+			throw;
+		}
+	};
+
+	if(thread_pool && chunks_count > 1)
+		thread_pool->parallelFor((std::min)(thread_pool->threadsCount(), chunks_count), worker);
+	else
+		worker(0);
+
+	// the concurrent insertion into one index is not supported, so the templates are inserted serially
+	result->add(templates, data + uuids_data_offset, uuids_offsets, chunk_size);
+
+	return result;
+}
+#endif
+
+}  // pbio namespace
+
+#endif  // __PBIO_API__PBIO__PACKED_GALLERY_H_
@@ -11,6 +11,9 @@
 
 #ifndef WITHOUT_PROCESSING_BLOCK
 
+#include <sstream>
+#include <vector>
+
 #include "Context.h"
 #include "DllHandle.h"
 #include "ExceptionCheck.h"
@@ -63,6 +66,66 @@ public:
 		tdvCheckException(dll_handle_, eh_);
 	}
 
+	/**
+		\~English
+		\brief
+			Calling the processing block function for each Context of a batch, in order, with one error handler.
+			All pointers are checked before processing. On an error the preceding Contexts stay processed,
+			the error code is kept and the message gets the index of the failed Context.
+		\param[in]  batch Contexts
+		\~Russian
+		\brief
+			Вызов функции процессинг-блока для каждого Context пакета по порядку с одним обработчиком ошибок.
+			Все указатели проверяются до обработки. При ошибке предшествующие Context остаются обработанными,
+			код ошибки сохраняется, а в сообщение добавляется индекс Context, вызвавшего ошибку.
+		\param[in]  batch Context-ы
+	*/
+	void processBatch(const std::vector<pbio::Context*>& batch)
+	{
+		for(size_t i = 0; i < batch.size(); ++i)
+			if(!batch[i])
+				throw pbio::Error(0x7b3e5d21, "Error in pbio::ProcessingBlock::processBatch: batch contains NULL context, error code: 0x7b3e5d21.");
+
+		for(size_t i = 0; i < batch.size(); ++i)
+		{
+			dll_handle_->TDVProcessingBlock_processContext(handle_, batch[i]->getHandle(), &eh_);
+
+			if(eh_)
+			{
+				const uint32_t code = dll_handle_->TDVException_getErrorCode(eh_);
+
+				std::ostringstream message;
+				message << "Error in pbio::ProcessingBlock::processBatch: context " << i << ": " << dll_handle_->TDVException_getMessage(eh_);
+
+				dll_handle_->TDVException_deleteException(eh_);
+				eh_ = nullptr;
+
+				throw pbio::Error(code, message.str());
+			}
+		}
+	}
+
+	/**
+		\~English
+		\brief
+			Calling the processing block function for each Context of a batch, see processBatch(const std::vector<pbio::Context*>&).
+		\param[in]  batch Contexts
+		\~Russian
+		\brief
+			Вызов функции процессинг-блока для каждого Context пакета, см. processBatch(const std::vector<pbio::Context*>&).
+		\param[in]  batch Context-ы
+	*/
+	void processBatch(std::vector<pbio::Context>& batch)
+	{
+		std::vector<pbio::Context*> pointers;
+		pointers.reserve(batch.size());
+
+		for(size_t i = 0; i < batch.size(); ++i)
+			pointers.push_back(&batch[i]);
+
+		processBatch(pointers);
+	}
+
 	~ProcessingBlock() {
 		if(handle_)
 		{
@@ -10,13 +10,20 @@
 #define __PBIO_API__PBIO__RECOGNIZER_H_
 
 
+#include <algorithm>
+#include <atomic>
 #include <istream>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 #include "ComplexObject.h"
 #include "Error.h"
+#include "Expected.h"
+#include "FilteredTemplatesIndex.h"
 #include "RawSample.h"
+#include "SearchResultBuffer.h"
+#include "ShardedTemplatesIndex.h"
 #include "SmartPtr.h"
 #include "Template.h"
 #include "TemplatesIndex.h"
@@ -28,6 +35,7 @@ namespace pbio
 {
 
 class FacerecService;
+class PackedGallery;
 
 /** \~English
 	\brief Interface object for creating and matching templates.
@@ -111,6 +119,35 @@ public:
 		MatchResult match_result;
 	};
 
+	/** \~English
+		\brief Pair of likely duplicates found by selfJoin.
+		\~Russian
+		\brief Пара вероятных дубликатов, найденная selfJoin.
+	*/
+	struct DuplicatePair
+	{
+		/** \~English
+			\brief Index of the first template in the TemplatesIndex, i < j.
+			\~Russian
+			\brief Порядковый номер первого шаблона в индексе, i < j.
+		*/
+		size_t i;
+
+		/** \~English
+			\brief Index of the second template in the TemplatesIndex.
+			\~Russian
+			\brief Порядковый номер второго шаблона в индексе.
+		*/
+		size_t j;
+
+		/** \~English
+			\brief Result of matching the i-th and the j-th templates.
+			\~Russian
+			\brief Результат сравнения i-го и j-го шаблонов.
+		*/
+		MatchResult match_result;
+	};
+
 	/** \~English
 		\brief Types of search acceleration.
 		\~Russian
@@ -371,6 +408,64 @@ public:
 		const int size) const;
 
 
+	/**
+		\~English
+		\brief
+			Load count templates saved with Template::save into slots of template_stride bytes
+			(the i-th template starts at data + i * template_stride), as in PackedGallery.
+			Templates are read directly from the memory without std::istream.
+
+		\param[in] data
+			Slots of the templates.
+
+		\param[in] template_stride
+			Size of the slot of one template in bytes.
+
+		\param[in] count
+			Number of templates.
+
+		\return
+			Loaded templates.
+
+		\~Russian
+		\brief
+			Загрузить count шаблонов, сохраненных с помощью Template::save в ячейки по template_stride байт
+			(i-й шаблон начинается с data + i * template_stride), как в PackedGallery.
+			Шаблоны читаются непосредственно из памяти без std::istream.
+
+		\param[in] data
+			Ячейки шаблонов.
+
+		\param[in] template_stride
+			Размер ячейки одного шаблона в байтах.
+
+		\param[in] count
+			Количество шаблонов.
+
+		\return
+			Загруженные шаблоны.
+	*/
+	std::vector<Template::Ptr> loadTemplates(
+		const void* const data,
+		const size_t template_stride,
+		const size_t count) const;
+
+	/**
+		\~English
+		\brief
+			Load all templates of the packed gallery.
+			The gallery must be created with the same method.
+			Defined in PackedGallery.h.
+
+		\~Russian
+		\brief
+			Загрузить все шаблоны упакованной галереи.
+			Галерея должна быть создана этим же методом.
+			Определен в PackedGallery.h.
+	*/
+	std::vector<Template::Ptr> loadTemplates(const pbio::PackedGallery &gallery) const;
+
+
 	/**
 		\~English
 		\brief
@@ -408,6 +503,123 @@ public:
 		const Template &template1,
 		const Template &template2) const;
 
+	/**
+		\~English
+		\brief
+			Same as verifyMatch, but an error of the library is returned
+			as a failed status instead of throwing pbio::Error.
+
+		\param[in]  template1
+			%Template created by the same method.
+
+		\param[in]  template2
+			%Template created by the same method.
+
+		\return
+			Result of the matching or failed status.
+
+		\~Russian
+		\brief
+			То же, что verifyMatch, но ошибка библиотеки возвращается
+			в виде статуса ошибки вместо выбрасывания pbio::Error.
+
+		\param[in]  template1
+			Шаблон, созданный таким же методом.
+
+		\param[in]  template2
+			Шаблон, созданный таким же методом.
+
+		\return
+			Результат сравнения или статус ошибки.
+	*/
+	Expected<MatchResult> tryVerifyMatch(
+		const Template &template1,
+		const Template &template2) const noexcept;
+
+
+	/**
+		\~English
+		\brief
+			Compare every query template with every gallery template.
+			Results are written to row-major matrices of queries.size() rows and gallery.size() columns:
+			the result of queries[i] and gallery[j] is at i * gallery.size() + j.
+			The matrix is computed by tiles of 16 queries and 256 gallery templates,
+			so the templates of a tile stay in the cache.
+			The matching with one recognizer is not parallel, so for the parallel computation
+			pass the thread pool and recognizers created with the same config, one for each additional thread
+			(as in recognition_test11), tiles are distributed between this recognizer and thread_recognizers.
+
+		\param[in]  queries
+			Query templates created by the same method.
+
+		\param[in]  gallery
+			Gallery templates created by the same method.
+
+		\param[out]  out_distances
+			Matrix of distances, queries.size() * gallery.size() elements, can be NULL.
+
+		\param[out]  out_scores
+			Matrix of similarity scores, queries.size() * gallery.size() elements, can be NULL.
+
+		\param[in]  thread_pool
+			Pool for the parallel computation, if NULL, the matrix is computed in the calling thread.
+
+		\param[in]  thread_recognizers
+			Recognizers for the additional threads of the pool.
+
+		\~Russian
+		\brief
+			Сравнить каждый запросный шаблон с каждым шаблоном галереи.
+			Результаты записываются в матрицы из queries.size() строк и gallery.size() столбцов, хранящиеся по строкам:
+			результат queries[i] и gallery[j] находится в i * gallery.size() + j.
+			Матрица вычисляется блоками из 16 запросов и 256 шаблонов галереи,
+			поэтому шаблоны блока остаются в кэше.
+			Сравнение одним распознавателем не параллельное, поэтому для параллельного вычисления
+			передайте пул потоков и распознаватели, созданные с такой же конфигурацией, по одному на каждый дополнительный поток
+			(как в recognition_test11), блоки распределяются между этим распознавателем и thread_recognizers.
+
+		\param[in]  queries
+			Запросные шаблоны, созданные этим же методом.
+
+		\param[in]  gallery
+			Шаблоны галереи, созданные этим же методом.
+
+		\param[out]  out_distances
+			Матрица расстояний, queries.size() * gallery.size() элементов, может быть NULL.
+
+		\param[out]  out_scores
+			Матрица величин сходства, queries.size() * gallery.size() элементов, может быть NULL.
+
+		\param[in]  thread_pool
+			Пул для параллельного вычисления, если NULL, матрица вычисляется в вызывающем потоке.
+
+		\param[in]  thread_recognizers
+			Распознаватели для дополнительных потоков пула.
+	*/
+	void verifyMatchMatrix(
+		const std::vector<pbio::Template::Ptr> &queries,
+		const std::vector<pbio::Template::Ptr> &gallery,
+		float* const out_distances,
+		float* const out_scores,
+		const pbio::ThreadPool::Ptr &thread_pool = pbio::ThreadPool::Ptr(),
+		const std::vector<Recognizer::Ptr> &thread_recognizers = std::vector<Recognizer::Ptr>()) const;
+
+	/**
+		\~English
+		\brief
+			Compute the matrix of similarity scores, out_scores is resized to queries.size() * gallery.size().
+
+		\~Russian
+		\brief
+			Вычислить матрицу величин сходства, размер out_scores изменяется на queries.size() * gallery.size().
+	*/
+	void verifyMatchMatrix(
+		const std::vector<pbio::Template::Ptr> &queries,
+		const std::vector<pbio::Template::Ptr> &gallery,
+		std::vector<float> &out_scores,
+		const pbio::ThreadPool::Ptr &thread_pool = pbio::ThreadPool::Ptr(),
+		const std::vector<Recognizer::Ptr> &thread_recognizers = std::vector<Recognizer::Ptr>()) const;
+
 
 	/**
 		\~English
@@ -450,6 +662,31 @@ public:
 		const int reserve_queries_count = 0) const;
 
 
+	/**
+		\~English
+		\brief
+			Create the TemplatesIndex from all templates of the packed gallery,
+			the i-th template of the index is the i-th template of the gallery
+			(gallery.id(i) is its id). The index keeps the loaded templates
+			until it is destroyed. The gallery must be created with the same method.
+			The total size of all indexes is limited by the license.
+			Defined in PackedGallery.h.
+
+		\~Russian
+		\brief
+			Создать индекс (TemplatesIndex) из всех шаблонов упакованной галереи,
+			i-й шаблон индекса - i-й шаблон галереи (gallery.id(i) - его идентификатор).
+			Индекс хранит загруженные шаблоны до своего уничтожения.
+			Галерея должна быть создана этим же методом.
+			Суммарный размер всех индексов ограничен лицензией.
+			Определен в PackedGallery.h.
+	*/
+	TemplatesIndex::Ptr createIndex(
+		const pbio::PackedGallery &gallery,
+		const int search_threads_count = 1,
+		const int reserve_queries_count = 0) const;
+
+
 	TemplatesIndex::Ptr createResizableIndex(
 		const uint64_t templates_count,
 		const int search_threads_count = 1,
@@ -561,447 +798,2050 @@ public:
 	/**
 		\~English
 		\brief
-			Choose templates set that best represent original templates.
+			Search for the k nearest Templates in the TemplatesIndex
+			and write the results into the caller-owned buffer.
+			Does not allocate memory if the buffer already has enough memory
+			for queries_templates.size() queries with k results each.
 
-		\param[in]  set_size
-			Required set size.
+		\param[in]  queries_templates
+			Vector of queries.
 
-		\param[in]  templates
-			Original templates.
+		\param[in]  templates_index
+			TemplatesIndex for search.
 
-		\param[in]  inviolable_templates_indexes
-			Indexes of templates, required to be included in the result set.
+		\param[in]  k
+			Count of the nearest templates for search.
 
-		\return
-			Indexes of templates that make up the result set.
+		\param[out]  result
+			Buffer for the results, its previous content is overwritten.
+			result.size(i) is min(k, templates_index.size()).
+
+		\param[in]  acceleration
+			Acceleration type.
 
 		\~Russian
 		\brief
-			Выбрать набор шаблонов, представляющий оригинальные шаблоны наилучшим образом.
+			Поиск k ближайших шаблонов в индексе
+			с записью результатов в принадлежащий вызывающему буфер.
+			Не выделяет память, если в буфере уже достаточно памяти
+			для queries_templates.size() запросов по k результатов.
 
-		\param[in]  set_size
-			Требуемый размер набора.
+		\param[in]  queries_templates
+			Вектор запросных шаблонов.
 
-		\param[in]  templates
-			Оригинальные шаблоны.
+		\param[in]  templates_index
+			Индекс для поиска.
 
-		\param[in]  inviolable_templates_indexes
-			Индексы шаблонов, которых необходимо включить в набор.
+		\param[in]  k
+			Количество ближайших шаблонов для поиска.
 
-		\return
-			Индексы шаблонов, составляющих результирующий набор.
+		\param[out]  result
+			Буфер для результатов, его предыдущее содержимое перезаписывается.
+			result.size(i) равен min(k, templates_index.size()).
+
+		\param[in]  acceleration
+			Тип ускорения поиска.
 	*/
-	std::vector<size_t> chooseRepresentativeTemplatesSet(
-		const size_t set_size,
-		const std::vector<pbio::Template::Ptr> &templates,
-		const std::vector<size_t> &inviolable_templates_indexes = std::vector<size_t>());
+	void search(
+		const std::vector<pbio::Template::Ptr> &queries_templates,
+		const pbio::TemplatesIndex &templates_index,
+		const size_t k,
+		SearchResultBuffer &result,
+		const SearchAccelerationType acceleration = SEARCH_ACCELERATION_1) const;
 
-private:
+	/**
+		\~English
+		\brief
+			Search for the k nearest Templates of one query in the TemplatesIndex
+			and write the results into the caller-owned buffer (with one row).
 
-	Recognizer(
-		const DHPtr &dll_handle,
-		void* impl);
+		\~Russian
+		\brief
+			Поиск k ближайших шаблонов одного запроса в индексе
+			с записью результатов в принадлежащий вызывающему буфер (с одной строкой).
+	*/
+	void search(
+		const pbio::Template &query_template,
+		const pbio::TemplatesIndex &templates_index,
+		const size_t k,
+		SearchResultBuffer &result,
+		const SearchAccelerationType acceleration = SEARCH_ACCELERATION_1) const;
 
-	friend class FacerecService;
-	friend class object_with_ref_counter<Recognizer>;
-};
+	/**
+		\~English
+		\brief
+			Search for the k nearest Templates among the templates allowed by the filter.
+			The result is the same as the k first allowed templates of the search
+			with k = templates_index.size(), without post-filtering losses.
+			The full index is searched for about 2 * k * size / (count of the allowed templates)
+			results per query, and the search is repeated with a doubled k until
+			every query has k allowed results or the whole index is searched,
+			so the cost grows as the filter narrows and reaches a search of the whole index.
+			For a narrow filter or a filter used for several searches, create the index
+			of the allowed templates once with createFilteredIndex and search it with
+			searchFiltered(queries_templates, filtered_index, ...), every such search costs
+			as a search in the allowed templates only.
 
-}  // pbio namespace
+		\param[in]  queries_templates
+			Vector of queries.
 
+		\param[in]  templates_index
+			TemplatesIndex for search.
 
+		\param[in]  k
+			Count of the nearest templates for search.
 
-////////////////////////
-/////IMPLEMENTATION/////
-////////////////////////
+		\param[in]  allowed_bitmap
+			Filter: the i-th template is allowed if the bit (i % 64) of allowed_bitmap[i / 64] is set,
+			must have at least (templates_index.size() + 63) / 64 elements.
 
-namespace pbio
-{
+		\param[out]  result
+			Buffer for the results, its previous content is overwritten.
+			result.size(i) is min(k, count of the allowed templates).
 
-inline
-Recognizer::Recognizer(
-	const DHPtr &dll_handle,
-	void* impl):
-ComplexObject(dll_handle, impl)
-{
-	// nothing else
-}
+		\param[in]  acceleration
+			Acceleration type.
 
+		\~Russian
+		\brief
+			Поиск k ближайших шаблонов среди шаблонов, разрешенных фильтром.
+			Результат совпадает с k первыми разрешенными шаблонами поиска
+			с k = templates_index.size(), без потерь фильтрации после поиска.
+			В полном индексе ищется около 2 * k * size / (количество разрешенных шаблонов)
+			результатов для каждого запроса, и поиск повторяется с удвоенным k, пока
+			у каждого запроса не будет k разрешенных результатов или не будет просмотрен весь индекс,
+			поэтому стоимость растет с сужением фильтра вплоть до поиска по всему индексу.
+			Для узкого фильтра или фильтра, используемого в нескольких поисках, создайте индекс
+			разрешенных шаблонов один раз с помощью createFilteredIndex и выполняйте поиск в нем с помощью
+			searchFiltered(queries_templates, filtered_index, ...), каждый такой поиск стоит
+			как поиск только в разрешенных шаблонах.
 
-inline
-std::string Recognizer::getMethodName() const
-{
-	std::ostringstream name_stream;
-	pbio::stl_wraps::WrapOStreamImpl name_stream_wrap(name_stream);
+		\param[in]  queries_templates
+			Вектор запросных шаблонов.
 
-	void* exception = NULL;
+		\param[in]  templates_index
+			Индекс для поиска.
 
-	_dll_handle->Recognizer_getMethodName(
-		_impl,
-		&name_stream_wrap,
-		pbio::stl_wraps::WrapOStream::write_func,
-		&exception);
+		\param[in]  k
+			Количество ближайших шаблонов для поиска.
 
-	checkException(exception, *_dll_handle);
+		\param[in]  allowed_bitmap
+			Фильтр: i-й шаблон разрешен, если установлен бит (i % 64) в allowed_bitmap[i / 64],
+			должен содержать не менее (templates_index.size() + 63) / 64 элементов.
 
-	return name_stream.str();
-}
+		\param[out]  result
+			Буфер для результатов, его предыдущее содержимое перезаписывается.
+			result.size(i) равен min(k, количество разрешенных шаблонов).
 
+		\param[in]  acceleration
+			Тип ускорения поиска.
+	*/
+	void searchFiltered(
+		const std::vector<pbio::Template::Ptr> &queries_templates,
+		const pbio::TemplatesIndex &templates_index,
+		const size_t k,
+		const std::vector<uint64_t> &allowed_bitmap,
+		SearchResultBuffer &result,
+		const SearchAccelerationType acceleration = SEARCH_ACCELERATION_1) const;
 
-inline
-Template::Ptr Recognizer::processing(
-	const RawSample &sample) const
-{
-	void* exception = NULL;
+	/**
+		\~English
+		\brief
+			Search for the k nearest Templates among the templates with indexes i
+			for which allowed(i) is true (see searchFiltered with a bitmap).
+			allowed is called once for every template of the index.
 
-	void* const result_impl = _dll_handle->Recognizer_processing(
-		_impl,
-		(const pbio::facerec::RawSampleImpl*) sample._impl,
-		&exception);
+		\~Russian
+		\brief
+			Поиск k ближайших шаблонов среди шаблонов с индексами i,
+			для которых allowed(i) истинно (см. searchFiltered с битовой картой).
+			allowed вызывается один раз для каждого шаблона индекса.
+	*/
+	template<typename Predicate>
+	void searchFiltered(
+		const std::vector<pbio::Template::Ptr> &queries_templates,
+		const pbio::TemplatesIndex &templates_index,
+		const size_t k,
+		const Predicate &allowed,
+		SearchResultBuffer &result,
+		const SearchAccelerationType acceleration = SEARCH_ACCELERATION_1) const;
 
-	checkException(exception, *_dll_handle);
+	/**
+		\~English
+		\brief
+			Create an index of the templates allowed by the filter for the repeated search
+			with searchFiltered. The allowed templates are copied from templates_index.
+			The total size of all indexes is limited by the license.
+
+		\param[in]  templates_index
+			Full index.
+
+		\param[in]  allowed_bitmap
+			Filter: the i-th template is allowed if the bit (i % 64) of allowed_bitmap[i / 64] is set,
+			must have at least (templates_index.size() + 63) / 64 elements.
+
+		\param[in]  search_threads_count
+			Count of threads that will be used while searching in the created index.
+
+		\~Russian
+		\brief
+			Создать индекс шаблонов, разрешенных фильтром, для повторного поиска
+			с помощью searchFiltered. Разрешенные шаблоны копируются из templates_index.
+			Суммарный размер всех индексов ограничен лицензией.
+
+		\param[in]  templates_index
+			Полный индекс.
+
+		\param[in]  allowed_bitmap
+			Фильтр: i-й шаблон разрешен, если установлен бит (i % 64) в allowed_bitmap[i / 64],
+			должен содержать не менее (templates_index.size() + 63) / 64 элементов.
+
+		\param[in]  search_threads_count
+			Количество потоков для использования во время поиска в созданном индексе.
+	*/
+	FilteredTemplatesIndex::Ptr createFilteredIndex(
+		const pbio::TemplatesIndex &templates_index,
+		const std::vector<uint64_t> &allowed_bitmap,
+		const int search_threads_count = 1) const;
+
+	/**
+		\~English
+		\brief
+			Search for the k nearest Templates in the index of the allowed templates,
+			indexes in the result are the indexes in the full index.
+			result.size(i) is min(k, filtered_index.size()).
+
+		\~Russian
+		\brief
+			Поиск k ближайших шаблонов в индексе разрешенных шаблонов,
+			индексы в результате - индексы в полном индексе.
+			result.size(i) равен min(k, filtered_index.size()).
+	*/
+	void searchFiltered(
+		const std::vector<pbio::Template::Ptr> &queries_templates,
+		const pbio::FilteredTemplatesIndex &filtered_index,
+		const size_t k,
+		SearchResultBuffer &result,
+		const SearchAccelerationType acceleration = SEARCH_ACCELERATION_1) const;
+
+	/**
+		\~English
+		\brief
+			Search for all Templates in the TemplatesIndex with FAR not greater than far_threshold
+			(FAR grows with the distance, so these are the nearest templates).
+			A query is complete when its last result is above the threshold or the whole index is searched,
+			only the incomplete queries are searched again with a doubled k.
+
+		\param[in]  queries_templates
+			Vector of queries.
+
+		\param[in]  templates_index
+			TemplatesIndex for search.
+
+		\param[in]  far_threshold
+			FAR threshold, see getROCCurvePointByDistanceThreshold for the conversion from the distance.
+
+		\param[out]  result
+			Buffer for the results, its previous content is overwritten.
+			result.k() is the max count of matches of a query,
+			result.size(i) is the count of matches of the i-th query.
+
+		\param[in]  acceleration
+			Acceleration type.
+
+		\~Russian
+		\brief
+			Поиск всех шаблонов в индексе с FAR не больше far_threshold
+			(FAR растет с расстоянием, поэтому это ближайшие шаблоны).
+			Запрос завершен, когда его последний результат выше порога или просмотрен весь индекс,
+			повторный поиск с удвоенным k выполняется только для незавершенных запросов.
+
+		\param[in]  queries_templates
+			Вектор запросных шаблонов.
+
+		\param[in]  templates_index
+			Индекс для поиска.
+
+		\param[in]  far_threshold
+			Порог FAR, преобразование из расстояния см. в getROCCurvePointByDistanceThreshold.
+
+		\param[out]  result
+			Буфер для результатов, его предыдущее содержимое перезаписывается.
+			result.k() - максимальное количество совпадений одного запроса,
+			result.size(i) - количество совпадений i-го запроса.
+
+		\param[in]  acceleration
+			Тип ускорения поиска.
+	*/
+	void searchRange(
+		const std::vector<pbio::Template::Ptr> &queries_templates,
+		const pbio::TemplatesIndex &templates_index,
+		const double far_threshold,
+		SearchResultBuffer &result,
+		const SearchAccelerationType acceleration = SEARCH_ACCELERATION_1) const;
+
+	/**
+		\~English
+		\brief
+			Search for all Templates in the TemplatesIndex with FAR not greater than far_threshold
+			(see searchRange with a buffer), callback(query_index, search_result) is called
+			for the matches of a query as soon as the query is complete, so the matches are not buffered
+			and the queries with fewer matches come first.
+			The matches of a query are passed consecutively in ascending order of distance.
+
+		\~Russian
+		\brief
+			Поиск всех шаблонов в индексе с FAR не больше far_threshold
+			(см. searchRange с буфером), callback(query_index, search_result) вызывается
+			для совпадений запроса, как только запрос завершен, поэтому совпадения не накапливаются,
+			и запросы с меньшим количеством совпадений идут первыми.
+			Совпадения одного запроса передаются подряд в порядке возрастания расстояния.
+	*/
+	template<typename Callback>
+	void searchRange(
+		const std::vector<pbio::Template::Ptr> &queries_templates,
+		const pbio::TemplatesIndex &templates_index,
+		const double far_threshold,
+		const Callback &callback,
+		const SearchAccelerationType acceleration = SEARCH_ACCELERATION_1) const;
+
+	/**
+		\~English
+		\brief
+			Search for all Templates in the TemplatesIndex with FAR not greater than far_threshold
+			for one query (see searchRange with a buffer).
+
+		\return
+			Matches in ascending order of distance.
+
+		\~Russian
+		\brief
+			Поиск всех шаблонов в индексе с FAR не больше far_threshold
+			для одного запроса (см. searchRange с буфером).
+
+		\return
+			Совпадения в порядке возрастания расстояния.
+	*/
+	std::vector<SearchResult> searchRange(
+		const pbio::Template::Ptr &query_template,
+		const pbio::TemplatesIndex &templates_index,
+		const double far_threshold,
+		const SearchAccelerationType acceleration = SEARCH_ACCELERATION_1) const;
+
+	/**
+		\~English
+		\brief
+			Self-join of the index: search for the pairs of likely duplicates among its templates.
+			Every template of the index is a query, the queries are split into blocks of 256,
+			every block is searched with one batched search for the k nearest templates,
+			the pairs with FAR not greater than far_threshold are returned.
+			The blocks are searched one after another in templates_index,
+			the search of a block is parallelized by the library in search_threads_count threads
+			of the index (see createIndex), so create the index with the count of threads to use.
+
+		\param[in]  templates_index
+			TemplatesIndex to deduplicate.
+
+		\param[in]  k
+			Max count of duplicates of one template.
+
+		\param[in]  far_threshold
+			FAR threshold of a duplicate.
+
+		\param[in]  acceleration
+			Acceleration type.
+
+		\return
+			Pairs of duplicates (i < j) in ascending order of i, then j.
+
+		\~Russian
+		\brief
+			Самообъединение индекса: поиск пар вероятных дубликатов среди его шаблонов.
+			Каждый шаблон индекса является запросом, запросы разбиваются на блоки по 256,
+			поиск k ближайших шаблонов для каждого блока выполняется одним пакетным поиском,
+			возвращаются пары с FAR не больше far_threshold.
+			Блоки обрабатываются один за другим в templates_index,
+			поиск блока распараллеливается библиотекой в search_threads_count потоках
+			индекса (см. createIndex), поэтому создавайте индекс с нужным количеством потоков.
+
+		\param[in]  templates_index
+			Индекс для поиска дубликатов.
+
+		\param[in]  k
+			Максимальное количество дубликатов одного шаблона.
+
+		\param[in]  far_threshold
+			Порог FAR для дубликата.
+
+		\param[in]  acceleration
+			Тип ускорения поиска.
+
+		\return
+			Пары дубликатов (i < j) в порядке возрастания i, затем j.
+	*/
+	std::vector<DuplicatePair> selfJoin(
+		const pbio::TemplatesIndex &templates_index,
+		const size_t k,
+		const double far_threshold,
+		const SearchAccelerationType acceleration = SEARCH_ACCELERATION_1) const;
+
+
+	/**
+		\~English
+		\brief
+			Search for the k nearest Templates in the ShardedTemplatesIndex.
+			Per-shard results are merged, indexes in the result are global indexes
+			in the sharded index (see ShardedTemplatesIndex). Global indexes are computed
+			from the current shard sizes, so they change if a shard before is resized between searches.
+			The search with one recognizer is not parallel, so shards are searched in parallel
+			only if thread_recognizers are passed (created with the same config, one for each additional thread,
+			as in verifyMatchMatrix): shards are distributed between this recognizer and thread_recognizers
+			in the threads of sharded_index.threadPool(). Otherwise shards are searched in the calling thread.
+			Does not allocate memory if the buffer already has enough memory
+			(see SearchResultBuffer::reserve with shards_count).
+
+		\param[in]  queries_templates
+			Vector of queries.
+
+		\param[in]  sharded_index
+			ShardedTemplatesIndex for search.
+
+		\param[in]  k
+			Count of the nearest templates for search.
+
+		\param[out]  result
+			Buffer for the results, its previous content is overwritten.
+			result.size(i) is min(k, sharded_index.size()).
+
+		\param[in]  acceleration
+			Acceleration type, used for the search in every shard.
+
+		\param[in]  thread_recognizers
+			Recognizers for the additional threads of sharded_index.threadPool().
+
+		\~Russian
+		\brief
+			Поиск k ближайших шаблонов в составном индексе ShardedTemplatesIndex.
+			Результаты частей объединяются, индексы в результате - глобальные индексы
+			в составном индексе (см. ShardedTemplatesIndex). Глобальные индексы вычисляются
+			по текущим размерам частей, поэтому они меняются, если размер предшествующей части изменился между поисками.
+			Поиск одним распознавателем не параллельный, поэтому поиск в частях выполняется параллельно,
+			только если переданы thread_recognizers (созданные с такой же конфигурацией, по одному на каждый дополнительный поток,
+			как в verifyMatchMatrix): части распределяются между этим распознавателем и thread_recognizers
+			в потоках sharded_index.threadPool(). Иначе поиск в частях выполняется в вызывающем потоке.
+			Не выделяет память, если в буфере уже достаточно памяти
+			(см. SearchResultBuffer::reserve с shards_count).
+
+		\param[in]  queries_templates
+			Вектор запросных шаблонов.
+
+		\param[in]  sharded_index
+			Составной индекс для поиска.
+
+		\param[in]  k
+			Количество ближайших шаблонов для поиска.
+
+		\param[out]  result
+			Буфер для результатов, его предыдущее содержимое перезаписывается.
+			result.size(i) равен min(k, sharded_index.size()).
+
+		\param[in]  acceleration
+			Тип ускорения поиска, используется для поиска в каждом индексе-части.
+
+		\param[in]  thread_recognizers
+			Распознаватели для дополнительных потоков sharded_index.threadPool().
+	*/
+	void search(
+		const std::vector<pbio::Template::Ptr> &queries_templates,
+		const pbio::ShardedTemplatesIndex &sharded_index,
+		const size_t k,
+		SearchResultBuffer &result,
+		const SearchAccelerationType acceleration = SEARCH_ACCELERATION_1,
+		const std::vector<Recognizer::Ptr> &thread_recognizers = std::vector<Recognizer::Ptr>()) const;
+
+	/**
+		\~English
+		\brief
+			Search for the k nearest Templates of one query in the ShardedTemplatesIndex
+			and write the results into the caller-owned buffer (with one row).
+
+		\~Russian
+		\brief
+			Поиск k ближайших шаблонов одного запроса в составном индексе ShardedTemplatesIndex
+			с записью результатов в принадлежащий вызывающему буфер (с одной строкой).
+	*/
+	void search(
+		const pbio::Template &query_template,
+		const pbio::ShardedTemplatesIndex &sharded_index,
+		const size_t k,
+		SearchResultBuffer &result,
+		const SearchAccelerationType acceleration = SEARCH_ACCELERATION_1,
+		const std::vector<Recognizer::Ptr> &thread_recognizers = std::vector<Recognizer::Ptr>()) const;
+
+	/**
+		\~English
+		\brief
+			Search for the k nearest Templates in the ShardedTemplatesIndex,
+			SearchResult::i is the global index in the sharded index.
+
+		\~Russian
+		\brief
+			Поиск k ближайших шаблонов в составном индексе ShardedTemplatesIndex,
+			SearchResult::i - глобальный индекс в составном индексе.
+	*/
+	std::vector<std::vector<SearchResult> > search(
+		const std::vector<pbio::Template::Ptr> &queries_templates,
+		const pbio::ShardedTemplatesIndex &sharded_index,
+		const size_t k,
+		const SearchAccelerationType acceleration = SEARCH_ACCELERATION_1,
+		const std::vector<Recognizer::Ptr> &thread_recognizers = std::vector<Recognizer::Ptr>()) const;
+
+
+	/**
+		\~English
+		\brief
+			Choose templates set that best represent original templates.
+
+		\param[in]  set_size
+			Required set size.
+
+		\param[in]  templates
+			Original templates.
+
+		\param[in]  inviolable_templates_indexes
+			Indexes of templates, required to be included in the result set.
+
+		\return
+			Indexes of templates that make up the result set.
+
+		\~Russian
+		\brief
+			Выбрать набор шаблонов, представляющий оригинальные шаблоны наилучшим образом.
+
+		\param[in]  set_size
+			Требуемый размер набора.
+
+		\param[in]  templates
+			Оригинальные шаблоны.
+
+		\param[in]  inviolable_templates_indexes
+			Индексы шаблонов, которых необходимо включить в набор.
+
+		\return
+			Индексы шаблонов, составляющих результирующий набор.
+	*/
+	std::vector<size_t> chooseRepresentativeTemplatesSet(
+		const size_t set_size,
+		const std::vector<pbio::Template::Ptr> &templates,
+		const std::vector<size_t> &inviolable_templates_indexes = std::vector<size_t>());
+
+	/**
+		\~English
+		\brief
+			Choose templates set that best represent original templates,
+			parallel version for large template sets.
+			Templates are split into chunks of chunk_size, a set of set_size templates is chosen
+			in every chunk in parallel, the chosen templates are split into chunks again
+			until they fit into one chunk, the result set is chosen from them.
+			Chunks are distributed between this recognizer and thread_recognizers
+			in the threads of thread_pool (see verifyMatchMatrix).
+			Inviolable templates are kept in every step.
+			The result is approximate: a template dropped in its chunk is not considered again,
+			so the set differs from the set chosen by chooseRepresentativeTemplatesSet
+			without chunks for the same templates.
+
+		\param[in]  set_size
+			Required set size.
+
+		\param[in]  templates
+			Original templates.
+
+		\param[in]  inviolable_templates_indexes
+			Indexes of templates, required to be included in the result set.
+
+		\param[in]  chunk_size
+			Count of templates processed by one call of chooseRepresentativeTemplatesSet,
+			must be greater than set_size.
+
+		\param[in]  thread_pool
+			Pool for the parallel processing of chunks, if NULL, chunks are processed in the calling thread.
+
+		\param[in]  thread_recognizers
+			Recognizers for the additional threads of the pool.
+
+		\return
+			Indexes of templates that make up the result set.
+
+		\~Russian
+		\brief
+			Выбрать набор шаблонов, представляющий оригинальные шаблоны наилучшим образом,
+			параллельная версия для больших наборов шаблонов.
+			Шаблоны разбиваются на части по chunk_size, в каждой части параллельно выбирается
+			набор из set_size шаблонов, выбранные шаблоны снова разбиваются на части,
+			пока не поместятся в одну часть, из них выбирается результирующий набор.
+			Части распределяются между этим распознавателем и thread_recognizers
+			в потоках thread_pool (см. verifyMatchMatrix).
+			Неприкосновенные шаблоны сохраняются на каждом шаге.
+			Результат приближенный: шаблон, отброшенный в своей части, больше не рассматривается,
+			поэтому набор отличается от набора, выбранного chooseRepresentativeTemplatesSet
+			без разбиения на части для тех же шаблонов.
+
+		\param[in]  set_size
+			Требуемый размер набора.
+
+		\param[in]  templates
+			Оригинальные шаблоны.
+
+		\param[in]  inviolable_templates_indexes
+			Индексы шаблонов, которых необходимо включить в набор.
+
+		\param[in]  chunk_size
+			Количество шаблонов, обрабатываемых одним вызовом chooseRepresentativeTemplatesSet,
+			должно быть больше set_size.
+
+		\param[in]  thread_pool
+			Пул для параллельной обработки частей, если NULL, части обрабатываются в вызывающем потоке.
+
+		\param[in]  thread_recognizers
+			Распознаватели для дополнительных потоков пула.
+
+		\return
+			Индексы шаблонов, составляющих результирующий набор.
+	*/
+	std::vector<size_t> chooseRepresentativeTemplatesSet(
+		const size_t set_size,
+		const std::vector<pbio::Template::Ptr> &templates,
+		const std::vector<size_t> &inviolable_templates_indexes,
+		const size_t chunk_size,
+		const pbio::ThreadPool::Ptr &thread_pool,
+		const std::vector<Recognizer::Ptr> &thread_recognizers = std::vector<Recognizer::Ptr>());
+
+	/**
+		\~English
+		\brief
+			Update the representative templates set with new templates without the templates
+			collected before: the set is chosen from representative_templates and new_templates
+			by chooseRepresentativeTemplatesSet. The call costs the same as a full
+			chooseRepresentativeTemplatesSet for representative_templates.size() + new_templates.size()
+			templates, it only saves keeping and processing the dropped templates. The result is approximate:
+			it differs from the set chosen from all templates collected so far.
+
+		\param[in]  set_size
+			Required set size.
+
+		\param[in]  representative_templates
+			Current representative set.
+
+		\param[in]  new_templates
+			Templates collected since the current set was chosen.
+
+		\param[in]  inviolable_templates_indexes
+			Indexes of templates in representative_templates, required to be included in the result set.
+
+		\return
+			Indexes of templates that make up the result set:
+			i < representative_templates.size() is representative_templates[i],
+			otherwise it is new_templates[i - representative_templates.size()].
+
+		\~Russian
+		\brief
+			Обновить представительный набор шаблонов новыми шаблонами без ранее собранных
+			шаблонов: набор выбирается из representative_templates и new_templates
+			с помощью chooseRepresentativeTemplatesSet. Вызов стоит столько же, сколько полный
+			chooseRepresentativeTemplatesSet для representative_templates.size() + new_templates.size()
+			шаблонов, экономится только хранение и обработка отброшенных шаблонов. Результат приближенный:
+			он отличается от набора, выбранного из всех собранных шаблонов.
+
+		\param[in]  set_size
+			Требуемый размер набора.
+
+		\param[in]  representative_templates
+			Текущий представительный набор.
+
+		\param[in]  new_templates
+			Шаблоны, собранные после выбора текущего набора.
+
+		\param[in]  inviolable_templates_indexes
+			Индексы шаблонов в representative_templates, которых необходимо включить в набор.
+
+		\return
+			Индексы шаблонов, составляющих результирующий набор:
+			i < representative_templates.size() - это representative_templates[i],
+			иначе это new_templates[i - representative_templates.size()].
+	*/
+	std::vector<size_t> updateRepresentativeTemplatesSet(
+		const size_t set_size,
+		const std::vector<pbio::Template::Ptr> &representative_templates,
+		const std::vector<pbio::Template::Ptr> &new_templates,
+		const std::vector<size_t> &inviolable_templates_indexes = std::vector<size_t>());
+
+private:
+
+	Recognizer(
+		const DHPtr &dll_handle,
+		void* impl);
+
+	void checkGalleryMethod(const pbio::PackedGallery &gallery) const;
+
+	// computes the tile of the matrix of verifyMatchMatrix
+	void verifyMatchTile(
+		const std::vector<pbio::Template::Ptr> &queries,
+		const std::vector<pbio::Template::Ptr> &gallery,
+		const size_t queries_begin,
+		const size_t queries_end,
+		const size_t gallery_begin,
+		const size_t gallery_end,
+		float* const out_distances,
+		float* const out_scores) const;
+
+	// loads the template from the slot of the packed templates
+	void* loadTemplateImpl(const char* const data, const size_t template_stride) const;
+
+	// search of result._queries
+	void searchIntoBuffer(
+		const pbio::TemplatesIndex &templates_index,
+		const size_t k,
+		SearchResultBuffer &result,
+		const SearchAccelerationType acceleration) const;
+
+	// search of all matches of result._queries with FAR not greater than far_threshold,
+	// on_complete(query_index, row, matches_count) is called for every query as soon as it is complete,
+	// its matches are result._shard_columns[row, row + matches_count),
+	// result._queries is reordered while the complete queries are removed from it
+	template<typename OnComplete>
+	void searchRangeIntoBuffer(
+		const pbio::TemplatesIndex &templates_index,
+		const double far_threshold,
+		SearchResultBuffer &result,
+		const SearchAccelerationType acceleration,
+		const OnComplete &on_complete) const;
+
+	// search of result._queries in the index of the allowed templates, indexes are mapped to the full index
+	void searchIntoBuffer(
+		const pbio::FilteredTemplatesIndex &filtered_index,
+		const size_t k,
+		SearchResultBuffer &result,
+		const SearchAccelerationType acceleration) const;
+
+	// search of result._queries in one shard, results are written to columns starting at offset
+	void searchIntoColumns(
+		const pbio::TemplatesIndex &templates_index,
+		const size_t k,
+		const SearchResultBuffer &result,
+		SearchResultBuffer::Columns &columns,
+		const size_t offset,
+		const SearchAccelerationType acceleration) const;
+
+	// search of result._queries in the shards and merge of the results
+	void searchIntoBuffer(
+		const pbio::ShardedTemplatesIndex &sharded_index,
+		const size_t k,
+		SearchResultBuffer &result,
+		const SearchAccelerationType acceleration,
+		const std::vector<Recognizer::Ptr> &thread_recognizers) const;
+
+	friend class FacerecService;
+	friend class object_with_ref_counter<Recognizer>;
+};
+
+}  // pbio namespace
+
+
+
+////////////////////////
+/////IMPLEMENTATION/////
+////////////////////////
+
+namespace pbio
+{
+
+inline
+Recognizer::Recognizer(
+	const DHPtr &dll_handle,
+	void* impl):
+ComplexObject(dll_handle, impl)
+{
+	// nothing else
+}
+
+
+inline
+std::string Recognizer::getMethodName() const
+{
+	std::ostringstream name_stream;
+	pbio::stl_wraps::WrapOStreamImpl name_stream_wrap(name_stream);
+
+	void* exception = NULL;
+
+	_dll_handle->Recognizer_getMethodName(
+		_impl,
+		&name_stream_wrap,
+		pbio::stl_wraps::WrapOStream::write_func,
+		&exception);
+
+	checkException(exception, *_dll_handle);
+
+	return name_stream.str();
+}
+
+
+inline
+Template::Ptr Recognizer::processing(
+	const RawSample &sample) const
+{
+	void* exception = NULL;
+
+	void* const result_impl = _dll_handle->Recognizer_processing(
+		_impl,
+		(const pbio::facerec::RawSampleImpl*) sample._impl,
+		&exception);
+
+	checkException(exception, *_dll_handle);
+
+	return Template::Ptr::make(_dll_handle, result_impl);
+}
+
+
+inline
+Template::Ptr Recognizer::loadTemplate(std::istream &binary_stream) const
+{
+	pbio::stl_wraps::WrapIStreamImpl binary_stream_wrap(binary_stream);
+
+	return loadTemplate(binary_stream_wrap);
+}
+
+inline
+Template::Ptr Recognizer::loadTemplate(pbio::stl_wraps::WrapIStream &binary_stream) const
+{
+	void* exception = NULL;
+
+	void* const result_impl = _dll_handle->Recognizer_loadTemplate(
+		_impl,
+		&binary_stream,
+		pbio::stl_wraps::WrapIStream::read_func,
+		&exception);
+
+	checkException(exception, *_dll_handle);
+
+	return Template::Ptr::make(_dll_handle, result_impl);
+}
+
+
+inline
+Template::Ptr Recognizer::loadTemplate(
+	const void* const data,
+	const int size) const
+{
+	void* exception = NULL;
+
+	pbio::stl_wraps::WrapIStreamBufferImpl input_stream((const char*) data, size);
+
+	void* const result_impl = _dll_handle->Recognizer_loadTemplate(
+		_impl,
+		&input_stream,
+		pbio::stl_wraps::WrapIStream::read_func,
+		&exception);
+
+	checkException(exception, *_dll_handle);
 
 	return Template::Ptr::make(_dll_handle, result_impl);
 }
 
 
 inline
-Template::Ptr Recognizer::loadTemplate(std::istream &binary_stream) const
+void* Recognizer::loadTemplateImpl(const char* const data, const size_t template_stride) const
+{
+	void* exception = NULL;
+
+	pbio::stl_wraps::WrapIStreamBufferImpl input_stream(data, (int) template_stride);
+
+	void* const result_impl = _dll_handle->Recognizer_loadTemplate(
+		_impl,
+		&input_stream,
+		pbio::stl_wraps::WrapIStream::read_func,
+		&exception);
+
+	checkException(exception, *_dll_handle);
+
+	return result_impl;
+}
+
+
+inline
+std::vector<Template::Ptr> Recognizer::loadTemplates(
+	const void* const data,
+	const size_t template_stride,
+	const size_t count) const
+{
+	std::vector<Template::Ptr> result;
+	result.reserve(count);
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		void* const result_impl = loadTemplateImpl((const char*) data + i * template_stride, template_stride);
+
+		result.push_back(Template::Ptr::make(_dll_handle, result_impl));
+	}
+
+	return result;
+}
+
+
+inline
+Recognizer::MatchResult Recognizer::verifyMatch(
+	const Template &template1,
+	const Template &template2) const
+{
+	MatchResult result;
+
+	void* exception = NULL;
+
+	_dll_handle->Recognizer_verifyMatch_v2(
+		_impl,
+		(const pbio::facerec::TemplateImpl*) template1._impl,
+		(const pbio::facerec::TemplateImpl*) template2._impl,
+		&result.distance,
+		&result.fa_r,
+		&result.fr_r,
+		&result.score,
+		&exception);
+
+	checkException(exception, *_dll_handle);
+
+	return result;
+}
+
+inline
+Expected<Recognizer::MatchResult> Recognizer::tryVerifyMatch(
+	const Template &template1,
+	const Template &template2) const noexcept
+{
+	MatchResult result;
+
+	void* exception = NULL;
+
+	_dll_handle->Recognizer_verifyMatch_v2(
+		_impl,
+		(const pbio::facerec::TemplateImpl*) template1._impl,
+		(const pbio::facerec::TemplateImpl*) template2._impl,
+		&result.distance,
+		&result.fa_r,
+		&result.fr_r,
+		&result.score,
+		&exception);
+
+	const Status status = exceptionStatus(exception, *_dll_handle);
+
+	if(!status.ok())
+		return status;
+
+	return result;
+}
+
+inline
+void Recognizer::verifyMatchMatrix(
+	const std::vector<pbio::Template::Ptr> &queries,
+	const std::vector<pbio::Template::Ptr> &gallery,
+	float* const out_distances,
+	float* const out_scores,
+	const pbio::ThreadPool::Ptr &thread_pool,
+	const std::vector<Recognizer::Ptr> &thread_recognizers) const
+{
+	const size_t queries_block = 16;
+	const size_t gallery_block = 256;
+
+	const size_t queries_blocks_count = (queries.size() + queries_block - 1) / queries_block;
+	const size_t gallery_blocks_count = (gallery.size() + gallery_block - 1) / gallery_block;
+	const size_t tiles_count = queries_blocks_count * gallery_blocks_count;
+
+	std::atomic<size_t> next_tile(0);
+	std::atomic<bool> failed(false);
+
+	// the w-th worker uses its own recognizer and takes the tiles one by one
+	const auto worker = [&](const size_t w)
+	{
+		const Recognizer &recognizer = w == 0 ? *this : *thread_recognizers[w - 1];
+
+		try
+		{
+			for(size_t tile = next_tile++; tile < tiles_count && !failed; tile = next_tile++)
+			{
+				const size_t queries_begin = (tile / gallery_blocks_count) * queries_block;
+				const size_t gallery_begin = (tile % gallery_blocks_count) * gallery_block;
+
+				recognizer.verifyMatchTile(
+					queries,
+					gallery,
+					queries_begin,
+					(std::min)(queries_begin + queries_block, queries.size()),
+					gallery_begin,
+					(std::min)(gallery_begin + gallery_block, gallery.size()),
+					out_distances,
+					out_scores);
+			}
+		}
+		catch(...)
+		{
+			failed = true;
+			throw;
+		}
+	};
+
+	if(thread_pool && !thread_recognizers.empty() && tiles_count > 1)
+		thread_pool->parallelFor((std::min)(thread_recognizers.size() + 1, tiles_count), worker);
+	else
+		worker(0);
+}
+
+
+inline
+void Recognizer::verifyMatchMatrix(
+	const std::vector<pbio::Template::Ptr> &queries,
+	const std::vector<pbio::Template::Ptr> &gallery,
+	std::vector<float> &out_scores,
+	const pbio::ThreadPool::Ptr &thread_pool,
+	const std::vector<Recognizer::Ptr> &thread_recognizers) const
+{
+	out_scores.resize(queries.size() * gallery.size());
+
+	verifyMatchMatrix(queries, gallery, NULL, out_scores.data(), thread_pool, thread_recognizers);
+}
+
+
+inline
+void Recognizer::verifyMatchTile(
+	const std::vector<pbio::Template::Ptr> &queries,
+	const std::vector<pbio::Template::Ptr> &gallery,
+	const size_t queries_begin,
+	const size_t queries_end,
+	const size_t gallery_begin,
+	const size_t gallery_end,
+	float* const out_distances,
+	float* const out_scores) const
+{
+	for(size_t i = queries_begin; i < queries_end; ++i)
+	{
+		const pbio::facerec::TemplateImpl* const query = (const pbio::facerec::TemplateImpl*) queries[i]->_impl;
+
+		for(size_t j = gallery_begin; j < gallery_end; ++j)
+		{
+			double distance, fa_r, fr_r, score;
+
+			void* exception = NULL;
+
+			_dll_handle->Recognizer_verifyMatch_v2(
+				_impl,
+				query,
+				(const pbio::facerec::TemplateImpl*) gallery[j]->_impl,
+				&distance,
+				&fa_r,
+				&fr_r,
+				&score,
+				&exception);
+
+			checkException(exception, *_dll_handle);
+
+			const size_t h = i * gallery.size() + j;
+
+			if(out_distances)
+				out_distances[h] = (float) distance;
+
+			if(out_scores)
+				out_scores[h] = (float) score;
+		}
+	}
+}
+
+
+inline
+TemplatesIndex::Ptr Recognizer::createIndex(
+	const std::vector<pbio::Template::Ptr> &templates,
+	const int search_threads_count,
+	const int reserve_queries_count) const
+{
+	std::vector<const pbio::facerec::TemplateImpl*> templates_impls(templates.size());
+
+	for(size_t i = 0; i < templates.size(); ++i)
+		templates_impls[i] = (const pbio::facerec::TemplateImpl*) templates[i]->_impl;
+
+	void* exception = NULL;
+
+	void* const result_impl =
+		_dll_handle->Recognizer_createIndex(
+			_impl,
+			templates.size(),
+			&templates_impls[0],
+			search_threads_count,
+			&exception);
+
+	checkException(exception, *_dll_handle);
+
+	const TemplatesIndex::Ptr result = TemplatesIndex::Ptr::make(_dll_handle, result_impl);
+
+	result->reserveSearchMemory(reserve_queries_count);
+
+	return result;
+}
+
+
+inline TemplatesIndex::Ptr Recognizer::createResizableIndex(
+		const uint64_t templates_count,
+		const int search_threads_count,
+		const int reserve_queries_count) const
+{
+	void* exception = NULL;
+
+	void* const result_impl =
+		_dll_handle->Recognizer_createResizableIndex(
+			_impl,
+			templates_count,
+			search_threads_count,
+			&exception);
+
+	checkException(exception, *_dll_handle);
+
+	const TemplatesIndex::Ptr result = TemplatesIndex::Ptr::make(_dll_handle, result_impl);
+
+	result->reserveSearchMemory(reserve_queries_count);
+
+	return result;
+}
+
+
+inline
+std::vector<Recognizer::SearchResult> Recognizer::search(
+	const pbio::Template &query_template,
+	const pbio::TemplatesIndex &templates_index,
+	const size_t k,
+	const SearchAccelerationType acceleration) const
+{
+	std::vector<int64_t> result_i(k);
+	std::vector<float> result_distance(k);
+	std::vector<float> result_far(k);
+	std::vector<float> result_frr(k);
+	std::vector<float> result_score(k);
+
+	void* exception = NULL;
+
+	_dll_handle->Recognizer_search_v2(
+		_impl,
+		acceleration,
+		1,  // queries_count
+		(const pbio::facerec::TemplateImpl* const*) &query_template._impl,
+		(const pbio::facerec::TemplatesIndexImpl*) templates_index._impl,
+		k,
+		&result_i[0],
+		&result_distance[0],
+		&result_far[0],
+		&result_frr[0],
+		&result_score[0],
+		&exception);
+
+	checkException(exception, *_dll_handle);
+
+	std::vector<SearchResult> result(k);
+	result.reserve(k);
+
+	for(size_t i = 0; i < k; ++i)
+	{
+		if(result_i[i] < 0)
+		{
+			result.resize(i);
+			break;
+		}
+
+		result[i].i = result_i[i];
+		result[i].match_result.distance = result_distance[i];
+		result[i].match_result.fa_r = result_far[i];
+		result[i].match_result.fr_r = result_frr[i];
+		result[i].match_result.score = result_score[i];
+	}
+
+	return result;
+}
+
+
+inline
+std::vector<std::vector<Recognizer::SearchResult> > Recognizer::search(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const pbio::TemplatesIndex &templates_index,
+	const size_t k,
+	const SearchAccelerationType acceleration) const
+{
+	const size_t queries_count = queries_templates.size();
+
+	std::vector<const pbio::facerec::TemplateImpl*> queries_impls(queries_count);
+
+	for(size_t i = 0; i < queries_count; ++i)
+	{
+		queries_impls[i] = (const pbio::facerec::TemplateImpl*) queries_templates[i]->_impl;
+	}
+
+	std::vector<int64_t> result_i(k * queries_count);
+	std::vector<float> result_distance(k * queries_count);
+	std::vector<float> result_far(k * queries_count);
+	std::vector<float> result_frr(k * queries_count);
+	std::vector<float> result_score(k * queries_count);
+
+	void* exception = NULL;
+
+	_dll_handle->Recognizer_search_v2(
+		_impl,
+		acceleration,
+		queries_count,
+		&queries_impls[0],
+		(const pbio::facerec::TemplatesIndexImpl*) templates_index._impl,
+		k,
+		&result_i[0],
+		&result_distance[0],
+		&result_far[0],
+		&result_frr[0],
+		&result_score[0],
+		&exception);
+
+	checkException(exception, *_dll_handle);
+
+	std::vector<std::vector<SearchResult> > result(
+		queries_count,
+		std::vector<SearchResult>(k));
+
+	for(size_t i = 0; i < queries_count; ++i)
+	{
+		for(size_t j = 0; j < k; ++j)
+		{
+			const size_t h = i * k + j;
+
+			if(result_i[h] < 0)
+			{
+				result[i].resize(j);
+				break;
+			}
+
+			result[i][j].i = result_i[h];
+			result[i][j].match_result.distance = result_distance[h];
+			result[i][j].match_result.fa_r = result_far[h];
+			result[i][j].match_result.fr_r = result_frr[h];
+			result[i][j].match_result.score = result_score[h];
+		}
+	}
+
+	return result;
+}
+
+
+
+
+
+inline
+Recognizer::MatchResult Recognizer::getROCCurvePointByDistanceThreshold(
+	const double distance_threshold) const
+{
+	MatchResult result;
+
+	void* exception = NULL;
+
+	_dll_handle->Recognizer_getROCCurvePointByDistanceThreshold_v2(
+		_impl,
+		distance_threshold,
+		&result.distance,
+		&result.fa_r,
+		&result.fr_r,
+		&result.score,
+		&exception);
+
+	checkException(exception, *_dll_handle);
+
+	return result;
+}
+
+inline
+Recognizer::MatchResult Recognizer::getROCCurvePointByFAR(
+	const double desired_far) const
+{
+	MatchResult result;
+
+	void* exception = NULL;
+
+	_dll_handle->Recognizer_getROCCurvePointByFAR_v2(
+		_impl,
+		desired_far,
+		&result.distance,
+		&result.fa_r,
+		&result.fr_r,
+		&result.score,
+		&exception);
+
+	checkException(exception, *_dll_handle);
+
+	return result;
+}
+
+inline
+Recognizer::MatchResult Recognizer::getROCCurvePointByFRR(
+	const double desired_frr) const
+{
+	MatchResult result;
+
+	void* exception = NULL;
+
+	_dll_handle->Recognizer_getROCCurvePointByFRR_v2(
+		_impl,
+		desired_frr,
+		&result.distance,
+		&result.fa_r,
+		&result.fr_r,
+		&result.score,
+		&exception);
+
+	checkException(exception, *_dll_handle);
+
+	return result;
+}
+
+
+inline
+Recognizer::MatchResult Recognizer::getROCCurvePointByScoreThreshold(
+	const double score_threshold) const
+{
+	MatchResult result;
+
+	void* exception = NULL;
+
+	_dll_handle->Recognizer_getROCCurvePointByScoreThreshold(
+		_impl,
+		score_threshold,
+		&result.distance,
+		&result.fa_r,
+		&result.fr_r,
+		&result.score,
+		&exception);
+
+	checkException(exception, *_dll_handle);
+
+	return result;
+}
+
+inline
+void Recognizer::search(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const pbio::TemplatesIndex &templates_index,
+	const size_t k,
+	SearchResultBuffer &result,
+	const SearchAccelerationType acceleration) const
+{
+	result.resize(queries_templates.size(), k);
+
+	for(size_t i = 0; i < queries_templates.size(); ++i)
+		result._queries[i] = queries_templates[i]->_impl;
+
+	searchIntoBuffer(templates_index, k, result, acceleration);
+}
+
+
+inline
+void Recognizer::search(
+	const pbio::Template &query_template,
+	const pbio::TemplatesIndex &templates_index,
+	const size_t k,
+	SearchResultBuffer &result,
+	const SearchAccelerationType acceleration) const
 {
-	pbio::stl_wraps::WrapIStreamImpl binary_stream_wrap(binary_stream);
+	result.resize(1, k);
 
-	return loadTemplate(binary_stream_wrap);
+	result._queries[0] = query_template._impl;
+
+	searchIntoBuffer(templates_index, k, result, acceleration);
 }
 
+
 inline
-Template::Ptr Recognizer::loadTemplate(pbio::stl_wraps::WrapIStream &binary_stream) const
+void Recognizer::searchFiltered(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const pbio::TemplatesIndex &templates_index,
+	const size_t k,
+	const std::vector<uint64_t> &allowed_bitmap,
+	SearchResultBuffer &result,
+	const SearchAccelerationType acceleration) const
 {
-	void* exception = NULL;
+	const size_t index_size = templates_index.size();
 
-	void* const result_impl = _dll_handle->Recognizer_loadTemplate(
-		_impl,
-		&binary_stream,
-		pbio::stl_wraps::WrapIStream::read_func,
-		&exception);
+	if(allowed_bitmap.size() < (index_size + 63) / 64)
+	{
+		throw pbio::Error(0x5b1e7a90, "Error in pbio::Recognizer::searchFiltered: allowed_bitmap is smaller than the index, error code: 0x5b1e7a90.");
+	}
 
-	checkException(exception, *_dll_handle);
+	const size_t queries_count = queries_templates.size();
 
-	return Template::Ptr::make(_dll_handle, result_impl);
+	result.resize(queries_count, k);
+
+	for(size_t i = 0; i < queries_count; ++i)
+		result._queries[i] = queries_templates[i]->_impl;
+
+	size_t allowed_count = 0;
+
+	for(size_t i = 0; i < index_size; ++i)
+		allowed_count += (allowed_bitmap[i / 64] >> (i % 64)) & 1;
+
+	if(queries_count == 0 || k == 0 || allowed_count == 0)
+	{
+		std::fill(result._columns.indexes.begin(), result._columns.indexes.end(), -1);
+
+		result.countValid();
+		return;
+	}
+
+	// about k of search_k nearest templates are allowed
+	size_t search_k = (std::min)(index_size, (std::max)(k, (size_t) (2. * k * index_size / allowed_count)));
+
+	while(true)
+	{
+		result.resizeShards(1, search_k);
+
+		searchIntoColumns(templates_index, search_k, result, result._shard_columns, 0, acceleration);
+
+		bool complete = true;
+
+		for(size_t q = 0; q < queries_count; ++q)
+		{
+			const size_t row = q * search_k;
+
+			size_t size = 0;
+			size_t j = 0;
+
+			for(; j < search_k && size < k && result._shard_columns.indexes[row + j] >= 0; ++j)
+			{
+				const int64_t index = result._shard_columns.indexes[row + j];
+
+				if(!((allowed_bitmap[index / 64] >> (index % 64)) & 1))
+					continue;
+
+				const size_t dst = q * k + size;
+
+				result._columns.indexes[dst] = index;
+				result._columns.distances[dst] = result._shard_columns.distances[row + j];
+				result._columns.fars[dst] = result._shard_columns.fars[row + j];
+				result._columns.frrs[dst] = result._shard_columns.frrs[row + j];
+				result._columns.scores[dst] = result._shard_columns.scores[row + j];
+
+				++size;
+			}
+
+			for(size_t i = size; i < k; ++i)
+				result._columns.indexes[q * k + i] = -1;
+
+			result._sizes[q] = size;
+
+			// the row is exhausted, but the further templates can be allowed
+			if(size < k && j == search_k)
+				complete = false;
+		}
+
+		if(complete || search_k == index_size)
+			return;
+
+		search_k = (std::min)(index_size, 2 * search_k);
+	}
+}
+
+
+template<typename Predicate>
+void Recognizer::searchFiltered(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const pbio::TemplatesIndex &templates_index,
+	const size_t k,
+	const Predicate &allowed,
+	SearchResultBuffer &result,
+	const SearchAccelerationType acceleration) const
+{
+	const size_t index_size = templates_index.size();
+
+	std::vector<uint64_t> allowed_bitmap((index_size + 63) / 64, 0);
+
+	for(size_t i = 0; i < index_size; ++i)
+	{
+		if(allowed(i))
+			allowed_bitmap[i / 64] |= uint64_t(1) << (i % 64);
+	}
+
+	searchFiltered(queries_templates, templates_index, k, allowed_bitmap, result, acceleration);
 }
 
 
 inline
-Template::Ptr Recognizer::loadTemplate(
-	const void* const data,
-	const int size) const
+FilteredTemplatesIndex::Ptr Recognizer::createFilteredIndex(
+	const pbio::TemplatesIndex &templates_index,
+	const std::vector<uint64_t> &allowed_bitmap,
+	const int search_threads_count) const
 {
-	void* exception = NULL;
+	const size_t index_size = templates_index.size();
 
-	pbio::stl_wraps::WrapIStreamBufferImpl input_stream((const char*) data, size);
+	if(allowed_bitmap.size() < (index_size + 63) / 64)
+	{
+		throw pbio::Error(0x6f2d83b1, "Error in pbio::Recognizer::createFilteredIndex: allowed_bitmap is smaller than the index, error code: 0x6f2d83b1.");
+	}
 
-	void* const result_impl = _dll_handle->Recognizer_loadTemplate(
-		_impl,
-		&input_stream,
-		pbio::stl_wraps::WrapIStream::read_func,
-		&exception);
+	std::vector<pbio::Template::Ptr> templates;
+	std::vector<int64_t> ids;
 
-	checkException(exception, *_dll_handle);
+	for(size_t i = 0; i < index_size; ++i)
+	{
+		if(!((allowed_bitmap[i / 64] >> (i % 64)) & 1))
+			continue;
 
-	return Template::Ptr::make(_dll_handle, result_impl);
+		templates.push_back(templates_index.at(i));
+		ids.push_back(i);
+	}
+
+	const TemplatesIndex::Ptr index = templates.empty() ? TemplatesIndex::Ptr() : createIndex(templates, search_threads_count);
+
+	return FilteredTemplatesIndex::Ptr::make(index, ids);
 }
 
 
 inline
-Recognizer::MatchResult Recognizer::verifyMatch(
-	const Template &template1,
-	const Template &template2) const
+void Recognizer::searchFiltered(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const pbio::FilteredTemplatesIndex &filtered_index,
+	const size_t k,
+	SearchResultBuffer &result,
+	const SearchAccelerationType acceleration) const
 {
-	MatchResult result;
+	result.resize(queries_templates.size(), k);
 
-	void* exception = NULL;
+	for(size_t i = 0; i < queries_templates.size(); ++i)
+		result._queries[i] = queries_templates[i]->_impl;
 
-	_dll_handle->Recognizer_verifyMatch_v2(
-		_impl,
-		(const pbio::facerec::TemplateImpl*) template1._impl,
-		(const pbio::facerec::TemplateImpl*) template2._impl,
-		&result.distance,
-		&result.fa_r,
-		&result.fr_r,
-		&result.score,
-		&exception);
+	searchIntoBuffer(filtered_index, k, result, acceleration);
+}
 
-	checkException(exception, *_dll_handle);
 
-	return result;
+template<typename OnComplete>
+void Recognizer::searchRangeIntoBuffer(
+	const pbio::TemplatesIndex &templates_index,
+	const double far_threshold,
+	SearchResultBuffer &result,
+	const SearchAccelerationType acceleration,
+	const OnComplete &on_complete) const
+{
+	const size_t index_size = templates_index.size();
+	const size_t queries_count = result._queries_count;
+
+	if(queries_count == 0 || index_size == 0)
+		return;
+
+	// the i-th incomplete query is result._queries[i], its index is pending[i]
+	std::vector<size_t> &pending = result._merge_cursors;
+
+	pending.resize(queries_count);
+
+	for(size_t q = 0; q < queries_count; ++q)
+		pending[q] = q;
+
+	size_t pending_count = queries_count;
+	size_t search_k = (std::min)(index_size, (size_t) 16);
+
+	while(pending_count > 0)
+	{
+		result._queries_count = pending_count;
+		result._shard_columns.resize(pending_count * search_k);
+
+		searchIntoColumns(templates_index, search_k, result, result._shard_columns, 0, acceleration);
+
+		size_t incomplete_count = 0;
+
+		for(size_t i = 0; i < pending_count; ++i)
+		{
+			const size_t row = i * search_k;
+
+			size_t matches = 0;
+
+			while(matches < search_k &&
+				result._shard_columns.indexes[row + matches] >= 0 &&
+				result._shard_columns.fars[row + matches] <= far_threshold)
+			{
+				++matches;
+			}
+
+			// all results are matches, the further templates can be matches too
+			if(matches == search_k && search_k < index_size)
+			{
+				pending[incomplete_count] = pending[i];
+				result._queries[incomplete_count] = result._queries[i];
+				++incomplete_count;
+
+				continue;
+			}
+
+			on_complete(pending[i], row, matches);
+		}
+
+		pending_count = incomplete_count;
+		search_k = (std::min)(index_size, 2 * search_k);
+	}
+
+	result._queries_count = queries_count;
 }
 
+
 inline
-TemplatesIndex::Ptr Recognizer::createIndex(
-	const std::vector<pbio::Template::Ptr> &templates,
-	const int search_threads_count,
-	const int reserve_queries_count) const
+void Recognizer::searchRange(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const pbio::TemplatesIndex &templates_index,
+	const double far_threshold,
+	SearchResultBuffer &result,
+	const SearchAccelerationType acceleration) const
 {
-	std::vector<const pbio::facerec::TemplateImpl*> templates_impls(templates.size());
+	const size_t queries_count = queries_templates.size();
 
-	for(size_t i = 0; i < templates.size(); ++i)
-		templates_impls[i] = (const pbio::facerec::TemplateImpl*) templates[i]->_impl;
+	result.resize(queries_count, 0);
 
-	void* exception = NULL;
+	for(size_t i = 0; i < queries_count; ++i)
+		result._queries[i] = queries_templates[i]->_impl;
 
-	void* const result_impl =
-		_dll_handle->Recognizer_createIndex(
-			_impl,
-			templates.size(),
-			&templates_impls[0],
-			search_threads_count,
-			&exception);
+	std::fill(result._sizes.begin(), result._sizes.end(), 0);
 
-	checkException(exception, *_dll_handle);
+	// matches of the complete queries are appended to result._columns,
+	// the matches of the q-th query start at result._shard_offsets[q]
+	result._shard_offsets.assign(queries_count, 0);
 
-	const TemplatesIndex::Ptr result = TemplatesIndex::Ptr::make(_dll_handle, result_impl);
+	size_t matches_total = 0;
 
-	result->reserveSearchMemory(reserve_queries_count);
+	searchRangeIntoBuffer(
+		templates_index,
+		far_threshold,
+		result,
+		acceleration,
+		[&result, &matches_total](const size_t q, const size_t row, const size_t matches)
+		{
+			SearchResultBuffer::Columns &columns = result._columns;
+			const SearchResultBuffer::Columns &found = result._shard_columns;
 
-	return result;
+			columns.resize(matches_total + matches);
+
+			std::copy(found.indexes.begin() + row, found.indexes.begin() + row + matches, columns.indexes.begin() + matches_total);
+			std::copy(found.distances.begin() + row, found.distances.begin() + row + matches, columns.distances.begin() + matches_total);
+			std::copy(found.fars.begin() + row, found.fars.begin() + row + matches, columns.fars.begin() + matches_total);
+			std::copy(found.frrs.begin() + row, found.frrs.begin() + row + matches, columns.frrs.begin() + matches_total);
+			std::copy(found.scores.begin() + row, found.scores.begin() + row + matches, columns.scores.begin() + matches_total);
+
+			result._shard_offsets[q] = matches_total;
+			result._sizes[q] = matches;
+
+			matches_total += matches;
+		});
+
+	size_t max_matches = 0;
+
+	for(size_t q = 0; q < queries_count; ++q)
+		max_matches = (std::max)(max_matches, result._sizes[q]);
+
+	// rows of max_matches elements are built in the shard scratch, which then becomes the result columns
+	result._shard_columns.resize(queries_count * max_matches);
+
+	for(size_t q = 0; q < queries_count; ++q)
+	{
+		const size_t src = result._shard_offsets[q];
+		const size_t dst = q * max_matches;
+		const size_t matches = result._sizes[q];
+
+		std::copy(result._columns.indexes.begin() + src, result._columns.indexes.begin() + src + matches, result._shard_columns.indexes.begin() + dst);
+		std::copy(result._columns.distances.begin() + src, result._columns.distances.begin() + src + matches, result._shard_columns.distances.begin() + dst);
+		std::copy(result._columns.fars.begin() + src, result._columns.fars.begin() + src + matches, result._shard_columns.fars.begin() + dst);
+		std::copy(result._columns.frrs.begin() + src, result._columns.frrs.begin() + src + matches, result._shard_columns.frrs.begin() + dst);
+		std::copy(result._columns.scores.begin() + src, result._columns.scores.begin() + src + matches, result._shard_columns.scores.begin() + dst);
+
+		std::fill(
+			result._shard_columns.indexes.begin() + dst + matches,
+			result._shard_columns.indexes.begin() + dst + max_matches,
+			-1);
+	}
+
+	std::swap(result._columns, result._shard_columns);
+
+	result.resize(queries_count, max_matches);
 }
 
 
-inline TemplatesIndex::Ptr Recognizer::createResizableIndex(
-		const uint64_t templates_count,
-		const int search_threads_count,
-		const int reserve_queries_count) const
+template<typename Callback>
+void Recognizer::searchRange(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const pbio::TemplatesIndex &templates_index,
+	const double far_threshold,
+	const Callback &callback,
+	const SearchAccelerationType acceleration) const
 {
-	void* exception = NULL;
+	SearchResultBuffer buffer;
 
-	void* const result_impl =
-		_dll_handle->Recognizer_createResizableIndex(
-			_impl,
-			templates_count,
-			search_threads_count,
-			&exception);
+	buffer.resize(queries_templates.size(), 0);
 
-	checkException(exception, *_dll_handle);
+	for(size_t i = 0; i < queries_templates.size(); ++i)
+		buffer._queries[i] = queries_templates[i]->_impl;
 
-	const TemplatesIndex::Ptr result = TemplatesIndex::Ptr::make(_dll_handle, result_impl);
+	SearchResult search_result;
 
-	result->reserveSearchMemory(reserve_queries_count);
+	searchRangeIntoBuffer(
+		templates_index,
+		far_threshold,
+		buffer,
+		acceleration,
+		[&buffer, &search_result, &callback](const size_t q, const size_t row, const size_t matches)
+		{
+			const SearchResultBuffer::Columns &found = buffer._shard_columns;
+
+			for(size_t j = row; j < row + matches; ++j)
+			{
+				search_result.i = found.indexes[j];
+				search_result.match_result.distance = found.distances[j];
+				search_result.match_result.fa_r = found.fars[j];
+				search_result.match_result.fr_r = found.frrs[j];
+				search_result.match_result.score = found.scores[j];
+
+				callback(q, search_result);
+			}
+		});
+}
+
+
+inline
+std::vector<Recognizer::SearchResult> Recognizer::searchRange(
+	const pbio::Template::Ptr &query_template,
+	const pbio::TemplatesIndex &templates_index,
+	const double far_threshold,
+	const SearchAccelerationType acceleration) const
+{
+	std::vector<SearchResult> result;
+
+	searchRange(
+		std::vector<pbio::Template::Ptr>(1, query_template),
+		templates_index,
+		far_threshold,
+		[&result](const size_t, const SearchResult &search_result) { result.push_back(search_result); },
+		acceleration);
 
 	return result;
 }
 
 
 inline
-std::vector<Recognizer::SearchResult> Recognizer::search(
-	const pbio::Template &query_template,
+std::vector<Recognizer::DuplicatePair> Recognizer::selfJoin(
 	const pbio::TemplatesIndex &templates_index,
 	const size_t k,
+	const double far_threshold,
 	const SearchAccelerationType acceleration) const
 {
-	std::vector<int64_t> result_i(k);
-	std::vector<float> result_distance(k);
-	std::vector<float> result_far(k);
-	std::vector<float> result_frr(k);
-	std::vector<float> result_score(k);
+	const size_t index_size = templates_index.size();
+	const size_t queries_block = 256;
 
-	void* exception = NULL;
+	// the template itself is the nearest one
+	const size_t search_k = (std::min)(index_size, k + 1);
 
-	_dll_handle->Recognizer_search_v2(
-		_impl,
-		acceleration,
-		1,  // queries_count
-		(const pbio::facerec::TemplateImpl* const*) &query_template._impl,
-		(const pbio::facerec::TemplatesIndexImpl*) templates_index._impl,
-		k,
-		&result_i[0],
-		&result_distance[0],
-		&result_far[0],
-		&result_frr[0],
-		&result_score[0],
-		&exception);
+	std::vector<DuplicatePair> result;
 
-	checkException(exception, *_dll_handle);
+	std::vector<pbio::Template::Ptr> queries;
+	SearchResultBuffer block_result;
 
-	std::vector<SearchResult> result(k);
-	result.reserve(k);
+	// one index for all blocks, the library searches a block in the threads of the index
+	for(size_t begin = 0; begin < index_size; begin += queries_block)
+	{
+		const size_t end = (std::min)(begin + queries_block, index_size);
+
+		queries.clear();
+
+		for(size_t i = begin; i < end; ++i)
+			queries.push_back(templates_index.at(i));
+
+		search(queries, templates_index, search_k, block_result, acceleration);
+
+		for(size_t q = 0; q < queries.size(); ++q)
+		{
+			const size_t i = begin + q;
+
+			for(size_t r = 0; r < block_result.size(q) && block_result.fars(q)[r] <= far_threshold; ++r)
+			{
+				const size_t j = block_result.indexes(q)[r];
+
+				if(j == i)
+					continue;
+
+				DuplicatePair pair;
+				pair.i = (std::min)(i, j);
+				pair.j = (std::max)(i, j);
+				pair.match_result.distance = block_result.distances(q)[r];
+				pair.match_result.fa_r = block_result.fars(q)[r];
+				pair.match_result.fr_r = block_result.frrs(q)[r];
+				pair.match_result.score = block_result.scores(q)[r];
+
+				result.push_back(pair);
+			}
+		}
+	}
 
-	for(size_t i = 0; i < k; ++i)
+	// a pair is found from both of its templates
+	const auto pair_less = [](const DuplicatePair &a, const DuplicatePair &b)
 	{
-		if(result_i[i] < 0)
-		{
-			result.resize(i);
-			break;
-		}
+		return a.i < b.i || (a.i == b.i && a.j < b.j);
+	};
 
-		result[i].i = result_i[i];
-		result[i].match_result.distance = result_distance[i];
-		result[i].match_result.fa_r = result_far[i];
-		result[i].match_result.fr_r = result_frr[i];
-		result[i].match_result.score = result_score[i];
-	}
+	const auto pair_equal = [](const DuplicatePair &a, const DuplicatePair &b)
+	{
+		return a.i == b.i && a.j == b.j;
+	};
+
+	std::sort(result.begin(), result.end(), pair_less);
+
+	result.erase(std::unique(result.begin(), result.end(), pair_equal), result.end());
 
 	return result;
 }
 
 
 inline
-std::vector<std::vector<Recognizer::SearchResult> > Recognizer::search(
-	const std::vector<pbio::Template::Ptr> &queries_templates,
+void Recognizer::searchIntoBuffer(
 	const pbio::TemplatesIndex &templates_index,
 	const size_t k,
+	SearchResultBuffer &result,
 	const SearchAccelerationType acceleration) const
 {
-	const size_t queries_count = queries_templates.size();
-
-	std::vector<const pbio::facerec::TemplateImpl*> queries_impls(queries_count);
-
-	for(size_t i = 0; i < queries_count; ++i)
+	if(result._queries_count == 0 || k == 0)
 	{
-		queries_impls[i] = (const pbio::facerec::TemplateImpl*) queries_templates[i]->_impl;
+		result.countValid();
+		return;
 	}
 
-	std::vector<int64_t> result_i(k * queries_count);
-	std::vector<float> result_distance(k * queries_count);
-	std::vector<float> result_far(k * queries_count);
-	std::vector<float> result_frr(k * queries_count);
-	std::vector<float> result_score(k * queries_count);
+	searchIntoColumns(templates_index, k, result, result._columns, 0, acceleration);
 
-	void* exception = NULL;
+	result.countValid();
+}
 
-	_dll_handle->Recognizer_search_v2(
-		_impl,
-		acceleration,
-		queries_count,
-		&queries_impls[0],
-		(const pbio::facerec::TemplatesIndexImpl*) templates_index._impl,
-		k,
-		&result_i[0],
-		&result_distance[0],
-		&result_far[0],
-		&result_frr[0],
-		&result_score[0],
-		&exception);
 
-	checkException(exception, *_dll_handle);
+inline
+void Recognizer::searchIntoBuffer(
+	const pbio::FilteredTemplatesIndex &filtered_index,
+	const size_t k,
+	SearchResultBuffer &result,
+	const SearchAccelerationType acceleration) const
+{
+	const size_t queries_count = result._queries_count;
+	const size_t filtered_k = (std::min)(k, filtered_index.size());
 
-	std::vector<std::vector<SearchResult> > result(
-		queries_count,
-		std::vector<SearchResult>(k));
+	if(queries_count == 0 || filtered_k == 0)
+	{
+		std::fill(result._columns.indexes.begin(), result._columns.indexes.end(), -1);
 
-	for(size_t i = 0; i < queries_count; ++i)
+		result.countValid();
+		return;
+	}
+
+	// rows of filtered_k results are written to the shard scratch and copied to the rows of k results
+	result.resizeShards(1, filtered_k);
+
+	searchIntoColumns(*filtered_index.index(), filtered_k, result, result._shard_columns, 0, acceleration);
+
+	const std::vector<int64_t> &ids = filtered_index.ids();
+
+	for(size_t q = 0; q < queries_count; ++q)
 	{
-		for(size_t j = 0; j < k; ++j)
+		size_t size = 0;
+
+		for(; size < filtered_k; ++size)
 		{
-			const size_t h = i * k + j;
+			const size_t src = q * filtered_k + size;
+			const size_t dst = q * k + size;
 
-			if(result_i[h] < 0)
-			{
-				result[i].resize(j);
+			const int64_t local = result._shard_columns.indexes[src];
+
+			if(local < 0)
 				break;
-			}
 
-			result[i][j].i = result_i[h];
-			result[i][j].match_result.distance = result_distance[h];
-			result[i][j].match_result.fa_r = result_far[h];
-			result[i][j].match_result.fr_r = result_frr[h];
-			result[i][j].match_result.score = result_score[h];
+			result._columns.indexes[dst] = ids[local];
+			result._columns.distances[dst] = result._shard_columns.distances[src];
+			result._columns.fars[dst] = result._shard_columns.fars[src];
+			result._columns.frrs[dst] = result._shard_columns.frrs[src];
+			result._columns.scores[dst] = result._shard_columns.scores[src];
 		}
-	}
-
-	return result;
-}
-
 
+		for(size_t i = size; i < k; ++i)
+			result._columns.indexes[q * k + i] = -1;
 
+		result._sizes[q] = size;
+	}
+}
 
 
 inline
-Recognizer::MatchResult Recognizer::getROCCurvePointByDistanceThreshold(
-	const double distance_threshold) const
+void Recognizer::searchIntoColumns(
+	const pbio::TemplatesIndex &templates_index,
+	const size_t k,
+	const SearchResultBuffer &result,
+	SearchResultBuffer::Columns &columns,
+	const size_t offset,
+	const SearchAccelerationType acceleration) const
 {
-	MatchResult result;
-
 	void* exception = NULL;
 
-	_dll_handle->Recognizer_getROCCurvePointByDistanceThreshold_v2(
+	_dll_handle->Recognizer_search_v2(
 		_impl,
-		distance_threshold,
-		&result.distance,
-		&result.fa_r,
-		&result.fr_r,
-		&result.score,
+		acceleration,
+		result._queries_count,
+		(const pbio::facerec::TemplateImpl* const*) result._queries.data(),
+		(const pbio::facerec::TemplatesIndexImpl*) templates_index._impl,
+		k,
+		columns.indexes.data() + offset,
+		columns.distances.data() + offset,
+		columns.fars.data() + offset,
+		columns.frrs.data() + offset,
+		columns.scores.data() + offset,
 		&exception);
 
 	checkException(exception, *_dll_handle);
-
-	return result;
 }
 
+
 inline
-Recognizer::MatchResult Recognizer::getROCCurvePointByFAR(
-	const double desired_far) const
+void Recognizer::search(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const pbio::ShardedTemplatesIndex &sharded_index,
+	const size_t k,
+	SearchResultBuffer &result,
+	const SearchAccelerationType acceleration,
+	const std::vector<Recognizer::Ptr> &thread_recognizers) const
 {
-	MatchResult result;
+	result.resize(queries_templates.size(), k);
 
-	void* exception = NULL;
+	for(size_t i = 0; i < queries_templates.size(); ++i)
+		result._queries[i] = queries_templates[i]->_impl;
 
-	_dll_handle->Recognizer_getROCCurvePointByFAR_v2(
-		_impl,
-		desired_far,
-		&result.distance,
-		&result.fa_r,
-		&result.fr_r,
-		&result.score,
-		&exception);
+	searchIntoBuffer(sharded_index, k, result, acceleration, thread_recognizers);
+}
 
-	checkException(exception, *_dll_handle);
 
-	return result;
+inline
+void Recognizer::search(
+	const pbio::Template &query_template,
+	const pbio::ShardedTemplatesIndex &sharded_index,
+	const size_t k,
+	SearchResultBuffer &result,
+	const SearchAccelerationType acceleration,
+	const std::vector<Recognizer::Ptr> &thread_recognizers) const
+{
+	result.resize(1, k);
+
+	result._queries[0] = query_template._impl;
+
+	searchIntoBuffer(sharded_index, k, result, acceleration, thread_recognizers);
 }
 
+
 inline
-Recognizer::MatchResult Recognizer::getROCCurvePointByFRR(
-	const double desired_frr) const
+std::vector<std::vector<Recognizer::SearchResult> > Recognizer::search(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const pbio::ShardedTemplatesIndex &sharded_index,
+	const size_t k,
+	const SearchAccelerationType acceleration,
+	const std::vector<Recognizer::Ptr> &thread_recognizers) const
 {
-	MatchResult result;
+	SearchResultBuffer buffer(queries_templates.size(), k, sharded_index.shardsCount());
 
-	void* exception = NULL;
+	search(queries_templates, sharded_index, k, buffer, acceleration, thread_recognizers);
 
-	_dll_handle->Recognizer_getROCCurvePointByFRR_v2(
-		_impl,
-		desired_frr,
-		&result.distance,
-		&result.fa_r,
-		&result.fr_r,
-		&result.score,
-		&exception);
+	std::vector<std::vector<SearchResult> > result(queries_templates.size());
 
-	checkException(exception, *_dll_handle);
+	for(size_t i = 0; i < result.size(); ++i)
+	{
+		result[i].resize(buffer.size(i));
+
+		for(size_t j = 0; j < result[i].size(); ++j)
+		{
+			result[i][j].i = buffer.indexes(i)[j];
+			result[i][j].match_result.distance = buffer.distances(i)[j];
+			result[i][j].match_result.fa_r = buffer.fars(i)[j];
+			result[i][j].match_result.fr_r = buffer.frrs(i)[j];
+			result[i][j].match_result.score = buffer.scores(i)[j];
+		}
+	}
 
 	return result;
 }
 
 
 inline
-Recognizer::MatchResult Recognizer::getROCCurvePointByScoreThreshold(
-	const double score_threshold) const
+void Recognizer::searchIntoBuffer(
+	const pbio::ShardedTemplatesIndex &sharded_index,
+	const size_t k,
+	SearchResultBuffer &result,
+	const SearchAccelerationType acceleration,
+	const std::vector<Recognizer::Ptr> &thread_recognizers) const
 {
-	MatchResult result;
+	const size_t shards_count = sharded_index.shardsCount();
 
-	void* exception = NULL;
+	// one shard has the same indexes as the global ones, no merge is needed
+	if(shards_count == 1)
+	{
+		searchIntoBuffer(*sharded_index.shard(0), k, result, acceleration);
+		return;
+	}
 
-	_dll_handle->Recognizer_getROCCurvePointByScoreThreshold(
-		_impl,
-		score_threshold,
-		&result.distance,
-		&result.fa_r,
-		&result.fr_r,
-		&result.score,
-		&exception);
+	if(result._queries_count == 0 || k == 0)
+	{
+		result.countValid();
+		return;
+	}
 
-	checkException(exception, *_dll_handle);
+	result.resizeShards(shards_count, k);
 
-	return result;
+	int64_t offset = 0;
+
+	for(size_t s = 0; s < shards_count; ++s)
+	{
+		result._shard_offsets[s] = offset;
+		offset += sharded_index.shard(s)->size();
+	}
+
+	const size_t shard_stride = result._queries_count * k;
+
+	for(size_t w = 0; w < thread_recognizers.size(); ++w)
+	{
+		if(!thread_recognizers[w])
+			throw pbio::Error(0x4e97c3a6, "Error in pbio::Recognizer::search: thread recognizer is NULL, error code: 0x4e97c3a6.");
+	}
+
+	// each worker searches its shards with its own recognizer
+	std::atomic<size_t> next_shard(0);
+	std::atomic<bool> failed(false);
+
+	const auto worker = [&](const size_t w)
+	{
+		const Recognizer &recognizer = w == 0 ? *this : *thread_recognizers[w - 1];
+
+		try
+		{
+			for(size_t s = next_shard++; s < shards_count && !failed; s = next_shard++)
+			{
+				recognizer.searchIntoColumns(
+					*sharded_index.shard(s),
+					k,
+					result,
+					result._shard_columns,
+					s * shard_stride,
+					acceleration);
+			}
+		}
+		catch(...)
+		{
+			failed = true;
+			throw;
+		}
+	};
+
+	if(sharded_index.threadPool() && !thread_recognizers.empty())
+		sharded_index.threadPool()->parallelFor((std::min)(thread_recognizers.size() + 1, shards_count), worker);
+	else
+		worker(0);
+
+	result.mergeShards();
 }
 
+
 inline
 std::vector<size_t> Recognizer::chooseRepresentativeTemplatesSet(
 	const size_t set_size,
@@ -1046,6 +2886,138 @@ std::vector<size_t> Recognizer::chooseRepresentativeTemplatesSet(
 }
 
 
+inline
+std::vector<size_t> Recognizer::chooseRepresentativeTemplatesSet(
+	const size_t set_size,
+	const std::vector<pbio::Template::Ptr> &templates,
+	const std::vector<size_t> &inviolable_templates_indexes,
+	const size_t chunk_size,
+	const pbio::ThreadPool::Ptr &thread_pool,
+	const std::vector<Recognizer::Ptr> &thread_recognizers)
+{
+	if(chunk_size <= set_size)
+	{
+		throw pbio::Error(0x4f81d2b6, "Error in pbio::Recognizer::chooseRepresentativeTemplatesSet: chunk_size must be greater than set_size, error code: 0x4f81d2b6.");
+	}
+
+	std::vector<bool> inviolable(templates.size(), false);
+
+	for(size_t i = 0; i < inviolable_templates_indexes.size(); ++i)
+	{
+		const size_t j = inviolable_templates_indexes[i];
+
+		if(j >= templates.size())
+			throw pbio::Error(
+				0x63156958,
+				"Error: bad index in chooseRepresentativeTemplatesSet, error code: 0x63156958");
+
+		inviolable[j] = true;
+	}
+
+	// chooses the set from the candidates (indexes of templates) with the given recognizer
+	const auto choose = [&](Recognizer &recognizer, const size_t* const candidates, const size_t candidates_count)
+	{
+		std::vector<pbio::Template::Ptr> chunk_templates(candidates_count);
+		std::vector<size_t> chunk_inviolable;
+
+		for(size_t i = 0; i < candidates_count; ++i)
+		{
+			chunk_templates[i] = templates[candidates[i]];
+
+			if(inviolable[candidates[i]])
+				chunk_inviolable.push_back(i);
+		}
+
+		const size_t chunk_set_size = (std::min)(candidates_count, (std::max)(set_size, chunk_inviolable.size()));
+
+		std::vector<size_t> chosen = recognizer.chooseRepresentativeTemplatesSet(chunk_set_size, chunk_templates, chunk_inviolable);
+
+		for(size_t i = 0; i < chosen.size(); ++i)
+			chosen[i] = candidates[chosen[i]];
+
+		return chosen;
+	};
+
+	std::vector<size_t> candidates(templates.size());
+
+	for(size_t i = 0; i < candidates.size(); ++i)
+		candidates[i] = i;
+
+	while(candidates.size() > chunk_size)
+	{
+		const size_t chunks_count = (candidates.size() + chunk_size - 1) / chunk_size;
+
+		std::vector<std::vector<size_t> > chunks_chosen(chunks_count);
+
+		std::atomic<size_t> next_chunk(0);
+		std::atomic<bool> failed(false);
+
+		// the w-th worker uses its own recognizer and takes the chunks one by one
+		const auto worker = [&](const size_t w)
+		{
+			Recognizer &recognizer = w == 0 ? *this : *thread_recognizers[w - 1];
+
+			try
+			{
+				for(size_t chunk = next_chunk++; chunk < chunks_count && !failed; chunk = next_chunk++)
+				{
+					const size_t begin = chunk * chunk_size;
+					const size_t end = (std::min)(begin + chunk_size, candidates.size());
+
+					chunks_chosen[chunk] = choose(recognizer, candidates.data() + begin, end - begin);
+				}
+			}
+			catch(...)
+			{
+				failed = true;
+				throw;
+			}
+		};
+
+		if(thread_pool && !thread_recognizers.empty() && chunks_count > 1)
+			thread_pool->parallelFor((std::min)(thread_recognizers.size() + 1, chunks_count), worker);
+		else
+			worker(0);
+
+		std::vector<size_t> chosen;
+
+		for(size_t chunk = 0; chunk < chunks_count; ++chunk)
+			chosen.insert(chosen.end(), chunks_chosen[chunk].begin(), chunks_chosen[chunk].end());
+
+		// only the inviolable templates are left
+		if(chosen.size() == candidates.size())
+			break;
+
+		candidates.swap(chosen);
+	}
+
+	return choose(*this, candidates.data(), candidates.size());
+}
+
+
+inline
+std::vector<size_t> Recognizer::updateRepresentativeTemplatesSet(
+	const size_t set_size,
+	const std::vector<pbio::Template::Ptr> &representative_templates,
+	const std::vector<pbio::Template::Ptr> &new_templates,
+	const std::vector<size_t> &inviolable_templates_indexes)
+{
+	std::vector<pbio::Template::Ptr> templates(representative_templates);
+
+	templates.insert(templates.end(), new_templates.begin(), new_templates.end());
+
+	for(size_t i = 0; i < inviolable_templates_indexes.size(); ++i)
+	{
+		if(inviolable_templates_indexes[i] >= representative_templates.size())
+			throw pbio::Error(
+				0x63156958,
+				"Error: bad index in chooseRepresentativeTemplatesSet, error code: 0x63156958");
+	}
+
+	return chooseRepresentativeTemplatesSet(set_size, templates, inviolable_templates_indexes);
+}
+
+
 }  // pbio namespace
 
 
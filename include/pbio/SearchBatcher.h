@@ -0,0 +1,401 @@
+/**
+	\file SearchBatcher.h
+	\~English
+	\brief SearchBatcher - asynchronous search that batches concurrent single-template queries.
+	\~Russian
+	\brief SearchBatcher - асинхронный поиск, объединяющий одновременные запросы с одним шаблоном в пакеты.
+*/
+
+#ifndef __PBIO_API__PBIO__SEARCH_BATCHER_H_
+#define __PBIO_API__PBIO__SEARCH_BATCHER_H_
+
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Error.h"
+#include "Recognizer.h"
+#include "SearchResultBuffer.h"
+#include "SmartPtr.h"
+#include "Template.h"
+#include "TemplatesIndex.h"
+
+
+namespace pbio
+{
+
+/** \~English
+	\brief
+		Asynchronous front-end of Recognizer::search for one TemplatesIndex.
+		Single-template queries from any threads are put to a queue and
+		searched by a background thread with one batched Recognizer::search call:
+		the batch is started when max_batch_size queries are queued or
+		max_wait has passed since the first queued query.
+		The recognizer is used only by the background thread.
+		Thread-safe.
+	\~Russian
+	\brief
+		Асинхронный интерфейс Recognizer::search для одного индекса TemplatesIndex.
+		Запросы с одним шаблоном из любых потоков помещаются в очередь, и
+		поиск по ним выполняется фоновым потоком одним пакетным вызовом Recognizer::search:
+		пакет запускается, когда в очереди max_batch_size запросов или
+		с момента первого запроса в очереди прошло max_wait.
+		Распознаватель используется только фоновым потоком.
+		Потокобезопасный.
+*/
+class SearchBatcher
+{
+public:
+
+	/** \~English
+		\brief Alias for the type of a smart pointer to SearchBatcher.
+		\~Russian
+		\brief Псевдоним для типа умного указателя на SearchBatcher.
+	*/
+	typedef LightSmartPtr<SearchBatcher>::tPtr Ptr;
+
+	/**
+		\~English
+		\brief
+			Start the background thread.
+
+		\param[in]  recognizer
+			Recognizer that created the index, must not be used by other threads for search.
+
+		\param[in]  templates_index
+			TemplatesIndex for search.
+
+		\param[in]  max_batch_size
+			Max count of queries in one Recognizer::search call, must be positive.
+
+		\param[in]  max_wait
+			Max time the first query of a batch waits for other queries.
+
+		\param[in]  acceleration
+			Acceleration type.
+
+		\~Russian
+		\brief
+			Запустить фоновый поток.
+
+		\param[in]  recognizer
+			Распознаватель, создавший индекс, не должен использоваться другими потоками для поиска.
+
+		\param[in]  templates_index
+			Индекс для поиска.
+
+		\param[in]  max_batch_size
+			Максимальное количество запросов в одном вызове Recognizer::search, должно быть положительным.
+
+		\param[in]  max_wait
+			Максимальное время ожидания других запросов первым запросом пакета.
+
+		\param[in]  acceleration
+			Тип ускорения.
+	*/
+	SearchBatcher(
+		const pbio::Recognizer::Ptr &recognizer,
+		const pbio::TemplatesIndex::Ptr &templates_index,
+		const size_t max_batch_size = 64,
+		const std::chrono::microseconds max_wait = std::chrono::microseconds(200),
+		const Recognizer::SearchAccelerationType acceleration = Recognizer::SEARCH_ACCELERATION_1);
+
+	/**
+		\~English
+		\brief Searches the queued queries and stops the background thread.
+		\~Russian
+		\brief Выполняет поиск по запросам в очереди и останавливает фоновый поток.
+	*/
+	~SearchBatcher();
+
+	/**
+		\~English
+		\brief
+			Queue the search for the k nearest templates.
+			Thread-safe.
+
+		\param[in]  query_template
+			The query template.
+
+		\param[in]  k
+			Count of the nearest templates for search.
+
+		\return
+			Future of the search result, the same as of Recognizer::search,
+			or of the exception thrown by the batch search.
+
+		\~Russian
+		\brief
+			Поставить в очередь поиск k ближайших шаблонов.
+			Потокобезопасный.
+
+		\param[in]  query_template
+			Запросный шаблон.
+
+		\param[in]  k
+			Количество ближайших шаблонов для поиска.
+
+		\return
+			Будущий результат поиска, такой же, как у Recognizer::search,
+			или исключение, выброшенное при пакетном поиске.
+	*/
+	std::future<std::vector<Recognizer::SearchResult> > search(
+		const pbio::Template::Ptr &query_template,
+		const size_t k);
+
+private:
+
+	SearchBatcher(const SearchBatcher&);
+	SearchBatcher& operator=(const SearchBatcher&);
+
+	struct Request
+	{
+		pbio::Template::Ptr query;
+		size_t k;
+		std::promise<std::vector<Recognizer::SearchResult> > promise;
+	};
+
+	void workerLoop();
+
+	// one Recognizer::search call for the batch, the results (or the exceptions) are set to the promises
+	void searchBatch(std::vector<Request> &batch);
+
+	// searches the requests [begin, end) and sets the results to their promises,
+	// the promises are set only after all results are built, so none is set if it throws
+	void searchRequests(std::vector<Request> &batch, const size_t begin, const size_t end);
+
+	const pbio::Recognizer::Ptr _recognizer;
+	const pbio::TemplatesIndex::Ptr _templates_index;
+	const size_t _max_batch_size;
+	const std::chrono::microseconds _max_wait;
+	const Recognizer::SearchAccelerationType _acceleration;
+
+	std::mutex _mutex;
+	std::condition_variable _new_request;
+	std::deque<Request> _requests;
+	std::chrono::steady_clock::time_point _first_request_time;
+	bool _stop;
+
+	// used only by the background thread
+	std::vector<pbio::Template::Ptr> _batch_queries;
+	SearchResultBuffer _batch_result;
+	std::vector<std::vector<Recognizer::SearchResult> > _batch_results;
+
+	std::thread _worker;
+
+	int32_t refcounter4light_shared_ptr;
+
+	friend class object_with_ref_counter<SearchBatcher>;
+};
+
+}  // pbio namespace
+
+
+
+////////////////////////
+/////IMPLEMENTATION/////
+////////////////////////
+
+namespace pbio
+{
+
+inline
+SearchBatcher::SearchBatcher(
+	const pbio::Recognizer::Ptr &recognizer,
+	const pbio::TemplatesIndex::Ptr &templates_index,
+	const size_t max_batch_size,
+	const std::chrono::microseconds max_wait,
+	const Recognizer::SearchAccelerationType acceleration) :
+_recognizer(recognizer),
+_templates_index(templates_index),
+_max_batch_size(max_batch_size),
+_max_wait(max_wait),
+_acceleration(acceleration),
+_stop(false)
+{
+	if(max_batch_size == 0)
+	{
+		throw pbio::Error(0x2b7f94c3, "Error in pbio::SearchBatcher: max_batch_size must be positive, error code: 0x2b7f94c3.");
+	}
+
+	_batch_queries.reserve(max_batch_size);
+
+	_worker = std::thread(&SearchBatcher::workerLoop, this);
+}
+
+
+inline
+SearchBatcher::~SearchBatcher()
+{
+	{
+		const std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+
+	_new_request.notify_one();
+
+	_worker.join();
+}
+
+
+inline
+std::future<std::vector<Recognizer::SearchResult> > SearchBatcher::search(
+	const pbio::Template::Ptr &query_template,
+	const size_t k)
+{
+	std::future<std::vector<Recognizer::SearchResult> > result;
+
+	{
+		const std::lock_guard<std::mutex> lock(_mutex);
+
+		if(_requests.empty())
+			_first_request_time = std::chrono::steady_clock::now();
+
+		_requests.push_back(Request());
+		_requests.back().query = query_template;
+		_requests.back().k = k;
+
+		result = _requests.back().promise.get_future();
+
+		// the worker waits for the first request or for the full batch
+		if(_requests.size() != 1 && _requests.size() != _max_batch_size)
+			return result;
+	}
+
+	_new_request.notify_one();
+
+	return result;
+}
+
+
+inline
+void SearchBatcher::workerLoop()
+{
+	std::vector<Request> batch;
+	batch.reserve(_max_batch_size);
+
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	while(true)
+	{
+		_new_request.wait(lock, [this]{ return _stop || !_requests.empty(); });
+
+		if(_requests.empty())
+			return;
+
+		// after the stop the queued requests are searched without waiting
+		if(!_stop && _requests.size() < _max_batch_size)
+		{
+			_new_request.wait_until(
+				lock,
+				_first_request_time + _max_wait,
+				[this]{ return _stop || _requests.size() >= _max_batch_size; });
+		}
+
+		const size_t batch_size = (std::min)(_requests.size(), _max_batch_size);
+
+		for(size_t i = 0; i < batch_size; ++i)
+		{
+			batch.push_back(std::move(_requests.front()));
+			_requests.pop_front();
+		}
+
+		// the rest of the queue starts a new batch
+		if(!_requests.empty())
+			_first_request_time = std::chrono::steady_clock::now();
+
+		lock.unlock();
+
+		searchBatch(batch);
+
+		batch.clear();
+
+		lock.lock();
+	}
+}
+
+
+inline
+void SearchBatcher::searchBatch(std::vector<Request> &batch)
+{
+	try
+	{
+		searchRequests(batch, 0, batch.size());
+	}
+	catch(...)
+	{
+		if(batch.size() == 1)
+		{
+			batch[0].promise.set_exception(std::current_exception());
+			return;
+		}
+
+		// one bad query (of another method, for example) must not fail the whole batch,
+		// so the requests are searched one by one
+		for(size_t i = 0; i < batch.size(); ++i)
+		{
+			try
+			{
+				searchRequests(batch, i, i + 1);
+			}
+			catch(...)
+			{
+				batch[i].promise.set_exception(std::current_exception());
+			}
+		}
+	}
+}
+
+
+inline
+void SearchBatcher::searchRequests(std::vector<Request> &batch, const size_t begin, const size_t end)
+{
+	size_t k = 0;
+
+	_batch_queries.clear();
+
+	for(size_t i = begin; i < end; ++i)
+	{
+		_batch_queries.push_back(batch[i].query);
+		k = (std::max)(k, batch[i].k);
+	}
+
+	_recognizer->search(_batch_queries, *_templates_index, k, _batch_result, _acceleration);
+
+	_batch_results.resize(end - begin);
+
+	// results of the smaller k are the prefixes of the results of the largest k
+	for(size_t i = begin; i < end; ++i)
+	{
+		const size_t q = i - begin;
+
+		std::vector<Recognizer::SearchResult> &result = _batch_results[q];
+
+		result.resize((std::min)(batch[i].k, _batch_result.size(q)));
+
+		for(size_t j = 0; j < result.size(); ++j)
+		{
+			result[j].i = _batch_result.indexes(q)[j];
+			result[j].match_result.distance = _batch_result.distances(q)[j];
+			result[j].match_result.fa_r = _batch_result.fars(q)[j];
+			result[j].match_result.fr_r = _batch_result.frrs(q)[j];
+			result[j].match_result.score = _batch_result.scores(q)[j];
+		}
+	}
+
+	// moving the results doesn't throw
+	for(size_t i = begin; i < end; ++i)
+		batch[i].promise.set_value(std::move(_batch_results[i - begin]));
+}
+
+}  // pbio namespace
+
+#endif  // __PBIO_API__PBIO__SEARCH_BATCHER_H_
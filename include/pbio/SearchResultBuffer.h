@@ -0,0 +1,420 @@
+/**
+	\file SearchResultBuffer.h
+	\~English
+	\brief SearchResultBuffer - reusable structure-of-arrays storage for the results of Recognizer::search.
+	\~Russian
+	\brief SearchResultBuffer - переиспользуемое хранилище результатов Recognizer::search в виде структуры массивов.
+*/
+
+#ifndef __PBIO_API__PBIO__SEARCH_RESULT_BUFFER_H_
+#define __PBIO_API__PBIO__SEARCH_RESULT_BUFFER_H_
+
+
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "Error.h"
+
+
+namespace pbio
+{
+
+class Recognizer;
+class UpdatableTemplatesIndex;
+class ClusteredTemplatesIndex;
+
+/** \~English
+	\brief
+		Caller-owned buffer for the results of Recognizer::search (in TemplatesIndex or ShardedTemplatesIndex).
+		Results of all queries are stored in contiguous columns of queriesCount() * k() elements,
+		the row of the i-th query starts at i * k(), first size(i) elements of the row are valid.
+		The buffer keeps its memory between calls, so the search with the same or smaller
+		queries count and k does not allocate memory.
+		Not thread-safe, use one buffer per thread.
+	\~Russian
+	\brief
+		Принадлежащий вызывающему буфер для результатов Recognizer::search (в TemplatesIndex или ShardedTemplatesIndex).
+		Результаты всех запросов хранятся в непрерывных столбцах из queriesCount() * k() элементов,
+		строка i-го запроса начинается с i * k(), первые size(i) элементов строки действительны.
+		Буфер сохраняет память между вызовами, поэтому поиск с таким же или меньшим
+		количеством запросов и k не выделяет память.
+		Не потокобезопасный, используйте отдельный буфер в каждом потоке.
+*/
+class SearchResultBuffer
+{
+public:
+
+	SearchResultBuffer() :
+	_queries_count(0),
+	_k(0),
+	_shard_k(0)
+	{
+		// nothing else
+	}
+
+	/**
+		\~English
+		\brief
+			Create a buffer with memory reserved for queries_count queries with k results each.
+
+		\~Russian
+		\brief
+			Создать буфер с памятью, зарезервированной для queries_count запросов по k результатов.
+	*/
+	SearchResultBuffer(const size_t queries_count, const size_t k) :
+	_queries_count(0),
+	_k(0),
+	_shard_k(0)
+	{
+		reserve(queries_count, k);
+	}
+
+	/**
+		\~English
+		\brief
+			Create a buffer with memory reserved for the search in a ShardedTemplatesIndex
+			with shards_count shards.
+
+		\~Russian
+		\brief
+			Создать буфер с памятью, зарезервированной для поиска в ShardedTemplatesIndex
+			из shards_count индексов-частей.
+	*/
+	SearchResultBuffer(const size_t queries_count, const size_t k, const size_t shards_count) :
+	_queries_count(0),
+	_k(0),
+	_shard_k(0)
+	{
+		reserve(queries_count, k, shards_count);
+	}
+
+	/**
+		\~English
+		\brief
+			Reserve memory for queries_count queries with k results each.
+
+		\~Russian
+		\brief
+			Зарезервировать память для queries_count запросов по k результатов.
+	*/
+	void reserve(const size_t queries_count, const size_t k)
+	{
+		_columns.reserve(queries_count * k);
+		_sizes.reserve(queries_count);
+		_queries.reserve(queries_count);
+	}
+
+	/**
+		\~English
+		\brief
+			Reserve memory for the search in a ShardedTemplatesIndex with shards_count shards.
+
+		\~Russian
+		\brief
+			Зарезервировать память для поиска в ShardedTemplatesIndex из shards_count индексов-частей.
+	*/
+	void reserve(const size_t queries_count, const size_t k, const size_t shards_count)
+	{
+		reserve(queries_count, k);
+
+		_shard_columns.reserve(shards_count * queries_count * k);
+		_shard_offsets.reserve(shards_count);
+		_shard_ids.reserve(shards_count);
+		_merge_heap.reserve(shards_count);
+		_merge_cursors.reserve(shards_count);
+	}
+
+	/**
+		\~English
+		\brief Number of queries of the last search.
+		\~Russian
+		\brief Количество запросов последнего поиска.
+	*/
+	size_t queriesCount() const
+	{
+		return _queries_count;
+	}
+
+	/**
+		\~English
+		\brief Row length (k of the last search).
+		\~Russian
+		\brief Длина строки (k последнего поиска).
+	*/
+	size_t k() const
+	{
+		return _k;
+	}
+
+	/**
+		\~English
+		\brief Number of valid results of the query_index-th query.
+		\~Russian
+		\brief Количество действительных результатов query_index-го запроса.
+	*/
+	size_t size(const size_t query_index) const
+	{
+		checkQueryIndex(query_index);
+
+		return _sizes[query_index];
+	}
+
+	/**
+		\~English
+		\brief
+			Row of the query_index-th query in the column of indexes in the TemplatesIndex,
+			in ascending order of distance, size(query_index) valid elements.
+		\~Russian
+		\brief
+			Строка query_index-го запроса в столбце индексов в TemplatesIndex,
+			в порядке возрастания расстояния, size(query_index) действительных элементов.
+	*/
+	const int64_t* indexes(const size_t query_index) const
+	{
+		checkQueryIndex(query_index);
+
+		return _columns.indexes.data() + query_index * _k;
+	}
+
+	/**
+		\~English
+		\brief Row of the query_index-th query in the column of distances.
+		\~Russian
+		\brief Строка query_index-го запроса в столбце расстояний.
+	*/
+	const float* distances(const size_t query_index) const
+	{
+		checkQueryIndex(query_index);
+
+		return _columns.distances.data() + query_index * _k;
+	}
+
+	/**
+		\~English
+		\brief Row of the query_index-th query in the column of FAR values.
+		\~Russian
+		\brief Строка query_index-го запроса в столбце значений FAR.
+	*/
+	const float* fars(const size_t query_index) const
+	{
+		checkQueryIndex(query_index);
+
+		return _columns.fars.data() + query_index * _k;
+	}
+
+	/**
+		\~English
+		\brief Row of the query_index-th query in the column of FRR values.
+		\~Russian
+		\brief Строка query_index-го запроса в столбце значений FRR.
+	*/
+	const float* frrs(const size_t query_index) const
+	{
+		checkQueryIndex(query_index);
+
+		return _columns.frrs.data() + query_index * _k;
+	}
+
+	/**
+		\~English
+		\brief Row of the query_index-th query in the column of scores.
+		\~Russian
+		\brief Строка query_index-го запроса в столбце величин сходства.
+	*/
+	const float* scores(const size_t query_index) const
+	{
+		checkQueryIndex(query_index);
+
+		return _columns.scores.data() + query_index * _k;
+	}
+
+	/**
+		\~English
+		\brief Whole columns, queriesCount() * k() elements, invalid elements have index -1.
+		\~Russian
+		\brief Столбцы целиком, queriesCount() * k() элементов, недействительные элементы имеют индекс -1.
+	*/
+	const std::vector<int64_t>& indexesColumn() const { return _columns.indexes; }
+	const std::vector<float>& distancesColumn() const { return _columns.distances; }
+	const std::vector<float>& farsColumn() const { return _columns.fars; }
+	const std::vector<float>& frrsColumn() const { return _columns.frrs; }
+	const std::vector<float>& scoresColumn() const { return _columns.scores; }
+
+private:
+
+	// columns of Recognizer_search_v2 results
+	struct Columns
+	{
+		std::vector<int64_t> indexes;
+		std::vector<float> distances;
+		std::vector<float> fars;
+		std::vector<float> frrs;
+		std::vector<float> scores;
+
+		void reserve(const size_t size)
+		{
+			indexes.reserve(size);
+			distances.reserve(size);
+			fars.reserve(size);
+			frrs.reserve(size);
+			scores.reserve(size);
+		}
+
+		void resize(const size_t size)
+		{
+			indexes.resize(size);
+			distances.resize(size);
+			fars.resize(size);
+			frrs.resize(size);
+			scores.resize(size);
+		}
+	};
+
+	void checkQueryIndex(const size_t query_index) const
+	{
+		if(query_index >= _queries_count)
+		{
+			throw pbio::Error(0x6a3f0e27, "Error in pbio::SearchResultBuffer: query index out of range, error code: 0x6a3f0e27.");
+		}
+	}
+
+	// resizing a vector to a smaller or the same size keeps its memory
+	void resize(const size_t queries_count, const size_t k)
+	{
+		_queries_count = queries_count;
+		_k = k;
+
+		_columns.resize(queries_count * k);
+		_sizes.resize(queries_count);
+		_queries.resize(queries_count);
+	}
+
+	// rows are filled in ascending order of distance and padded with index -1
+	void countValid()
+	{
+		for(size_t i = 0; i < _queries_count; ++i)
+		{
+			const int64_t* const row = _columns.indexes.data() + i * _k;
+
+			size_t size = 0;
+
+			while(size < _k && row[size] >= 0)
+				++size;
+
+			_sizes[i] = size;
+		}
+	}
+
+	// the s-th shard writes its results to _shard_columns starting at s * queriesCount() * shard_k,
+	// rows of shard_k elements, result indexes are _shard_offsets[s] + local index
+	// or _shard_ids[s][local index] if _shard_ids is not empty
+	void resizeShards(const size_t shards_count, const size_t shard_k)
+	{
+		_shard_k = shard_k;
+		_shard_columns.resize(shards_count * _queries_count * shard_k);
+		_shard_offsets.assign(shards_count, 0);
+		_shard_ids.clear();
+	}
+
+	int64_t shardResultIndex(const size_t s, const size_t src) const
+	{
+		const int64_t local = _shard_columns.indexes[src];
+
+		return _shard_ids.empty() ? _shard_offsets[s] + local : _shard_ids[s][local];
+	}
+
+	// pushes the result at the cursor of the s-th shard to the heap
+	void pushShardHead(const size_t s, const size_t row)
+	{
+		if(_merge_cursors[s] >= _shard_k)
+			return;
+
+		const size_t src = row + _merge_cursors[s];
+
+		if(_shard_columns.indexes[src] < 0)
+			return;
+
+		_merge_heap.push_back(std::make_pair(_shard_columns.distances[src], s));
+		std::push_heap(_merge_heap.begin(), _merge_heap.end(), std::greater<std::pair<float, size_t> >());
+	}
+
+	// k-way merge of the sorted per-shard rows of every query with a min-heap of the shards heads
+	void mergeShards()
+	{
+		const size_t shards_count = _shard_offsets.size();
+		const size_t shard_stride = _queries_count * _shard_k;
+
+		_merge_cursors.resize(shards_count);
+
+		for(size_t q = 0; q < _queries_count; ++q)
+		{
+			_merge_heap.clear();
+
+			for(size_t s = 0; s < shards_count; ++s)
+			{
+				_merge_cursors[s] = 0;
+
+				pushShardHead(s, s * shard_stride + q * _shard_k);
+			}
+
+			size_t size = 0;
+
+			while(size < _k && !_merge_heap.empty())
+			{
+				std::pop_heap(_merge_heap.begin(), _merge_heap.end(), std::greater<std::pair<float, size_t> >());
+
+				const size_t s = _merge_heap.back().second;
+
+				_merge_heap.pop_back();
+
+				const size_t row = s * shard_stride + q * _shard_k;
+				const size_t src = row + _merge_cursors[s];
+				const size_t dst = q * _k + size;
+
+				_columns.indexes[dst] = shardResultIndex(s, src);
+				_columns.distances[dst] = _shard_columns.distances[src];
+				_columns.fars[dst] = _shard_columns.fars[src];
+				_columns.frrs[dst] = _shard_columns.frrs[src];
+				_columns.scores[dst] = _shard_columns.scores[src];
+
+				++size;
+
+				++_merge_cursors[s];
+				pushShardHead(s, row);
+			}
+
+			_sizes[q] = size;
+
+			for(size_t i = size; i < _k; ++i)
+				_columns.indexes[q * _k + i] = -1;
+		}
+	}
+
+	size_t _queries_count;
+	size_t _k;
+
+	Columns _columns;
+	std::vector<size_t> _sizes;
+
+	// query templates implementations passed to the library
+	std::vector<const void*> _queries;
+
+	// scratch of the search in several indexes (ShardedTemplatesIndex, UpdatableTemplatesIndex, ClusteredTemplatesIndex)
+	size_t _shard_k;
+	Columns _shard_columns;
+	std::vector<int64_t> _shard_offsets;
+	std::vector<const int64_t*> _shard_ids;
+	std::vector<std::pair<float, size_t> > _merge_heap;
+	std::vector<size_t> _merge_cursors;
+
+	friend class Recognizer;
+	friend class UpdatableTemplatesIndex;
+	friend class ClusteredTemplatesIndex;
+};
+
+}  // pbio namespace
+
+#endif  // __PBIO_API__PBIO__SEARCH_RESULT_BUFFER_H_
@@ -0,0 +1,277 @@
+/**
+	\file ShardedTemplatesIndex.h
+	\~English
+	\brief ShardedTemplatesIndex - several TemplatesIndex shards searched in parallel as one index.
+	\~Russian
+	\brief ShardedTemplatesIndex - несколько индексов TemplatesIndex, в которых поиск выполняется параллельно как в одном индексе.
+*/
+
+#ifndef __PBIO_API__PBIO__SHARDED_TEMPLATES_INDEX_H_
+#define __PBIO_API__PBIO__SHARDED_TEMPLATES_INDEX_H_
+
+
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+#include "Error.h"
+#include "SmartPtr.h"
+#include "Template.h"
+#include "TemplatesIndex.h"
+#include "ThreadPool.h"
+
+
+namespace pbio
+{
+
+/** \~English
+	\brief
+		Several TemplatesIndex shards (created by the same method) searched as one index
+		with Recognizer::search.
+		Shards are searched in parallel in the threads of the ThreadPool
+		if Recognizer::search gets recognizers for the additional threads,
+		per-shard results are merged into the global k nearest.
+		Global index of the j-th template of the s-th shard is
+		the sum of the current sizes of shards 0..s-1 plus j.
+	\~Russian
+	\brief
+		Несколько индексов TemplatesIndex (созданных одним методом), в которых поиск
+		с помощью Recognizer::search выполняется как в одном индексе.
+		Поиск в индексах выполняется параллельно в потоках ThreadPool,
+		если Recognizer::search получает распознаватели для дополнительных потоков,
+		результаты отдельных индексов объединяются в глобальные k ближайших.
+		Глобальный индекс j-го шаблона s-го индекса равен
+		сумме текущих размеров индексов 0..s-1 плюс j.
+*/
+class ShardedTemplatesIndex
+{
+public:
+
+	/** \~English
+		\brief Alias for the type of a smart pointer to ShardedTemplatesIndex.
+		\~Russian
+		\brief Псевдоним для типа умного указателя на ShardedTemplatesIndex.
+	*/
+	typedef LightSmartPtr<ShardedTemplatesIndex>::tPtr Ptr;
+
+	/**
+		\~English
+		\brief
+			Create a sharded index.
+
+		\param[in]  shards
+			Shards, must not be NULL.
+
+		\param[in]  thread_pool
+			Pool for the parallel search, can be shared by several sharded indexes.
+			If NULL or if Recognizer::search gets no recognizers for the additional threads,
+			shards are searched sequentially in the calling thread.
+
+		\~Russian
+		\brief
+			Создать составной индекс.
+
+		\param[in]  shards
+			Индексы-части, не должны быть NULL.
+
+		\param[in]  thread_pool
+			Пул для параллельного поиска, может использоваться несколькими составными индексами.
+			Если NULL или если Recognizer::search не получает распознаватели для дополнительных потоков,
+			поиск в частях выполняется последовательно в вызывающем потоке.
+	*/
+	explicit
+	ShardedTemplatesIndex(
+		const std::vector<pbio::TemplatesIndex::Ptr> &shards,
+		const pbio::ThreadPool::Ptr &thread_pool = pbio::ThreadPool::Ptr());
+
+	/**
+		\~English
+		\brief Get a number of shards.
+		\~Russian
+		\brief Получить количество индексов-частей.
+	*/
+	size_t shardsCount() const
+	{
+		return _shards.size();
+	}
+
+	/**
+		\~English
+		\brief Get the shard_index-th shard.
+		\~Russian
+		\brief Получить shard_index-й индекс-часть.
+	*/
+	const pbio::TemplatesIndex::Ptr& shard(const size_t shard_index) const;
+
+	/**
+		\~English
+		\brief Get the thread pool (can be NULL).
+		\~Russian
+		\brief Получить пул потоков (может быть NULL).
+	*/
+	const pbio::ThreadPool::Ptr& threadPool() const
+	{
+		return _thread_pool;
+	}
+
+	/**
+		\~English
+		\brief
+			Get a total number of templates in all shards.
+			Thread-safe.
+		\~Russian
+		\brief
+			Получить общее количество шаблонов во всех индексах-частях.
+			Потокобезопасный.
+	*/
+	size_t size() const;
+
+	/**
+		\~English
+		\brief
+			Get the shard index and the index in the shard of the template with the global index i.
+			Thread-safe.
+
+		\param[in]  i
+			Integer i: 0 <= i < size().
+
+		\~Russian
+		\brief
+			Получить номер индекса-части и номер в индексе-части шаблона с глобальным индексом i.
+			Потокобезопасный.
+
+		\param[in]  i
+			Целое i: 0 <= i < size().
+	*/
+	std::pair<size_t, size_t> locate(size_t i) const;
+
+	/**
+		\~English
+		\brief
+			Get the template with the global index i.
+			Thread-safe.
+
+		\param[in]  i
+			Integer i: 0 <= i < size().
+
+		\~Russian
+		\brief
+			Получить шаблон с глобальным индексом i.
+			Потокобезопасный.
+
+		\param[in]  i
+			Целое i: 0 <= i < size().
+	*/
+	pbio::Template::Ptr at(const size_t i) const;
+
+	/**
+		\~English
+		\brief
+			Reserve memory for temporary buffers used while searching in every shard.
+
+		\~Russian
+		\brief
+			Зарезервировать память для временных буферов, используемых при поиске, в каждом индексе-части.
+	*/
+	void reserveSearchMemory(const int64_t queries_count) const;
+
+private:
+
+	std::vector<pbio::TemplatesIndex::Ptr> _shards;
+
+	pbio::ThreadPool::Ptr _thread_pool;
+
+	int32_t refcounter4light_shared_ptr;
+
+	friend class object_with_ref_counter<ShardedTemplatesIndex>;
+};
+
+}  // pbio namespace
+
+
+
+////////////////////////
+/////IMPLEMENTATION/////
+////////////////////////
+
+namespace pbio
+{
+
+inline
+ShardedTemplatesIndex::ShardedTemplatesIndex(
+	const std::vector<pbio::TemplatesIndex::Ptr> &shards,
+	const pbio::ThreadPool::Ptr &thread_pool) :
+_shards(shards),
+_thread_pool(thread_pool)
+{
+	for(size_t i = 0; i < _shards.size(); ++i)
+	{
+		if(!_shards[i])
+		{
+			throw pbio::Error(0x1c6d8f42, "Error in pbio::ShardedTemplatesIndex: shard is NULL, error code: 0x1c6d8f42.");
+		}
+	}
+}
+
+
+inline
+const pbio::TemplatesIndex::Ptr& ShardedTemplatesIndex::shard(const size_t shard_index) const
+{
+	if(shard_index >= _shards.size())
+	{
+		throw pbio::Error(0x53e0a9b1, "Error in pbio::ShardedTemplatesIndex::shard: shard index out of range, error code: 0x53e0a9b1.");
+	}
+
+	return _shards[shard_index];
+}
+
+
+inline
+size_t ShardedTemplatesIndex::size() const
+{
+	size_t result = 0;
+
+	for(size_t i = 0; i < _shards.size(); ++i)
+		result += _shards[i]->size();
+
+	return result;
+}
+
+
+inline
+std::pair<size_t, size_t> ShardedTemplatesIndex::locate(size_t i) const
+{
+	for(size_t s = 0; s < _shards.size(); ++s)
+	{
+		const size_t shard_size = _shards[s]->size();
+
+		if(i < shard_size)
+			return std::make_pair(s, i);
+
+		i -= shard_size;
+	}
+
+	throw pbio::Error(0x7b24c5e0, "Error in pbio::ShardedTemplatesIndex: index out of range, error code: 0x7b24c5e0.");
+}
+
+
+inline
+pbio::Template::Ptr ShardedTemplatesIndex::at(const size_t i) const
+{
+	const std::pair<size_t, size_t> location = locate(i);
+
+	return _shards[location.first]->at(location.second);
+}
+
+
+inline
+void ShardedTemplatesIndex::reserveSearchMemory(const int64_t queries_count) const
+{
+	for(size_t i = 0; i < _shards.size(); ++i)
+		_shards[i]->reserveSearchMemory(queries_count);
+}
+
+}  // pbio namespace
+
+#endif  // __PBIO_API__PBIO__SHARDED_TEMPLATES_INDEX_H_
@@ -11,6 +11,9 @@
 #define __FACE_SDK_PBIO_LIGHT_SHARED_PTR_CHECK_NULL_USE__e8dbe74d9bf04bfa9d97e90c29e858f5
 // #define __FACE_SDK_PBIO_LIGHT_SHARED_PTR_NEED_REFCOUNTER__d213e87df35b4d47af0999a1192bce7d
 
+// allocate the nodes of light_shared_ptr from slab pools instead of one heap allocation per object
+// #define __FACE_SDK_PBIO_LIGHT_SHARED_PTR_POOL__
+
 #if defined( PBIO_OPENCV_SMART_POINTER )
 
 // for cv::Ptr
@@ -19,6 +19,7 @@
 #include "ComplexObject.h"
 #include "Error.h"
 #include "SmartPtr.h"
+#include "Template.h"
 #include "stl_wraps_impls/WrapOStreamImpl.h"
 
 
@@ -29,12 +30,21 @@ namespace pbio
 
 class Recognizer;
 
+//! @cond IGNORED
+// templates that an index created by Recognizer::createIndex(const PackedGallery&) references,
+// it is the first base of TemplatesIndex, so the templates are destroyed after the index object
+struct TemplatesIndexLoadedTemplates
+{
+	std::vector<pbio::Template::Ptr> _loaded_templates;
+};
+//! @endcond
+
 /** \~English
 	\brief Interface object for working with the template index.
 	\~Russian
 	\brief Интерфейсный объект для работы с индексом шаблонов.
 */
-class TemplatesIndex : public ComplexObject
+class TemplatesIndex : private TemplatesIndexLoadedTemplates, public ComplexObject
 {
 public:
 
@@ -0,0 +1,284 @@
+/**
+	\file ThreadPool.h
+	\~English
+	\brief ThreadPool - fixed set of worker threads for the parallel wrapper methods.
+	\~Russian
+	\brief ThreadPool - фиксированный набор рабочих потоков для параллельных методов обертки.
+*/
+
+#ifndef __PBIO_API__PBIO__THREAD_POOL_H_
+#define __PBIO_API__PBIO__THREAD_POOL_H_
+
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+#include "SmartPtr.h"
+
+
+namespace pbio
+{
+
+/** \~English
+	\brief
+		Fixed set of worker threads, can be shared by several objects
+		(ShardedTemplatesIndex, for example), which run their tasks with parallelFor.
+	\~Russian
+	\brief
+		Фиксированный набор рабочих потоков, может использоваться несколькими объектами
+		(например, ShardedTemplatesIndex), которые выполняют свои задачи с помощью parallelFor.
+*/
+class ThreadPool
+{
+public:
+
+	/** \~English
+		\brief Alias for the type of a smart pointer to ThreadPool.
+		\~Russian
+		\brief Псевдоним для типа умного указателя на ThreadPool.
+	*/
+	typedef LightSmartPtr<ThreadPool>::tPtr Ptr;
+
+	/**
+		\~English
+		\brief
+			Start worker threads.
+
+		\param[in]  threads_count
+			Number of threads that run the tasks, including the thread calling parallelFor,
+			so threads_count - 1 worker threads are started.
+			0 means std::thread::hardware_concurrency().
+
+		\~Russian
+		\brief
+			Запустить рабочие потоки.
+
+		\param[in]  threads_count
+			Количество потоков, выполняющих задачи, включая поток, вызывающий parallelFor,
+			поэтому запускается threads_count - 1 рабочих потоков.
+			0 означает std::thread::hardware_concurrency().
+	*/
+	explicit
+	ThreadPool(size_t threads_count = 0);
+
+	~ThreadPool();
+
+	/**
+		\~English
+		\brief Number of threads that run the tasks, including the calling thread.
+		\~Russian
+		\brief Количество потоков, выполняющих задачи, включая вызывающий поток.
+	*/
+	size_t threadsCount() const
+	{
+		return _workers.size() + 1;
+	}
+
+	/**
+		\~English
+		\brief
+			Call func(i) for each i in [0, tasks_count) in the pool threads and the calling thread,
+			return when all calls are finished.
+			Thread-safe, if one of the calls throws, the first exception is rethrown
+			after all calls are finished.
+
+		\~Russian
+		\brief
+			Вызвать func(i) для каждого i из [0, tasks_count) в потоках пула и вызывающем потоке,
+			вернуть управление после завершения всех вызовов.
+			Потокобезопасный, если один из вызовов выбрасывает исключение, первое исключение
+			выбрасывается повторно после завершения всех вызовов.
+	*/
+	template<typename Func>
+	void parallelFor(const size_t tasks_count, const Func &func);
+
+private:
+
+	ThreadPool(const ThreadPool&);
+	ThreadPool& operator=(const ThreadPool&);
+
+	struct Job
+	{
+		const std::function<void(size_t)>* func;
+		size_t tasks_count;
+		size_t next_task;
+		size_t finished_tasks;
+		std::exception_ptr error;
+		std::condition_variable finished;
+	};
+
+	// takes the next task of the job, _mutex must be locked
+	bool takeTask(Job &job, size_t &task);
+
+	// runs the task with _mutex unlocked
+	void runTask(Job &job, const size_t task, std::unique_lock<std::mutex> &lock);
+
+	void workerLoop();
+
+	int32_t refcounter4light_shared_ptr;
+
+	std::mutex _mutex;
+	std::condition_variable _new_job;
+	std::deque<Job*> _jobs;
+	bool _stop;
+
+	std::vector<std::thread> _workers;
+
+	friend class object_with_ref_counter<ThreadPool>;
+};
+
+}  // pbio namespace
+
+
+
+////////////////////////
+/////IMPLEMENTATION/////
+////////////////////////
+
+namespace pbio
+{
+
+inline
+ThreadPool::ThreadPool(size_t threads_count) :
+_stop(false)
+{
+	if(threads_count == 0)
+		threads_count = (std::max)(1u, std::thread::hardware_concurrency());
+
+	_workers.reserve(threads_count - 1);
+
+	for(size_t i = 1; i < threads_count; ++i)
+		_workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+
+inline
+ThreadPool::~ThreadPool()
+{
+	{
+		const std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+
+	_new_job.notify_all();
+
+	for(size_t i = 0; i < _workers.size(); ++i)
+		_workers[i].join();
+}
+
+
+template<typename Func>
+void ThreadPool::parallelFor(const size_t tasks_count, const Func &func)
+{
+	if(tasks_count == 0)
+		return;
+
+	const std::function<void(size_t)> func_wrap(std::cref(func));
+
+	Job job;
+	job.func = &func_wrap;
+	job.tasks_count = tasks_count;
+	job.next_task = 0;
+	job.finished_tasks = 0;
+
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	if(tasks_count > 1 && !_workers.empty())
+	{
+		_jobs.push_back(&job);
+		_new_job.notify_all();
+	}
+
+	// the calling thread takes part in its own job
+	size_t task;
+	while(takeTask(job, task))
+		runTask(job, task, lock);
+
+	job.finished.wait(lock, [&job]{ return job.finished_tasks == job.tasks_count; });
+
+	lock.unlock();
+
+	if(job.error)
+		std::rethrow_exception(job.error);
+}
+
+
+inline
+bool ThreadPool::takeTask(Job &job, size_t &task)
+{
+	if(job.next_task >= job.tasks_count)
+		return false;
+
+	task = job.next_task++;
+
+	// an exhausted job is not visible to the workers any more
+	if(job.next_task == job.tasks_count)
+	{
+		const std::deque<Job*>::iterator it = std::find(_jobs.begin(), _jobs.end(), &job);
+
+		if(it != _jobs.end())
+			_jobs.erase(it);
+	}
+
+	return true;
+}
+
+
+inline
+void ThreadPool::runTask(Job &job, const size_t task, std::unique_lock<std::mutex> &lock)
+{
+	lock.unlock();
+
+	std::exception_ptr error;
+
+	try
+	{
+		(*job.func)(task);
+	}
+	catch(...)
+	{
+		error = std::current_exception();
+	}
+
+	lock.lock();
+
+	if(error && !job.error)
+		job.error = error;
+
+	// the job lives on the stack of parallelFor, it must not be used after the last task is counted
+	if(++job.finished_tasks == job.tasks_count)
+		job.finished.notify_all();
+}
+
+
+inline
+void ThreadPool::workerLoop()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+
+	while(true)
+	{
+		_new_job.wait(lock, [this]{ return _stop || !_jobs.empty(); });
+
+		if(_stop)
+			return;
+
+		Job &job = *_jobs.front();
+
+		size_t task;
+		if(takeTask(job, task))
+			runTask(job, task, lock);
+	}
+}
+
+}  // pbio namespace
+
+#endif  // __PBIO_API__PBIO__THREAD_POOL_H_
@@ -0,0 +1,1089 @@
+/**
+	\file UpdatableTemplatesIndex.h
+	\~English
+	\brief UpdatableTemplatesIndex - templates index with add, remove and background compaction.
+	\~Russian
+	\brief UpdatableTemplatesIndex - индекс шаблонов с добавлением, удалением и фоновым сжатием.
+*/
+
+#ifndef __PBIO_API__PBIO__UPDATABLE_TEMPLATES_INDEX_H_
+#define __PBIO_API__PBIO__UPDATABLE_TEMPLATES_INDEX_H_
+
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+#include "Error.h"
+#include "Recognizer.h"
+#include "SearchResultBuffer.h"
+#include "SmartPtr.h"
+#include "Template.h"
+#include "TemplatesIndex.h"
+
+
+namespace pbio
+{
+
+/** \~English
+	\brief
+		Templates index that supports adding and removing templates without rebuilding
+		the whole index.
+		Templates are kept in TemplatesIndex segments: the large base and small immutable delta chunks
+		with the templates added since the last compaction. Adding templates builds a chunk only from them,
+		the last chunks are merged while they are of close sizes, so the count of chunks
+		grows logarithmically with the count of added templates.
+		Removing a template marks it in the tombstones of its segment, removed templates are skipped
+		by search. When the delta chunks and the removed templates of the base exceed compaction_ratio of the base,
+		the base is rebuilt from the live templates and the tombstones of the old segments are dropped.
+		Every template gets a stable id (returned by add), search results contain ids.
+		Not thread-safe: search, add, remove and compact use the recognizer passed to the constructor
+		and must not be called concurrently. The background compaction uses its own recognizer
+		and does not block them.
+	\~Russian
+	\brief
+		Индекс шаблонов с добавлением и удалением шаблонов без перестроения
+		всего индекса.
+		Шаблоны хранятся в сегментах TemplatesIndex: большом базовом и маленьких неизменяемых дельта-частях
+		с шаблонами, добавленными после последнего сжатия. Добавление шаблонов строит часть только из них,
+		последние части объединяются, пока их размеры близки, поэтому количество частей
+		растет логарифмически от количества добавленных шаблонов.
+		Удаление шаблона отмечает его в списке удаленных его сегмента, удаленные шаблоны
+		пропускаются при поиске. Когда дельта-части и удаленные шаблоны базового сегмента превышают compaction_ratio от базового,
+		базовый сегмент перестраивается из оставшихся шаблонов, а списки удаленных старых сегментов освобождаются.
+		Каждый шаблон получает постоянный идентификатор (возвращается add), результаты поиска содержат идентификаторы.
+		Не потокобезопасный: search, add, remove и compact используют распознаватель, переданный в конструктор,
+		и не должны вызываться одновременно. Фоновое сжатие использует свой распознаватель
+		и не блокирует их.
+*/
+class UpdatableTemplatesIndex
+{
+public:
+
+	/** \~English
+		\brief Alias for the type of a smart pointer to UpdatableTemplatesIndex.
+		\~Russian
+		\brief Псевдоним для типа умного указателя на UpdatableTemplatesIndex.
+	*/
+	typedef LightSmartPtr<UpdatableTemplatesIndex>::tPtr Ptr;
+
+	/**
+		\~English
+		\brief
+			Create an index.
+
+		\param[in]  recognizer
+			Recognizer that created the templates, used to build and search the segments.
+
+		\param[in]  templates
+			Initial templates, the i-th template gets id i.
+
+		\param[in]  search_threads_count
+			Count of threads that will be used while searching in the segments.
+
+		\param[in]  compaction_ratio
+			The compaction starts when the number of templates in the delta chunks
+			and of removed templates of the base exceeds compaction_ratio * (size of the base segment).
+
+		\param[in]  compaction_recognizer
+			Recognizer created with the same config, used by the background compaction
+			(Recognizer::createIndex and Recognizer::search are not thread-safe, so the compaction
+			can't share the recognizer with search).
+			If NULL, the compaction runs in the add or remove call that started it.
+
+		\~Russian
+		\brief
+			Создать индекс.
+
+		\param[in]  recognizer
+			Распознаватель, создавший шаблоны, используется для построения сегментов и поиска в них.
+
+		\param[in]  templates
+			Начальные шаблоны, i-й шаблон получает идентификатор i.
+
+		\param[in]  search_threads_count
+			Количество потоков для использования во время поиска в сегментах.
+
+		\param[in]  compaction_ratio
+			Сжатие запускается, когда количество шаблонов в дельта-частях
+			и удаленных шаблонов базового сегмента превышает compaction_ratio * (размер базового сегмента).
+
+		\param[in]  compaction_recognizer
+			Распознаватель, созданный с тем же конфигом, используется фоновым сжатием
+			(Recognizer::createIndex и Recognizer::search не потокобезопасные, поэтому сжатие
+			не может использовать распознаватель поиска).
+			Если NULL, сжатие выполняется в вызове add или remove, который его запустил.
+	*/
+	UpdatableTemplatesIndex(
+		const pbio::Recognizer::Ptr &recognizer,
+		const std::vector<pbio::Template::Ptr> &templates,
+		const int search_threads_count = 1,
+		const double compaction_ratio = 0.1,
+		const pbio::Recognizer::Ptr &compaction_recognizer = pbio::Recognizer::Ptr());
+
+	/**
+		\~English
+		\brief Waits for the background compaction.
+		\~Russian
+		\brief Ожидает завершения фонового сжатия.
+	*/
+	~UpdatableTemplatesIndex();
+
+	/**
+		\~English
+		\brief
+			Add templates.
+
+		\return
+			Ids of the added templates.
+
+		\~Russian
+		\brief
+			Добавить шаблоны.
+
+		\return
+			Идентификаторы добавленных шаблонов.
+	*/
+	std::vector<int64_t> add(const std::vector<pbio::Template::Ptr> &templates);
+
+	/**
+		\~English
+		\brief
+			Remove templates, already removed ids are ignored.
+
+		\~Russian
+		\brief
+			Удалить шаблоны, уже удаленные идентификаторы игнорируются.
+	*/
+	void remove(const std::vector<int64_t> &ids);
+
+	/**
+		\~English
+		\brief
+			Rebuild the base segment from the live templates in the calling thread
+			(waits for the running background compaction first).
+
+		\~Russian
+		\brief
+			Перестроить базовый сегмент из оставшихся шаблонов в вызывающем потоке
+			(сначала ожидает завершения запущенного фонового сжатия).
+	*/
+	void compact();
+
+	/**
+		\~English
+		\brief
+			Exceptions from the background compaction
+			are rethrown when this method is called.
+
+		\~Russian
+		\brief
+			Исключения, выброшенные при фоновом сжатии,
+			будут выброшены повторно при вызове данного метода.
+	*/
+	void checkExceptions();
+
+	/**
+		\~English
+		\brief Get a number of not removed templates.
+		\~Russian
+		\brief Получить количество неудаленных шаблонов.
+	*/
+	size_t size() const;
+
+	/**
+		\~English
+		\brief Check that the template with the id is added and not removed.
+		\~Russian
+		\brief Проверить, что шаблон с идентификатором добавлен и не удален.
+	*/
+	bool contains(const int64_t id) const;
+
+	/**
+		\~English
+		\brief Get the template with the id.
+		\~Russian
+		\brief Получить шаблон с идентификатором.
+	*/
+	pbio::Template::Ptr at(const int64_t id) const;
+
+	/**
+		\~English
+		\brief
+			Search for the k nearest not removed templates,
+			indexes in the result are template ids.
+			Does not allocate memory if the buffer already has enough memory
+			(see SearchResultBuffer::reserve with shards_count = 1 + count of the delta chunks).
+
+		\~Russian
+		\brief
+			Поиск k ближайших неудаленных шаблонов,
+			индексы в результате - идентификаторы шаблонов.
+			Не выделяет память, если в буфере уже достаточно памяти
+			(см. SearchResultBuffer::reserve с shards_count = 1 + количество дельта-частей).
+	*/
+	void search(
+		const std::vector<pbio::Template::Ptr> &queries_templates,
+		const size_t k,
+		SearchResultBuffer &result,
+		const Recognizer::SearchAccelerationType acceleration = Recognizer::SEARCH_ACCELERATION_1) const;
+
+	/**
+		\~English
+		\brief
+			Search for the k nearest not removed templates,
+			SearchResult::i is the template id.
+
+		\~Russian
+		\brief
+			Поиск k ближайших неудаленных шаблонов,
+			SearchResult::i - идентификатор шаблона.
+	*/
+	std::vector<std::vector<Recognizer::SearchResult> > search(
+		const std::vector<pbio::Template::Ptr> &queries_templates,
+		const size_t k,
+		const Recognizer::SearchAccelerationType acceleration = Recognizer::SEARCH_ACCELERATION_1) const;
+
+private:
+
+	UpdatableTemplatesIndex(const UpdatableTemplatesIndex&);
+	UpdatableTemplatesIndex& operator=(const UpdatableTemplatesIndex&);
+
+	// immutable part of the index, ids are in ascending order,
+	// templates are kept only for the delta chunks
+	struct Segment
+	{
+		typedef LightSmartPtr<Segment>::tPtr Ptr;
+
+		pbio::TemplatesIndex::Ptr index;
+		std::vector<pbio::Template::Ptr> templates;
+		std::vector<int64_t> ids;
+
+		int32_t refcounter4light_shared_ptr;
+	};
+
+	// bitmap of the removed positions of a segment, split into blocks,
+	// remove copies only the modified blocks, the others are shared with the previous state
+	struct Tombstones
+	{
+		typedef LightSmartPtr<Tombstones>::tPtr Ptr;
+
+		static const size_t block_words = 64;
+		static const size_t block_bits = block_words * 64;
+
+		struct Block
+		{
+			typedef LightSmartPtr<Block>::tPtr Ptr;
+
+			uint64_t words[block_words];
+
+			int32_t refcounter4light_shared_ptr;
+
+			Block()
+			{
+				std::fill(words, words + block_words, 0);
+			}
+		};
+
+		// NULL if no template of the block is removed
+		std::vector<Block::Ptr> blocks;
+
+		size_t count;
+
+		int32_t refcounter4light_shared_ptr;
+
+		Tombstones() :
+		count(0)
+		{
+		}
+
+		bool test(const size_t i) const
+		{
+			const Block* const block = blocks[i / block_bits].get();
+
+			return block && ((block->words[i % block_bits / 64] >> (i % 64)) & 1);
+		}
+
+		// the block of i must not be shared with other states
+		void set(const size_t i)
+		{
+			Block::Ptr &block = blocks[i / block_bits];
+
+			if(!block)
+				block = Block::Ptr::make();
+
+			uint64_t &word = block->words[i % block_bits / 64];
+			const uint64_t bit = uint64_t(1) << (i % 64);
+
+			if(word & bit)
+				return;
+
+			word |= bit;
+			++count;
+		}
+	};
+
+	struct Part
+	{
+		Segment::Ptr segment;
+
+		// NULL if no template of the segment is removed
+		Tombstones::Ptr removed;
+
+		bool isRemoved(const size_t i) const
+		{
+			return removed && removed->test(i);
+		}
+
+		size_t removedCount() const
+		{
+			return removed ? removed->count : 0;
+		}
+
+		pbio::Template::Ptr templateAt(const size_t i) const
+		{
+			return segment->templates.empty() ? segment->index->at(i) : segment->templates[i];
+		}
+	};
+
+	// snapshot of the index, replaced (not modified) by add, remove and compaction,
+	// so search works with a consistent snapshot without locks
+	struct State
+	{
+		typedef LightSmartPtr<State>::tPtr Ptr;
+
+		// the base segment and the delta chunks in ascending order of ids, chunks are never empty
+		std::vector<Part> parts;
+
+		int64_t next_id;
+
+		int32_t refcounter4light_shared_ptr;
+
+		State() :
+		next_id(0)
+		{
+		}
+
+		// the refcounter of the other state may be changed by other threads, it is not copied
+		State(const State &other) :
+		parts(other.parts),
+		next_id(other.next_id)
+		{
+		}
+
+		static bool idBeforePart(const int64_t id, const Part &part)
+		{
+			return id < part.segment->ids.front();
+		}
+
+		// false if the id was removed by a compaction or by a merge of the delta chunks
+		bool find(const int64_t id, size_t &part, size_t &i) const
+		{
+			part = std::upper_bound(parts.begin() + 1, parts.end(), id, idBeforePart) - parts.begin() - 1;
+
+			const std::vector<int64_t> &ids = parts[part].segment->ids;
+
+			i = std::lower_bound(ids.begin(), ids.end(), id) - ids.begin();
+
+			return i < ids.size() && ids[i] == id;
+		}
+
+		size_t deltaSize() const
+		{
+			size_t result = 0;
+
+			for(size_t p = 1; p < parts.size(); ++p)
+				result += parts[p].segment->ids.size();
+
+			return result;
+		}
+	};
+
+	// the last delta chunk is merged with the previous one while the previous one
+	// is at most delta_merge_factor times larger and the result is at most max_delta_chunk_size
+	static const size_t delta_merge_factor = 2;
+	static const size_t max_delta_chunk_size = 16384;
+
+	State::Ptr state() const;
+
+	void setState(const State::Ptr &state);
+
+	Segment::Ptr createSegment(
+		const pbio::Recognizer &recognizer,
+		const std::vector<pbio::Template::Ptr> &templates,
+		const std::vector<int64_t> &ids,
+		const bool keep_templates) const;
+
+	void mergeDeltaChunks(State &state) const;
+
+	bool compactionNeeded(const State &state) const;
+
+	// runs the compaction in the calling thread or starts the background compaction if it is not running,
+	// _update_mutex must not be locked
+	void startCompaction();
+
+	void compactionThread();
+
+	void compactImpl(const pbio::Recognizer &recognizer);
+
+	const pbio::Recognizer::Ptr _recognizer;
+	const pbio::Recognizer::Ptr _compaction_recognizer;
+	const int _search_threads_count;
+	const double _compaction_ratio;
+
+	mutable std::mutex _state_mutex;
+	State::Ptr _state;
+
+	// serializes add, remove and the swap of the compacted state
+	std::mutex _update_mutex;
+
+	// serializes compactions
+	std::mutex _compaction_mutex;
+
+	std::thread _compaction_thread;
+	bool _compaction_running;
+	std::exception_ptr _compaction_exception;
+
+	int32_t refcounter4light_shared_ptr;
+
+	friend class object_with_ref_counter<UpdatableTemplatesIndex>;
+};
+
+}  // pbio namespace
+
+
+
+////////////////////////
+/////IMPLEMENTATION/////
+////////////////////////
+
+namespace pbio
+{
+
+inline
+UpdatableTemplatesIndex::UpdatableTemplatesIndex(
+	const pbio::Recognizer::Ptr &recognizer,
+	const std::vector<pbio::Template::Ptr> &templates,
+	const int search_threads_count,
+	const double compaction_ratio,
+	const pbio::Recognizer::Ptr &compaction_recognizer) :
+_recognizer(recognizer),
+_compaction_recognizer(compaction_recognizer),
+_search_threads_count(search_threads_count),
+_compaction_ratio(compaction_ratio),
+_compaction_running(false)
+{
+	std::vector<int64_t> ids(templates.size());
+
+	for(size_t i = 0; i < ids.size(); ++i)
+		ids[i] = i;
+
+	const State::Ptr state = State::Ptr::make();
+
+	state->parts.resize(1);
+	state->parts[0].segment = createSegment(*_recognizer, templates, ids, false);
+	state->next_id = templates.size();
+
+	_state = state;
+}
+
+
+inline
+UpdatableTemplatesIndex::~UpdatableTemplatesIndex()
+{
+	if(_compaction_thread.joinable())
+		_compaction_thread.join();
+}
+
+
+inline
+UpdatableTemplatesIndex::State::Ptr UpdatableTemplatesIndex::state() const
+{
+	const std::lock_guard<std::mutex> lock(_state_mutex);
+
+	return _state;
+}
+
+
+inline
+void UpdatableTemplatesIndex::setState(const State::Ptr &state)
+{
+	State::Ptr old_state;
+
+	{
+		const std::lock_guard<std::mutex> lock(_state_mutex);
+
+		old_state = _state;
+		_state = state;
+	}
+
+	// the old state is released outside of the lock
+}
+
+
+inline
+UpdatableTemplatesIndex::Segment::Ptr UpdatableTemplatesIndex::createSegment(
+	const pbio::Recognizer &recognizer,
+	const std::vector<pbio::Template::Ptr> &templates,
+	const std::vector<int64_t> &ids,
+	const bool keep_templates) const
+{
+	const Segment::Ptr segment = Segment::Ptr::make();
+
+	if(!templates.empty())
+		segment->index = recognizer.createIndex(templates, _search_threads_count);
+
+	if(keep_templates)
+		segment->templates = templates;
+
+	segment->ids = ids;
+
+	return segment;
+}
+
+
+inline
+void UpdatableTemplatesIndex::mergeDeltaChunks(State &state) const
+{
+	while(state.parts.size() > 2)
+	{
+		const Part &previous = state.parts[state.parts.size() - 2];
+		const Part &last = state.parts.back();
+
+		const size_t previous_size = previous.segment->ids.size();
+		const size_t last_size = last.segment->ids.size();
+
+		if(previous_size > delta_merge_factor * last_size || previous_size + last_size > max_delta_chunk_size)
+			break;
+
+		// removed templates are dropped
+		std::vector<pbio::Template::Ptr> templates;
+		std::vector<int64_t> ids;
+
+		templates.reserve(previous_size + last_size);
+		ids.reserve(previous_size + last_size);
+
+		for(size_t p = state.parts.size() - 2; p < state.parts.size(); ++p)
+		{
+			const Part &part = state.parts[p];
+
+			for(size_t i = 0; i < part.segment->ids.size(); ++i)
+			{
+				if(part.isRemoved(i))
+					continue;
+
+				templates.push_back(part.segment->templates[i]);
+				ids.push_back(part.segment->ids[i]);
+			}
+		}
+
+		state.parts.resize(state.parts.size() - 2);
+
+		if(ids.empty())
+			continue;
+
+		state.parts.push_back(Part());
+		state.parts.back().segment = createSegment(*_recognizer, templates, ids, true);
+	}
+}
+
+
+inline
+std::vector<int64_t> UpdatableTemplatesIndex::add(const std::vector<pbio::Template::Ptr> &templates)
+{
+	std::vector<int64_t> result(templates.size());
+
+	if(templates.empty())
+		return result;
+
+	bool compaction_needed = false;
+
+	{
+		const std::lock_guard<std::mutex> update_lock(_update_mutex);
+
+		const State::Ptr current = state();
+
+		for(size_t i = 0; i < templates.size(); ++i)
+			result[i] = current->next_id + i;
+
+		// only a chunk of the new templates is built, the other segments are shared with the current state
+		const State::Ptr next = State::Ptr::make(*current);
+
+		next->parts.push_back(Part());
+		next->parts.back().segment = createSegment(*_recognizer, templates, result, true);
+		next->next_id += templates.size();
+
+		mergeDeltaChunks(*next);
+
+		setState(next);
+
+		compaction_needed = compactionNeeded(*next);
+	}
+
+	if(compaction_needed)
+		startCompaction();
+
+	return result;
+}
+
+
+inline
+void UpdatableTemplatesIndex::remove(const std::vector<int64_t> &ids)
+{
+	// sorted ids visit the parts and the blocks of the tombstones in order,
+	// so each modified block is copied once
+	std::vector<int64_t> sorted_ids(ids);
+
+	std::sort(sorted_ids.begin(), sorted_ids.end());
+
+	bool compaction_needed = false;
+
+	{
+		const std::lock_guard<std::mutex> update_lock(_update_mutex);
+
+		const State::Ptr next = State::Ptr::make(*state());
+
+		size_t copied_part = next->parts.size();
+		size_t copied_block = 0;
+
+		for(size_t k = 0; k < sorted_ids.size(); ++k)
+		{
+			const int64_t id = sorted_ids[k];
+
+			if(id < 0 || id >= next->next_id)
+			{
+				throw pbio::Error(0x24f1b6d9, "Error in pbio::UpdatableTemplatesIndex::remove: unknown id, error code: 0x24f1b6d9.");
+			}
+
+			size_t p, i;
+
+			// already removed by a compaction or by a merge of the delta chunks
+			if(!next->find(id, p, i))
+				continue;
+
+			Part &part = next->parts[p];
+
+			if(part.isRemoved(i))
+				continue;
+
+			if(p != copied_part)
+			{
+				const Tombstones::Ptr removed = Tombstones::Ptr::make();
+
+				if(part.removed)
+				{
+					removed->blocks = part.removed->blocks;
+					removed->count = part.removed->count;
+				}
+				else
+				{
+					removed->blocks.resize((part.segment->ids.size() + Tombstones::block_bits - 1) / Tombstones::block_bits);
+				}
+
+				part.removed = removed;
+
+				copied_part = p;
+				copied_block = removed->blocks.size();
+			}
+
+			const size_t b = i / Tombstones::block_bits;
+
+			if(b != copied_block)
+			{
+				Tombstones::Block::Ptr &block = part.removed->blocks[b];
+
+				if(block)
+				{
+					const Tombstones::Block::Ptr copy = Tombstones::Block::Ptr::make();
+
+					std::copy(block->words, block->words + Tombstones::block_words, copy->words);
+
+					block = copy;
+				}
+
+				copied_block = b;
+			}
+
+			part.removed->set(i);
+		}
+
+		setState(next);
+
+		compaction_needed = compactionNeeded(*next);
+	}
+
+	if(compaction_needed)
+		startCompaction();
+}
+
+
+inline
+bool UpdatableTemplatesIndex::compactionNeeded(const State &state) const
+{
+	const size_t changes_count = state.deltaSize() + state.parts[0].removedCount();
+
+	return changes_count > 0 && changes_count > _compaction_ratio * state.parts[0].segment->ids.size();
+}
+
+
+inline
+void UpdatableTemplatesIndex::startCompaction()
+{
+	if(!_compaction_recognizer)
+	{
+		compactImpl(*_recognizer);
+		return;
+	}
+
+	const std::lock_guard<std::mutex> update_lock(_update_mutex);
+
+	if(_compaction_running)
+		return;
+
+	if(_compaction_thread.joinable())
+		_compaction_thread.join();
+
+	_compaction_running = true;
+
+	_compaction_thread = std::thread(&UpdatableTemplatesIndex::compactionThread, this);
+}
+
+
+inline
+void UpdatableTemplatesIndex::compactionThread()
+{
+	std::exception_ptr exception;
+
+	try
+	{
+		compactImpl(*_compaction_recognizer);
+	}
+	catch(...)
+	{
+		exception = std::current_exception();
+	}
+
+	const std::lock_guard<std::mutex> update_lock(_update_mutex);
+
+	if(exception)
+		_compaction_exception = exception;
+
+	_compaction_running = false;
+}
+
+
+inline
+void UpdatableTemplatesIndex::compact()
+{
+	compactImpl(*_recognizer);
+}
+
+
+inline
+void UpdatableTemplatesIndex::compactImpl(const pbio::Recognizer &recognizer)
+{
+	const std::lock_guard<std::mutex> compaction_lock(_compaction_mutex);
+
+	const State::Ptr start = state();
+
+	std::vector<pbio::Template::Ptr> templates;
+	std::vector<int64_t> ids;
+
+	for(size_t p = 0; p < start->parts.size(); ++p)
+	{
+		const Part &part = start->parts[p];
+
+		for(size_t i = 0; i < part.segment->ids.size(); ++i)
+		{
+			if(part.isRemoved(i))
+				continue;
+
+			templates.push_back(part.templateAt(i));
+			ids.push_back(part.segment->ids[i]);
+		}
+	}
+
+	// the long part, add and remove are not blocked
+	const Segment::Ptr base = createSegment(recognizer, templates, ids, false);
+
+	templates.clear();
+
+	const std::lock_guard<std::mutex> update_lock(_update_mutex);
+
+	const State::Ptr current = state();
+	const State::Ptr next = State::Ptr::make();
+
+	next->parts.resize(1);
+	next->parts[0].segment = base;
+	next->next_id = current->next_id;
+
+	// templates removed during the compaction, both id lists are in ascending order
+	{
+		size_t p = 0;
+		size_t i = 0;
+
+		for(size_t j = 0; j < base->ids.size(); ++j)
+		{
+			while(p < current->parts.size())
+			{
+				const std::vector<int64_t> &current_ids = current->parts[p].segment->ids;
+
+				if(i == current_ids.size())
+				{
+					++p;
+					i = 0;
+				}
+				else if(current_ids[i] < base->ids[j])
+				{
+					++i;
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			const bool live =
+				p < current->parts.size() &&
+				current->parts[p].segment->ids[i] == base->ids[j] &&
+				!current->parts[p].isRemoved(i);
+
+			if(live)
+				continue;
+
+			Tombstones::Ptr &removed = next->parts[0].removed;
+
+			if(!removed)
+			{
+				removed = Tombstones::Ptr::make();
+				removed->blocks.resize((base->ids.size() + Tombstones::block_bits - 1) / Tombstones::block_bits);
+			}
+
+			removed->set(j);
+		}
+	}
+
+	// chunks added during the compaction are kept, chunks merged during it are rebuilt without the compacted templates
+	for(size_t p = 1; p < current->parts.size(); ++p)
+	{
+		const Part &part = current->parts[p];
+
+		if(part.segment->ids.back() < start->next_id)
+			continue;
+
+		if(part.segment->ids.front() >= start->next_id)
+		{
+			next->parts.push_back(part);
+			continue;
+		}
+
+		std::vector<int64_t> chunk_ids;
+
+		for(size_t i = 0; i < part.segment->ids.size(); ++i)
+		{
+			if(part.segment->ids[i] < start->next_id || part.isRemoved(i))
+				continue;
+
+			templates.push_back(part.segment->templates[i]);
+			chunk_ids.push_back(part.segment->ids[i]);
+		}
+
+		if(!chunk_ids.empty())
+		{
+			next->parts.push_back(Part());
+			next->parts.back().segment = createSegment(recognizer, templates, chunk_ids, true);
+		}
+
+		templates.clear();
+	}
+
+	setState(next);
+}
+
+
+inline
+void UpdatableTemplatesIndex::checkExceptions()
+{
+	std::exception_ptr exception;
+
+	{
+		const std::lock_guard<std::mutex> update_lock(_update_mutex);
+
+		exception = _compaction_exception;
+		_compaction_exception = std::exception_ptr();
+	}
+
+	if(exception)
+		std::rethrow_exception(exception);
+}
+
+
+inline
+size_t UpdatableTemplatesIndex::size() const
+{
+	const State::Ptr current = state();
+
+	size_t result = 0;
+
+	for(size_t p = 0; p < current->parts.size(); ++p)
+		result += current->parts[p].segment->ids.size() - current->parts[p].removedCount();
+
+	return result;
+}
+
+
+inline
+bool UpdatableTemplatesIndex::contains(const int64_t id) const
+{
+	const State::Ptr current = state();
+
+	size_t p, i;
+
+	return id >= 0 && id < current->next_id && current->find(id, p, i) && !current->parts[p].isRemoved(i);
+}
+
+
+inline
+pbio::Template::Ptr UpdatableTemplatesIndex::at(const int64_t id) const
+{
+	const State::Ptr current = state();
+
+	size_t p, i;
+
+	if(id < 0 || id >= current->next_id || !current->find(id, p, i) || current->parts[p].isRemoved(i))
+	{
+		throw pbio::Error(0x5d38e0a6, "Error in pbio::UpdatableTemplatesIndex::at: unknown or removed id, error code: 0x5d38e0a6.");
+	}
+
+	return current->parts[p].templateAt(i);
+}
+
+
+inline
+void UpdatableTemplatesIndex::search(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const size_t k,
+	SearchResultBuffer &result,
+	const Recognizer::SearchAccelerationType acceleration) const
+{
+	const State::Ptr current = state();
+
+	const size_t queries_count = queries_templates.size();
+
+	result.resize(queries_count, k);
+
+	if(queries_count == 0 || k == 0)
+	{
+		result.countValid();
+		return;
+	}
+
+	// removed templates are skipped, so each segment is searched for k + removed count
+	size_t segments_count = 0;
+	size_t shard_k = 0;
+
+	for(size_t p = 0; p < current->parts.size(); ++p)
+	{
+		const Part &part = current->parts[p];
+
+		if(!part.segment->index)
+			continue;
+
+		shard_k = (std::max)(shard_k, (std::min)(part.segment->ids.size(), k + part.removedCount()));
+		++segments_count;
+	}
+
+	result.resizeShards(segments_count, shard_k);
+
+	size_t s = 0;
+
+	for(size_t p = 0; p < current->parts.size(); ++p)
+	{
+		const Part &part = current->parts[p];
+
+		if(!part.segment->index)
+			continue;
+
+		const size_t segment_k = (std::min)(part.segment->ids.size(), k + part.removedCount());
+
+		_recognizer->search(queries_templates, *part.segment->index, segment_k, result, acceleration);
+
+		for(size_t q = 0; q < queries_count; ++q)
+		{
+			const size_t src = q * segment_k;
+			const size_t dst = (s * queries_count + q) * shard_k;
+
+			size_t size = 0;
+
+			for(size_t j = 0; j < segment_k; ++j)
+			{
+				const int64_t local = result._columns.indexes[src + j];
+
+				if(local < 0)
+					break;
+
+				if(part.isRemoved(local))
+					continue;
+
+				result._shard_columns.indexes[dst + size] = local;
+				result._shard_columns.distances[dst + size] = result._columns.distances[src + j];
+				result._shard_columns.fars[dst + size] = result._columns.fars[src + j];
+				result._shard_columns.frrs[dst + size] = result._columns.frrs[src + j];
+				result._shard_columns.scores[dst + size] = result._columns.scores[src + j];
+
+				++size;
+			}
+
+			std::fill(
+				result._shard_columns.indexes.begin() + dst + size,
+				result._shard_columns.indexes.begin() + dst + shard_k,
+				-1);
+		}
+
+		result._shard_ids.push_back(part.segment->ids.data());
+
+		++s;
+	}
+
+	result.resize(queries_count, k);
+
+	result.mergeShards();
+}
+
+
+inline
+std::vector<std::vector<Recognizer::SearchResult> > UpdatableTemplatesIndex::search(
+	const std::vector<pbio::Template::Ptr> &queries_templates,
+	const size_t k,
+	const Recognizer::SearchAccelerationType acceleration) const
+{
+	SearchResultBuffer buffer(queries_templates.size(), k, 2);
+
+	search(queries_templates, k, buffer, acceleration);
+
+	std::vector<std::vector<Recognizer::SearchResult> > result(queries_templates.size());
+
+	for(size_t i = 0; i < result.size(); ++i)
+	{
+		result[i].resize(buffer.size(i));
+
+		for(size_t j = 0; j < result[i].size(); ++j)
+		{
+			result[i][j].i = buffer.indexes(i)[j];
+			result[i][j].match_result.distance = buffer.distances(i)[j];
+			result[i][j].match_result.fa_r = buffer.fars(i)[j];
+			result[i][j].match_result.fr_r = buffer.frrs(i)[j];
+			result[i][j].match_result.score = buffer.scores(i)[j];
+		}
+	}
+
+	return result;
+}
+
+}  // pbio namespace
+
+#endif  // __PBIO_API__PBIO__UPDATABLE_TEMPLATES_INDEX_H_
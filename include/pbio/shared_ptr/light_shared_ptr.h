@@ -12,9 +12,14 @@
 namespace pbio
 {
 
-template<typename T>
+// RefCounter is a refcounter policy from object_with_ref_counter.h,
+// pointers with different policies can share one object, if it is used in one thread only
+template<typename T, typename RefCounter = atomic_refcounter>
 class light_shared_ptr
 {
+	template<typename, typename>
+	friend class light_shared_ptr;
+
 public:
 
 
@@ -25,7 +30,7 @@ public:
 	{
 		if(ptr)
 		{
-			ptr->increment_refcounter();
+			ptr->template increment_refcounter<RefCounter>();
 		}
 	}
 
@@ -37,11 +42,21 @@ public:
 	}
 
 
+	template<typename OtherRefCounter>
+	explicit light_shared_ptr(const light_shared_ptr<T, OtherRefCounter> &a) : ptr(a.ptr)
+	{
+		if(ptr)
+		{
+			ptr->template increment_refcounter<RefCounter>();
+		}
+	}
+
+
 	~light_shared_ptr()
 	{
 		if(ptr)
 		{
-			ptr->decrement_refcounter();
+			ptr->template decrement_refcounter<RefCounter>();
 		}
 	}
 
@@ -55,14 +70,14 @@ public:
 
 		if(ptr)
 		{
-			ptr->decrement_refcounter();
+			ptr->template decrement_refcounter<RefCounter>();
 		}
 
 		ptr = a.ptr;
 
 		if(ptr)
 		{
-			ptr->increment_refcounter();
+			ptr->template increment_refcounter<RefCounter>();
 		}
 
 		return *this;
@@ -78,7 +93,7 @@ public:
 
 		if (ptr)
 		{
-			ptr->decrement_refcounter();
+			ptr->template decrement_refcounter<RefCounter>();
 		}
 
 		ptr = a.ptr;
@@ -114,7 +129,7 @@ public:
 	{
 		if(ptr)
 		{
-			ptr->decrement_refcounter();
+			ptr->template decrement_refcounter<RefCounter>();
 			ptr = NULL;
 		}
 	}
@@ -201,7 +216,7 @@ private:
 	{
 		if(ptr)
 		{
-			ptr->increment_refcounter();
+			ptr->template increment_refcounter<RefCounter>();
 		}
 	}
 
@@ -210,16 +225,16 @@ private:
 };
 
 
-template<typename T>
+template<typename T, typename RefCounterA, typename RefCounterB>
 inline
-bool operator == (const light_shared_ptr<T> &a, const light_shared_ptr<T> &b)
+bool operator == (const light_shared_ptr<T, RefCounterA> &a, const light_shared_ptr<T, RefCounterB> &b)
 {
 	return a.get() == b.get();
 }
 
-template<typename T>
+template<typename T, typename RefCounterA, typename RefCounterB>
 inline
-bool operator != (const light_shared_ptr<T> &a, const light_shared_ptr<T> &b)
+bool operator != (const light_shared_ptr<T, RefCounterA> &a, const light_shared_ptr<T, RefCounterB> &b)
 {
 	return a.get() != b.get();
 }
@@ -0,0 +1,229 @@
+#ifndef __FACE_SDK__PBIO__NODE_POOL_H__0c5e3d1f8b7a4e62a9f1d27c4b86e3a5
+#define __FACE_SDK__PBIO__NODE_POOL_H__0c5e3d1f8b7a4e62a9f1d27c4b86e3a5
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+//! @cond IGNORED
+
+namespace pbio
+{
+
+// slab allocator of fixed size nodes, used by object_with_ref_counter
+// when __FACE_SDK_PBIO_LIGHT_SHARED_PTR_POOL__ is defined
+//
+// nodes are taken from slabs of slab_nodes_count nodes without the per-allocation
+// malloc header, slabs are never returned to the system.
+// each thread allocates from and frees to its own cache without synchronization,
+// the cache exchanges batches of batch_nodes_count nodes with a lock-free global list,
+// so a node freed by another thread is reused after its batch moves to the global list.
+// the global list is only pushed to with a CAS and taken whole with an exchange,
+// which keeps it free of the ABA problem without tagged pointers.
+// the mutex guards only the list of slabs, taken once per slab_nodes_count new nodes
+template<size_t node_size, size_t node_align>
+class node_pool
+{
+	// slabs come from ::operator new, aligned for std::max_align_t
+	static_assert(node_align <= alignof(std::max_align_t), "node_pool doesn't support over-aligned nodes");
+
+public:
+
+	// the pool is never destroyed, so nodes of static objects
+	// can be freed after the end of main
+	static node_pool& instance()
+	{
+		static node_pool* const pool = new node_pool();
+
+		return *pool;
+	}
+
+	void* allocate()
+	{
+		thread_cache& cache = local_cache();
+
+		if(!cache.head)
+			refill(cache);
+
+		free_node* const result = cache.head;
+
+		cache.head = result->next;
+		--cache.count;
+
+		return result;
+	}
+
+	void deallocate(void* const ptr)
+	{
+		if(!ptr)
+			return;
+
+		thread_cache& cache = local_cache();
+
+		free_node* const node = static_cast<free_node*>(ptr);
+
+		// the cache of this thread is already returned to the global list
+		// by cache_owner, nodes freed after that go to the global list directly
+		if(cache.closed)
+		{
+			node->next = NULL;
+			push_batches(node, node);
+			return;
+		}
+
+		node->next = cache.head;
+		cache.head = node;
+
+		if(++cache.count >= 2 * batch_nodes_count)
+			flush_batch(cache);
+	}
+
+private:
+
+	struct free_node
+	{
+		free_node* next;        // next node of the cache or of the batch
+		free_node* next_batch;  // next batch of the global list, set in the first node of a batch
+	};
+
+	// trivially destructible, so it stays usable in the destructors
+	// of other thread_local objects that free nodes after cache_owner
+	struct thread_cache
+	{
+		free_node* head;
+		size_t count;
+		bool registered;
+		bool closed;
+	};
+
+	// returns the nodes of the cache to the global list on the thread exit
+	struct cache_owner
+	{
+		thread_cache* cache;
+
+		~cache_owner()
+		{
+			if(cache->head)
+				instance().push_batches(cache->head, cache->head);
+
+			cache->head = NULL;
+			cache->count = 0;
+			cache->closed = true;
+		}
+	};
+
+	static const size_t slab_nodes_count = 256;
+	static const size_t batch_nodes_count = 64;
+
+	static const size_t align = node_align < alignof(free_node) ? alignof(free_node) : node_align;
+
+	static const size_t stride =
+		((node_size < sizeof(free_node) ? sizeof(free_node) : node_size) + align - 1) / align * align;
+
+	node_pool() : _global(NULL) {}
+
+	static thread_cache& local_cache()
+	{
+		static thread_local thread_cache cache = {NULL, 0, false, false};
+
+		if(!cache.registered)
+		{
+			static thread_local cache_owner owner = {&cache};
+
+			(void) owner;
+			cache.registered = true;
+		}
+
+		return cache;
+	}
+
+	void refill(thread_cache& cache)
+	{
+		free_node* const batches = _global.exchange(NULL, std::memory_order_acquire);
+
+		if(!batches)
+		{
+			add_slab(cache);
+			return;
+		}
+
+		// the first batch goes to the cache, the rest goes back
+		if(free_node* const rest = batches->next_batch)
+		{
+			free_node* last = rest;
+
+			while(last->next_batch)
+				last = last->next_batch;
+
+			push_batches(rest, last);
+		}
+
+		cache.head = batches;
+		cache.count = 0;
+
+		for(free_node* node = batches; node; node = node->next)
+			++cache.count;
+	}
+
+	// moves batch_nodes_count nodes from the head of the cache to the global list
+	void flush_batch(thread_cache& cache)
+	{
+		free_node* const first = cache.head;
+		free_node* last = first;
+
+		for(size_t i = 1; i < batch_nodes_count; ++i)
+			last = last->next;
+
+		cache.head = last->next;
+		cache.count -= batch_nodes_count;
+
+		last->next = NULL;
+		push_batches(first, first);
+	}
+
+	// pushes the batches from first to last, linked by next_batch
+	void push_batches(free_node* const first, free_node* const last)
+	{
+		free_node* head = _global.load(std::memory_order_relaxed);
+
+		do
+		{
+			last->next_batch = head;
+		}
+		while(!_global.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	void add_slab(thread_cache& cache)
+	{
+		char* const slab = static_cast<char*>(::operator new(stride * slab_nodes_count));
+
+		{
+			std::lock_guard<std::mutex> lock(_slabs_mutex);
+
+			_slabs.push_back(slab);
+		}
+
+		for(size_t i = slab_nodes_count; i > 0; --i)
+		{
+			free_node* const node = reinterpret_cast<free_node*>(slab + (i - 1) * stride);
+
+			node->next = cache.head;
+			cache.head = node;
+		}
+
+		cache.count += slab_nodes_count;
+	}
+
+	std::atomic<free_node*> _global;
+
+	std::mutex _slabs_mutex;
+	std::vector<char*> _slabs;
+};
+
+}  // pbio namespace
+
+//! @endcond
+
+#endif  // __FACE_SDK__PBIO__NODE_POOL_H__0c5e3d1f8b7a4e62a9f1d27c4b86e3a5
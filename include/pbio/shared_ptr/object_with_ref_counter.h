@@ -1,13 +1,44 @@
 #ifndef __FACE_SDK__PBIO__OBJECT_WITH_REF_COUNTER_H__2a81343862d047159b41d58bfe5e730b
 #define __FACE_SDK__PBIO__OBJECT_WITH_REF_COUNTER_H__2a81343862d047159b41d58bfe5e730b
 
+#include <stdint.h>
+
 #include "atomic_exchange_add.h"
 
+#ifdef __FACE_SDK_PBIO_LIGHT_SHARED_PTR_POOL__
+#include "node_pool.h"
+#endif
+
 //! @cond IGNORED
 
 namespace pbio
 {
 
+// refcounter policies of light_shared_ptr,
+// exchange_add returns the value before the addition
+
+// default, pointers to the same object can be copied and destroyed in different threads
+class atomic_refcounter
+{
+public:
+	static inline int32_t exchange_add(int32_t &x, const int32_t delta)
+	{
+		return atomic_exchange_add(x, delta);
+	}
+};
+
+// all pointers to the object must be copied and destroyed in one thread
+class single_thread_refcounter
+{
+public:
+	static inline int32_t exchange_add(int32_t &x, const int32_t delta)
+	{
+		const int32_t result = x;
+		x += delta;
+		return result;
+	}
+};
+
 template<typename T>
 class object_with_ref_counter
 {
@@ -35,19 +66,35 @@ public:
 
 
 
+	template<typename RefCounter>
 	void increment_refcounter()
 	{
-		atomic_exchange_add(refcounter(), 1);
+		RefCounter::exchange_add(refcounter(), 1);
 	}
 
+	template<typename RefCounter>
 	void decrement_refcounter()
 	{
-		if(atomic_exchange_add(refcounter(), -1) == 1)
+		if(RefCounter::exchange_add(refcounter(), -1) == 1)
 		{
 			delete this;
 		}
 	}
 
+#ifdef __FACE_SDK_PBIO_LIGHT_SHARED_PTR_POOL__
+
+	static void* operator new(size_t)
+	{
+		return node_pool<sizeof(object_with_ref_counter), alignof(object_with_ref_counter)>::instance().allocate();
+	}
+
+	static void operator delete(void* ptr)
+	{
+		node_pool<sizeof(object_with_ref_counter), alignof(object_with_ref_counter)>::instance().deallocate(ptr);
+	}
+
+#endif
+
 
 	object_with_ref_counter():
 	object() { refcounter() = 0; }
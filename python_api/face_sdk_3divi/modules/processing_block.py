@@ -8,7 +8,7 @@
 import sys
 import json
 from ctypes import c_void_p, c_char_p, create_string_buffer, POINTER, c_int32, c_int64
-from typing import Union
+from typing import List, Union
 
 from .complex_object import ComplexObject
 from .exception_check import check_exception, check_processing_block_exception, make_exception
@@ -54,6 +54,28 @@ class ProcessingBlock(ComplexObject):
         else:
             raise Error(0xa341de35, "Wrong type of ctx")
 
+    ##
+    # \~English
+    #    \brief Calling the processing block function for each element of a batch, in order.
+    #
+    #    \param[in] ctxs list of Context or dict.
+    #
+    # \~Russian
+    #    \brief Вызов функции процессинг-блока для каждого элемента пакета по порядку.
+    #
+    #    \param[in] ctxs список Context или dict.
+    #
+    def process_batch(self, ctxs: List[Union[dict, Context]]):
+        for ctx in ctxs:
+            if not isinstance(ctx, (dict, Context)):
+                raise Error(0xa341de35, "Wrong type of ctx")
+
+        for i, ctx in enumerate(ctxs):
+            try:
+                self(ctx)
+            except Error as error:
+                raise Error(error.code(), "context {}: {}".format(i, error.what())) from error
+
     def __call_dicts(self, ctx: dict):
         exception = make_exception()
         meta_ctx = Context(self._dll_handle)